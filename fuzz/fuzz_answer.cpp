@@ -0,0 +1,34 @@
+/**
+ * DNSAnswer::parse（含 RDATA 域名展开）的模糊测试入口
+ *
+ * 与 forwardQuery() 解析上游响应的顺序相同：跳过 Question，再解析所有资源记录。
+ * 不变量：offset 不超过报文长度；rdlength 与展开后的 RDATA 长度一致
+ */
+
+#include "fuzz_common.hpp"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    RequestArena& arena = fuzzArena();
+
+    DNSHeader header;
+    if (DNSHeader::parse(data, size, header) != ParseError::NONE) return 0;
+
+    size_t offset = 12;
+    for (uint16_t i = 0; i < header.qdcount; i++)
+    {
+        DNSQuestion question(arena.resource());
+        if (DNSQuestion::parse(data, size, offset, question) != ParseError::NONE) return 0;
+    }
+
+    uint32_t records = static_cast<uint32_t>(header.ancount) + header.nscount + header.arcount;
+    for (uint32_t i = 0; i < records; i++)
+    {
+        DNSAnswer answer(arena.resource());
+        if (DNSAnswer::parse(data, size, offset, answer) != ParseError::NONE) break;
+        FUZZ_CHECK(offset <= size);
+        FUZZ_CHECK(answer.rdata.size() == answer.rdlength);
+        FUZZ_CHECK(answer.name.size() < DNSQuestion::MAX_NAME_LENGTH);
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+/**
+ * 模糊测试（fuzzing）公共代码
+ *
+ * 每个 fuzz_*.cpp 实现一个 libFuzzer 入口 LLVMFuzzerTestOneInput()，
+ * 输入都是“一个完整的 UDP 报文”，与主循环收到的数据相同。
+ *
+ * 构建与运行（默认不构建，不影响 dns-server）：
+ *   Clang（真正的 libFuzzer + ASan + UBSan）:
+ *     CXX=clang++ cmake -S . -B build-fuzz -DDNS_BUILD_FUZZERS=ON
+ *     cmake --build build-fuzz
+ *     ./build-fuzz/fuzz_roundtrip -max_len=512 fuzz/corpus
+ *   GCC（没有 libFuzzer，链接 standalone_main.cpp，只回放语料 / 崩溃样本）:
+ *     ./build-fuzz/fuzz_roundtrip fuzz/corpus crash-1234...
+ *
+ * 发现崩溃或断言失败时，把最小化后的样本放进 fuzz/corpus/ 作为回归用例。
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>  // std::abort() 不变量被破坏时让 fuzzer 记录崩溃
+
+#include "dns_arena.hpp"
+#include "dns_message.hpp"
+
+// 与主循环相同：每个输入使用一次 arena，然后整体释放
+inline RequestArena& fuzzArena()
+{
+    static RequestArena arena;
+    arena.reset();
+    return arena;
+}
+
+// 不变量检查：失败时 abort()，libFuzzer 会把当前输入保存为 crash-* 文件
+#define FUZZ_CHECK(condition) \
+    do { if (!(condition)) std::abort(); } while (0)
+
+/**
+ * 解析完整消息：Header + Question + Answer + Authority（Additional 暂不保存，只跳过）
+ *
+ * @return 第一个错误；成功时 message 的计数与各部分的实际记录数一致
+ */
+inline ParseError parseMessage(const uint8_t* data, size_t size, DNSMessage& message)
+{
+    ParseError error = DNSHeader::parse(data, size, message.header);
+    size_t offset = 12;
+    for (uint16_t i = 0; i < message.header.qdcount && error == ParseError::NONE; i++)
+    {
+        error = DNSQuestion::parse(data, size, offset, message.questions.emplace_back());
+    }
+    for (uint16_t i = 0; i < message.header.ancount && error == ParseError::NONE; i++)
+    {
+        error = DNSAnswer::parse(data, size, offset, message.answers.emplace_back());
+    }
+    for (uint16_t i = 0; i < message.header.nscount && error == ParseError::NONE; i++)
+    {
+        error = DNSAnswer::parse(data, size, offset, message.authorities.emplace_back());
+    }
+    for (uint16_t i = 0; i < message.header.arcount && error == ParseError::NONE; i++)
+    {
+        DNSAnswer additional(message.answers.get_allocator());
+        error = DNSAnswer::parse(data, size, offset, additional);
+    }
+    if (error == ParseError::NONE) FUZZ_CHECK(offset <= size);
+    message.header.arcount = 0;
+    return error;
+}
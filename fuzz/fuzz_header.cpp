@@ -0,0 +1,25 @@
+/**
+ * DNSHeader::parse 的模糊测试入口
+ *
+ * 不变量：任意长度的输入都不会越界；解析成功时 serialize() 还原出完全相同的 12 字节
+ */
+
+#include <cstring>
+
+#include "fuzz_common.hpp"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    RequestArena& arena = fuzzArena();
+
+    DNSHeader header;
+    ParseError error = DNSHeader::parse(data, size, header);
+    FUZZ_CHECK((error == ParseError::NONE) == (size >= 12));
+    if (error != ParseError::NONE) return 0;
+
+    std::pmr::vector<uint8_t> bytes(arena.resource());
+    header.serialize(bytes);
+    FUZZ_CHECK(bytes.size() == 12);
+    FUZZ_CHECK(std::memcmp(bytes.data(), data, 12) == 0);
+    return 0;
+}
@@ -0,0 +1,29 @@
+/**
+ * DNSQuestion::parse（以及 parseDomainName）的模糊测试入口
+ *
+ * 与主循环相同：先解析 Header，再按 QDCOUNT 逐个解析 Question，遇到错误即停止。
+ * 不变量：offset 永远不超过报文长度；域名文本不超过 254 字节；
+ *         解析时累加的两个哈希与从点分文本重新计算的哈希相同（缓存快照、区域加载、分片加载依赖这一点）
+ */
+
+#include "fuzz_common.hpp"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    RequestArena& arena = fuzzArena();
+
+    DNSHeader header;
+    if (DNSHeader::parse(data, size, header) != ParseError::NONE) return 0;
+
+    size_t offset = 12;
+    for (uint16_t i = 0; i < header.qdcount; i++)
+    {
+        DNSQuestion question(arena.resource());
+        if (DNSQuestion::parse(data, size, offset, question) != ParseError::NONE) break;
+        FUZZ_CHECK(offset <= size);
+        FUZZ_CHECK(question.name.size() < DNSQuestion::MAX_NAME_LENGTH);
+        FUZZ_CHECK(question.hash == QuestionHash::of(question.name, question.type, question.qclass));
+        FUZZ_CHECK(question.shardHash == SteeringHash::of(question.name));
+    }
+    return 0;
+}
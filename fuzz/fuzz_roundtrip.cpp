@@ -0,0 +1,30 @@
+/**
+ * 解析 -> 序列化 往返测试
+ *
+ * 序列化结果不使用名字压缩，RDATA 中的域名也已展开，所以与原始输入的字节不同；
+ * 但它必须是一个合法的报文，并且再解析、再序列化后保持不变：
+ *   bytes1 = serialize(parse(input))
+ *   bytes2 = serialize(parse(bytes1))
+ *   bytes1 == bytes2
+ */
+
+#include "fuzz_common.hpp"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    RequestArena& arena = fuzzArena();
+
+    DNSMessage first(arena.resource());
+    if (parseMessage(data, size, first) != ParseError::NONE) return 0;
+    std::pmr::vector<uint8_t> bytes1 = first.serialize();
+
+    DNSMessage second(arena.resource());
+    FUZZ_CHECK(parseMessage(bytes1.data(), bytes1.size(), second) == ParseError::NONE);
+    FUZZ_CHECK(second.questions.size() == first.questions.size());
+    FUZZ_CHECK(second.answers.size() == first.answers.size());
+    FUZZ_CHECK(second.authorities.size() == first.authorities.size());
+
+    std::pmr::vector<uint8_t> bytes2 = second.serialize();
+    FUZZ_CHECK(bytes1 == bytes2);
+    return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * 没有 libFuzzer 时（GCC）使用的 main()
+ *
+ * 依次把每个参数（文件，或目录中的所有文件）作为一个输入调用 LLVMFuzzerTestOneInput()，
+ * 用于回放种子语料和 crash-* 样本；配合 -fsanitize=address,undefined 检查内存错误。
+ *
+ *   ./fuzz_answer fuzz/corpus crash-1234
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static void runFile(const std::filesystem::path& path)
+{
+    // 与 libFuzzer 回放文件时的输出一致：崩溃时最后一行就是出问题的输入
+    std::cerr << "Running: " << path.string() << std::endl;
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+}
+
+int main(int argc, char* argv[])
+{
+    size_t inputs = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        std::filesystem::path path = argv[i];
+        if (std::filesystem::is_directory(path))
+        {
+            for (const auto& entry : std::filesystem::directory_iterator(path))
+            {
+                if (!entry.is_regular_file()) continue;
+                runFile(entry.path());
+                inputs++;
+            }
+        }
+        else
+        {
+            runFile(path);
+            inputs++;
+        }
+    }
+    std::cout << "Executed " << inputs << " inputs" << std::endl;
+    return 0;
+}
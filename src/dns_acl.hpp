@@ -0,0 +1,238 @@
+/**
+ * 按客户端地址的访问控制（ACL）
+ *
+ * 规则是 (动作, 前缀) 对：
+ *   allow   10.0.0.0/8        正常处理
+ *   deny    203.0.113.0/24    直接丢弃，不回复
+ *   refuse  2001:db8::/32     回复 REFUSED（RCODE = 5）
+ * 一个地址匹配多条规则时，最长前缀优先（与路由表相同）；前缀完全相同时，后写的规则优先。
+ * 没有匹配任何规则的地址使用默认动作（见 compile()）。
+ *
+ * 规则在启动时编译成多比特前缀树（multibit trie，每层 8 bit，即一个地址字节）：
+ *   - 每个节点是 256 个槽，槽里要么是动作（叶子），要么是子节点下标
+ *   - 查找按地址字节逐层下标访问：IPv4 最多 4 次，IPv6 最多 16 次，没有比较和分支回溯
+ *   - 前缀长度不是 8 的倍数时展开（controlled prefix expansion）：/12 在第二个字节那一层占 16 个连续的槽
+ *   - 按前缀长度从短到长插入，长前缀创建子节点时，子节点的 256 个槽先继承父槽的动作（leaf pushing），
+ *     所以叶子上的动作就是最长匹配的结果，查找时不需要记住“路过的最近动作”
+ *
+ * 示例：allow 10.0.0.0/8, deny 10.1.0.0/16, refuse 0.0.0.0/0
+ *   根节点：slot[0..255] = REFUSE，slot[10] = 子节点 1
+ *   节点 1：slot[0..255] = ALLOW（继承自 /8），slot[1] = 子节点 2
+ *   节点 2：slot[0..255] = DENY
+ *   查找 10.1.2.3 -> 根[10] -> 节点1[1] -> 节点2[2] = DENY
+ *   查找 10.2.0.1 -> 根[10] -> 节点1[2] = ALLOW
+ *   查找 8.8.8.8  -> 根[8] = REFUSE
+ *
+ * IPv4 映射的 IPv6 地址（::ffff:192.0.2.1）按 IPv4 规则匹配。
+ */
+
+#pragma once
+
+#include <algorithm>    // std::stable_sort
+#include <array>        // std::array 节点的 256 个槽
+#include <cstdint>      // uint8_t, uint32_t
+#include <string>       // std::string 规则文本
+#include <vector>       // std::vector 规则和节点
+#include <netinet/in.h> // sockaddr_in, sockaddr_in6
+#include <arpa/inet.h>  // inet_pton()
+
+enum class AclAction : uint8_t
+{
+    ALLOW,    // 正常处理
+    DENY,     // 丢弃，不回复
+    REFUSE,   // 回复 REFUSED
+};
+
+inline const char* aclActionName(AclAction action)
+{
+    switch (action)
+    {
+        case AclAction::ALLOW: return "allow";
+        case AclAction::DENY: return "deny";
+        case AclAction::REFUSE: return "refuse";
+    }
+    return "unknown";
+}
+
+class AccessList
+{
+public:
+    // 没有规则时允许所有地址
+    AccessList() { compile(AclAction::ALLOW); }
+
+    /**
+     * 添加一条规则（compile() 之前调用）
+     *
+     * @param action 匹配时的动作
+     * @param prefix "192.0.2.0/24"、"2001:db8::/32"；省略长度表示单个地址（/32 或 /128）
+     * @param error [输出] 前缀无法解析时的错误信息
+     * @return 成功返回 true
+     *
+     * 前缀中超出长度的主机位会被忽略：10.1.2.3/8 等同于 10.0.0.0/8
+     */
+    bool add(AclAction action, const std::string& prefix, std::string& error)
+    {
+        Rule rule{};
+        rule.action = action;
+
+        size_t slash = prefix.find('/');
+        std::string address = prefix.substr(0, slash);
+        if (inet_pton(AF_INET, address.c_str(), rule.bytes) == 1)
+        {
+            rule.ipv6 = false;
+        }
+        else if (inet_pton(AF_INET6, address.c_str(), rule.bytes) == 1)
+        {
+            rule.ipv6 = true;
+        }
+        else
+        {
+            error = "invalid address in ACL prefix: " + prefix;
+            return false;
+        }
+
+        unsigned maxLength = rule.ipv6 ? 128 : 32;
+        rule.length = static_cast<uint8_t>(maxLength);
+        if (slash != std::string::npos)
+        {
+            std::string length = prefix.substr(slash + 1);
+            if (length.empty() || length.size() > 3 || length.find_first_not_of("0123456789") != std::string::npos ||
+                std::stoul(length) > maxLength)
+            {
+                error = "invalid length in ACL prefix: " + prefix;
+                return false;
+            }
+            rule.length = static_cast<uint8_t>(std::stoul(length));
+        }
+        rules_.push_back(rule);
+        return true;
+    }
+
+    /**
+     * 把规则编译成前缀树（之后 add() 的规则需要再次 compile() 才生效）
+     *
+     * @param unmatched 没有匹配任何规则时的动作
+     */
+    void compile(AclAction unmatched)
+    {
+        // 从短到长插入：长前缀覆盖短前缀，stable_sort 保证同样长度时后写的规则覆盖先写的
+        std::vector<Rule> sorted = rules_;
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const Rule& a, const Rule& b) { return a.length < b.length; });
+
+        ipv4_.reset(unmatched);
+        ipv6_.reset(unmatched);
+        for (const Rule& rule : sorted)
+        {
+            (rule.ipv6 ? ipv6_ : ipv4_).insert(rule.bytes, rule.length, rule.action);
+        }
+    }
+
+    bool empty() const { return rules_.empty(); }
+    size_t ruleCount() const { return rules_.size(); }
+    size_t nodeCount() const { return ipv4_.nodeCount() + ipv6_.nodeCount(); }
+
+    // 是否至少有一条 allow 规则（用于决定默认动作：有白名单时，名单外的地址默认拒绝）
+    bool hasAllowRule() const
+    {
+        for (const Rule& rule : rules_)
+        {
+            if (rule.action == AclAction::ALLOW) return true;
+        }
+        return false;
+    }
+
+    AclAction match(const sockaddr_in& client) const
+    {
+        return ipv4_.lookup(reinterpret_cast<const uint8_t*>(&client.sin_addr), 4);
+    }
+
+    AclAction match(const sockaddr_in6& client) const
+    {
+        const uint8_t* bytes = client.sin6_addr.s6_addr;
+        if (IN6_IS_ADDR_V4MAPPED(&client.sin6_addr)) return ipv4_.lookup(bytes + 12, 4);
+        return ipv6_.lookup(bytes, 16);
+    }
+
+    // 按地址族分派（recvfrom() 得到的客户端地址）
+    AclAction match(const sockaddr* client) const
+    {
+        if (client->sa_family == AF_INET6) return match(*reinterpret_cast<const sockaddr_in6*>(client));
+        return match(*reinterpret_cast<const sockaddr_in*>(client));
+    }
+
+private:
+    struct Rule
+    {
+        AclAction action;
+        bool ipv6;
+        uint8_t length;       // 前缀长度（位）
+        uint8_t bytes[16];    // 地址（网络字节序）
+    };
+
+    // 每层 8 bit 的多比特前缀树
+    class PrefixTrie
+    {
+    public:
+        void reset(AclAction unmatched)
+        {
+            nodes_.assign(1, Node{});
+            nodes_[0].fill(static_cast<uint32_t>(unmatched));
+        }
+
+        size_t nodeCount() const { return nodes_.size(); }
+
+        void insert(const uint8_t* bytes, uint8_t length, AclAction action)
+        {
+            // 前缀落在第 depth 层：/1 ~ /8 在第 0 层，/9 ~ /16 在第 1 层，……；/0 覆盖整个根节点
+            size_t depth = length == 0 ? 0 : (length - 1) / 8;
+            size_t node = 0;
+            for (size_t level = 0; level < depth; level++)
+            {
+                uint32_t slot = nodes_[node][bytes[level]];
+                if (!(slot & CHILD))
+                {
+                    // leaf pushing：新子节点的每个槽继承当前槽的动作
+                    // （push_back 可能搬移 nodes_，所以先复制槽的值，之后再按下标写回）
+                    Node child;
+                    child.fill(slot);
+                    nodes_.push_back(child);
+                    slot = CHILD | static_cast<uint32_t>(nodes_.size() - 1);
+                    nodes_[node][bytes[level]] = slot;
+                }
+                node = slot & ~CHILD;
+            }
+
+            // 本层剩余的前缀位数（0 ~ 8）决定展开成多少个连续的槽
+            unsigned bits = length - depth * 8;
+            unsigned first = bits == 0 ? 0 : bytes[depth] & (0xFF00u >> bits) & 0xFF;
+            unsigned count = 256u >> bits;
+            for (unsigned i = 0; i < count; i++)
+            {
+                // 从短到长插入，这些槽此时不可能已有子节点（子节点只由更长的前缀创建）
+                nodes_[node][first + i] = static_cast<uint32_t>(action);
+            }
+        }
+
+        AclAction lookup(const uint8_t* bytes, size_t size) const
+        {
+            size_t node = 0;
+            for (size_t level = 0; level < size; level++)
+            {
+                uint32_t slot = nodes_[node][bytes[level]];
+                if (!(slot & CHILD)) return static_cast<AclAction>(slot);
+                node = slot & ~CHILD;
+            }
+            return AclAction::ALLOW;  // 不会到达：最深一层的槽总是叶子
+        }
+
+    private:
+        static constexpr uint32_t CHILD = 0x80000000u;  // 最高位：槽里存的是子节点下标
+        using Node = std::array<uint32_t, 256>;
+        std::vector<Node> nodes_;
+    };
+
+    std::vector<Rule> rules_;
+    PrefixTrie ipv4_;
+    PrefixTrie ipv6_;
+};
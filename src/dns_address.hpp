@@ -0,0 +1,121 @@
+/**
+ * 与地址族无关的套接字地址（IPv4 / IPv6）
+ *
+ * 监听、上游和客户端地址都用它保存，内部是 sockaddr_storage，足够容纳 sockaddr_in6；
+ * data() / length 可以直接传给 bind() / sendto() / recvfrom()。
+ *
+ * 文本格式（--resolver 等命令行参数）：
+ *   "8.8.8.8:53"              IPv4
+ *   "[2001:4860:4860::8888]:53"  IPv6（地址必须放在方括号中，否则无法区分地址里的 ':' 和端口）
+ *   "::1"、"8.8.8.8"          省略端口时使用调用方给出的默认端口
+ *
+ * 双栈套接字收到的 IPv4 报文，源地址是 IPv4 映射的 IPv6 地址（::ffff:192.0.2.1），
+ * toString() 把它显示为 IPv4 形式，ACL 和 RRL 也把它当作 IPv4 处理。
+ */
+
+#pragma once
+
+#include <cstdint>       // uint16_t
+#include <cstring>       // memcpy()
+#include <string>        // std::string
+#include <sys/socket.h>  // sockaddr, sockaddr_storage, socklen_t
+#include <netinet/in.h>  // sockaddr_in, sockaddr_in6
+#include <arpa/inet.h>   // inet_pton(), inet_ntop(), htons(), ntohs()
+
+struct SocketAddress
+{
+    sockaddr_storage storage{};
+    socklen_t length = sizeof(storage);  // recvfrom() 前保持为 sizeof(storage)，之后是实际长度
+
+    sockaddr* data() { return reinterpret_cast<sockaddr*>(&storage); }
+    const sockaddr* data() const { return reinterpret_cast<const sockaddr*>(&storage); }
+    int family() const { return storage.ss_family; }
+
+    const sockaddr_in& ipv4() const { return *reinterpret_cast<const sockaddr_in*>(&storage); }
+    const sockaddr_in6& ipv6() const { return *reinterpret_cast<const sockaddr_in6*>(&storage); }
+
+    uint16_t port() const
+    {
+        return ntohs(family() == AF_INET6 ? ipv6().sin6_port : ipv4().sin_port);
+    }
+
+    /**
+     * 解析 "ip:port" / "[ipv6]:port" / "ip"
+     *
+     * @param text 地址文本
+     * @param defaultPort 文本中没有端口时使用的端口
+     * @param out [输出] 解析结果
+     * @return 成功返回 true
+     */
+    static bool parse(const std::string& text, uint16_t defaultPort, SocketAddress& out)
+    {
+        std::string host = text;
+        std::string port;
+        if (!text.empty() && text[0] == '[')
+        {
+            size_t close = text.find(']');
+            if (close == std::string::npos) return false;
+            host = text.substr(1, close - 1);
+            if (close + 1 < text.size())
+            {
+                if (text[close + 1] != ':') return false;
+                port = text.substr(close + 2);
+            }
+        }
+        else if (text.find(':') == text.rfind(':') && text.find(':') != std::string::npos)
+        {
+            // 恰好一个 ':'：IPv4 地址加端口（IPv6 地址至少有两个 ':'）
+            host = text.substr(0, text.find(':'));
+            port = text.substr(text.find(':') + 1);
+        }
+
+        uint16_t portNumber = defaultPort;
+        if (!port.empty())
+        {
+            if (port.size() > 5 || port.find_first_not_of("0123456789") != std::string::npos) return false;
+            unsigned long value = std::stoul(port);
+            if (value > 65535) return false;
+            portNumber = static_cast<uint16_t>(value);
+        }
+
+        out = SocketAddress();
+        sockaddr_in ipv4{};
+        sockaddr_in6 ipv6{};
+        if (inet_pton(AF_INET, host.c_str(), &ipv4.sin_addr) == 1)
+        {
+            ipv4.sin_family = AF_INET;
+            ipv4.sin_port = htons(portNumber);
+            std::memcpy(&out.storage, &ipv4, sizeof(ipv4));
+            out.length = sizeof(ipv4);
+            return true;
+        }
+        if (inet_pton(AF_INET6, host.c_str(), &ipv6.sin6_addr) == 1)
+        {
+            ipv6.sin6_family = AF_INET6;
+            ipv6.sin6_port = htons(portNumber);
+            std::memcpy(&out.storage, &ipv6, sizeof(ipv6));
+            out.length = sizeof(ipv6);
+            return true;
+        }
+        return false;
+    }
+
+    // 示例："192.0.2.1:53"、"[2001:db8::1]:2053"；IPv4 映射地址显示为 "192.0.2.1:53"
+    std::string toString() const
+    {
+        char text[INET6_ADDRSTRLEN];
+        if (family() == AF_INET6)
+        {
+            const in6_addr& address = ipv6().sin6_addr;
+            if (IN6_IS_ADDR_V4MAPPED(&address))
+            {
+                inet_ntop(AF_INET, address.s6_addr + 12, text, sizeof(text));
+                return std::string(text) + ":" + std::to_string(port());
+            }
+            inet_ntop(AF_INET6, &address, text, sizeof(text));
+            return "[" + std::string(text) + "]:" + std::to_string(port());
+        }
+        inet_ntop(AF_INET, &ipv4().sin_addr, text, sizeof(text));
+        return std::string(text) + ":" + std::to_string(port());
+    }
+};
@@ -0,0 +1,46 @@
+/**
+ * 每个请求独占的内存池（arena）
+ *
+ * 一次请求会构造请求 Question 列表、若干域名字符串、响应 DNSMessage、
+ * 每条记录的 RDATA 以及序列化后的响应字节，处理完就全部丢弃。
+ * 这些对象都从这里的栈上缓冲区“顺序切分”内存（bump pointer），
+ * 处理下一个请求前调用 reset() 把指针拨回开头，整个请求周期不调用 malloc / free。
+ *
+ *   buffer_: [ questions | name | name | answers | rdata | responseBytes | ......空闲...... ]
+ *                                                                         ^ 下一次分配从这里开始
+ *   reset():  ^ 指针回到开头（不逐个释放对象）
+ *
+ * 缓冲区用完时（例如一个请求里有大量 CNAME）自动回退到全局堆，不会失败；
+ * 回退的内存同样在 reset() 时一次性归还。
+ *
+ * 注意：放进 arena 的对象不能活过 reset()。
+ * 缓存、预取队列等长期保存的数据都是拷贝（拷贝构造总是使用默认的全局堆），
+ * 不会持有 arena 中的指针。
+ */
+
+#pragma once
+
+#include <cstddef>          // std::byte, std::max_align_t
+#include <memory_resource>  // std::pmr::monotonic_buffer_resource
+
+class RequestArena
+{
+public:
+    // 一个 512 字节的请求展开后通常只需要几 KB，64 KB 足以覆盖几乎所有请求
+    static constexpr size_t CAPACITY = 64 * 1024;
+
+    RequestArena() = default;
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    // 传给 std::pmr 容器的内存资源
+    std::pmr::memory_resource* resource() { return &resource_; }
+
+    // 释放本次请求的全部内存（调用前所有 arena 对象必须已经析构）
+    void reset() { resource_.release(); }
+
+private:
+    alignas(std::max_align_t) std::byte buffer_[CAPACITY];
+    std::pmr::monotonic_buffer_resource resource_{ buffer_, sizeof(buffer_), std::pmr::new_delete_resource() };
+};
@@ -0,0 +1,314 @@
+/**
+ * 批量 UDP 收发：recvmmsg() / sendmmsg() + UDP GRO / GSO（--io-engine batch）
+ *
+ * 一次 recvmmsg() 最多接收 BATCH_SIZE 个报文，处理完后一次 sendmmsg() 发出这一批的全部响应。
+ * 在此之上再用内核的 UDP 分段卸载减少每个报文的内核开销：
+ *
+ *   GRO（接收，UDP_GRO）：同一条流（同一个源地址和端口）上连续到达的报文由内核合并成一个大缓冲区，
+ *     cmsg 中给出每段的长度（最后一段可以更短）：
+ *       [ 段 0 (gso_size) | 段 1 (gso_size) | 段 2 (<= gso_size) ]  -> 拆成 3 个查询
+ *
+ *   GSO（发送，UDP_SEGMENT）：发往同一目的地址、长度相同的多个响应合并成一个 sendmmsg() 条目，
+ *     内核只走一遍协议栈，最后才切成独立的 UDP 报文：
+ *       示例：NAT 后面的一个繁忙的 stub resolver（同一个源地址和端口）在一批中发来 20 个查询，
+ *             其中 12 个响应都是 45 字节 -> 1 个 GSO 条目（12 段）+ 其余 8 个普通条目
+ *     规则：除最后一段外每段长度必须相同；最后一段可以更短，但之后不能再追加；
+ *           最多 MAX_SEGMENTS 段，总长度不超过 65535 - 8（UDP 头）
+ *
+ * 内核不支持 GRO / GSO（Linux 5.0 之前，或某些虚拟网卡）时 setsockopt() 失败，相应功能自动关闭，
+ * 其余部分（recvmmsg / sendmmsg 批量收发）照常工作。
+ */
+
+#pragma once
+
+#include <cerrno>        // errno
+#include <cstdint>       // uint8_t, uint16_t
+#include <cstdio>        // perror()
+#include <cstring>       // memset(), memcpy()
+#include <vector>        // std::vector 缓冲区与消息数组
+#include <sys/socket.h>  // recvmmsg(), sendmmsg(), mmsghdr, cmsghdr
+#include <netinet/in.h>  // sockaddr_in6
+#include <netinet/udp.h> // SOL_UDP, UDP_SEGMENT, UDP_GRO
+
+#include "dns_address.hpp"
+#include "dns_hugepage.hpp"
+#include "dns_packet.hpp"    // PacketPool::BUFFER_SIZE 查询的最大长度
+
+class UdpBatchIo
+{
+public:
+    static constexpr unsigned BATCH_SIZE = 32;     // 每次 recvmmsg() / sendmmsg() 的最大报文数
+    static constexpr size_t PAYLOAD_SIZE = PacketPool::BUFFER_SIZE;  // 每个查询最多处理的字节数（与 recvmsg() 路径相同）
+    static constexpr unsigned MAX_SEGMENTS = 64;   // 一个 GSO 条目最多的段数（内核 UDP_MAX_SEGMENTS 的下限）
+    static constexpr size_t GRO_BUFFER_SIZE = 65535;
+    // 每个报文的控制信息：UDP_GRO 段长 + SO_RXQ_OVFL 累计丢包数
+    static constexpr size_t CONTROL_SIZE = CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(uint32_t));
+
+    /**
+     * @param udpSocket 已绑定的 UDP 套接字
+     * @param offload 是否尝试开启 GRO / GSO
+     * @param hugePages 接收缓冲区使用的页面（GRO 时一批约 2 MiB，正好一个大页）
+     */
+    UdpBatchIo(int udpSocket, bool offload, HugePageMode hugePages = HugePageMode::OFF)
+        : socket_(udpSocket)
+    {
+        if (offload)
+        {
+            int on = 1;
+            gro_ = setsockopt(socket_, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+            // 设置为 0 不改变行为，只用来探测内核是否认识 UDP_SEGMENT（之后按条目用 cmsg 指定段长）
+            int zero = 0;
+            gso_ = setsockopt(socket_, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero)) == 0;
+        }
+
+        bufferSize_ = gro_ ? GRO_BUFFER_SIZE : PAYLOAD_SIZE;
+        buffers_ = HugePageRegion(BATCH_SIZE * bufferSize_, hugePages);
+        receiveControl_.resize(BATCH_SIZE * CONTROL_SIZE);
+        addresses_.resize(BATCH_SIZE);
+        receiveIov_.resize(BATCH_SIZE);
+        receiveMessages_.resize(BATCH_SIZE);
+        sendControl_.resize(BATCH_SIZE * CMSG_SPACE(sizeof(uint16_t)));
+    }
+
+    bool gro() const { return gro_; }
+    bool gso() const { return gso_; }
+
+    /**
+     * 接收一批报文：阻塞到至少一个报文到达，再取走此时已在队列中的其余报文（MSG_WAITFORONE）
+     *
+     * @return 报文数（GRO 合并的报文算一个），出错返回 -1（errno 有效）
+     */
+    int receive()
+    {
+        for (unsigned i = 0; i < BATCH_SIZE; i++)
+        {
+            receiveIov_[i].iov_base = buffers_.data() + i * bufferSize_;
+            receiveIov_[i].iov_len = bufferSize_;
+            msghdr& header = receiveMessages_[i].msg_hdr;
+            std::memset(&header, 0, sizeof(header));
+            header.msg_name = &addresses_[i].storage;
+            header.msg_namelen = sizeof(sockaddr_storage);
+            header.msg_iov = &receiveIov_[i];
+            header.msg_iovlen = 1;
+            header.msg_control = receiveControl_.data() + i * CONTROL_SIZE;
+            header.msg_controllen = CONTROL_SIZE;
+        }
+        received_ = recvmmsg(socket_, receiveMessages_.data(), BATCH_SIZE, MSG_WAITFORONE, nullptr);
+        return received_;
+    }
+
+    /**
+     * 依次处理上一次 receive() 得到的每个查询（GRO 合并的报文按段长拆开）
+     *
+     * @param onPacket onPacket(data, size, clientAddress)
+     */
+    template <class OnPacket>
+    void forEachPacket(OnPacket&& onPacket)
+    {
+        for (int i = 0; i < received_; i++)
+        {
+            msghdr& header = receiveMessages_[i].msg_hdr;
+            size_t length = receiveMessages_[i].msg_len;
+            if (length == 0) continue;  // 套接字 shutdown() 后的空结果
+            if (length > bufferSize_) length = bufferSize_;
+
+            size_t segmentSize = length;
+            for (cmsghdr* control = CMSG_FIRSTHDR(&header); control != nullptr; control = CMSG_NXTHDR(&header, control))
+            {
+                if (control->cmsg_level == SOL_UDP && control->cmsg_type == UDP_GRO)
+                {
+                    int size;
+                    std::memcpy(&size, CMSG_DATA(control), sizeof(size));
+                    if (size > 0) segmentSize = static_cast<size_t>(size);
+                }
+                else if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SO_RXQ_OVFL)
+                {
+                    std::memcpy(&drops_, CMSG_DATA(control), sizeof(drops_));
+                }
+            }
+
+            SocketAddress& clientAddress = addresses_[i];
+            clientAddress.length = header.msg_namelen;
+            const uint8_t* data = static_cast<const uint8_t*>(receiveIov_[i].iov_base);
+            for (size_t offset = 0; offset < length; offset += segmentSize)
+            {
+                size_t size = length - offset < segmentSize ? length - offset : segmentSize;
+                onPacket(data + offset, size < PAYLOAD_SIZE ? size : PAYLOAD_SIZE, clientAddress);
+            }
+        }
+    }
+
+    /**
+     * 暂存一个响应（flush() 时发出）
+     *
+     * 能加入已有的 GSO 条目就加入（同一目的地址、段长相同、该条目还没有以较短的段结束）；否则新建一个条目
+     */
+    void queue(const uint8_t* data, size_t size, const SocketAddress& clientAddress)
+    {
+        if (size == 0) return;
+        size_t offset = sendData_.size();
+        sendData_.insert(sendData_.end(), data, data + size);
+
+        if (gso_)
+        {
+            for (Group& group : groups_)
+            {
+                if (group.closed || size > group.segmentSize || group.segments >= MAX_SEGMENTS ||
+                    group.bytes + size > GRO_BUFFER_SIZE - 8 || !sameAddress(group.address, clientAddress))
+                {
+                    continue;
+                }
+                responses_.push_back({ offset, size, static_cast<unsigned>(&group - groups_.data()) });
+                group.segments++;
+                group.bytes += size;
+                group.closed = size < group.segmentSize;  // 更短的段只能是最后一段
+                return;
+            }
+        }
+
+        responses_.push_back({ offset, size, static_cast<unsigned>(groups_.size()) });
+        groups_.push_back({ clientAddress, size, 1, size, false });
+        if (groups_.size() >= BATCH_SIZE) flush();
+    }
+
+    /**
+     * 用 sendmmsg() 发出暂存的全部响应；每个条目一个 mmsghdr，GSO 条目带 UDP_SEGMENT cmsg
+     */
+    void flush()
+    {
+        if (groups_.empty()) return;
+
+        // 按条目排列 iovec：每个条目的段在 iovec 数组中连续（内核把它们拼接后再切分）
+        std::vector<unsigned>& first = groupFirst_;
+        first.assign(groups_.size() + 1, 0);
+        for (const Response& response : responses_) first[response.group + 1]++;
+        for (size_t g = 0; g < groups_.size(); g++) first[g + 1] += first[g];
+        sendIov_.resize(responses_.size());
+        std::vector<unsigned>& next = groupNext_;
+        next.assign(first.begin(), first.end() - 1);
+        for (const Response& response : responses_)
+        {
+            iovec& iov = sendIov_[next[response.group]++];
+            iov.iov_base = sendData_.data() + response.offset;
+            iov.iov_len = response.size;
+        }
+
+        sendMessages_.resize(groups_.size());
+        if (sendControl_.size() < groups_.size() * CMSG_SPACE(sizeof(uint16_t)))
+        {
+            sendControl_.resize(groups_.size() * CMSG_SPACE(sizeof(uint16_t)));
+        }
+        for (size_t g = 0; g < groups_.size(); g++)
+        {
+            Group& group = groups_[g];
+            msghdr& header = sendMessages_[g].msg_hdr;
+            std::memset(&header, 0, sizeof(header));
+            header.msg_name = &group.address.storage;
+            header.msg_namelen = group.address.length;
+            header.msg_iov = &sendIov_[first[g]];
+            header.msg_iovlen = first[g + 1] - first[g];
+            if (group.segments > 1)
+            {
+                header.msg_control = sendControl_.data() + g * CMSG_SPACE(sizeof(uint16_t));
+                header.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                cmsghdr* control = CMSG_FIRSTHDR(&header);
+                control->cmsg_level = SOL_UDP;
+                control->cmsg_type = UDP_SEGMENT;
+                control->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segmentSize = static_cast<uint16_t>(group.segmentSize);
+                std::memcpy(CMSG_DATA(control), &segmentSize, sizeof(segmentSize));
+                coalesced_ += group.segments - 1;
+            }
+        }
+
+        // sendmmsg() 可能只发出一部分（例如发送缓冲区满）；出错的条目跳过，继续发送其余的
+        size_t sent = 0;
+        while (sent < groups_.size())
+        {
+            int count = sendmmsg(socket_, sendMessages_.data() + sent, static_cast<unsigned>(groups_.size() - sent), 0);
+            if (count < 0)
+            {
+                if (errno == EINTR) continue;
+                if (groups_[sent].segments > 1 && (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP))
+                {
+                    // 出口网卡不支持分段卸载：这一条目按段逐个发送，之后不再合并
+                    gso_ = false;
+                    sendSegments(sendMessages_[sent].msg_hdr);
+                }
+                else
+                {
+                    perror("Failed to send response");
+                }
+                count = 1;
+            }
+            sent += static_cast<size_t>(count);
+        }
+
+        sendData_.clear();
+        responses_.clear();
+        groups_.clear();
+    }
+
+    // 通过 GSO 省掉的 sendmmsg() 条目数（合并进其他条目的响应数）
+    uint64_t coalesced() const { return coalesced_; }
+
+    // 最近一个报文携带的 SO_RXQ_OVFL：套接字因接收队列满而丢弃的报文总数
+    uint32_t drops() const { return drops_; }
+
+private:
+    struct Response
+    {
+        size_t offset;     // 在 sendData_ 中的位置
+        size_t size;
+        unsigned group;
+    };
+
+    struct Group
+    {
+        SocketAddress address;
+        size_t segmentSize;  // 第一段的长度（之后的段不能更长）
+        unsigned segments;
+        size_t bytes;
+        bool closed;         // 已经以一个更短的段结束
+    };
+
+    int socket_;
+    bool gro_ = false;
+    bool gso_ = false;
+    size_t bufferSize_ = PAYLOAD_SIZE;
+    int received_ = 0;
+    uint64_t coalesced_ = 0;
+    uint32_t drops_ = 0;
+
+    HugePageRegion buffers_;
+    std::vector<uint8_t> receiveControl_;
+    std::vector<SocketAddress> addresses_;
+    std::vector<iovec> receiveIov_;
+    std::vector<mmsghdr> receiveMessages_;
+
+    std::vector<uint8_t> sendData_;
+    std::vector<Response> responses_;
+    std::vector<Group> groups_;
+    std::vector<unsigned> groupFirst_;
+    std::vector<unsigned> groupNext_;
+    std::vector<iovec> sendIov_;
+    std::vector<mmsghdr> sendMessages_;
+    std::vector<uint8_t> sendControl_;
+
+    void sendSegments(const msghdr& header)
+    {
+        for (size_t i = 0; i < header.msg_iovlen; i++)
+        {
+            if (sendto(socket_, header.msg_iov[i].iov_base, header.msg_iov[i].iov_len, 0,
+                       static_cast<const sockaddr*>(header.msg_name), header.msg_namelen) == -1)
+            {
+                perror("Failed to send response");
+            }
+        }
+    }
+
+    static bool sameAddress(const SocketAddress& a, const SocketAddress& b)
+    {
+        return a.length == b.length && std::memcmp(&a.storage, &b.storage, a.length) == 0;
+    }
+};
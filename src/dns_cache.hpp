@@ -0,0 +1,980 @@
+/**
+ * DNS 响应缓存 - 正向缓存 + 否定缓存（RFC 2308）
+ *
+ * 以 (name, type, class) 为键缓存上游的回答：
+ *   - 正向条目：上游返回了 Answer 记录，按记录中最小的 TTL 过期
+ *   - 否定条目：上游返回 NXDOMAIN（名字不存在）或 NODATA（名字存在但没有该类型），
+ *               按 RFC 2308 第 5 节，TTL = min(SOA 记录的 TTL, SOA.MINIMUM)
+ *
+ * 两类条目各自有独立的内存预算，
+ * 因此不存在名字的查询洪水（搜索域展开、拼写错误、遥测探测）
+ * 只会挤占否定缓存，不会把热门的正向条目挤出去。
+ *
+ * 准入与淘汰（W-TinyLFU）：每个分区分为三段
+ *
+ *   新条目 ──> [ 窗口 LRU (1%) ] ──溢出──> [ 试用段 probation ] ──再次命中──> [ 保护段 protected (80%) ]
+ *                                              ^        │                              │
+ *                                              └────────┼────────── 保护段溢出降级 ─────┘
+ *                                                       │
+ *                                       主区域超出预算时：候选（刚从窗口出来的条目）
+ *                                       与受害者（试用段最旧的条目）比较草图中的访问频率，
+ *                                       频率低的一方被淘汰
+ *
+ * 随机子域攻击和一次性爬虫流量产生的条目访问频率都很低，
+ * 只会在 1% 的窗口里短暂停留，无法挤掉主区域中真正的热门名字。
+ * 内存上限是硬性的：所有段（加上频率草图本身）的总和不会超过预算。
+ *
+ * 预取（prefetch）：每个条目记录命中次数，热门条目进入 TTL 的最后 10% 时，
+ * lookup() 会在结果中标记 prefetch，由调用方在后台向上游刷新，
+ * 这样热门名字在过期前就已被替换，不会出现一次完整的上游未命中。
+ *
+ * 过期提供（serve-stale，RFC 8767）：过期条目在可配置的窗口内继续保留，
+ * 上游故障时以很短的 TTL 返回过期数据，同时后台刷新不断重试，
+ * 上游中断因此退化为“稍旧的回答”，而不是延迟尖峰和失败。
+ *
+ * 快照（snapshot）：缓存可以导出为紧凑的二进制文件，重启时重新加载，
+ * 剩余 TTL 按两次之间经过的墙钟时间扣减，避免重启后的冷缓存和对上游的“惊群”。
+ *
+ * 索引以解析器算好的 DNSQuestion::hash 为键（见 dns_hash.hpp），查找时不再构造键、不再扫描域名计算哈希；
+ * 找到条目后只需把请求中的域名与条目保存的小写键比较一次，确认不是哈希碰撞。
+ *
+ * 所有公开方法都持有内部互斥锁，可以被后台预取线程并发调用。
+ *
+ * 大页（--huge-pages，见 dns_hugepage.hpp）：条目、链表节点、索引和频率草图都从缓存自己的内存资源分配，
+ * 开启时它是以大页为后备的池（HugePageResource + unsynchronized_pool_resource，同样由互斥锁保护）；
+ * 关闭时就是默认的全局堆。
+ */
+
+#pragma once
+
+#include <algorithm>       // std::min, std::max
+#include <chrono>          // std::chrono::steady_clock 计算剩余 TTL
+#include <cstdint>         // uint8_t, uint16_t, uint32_t, uint64_t
+#include <cstdio>          // snprintf(), std::rename() 格式化统计信息 / 原子替换快照文件
+#include <fstream>         // std::ifstream / std::ofstream 读写快照文件
+#include <cstring>         // memcmp() 校验快照魔数
+#include <iterator>        // std::prev, std::next, std::istreambuf_iterator
+#include <list>            // std::pmr::list 作为各段的 LRU 链表
+#include <memory>          // std::unique_ptr 大页内存池
+#include <memory_resource> // std::pmr::polymorphic_allocator 结果使用请求的 arena，条目使用缓存的内存池
+#include <mutex>           // std::mutex 保护缓存（工作线程 + 预取线程）
+#include <string>          // std::string
+#include <string_view>     // std::string_view 从键中取出域名
+#include <unordered_map>   // std::pmr::unordered_map 哈希 -> 链表节点
+#include <vector>          // std::vector
+
+#include "dns_hugepage.hpp"
+#include "dns_message.hpp"
+#include "dns_simd.hpp"
+#include "dns_sketch.hpp"
+
+/**
+ * 缓存配置
+ */
+struct CacheOptions
+{
+    size_t positiveBudget = 64 * 1024 * 1024;   // 正向条目的内存预算（字节），0 表示不缓存
+    size_t negativeBudget = 8 * 1024 * 1024;    // 否定条目的内存预算（字节），0 表示不缓存
+    uint32_t prefetchHits = 8;                  // 命中多少次后才预取，0 表示关闭预取
+    uint32_t serveStaleSeconds = 0;             // 过期后仍可提供的时长（秒），0 表示关闭 serve-stale
+    HugePageMode hugePages = HugePageMode::OFF; // 条目和频率草图是否放在大页上
+};
+
+/**
+ * 缓存命中的结果（记录的 TTL 已经减去在缓存中停留的时间）
+ */
+struct CacheResult
+{
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    uint8_t rcode = 0;                          // 0 = NOERROR, 3 = NXDOMAIN
+    std::pmr::vector<DNSAnswer> answers;        // 正向条目的 Answer 记录
+    std::pmr::vector<DNSAnswer> authorities;    // 否定条目的 SOA 记录（放在 Authority 部分）
+    bool prefetch = false;                      // 热门条目即将过期（或已过期），调用方应在后台刷新
+    bool stale = false;                         // 返回的是过期数据（serve-stale）
+
+    // @param alloc 命中时记录拷贝到这里（通常是当前请求的 arena）
+    explicit CacheResult(const allocator_type& alloc = {}) : answers(alloc), authorities(alloc) {}
+};
+
+/**
+ * 缓存统计快照
+ */
+struct CacheStats
+{
+    uint64_t hits[2][3] = {};     // [正向 / 否定][窗口 / 试用段 / 保护段] 的命中次数
+    uint64_t staleHits = 0;       // serve-stale 提供的过期回答
+    uint64_t misses = 0;
+    uint64_t prefetches = 0;
+    uint64_t admitted = 0;        // 候选在频率比较中胜出，进入主区域
+    uint64_t rejected = 0;        // 候选频率不够，被拒绝准入
+    size_t used[2] = {};          // [正向 / 否定] 已用字节
+    size_t budget[2] = {};        // [正向 / 否定] 预算字节
+};
+
+class DnsCache
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint8_t RCODE_NXDOMAIN = 3;
+
+    // RFC 2308 第 5 节：否定缓存的 TTL 建议不超过 1~3 小时
+    static constexpr uint32_t MAX_NEGATIVE_TTL = 10800;
+
+    // RFC 8767 第 5 节：过期数据返回给客户端时使用的 TTL，以及上游失败后的重试间隔
+    static constexpr uint32_t STALE_TTL = 30;
+    static constexpr uint32_t FAILURE_RECHECK_SECONDS = 30;
+
+    // W-TinyLFU 的段大小：窗口占分区的 1%，保护段占主区域的 80%
+    static constexpr size_t WINDOW_PERCENT = 1;
+    static constexpr size_t PROTECTED_PERCENT = 80;
+
+    // 估算频率草图宽度时假设的平均条目大小
+    static constexpr size_t AVERAGE_ENTRY_BYTES = 512;
+
+    DnsCache(const CacheOptions& options)
+        : options_(options),
+          pages_(makePages(options)),
+          pool_(pages_ ? std::make_unique<std::pmr::unsynchronized_pool_resource>(
+                             std::pmr::pool_options{ 0, HugePageResource::DEDICATED_THRESHOLD }, pages_.get())
+                       : nullptr),
+          memory_(pool_ ? pool_.get() : std::pmr::get_default_resource()),
+          sketch_(expectedEntries(options), pages_ ? pages_.get() : memory_),
+          positive_(memory_),
+          negative_(memory_),
+          index_(memory_)
+    {
+        // 频率草图的内存按比例从两个分区的预算中扣除，保证总内存不超过配置
+        //   草图约占总预算的 8 / AVERAGE_ENTRY_BYTES（约 1.6%）
+        size_t total = options.positiveBudget + options.negativeBudget;
+        auto share = [&](size_t budget) {
+            size_t sketchShare = total == 0 ? 0 : static_cast<size_t>(
+                static_cast<double>(sketch_.bytes()) * budget / total);
+            return budget > sketchShare ? budget - sketchShare : 0;
+        };
+        configure(positive_, share(options.positiveBudget));
+        configure(negative_, share(options.negativeBudget));
+
+        // 大页时预先分配索引的桶数组（单独的大页区域），增长过程中不反复 rehash
+        if (pages_) index_.reserve(expectedEntries(options));
+    }
+
+    /**
+     * 查找缓存
+     *
+     * @param question 查询的问题
+     * @param result [输出] 命中时填入 rcode 以及调整过 TTL 的记录
+     * @return 命中返回 true；条目已过期时返回 false（调用方应转发到上游）
+     *
+     * 无论是否命中，都会在频率草图中记录一次访问，
+     * 这样一个还没被缓存的名字被反复查询时，也能积累起准入所需的频率。
+     *
+     * 过期条目的处理（RFC 8767）：
+     *   - 超出 serve-stale 窗口：删除，未命中
+     *   - 仍在窗口内，且最近一次上游失败后的 30 秒重试间隔未到：
+     *     直接返回过期数据（TTL = 30），并请求后台刷新，客户端不必等待一个已知故障的上游
+     *   - 仍在窗口内，可以重试：未命中，由调用方转发；转发失败时再调用 serveStale()
+     */
+    bool lookup(const DNSQuestion& question, CacheResult& result)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sketch_.increment(question.hash);
+
+        auto it = find(question);
+        if (it == index_.end())
+        {
+            misses_++;
+            return false;
+        }
+
+        Entry& entry = *it->second;
+        Clock::time_point now = Clock::now();
+        if (now >= entry.expires)
+        {
+            if (expiredBeyondStale(entry, now))
+            {
+                erase(it);
+                misses_++;
+                return false;
+            }
+            if (now < entry.retryAfter)
+            {
+                fillStale(entry, result);
+                return true;
+            }
+            misses_++;
+            return false;
+        }
+
+        Partition& partition = partitionOf(entry);
+        partition.hits[entry.segment]++;
+        onHit(partition, it->second);
+        entry.hits++;
+
+        // 预取判断：命中次数达到阈值，且剩余 TTL 不超过原始 TTL 的 10%
+        // 示例：TTL = 300 秒，则最后 30 秒内的命中会触发一次后台刷新
+        //       （每个条目只触发一次，刷新写回后新条目重新计时）
+        if (options_.prefetchHits != 0 && !entry.prefetching && entry.hits >= options_.prefetchHits &&
+            (entry.expires - now) * 10 <= (entry.expires - entry.stored))
+        {
+            entry.prefetching = true;
+            result.prefetch = true;
+            prefetches_++;
+        }
+
+        uint32_t elapsed = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::seconds>(now - entry.stored).count());
+        result.rcode = entry.rcode;
+        result.answers = entry.answers;
+        result.authorities = entry.authorities;
+        for (auto& record : result.answers) record.ttl = record.ttl > elapsed ? record.ttl - elapsed : 0;
+        for (auto& record : result.authorities) record.ttl = record.ttl > elapsed ? record.ttl - elapsed : 0;
+        return true;
+    }
+
+    /**
+     * 上游失败时取出过期数据（RFC 8767 serve-stale）
+     *
+     * @param question 查询的问题
+     * @param result [输出] 过期数据，所有记录的 TTL 为 STALE_TTL
+     * @return 窗口内有过期数据时返回 true
+     *
+     * 同时启动 30 秒的失败重试间隔：间隔内的查询直接返回过期数据，不再等待上游。
+     */
+    bool serveStale(const DNSQuestion& question, CacheResult& result)
+    {
+        if (options_.serveStaleSeconds == 0) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = find(question);
+        if (it == index_.end()) return false;
+
+        Entry& entry = *it->second;
+        Clock::time_point now = Clock::now();
+        if (expiredBeyondStale(entry, now)) return false;
+
+        entry.retryAfter = now + std::chrono::seconds(FAILURE_RECHECK_SECONDS);
+        fillStale(entry, result);
+        return true;
+    }
+
+    /**
+     * 缓存正向回答
+     *
+     * @param question 查询的问题
+     * @param answers 上游返回的 Answer 记录（不能为空）
+     */
+    void insertPositive(const DNSQuestion& question, const std::pmr::vector<DNSAnswer>& answers)
+    {
+        if (answers.empty()) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        uint32_t ttl = answers[0].ttl;
+        for (const auto& record : answers) ttl = std::min(ttl, record.ttl);
+        if (ttl == 0) return;
+
+        Entry entry(memory_);
+        entry.rcode = 0;
+        entry.negative = false;
+        entry.answers = answers;  // 拷贝到条目自己的（全局堆）内存，不引用调用方的 arena
+        insert(question, std::move(entry), ttl);
+    }
+
+    /**
+     * 预取失败（例如上游不可达）时调用，允许该条目之后再次触发预取；
+     * 条目已过期时同时启动失败重试间隔，期间继续提供过期数据
+     */
+    void prefetchFailed(const DNSQuestion& question)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = find(question);
+        if (it == index_.end()) return;
+
+        Entry& entry = *it->second;
+        entry.prefetching = false;
+        Clock::time_point now = Clock::now();
+        if (now >= entry.expires) entry.retryAfter = now + std::chrono::seconds(FAILURE_RECHECK_SECONDS);
+    }
+
+    /**
+     * 缓存否定回答（NXDOMAIN 或 NODATA）
+     *
+     * @param question 查询的问题
+     * @param rcode 上游的 RCODE（NXDOMAIN = 3，NODATA 为 0）
+     * @param soa 上游 Authority 部分的 SOA 记录
+     *
+     * RFC 2308 第 5 节：否定回答的 TTL 取 SOA 记录本身的 TTL 与 SOA.MINIMUM 中较小者。
+     * SOA RDATA 的最后 4 字节就是 MINIMUM 字段。
+     */
+    void insertNegative(const DNSQuestion& question, uint8_t rcode, const DNSAnswer& soa)
+    {
+        if (soa.rdata.size() < 20) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        const uint8_t* minimumField = soa.rdata.data() + soa.rdata.size() - 4;
+        uint32_t minimum = (static_cast<uint32_t>(minimumField[0]) << 24) |
+                           (static_cast<uint32_t>(minimumField[1]) << 16) |
+                           (static_cast<uint32_t>(minimumField[2]) << 8) |
+                           minimumField[3];
+        uint32_t ttl = std::min({ soa.ttl, minimum, MAX_NEGATIVE_TTL });
+        if (ttl == 0) return;
+
+        Entry entry(memory_);
+        entry.rcode = rcode;
+        entry.negative = true;
+        entry.authorities.push_back(soa);
+        entry.authorities.back().ttl = ttl;
+        insert(question, std::move(entry), ttl);
+    }
+
+    /**
+     * 把缓存导出到快照文件
+     *
+     * @param path 快照文件路径（先写入 path + ".tmp"，完成后 rename 覆盖，崩溃时不会留下半个文件）
+     * @param error [输出] 失败原因
+     * @return 写入的条目数，失败返回 -1
+     *
+     * 文件格式（整数均为大端序）：
+     *   Header:
+     *     MAGIC "DNSC"(4) | VERSION(2) | RESERVED(2) | SAVED_AT(8, Unix 秒) | COUNT(4)
+     *   每个条目:
+     *     FLAGS(1: bit0=否定) | RCODE(1) | SEGMENT(1) | STORED_AT(8, Unix 秒) | TTL(4)
+     *     KEY_LEN(2) | KEY | ANCOUNT(2) | NSCOUNT(2) | 记录...
+     *   每条记录:
+     *     NAME_LEN(1) | NAME（点分文本）| TYPE(2) | CLASS(2) | TTL(4) | RDLENGTH(2) | RDATA
+     *
+     * 每段按从旧到新的顺序写出，加载时依次插入到段头部即可还原 LRU 顺序。
+     */
+    long saveSnapshot(const std::string& path, std::string& error) const
+    {
+        return saveSnapshot({ this }, path, error);
+    }
+
+    /**
+     * 把多个缓存（分片，见 dns_shards.hpp）导出到同一个快照文件，格式同上；
+     * 文件中不记录分片，加载时按域名重新分配，分片数可以与保存时不同
+     */
+    static long saveSnapshot(const std::vector<const DnsCache*>& caches, const std::string& path, std::string& error)
+    {
+        std::vector<uint8_t> bytes;
+        uint32_t count = 0;
+        auto wallNow = std::chrono::system_clock::now();
+        Clock::time_point now = Clock::now();
+
+        bytes.insert(bytes.end(), { 'D', 'N', 'S', 'C' });
+        put16(bytes, SNAPSHOT_VERSION);
+        put16(bytes, 0);
+        put64(bytes, toUnixSeconds(wallNow));
+        size_t countPos = bytes.size();
+        put32(bytes, 0);
+
+        for (const DnsCache* cache : caches)
+        {
+            std::lock_guard<std::mutex> lock(cache->mutex_);
+            for (const Partition* partition : { &cache->positive_, &cache->negative_ })
+            {
+                for (const EntryList& segment : partition->segments)
+                {
+                    for (auto it = segment.rbegin(); it != segment.rend(); ++it)
+                    {
+                        const Entry& entry = *it;
+                        if (cache->expiredBeyondStale(entry, now)) continue;
+
+                        // 条目写入时刻换算成墙钟时间
+                        auto storedWall = wallNow - std::chrono::duration_cast<std::chrono::system_clock::duration>(now - entry.stored);
+                        uint32_t ttl = static_cast<uint32_t>(
+                            std::chrono::duration_cast<std::chrono::seconds>(entry.expires - entry.stored).count());
+
+                        bytes.push_back(entry.negative ? 1 : 0);
+                        bytes.push_back(entry.rcode);
+                        bytes.push_back(entry.segment);
+                        put64(bytes, toUnixSeconds(storedWall));
+                        put32(bytes, ttl);
+                        put16(bytes, static_cast<uint16_t>(entry.key.size()));
+                        bytes.insert(bytes.end(), entry.key.begin(), entry.key.end());
+                        put16(bytes, static_cast<uint16_t>(entry.answers.size()));
+                        put16(bytes, static_cast<uint16_t>(entry.authorities.size()));
+                        for (const auto* records : { &entry.answers, &entry.authorities })
+                        {
+                            for (const auto& record : *records) putRecord(bytes, record);
+                        }
+                        count++;
+                    }
+                }
+            }
+        }
+
+        bytes[countPos] = (count >> 24) & 0xFF;
+        bytes[countPos + 1] = (count >> 16) & 0xFF;
+        bytes[countPos + 2] = (count >> 8) & 0xFF;
+        bytes[countPos + 3] = count & 0xFF;
+
+        std::string tmpPath = path + ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                error = "cannot open " + tmpPath;
+                return -1;
+            }
+            file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            if (!file)
+            {
+                error = "write to " + tmpPath + " failed";
+                return -1;
+            }
+        }
+        if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            error = "rename " + tmpPath + " failed";
+            return -1;
+        }
+        return count;
+    }
+
+    /**
+     * 从快照文件加载缓存（启动时调用）
+     *
+     * @param path 快照文件路径
+     * @param error [输出] 失败原因
+     * @return 加载的条目数；文件不存在或格式错误返回 -1；
+     *         文件在某个条目处被截断或损坏时，返回之前加载的条目数，并在 error 中说明
+     *
+     * TTL 调整：elapsed = 当前墙钟时间 - STORED_AT
+     *   - elapsed >= TTL + serve-stale 窗口：丢弃
+     *   - 否则按“已经在缓存中停留了 elapsed 秒”还原，lookup() 返回的 TTL 会相应减少
+     */
+    long loadSnapshot(const std::string& path, std::string& error)
+    {
+        return loadSnapshot(path, error, [this](std::string_view) -> DnsCache& { return *this; });
+    }
+
+    /**
+     * 从快照文件加载到多个缓存（分片）
+     *
+     * @param route route(name) 返回小写域名 name 所属的缓存
+     */
+    template <class Route>
+    static long loadSnapshot(const std::string& path, std::string& error, Route&& route)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            error = "cannot open " + path;
+            return -1;
+        }
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        SnapshotReader reader{ bytes.data(), bytes.size() };
+        uint8_t magic[4];
+        for (auto& c : magic) c = reader.u8();
+        uint16_t version = reader.u16();
+        reader.u16();
+        reader.u64();
+        uint32_t count = reader.u32();
+        if (!reader.ok || std::memcmp(magic, "DNSC", 4) != 0 || version != SNAPSHOT_VERSION)
+        {
+            error = path + " is not a cache snapshot (version " + std::to_string(SNAPSHOT_VERSION) + ")";
+            return -1;
+        }
+
+        uint64_t wallNow = toUnixSeconds(std::chrono::system_clock::now());
+        Clock::time_point now = Clock::now();
+        long loaded = 0;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            Entry entry;
+            uint8_t flags = reader.u8();
+            entry.negative = flags & 0x01;
+            entry.rcode = reader.u8();
+            uint8_t segment = reader.u8();
+            uint64_t storedAt = reader.u64();
+            uint32_t ttl = reader.u32();
+            entry.key.assign(reader.bytes(reader.u16()));
+            uint16_t answerCount = reader.u16();
+            uint16_t authorityCount = reader.u16();
+            for (uint16_t k = 0; k < answerCount && reader.ok; k++) entry.answers.push_back(reader.record());
+            for (uint16_t k = 0; k < authorityCount && reader.ok; k++) entry.authorities.push_back(reader.record());
+            if (!reader.ok)
+            {
+                error = path + " is truncated after " + std::to_string(loaded) + " entries";
+                return loaded;
+            }
+
+            // 键是 小写域名 + '\0' + TYPE(2) + CLASS(2)；不是这个形状时文件已损坏，之后的长度字段也不可信
+            if (entry.key.size() < KEY_SUFFIX_LENGTH || entry.key[entry.key.size() - KEY_SUFFIX_LENGTH] != '\0')
+            {
+                error = path + " is corrupt after " + std::to_string(loaded) + " entries";
+                return loaded;
+            }
+
+            // 墙钟时间可能被回拨，elapsed 不能为负
+            uint64_t elapsed = wallNow > storedAt ? wallNow - storedAt : 0;
+            DnsCache& cache = route(std::string_view(entry.key.data(), entry.key.size() - KEY_SUFFIX_LENGTH));
+            if (elapsed >= static_cast<uint64_t>(ttl) + cache.options_.serveStaleSeconds) continue;
+            if (segment > SEGMENT_PROTECTED) segment = SEGMENT_WINDOW;
+
+            // 哈希的种子每次启动都不同，所以快照中只保存键，加载时重新计算
+            entry.hash = hashOfKey(entry.key);
+            entry.stored = now - std::chrono::seconds(elapsed);
+            entry.expires = entry.stored + std::chrono::seconds(ttl);
+            entry.bytes = estimateBytes(entry);
+            std::lock_guard<std::mutex> lock(cache.mutex_);
+            if (cache.place(std::move(entry), static_cast<Segment>(segment))) loaded++;
+        }
+        return loaded;
+    }
+
+    // 统计信息快照
+    CacheStats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        CacheStats stats;
+        const Partition* partitions[2] = { &positive_, &negative_ };
+        for (int p = 0; p < 2; p++)
+        {
+            for (int s = 0; s < 3; s++) stats.hits[p][s] = partitions[p]->hits[s];
+            stats.used[p] = partitions[p]->used;
+            stats.budget[p] = partitions[p]->budget;
+        }
+        stats.staleHits = staleHits_;
+        stats.misses = misses_;
+        stats.prefetches = prefetches_;
+        stats.admitted = admitted_;
+        stats.rejected = rejected_;
+        return stats;
+    }
+
+    /**
+     * 格式化统计信息（一行），按段报告命中率
+     *
+     * 示例：
+     *   cache: lookups=1000 hit=87.3% (window=2.1% probation=10.2% protected=70.0% negative=5.0%)
+     *          stale=0 prefetch=12 admitted=40 rejected=345 memory=12.3/64.0MiB neg=0.1/8.0MiB
+     */
+    static std::string format(const CacheStats& stats)
+    {
+        uint64_t positiveHits = stats.hits[0][0] + stats.hits[0][1] + stats.hits[0][2];
+        uint64_t negativeHits = stats.hits[1][0] + stats.hits[1][1] + stats.hits[1][2];
+        uint64_t lookups = positiveHits + negativeHits + stats.staleHits + stats.misses;
+        auto percent = [&](uint64_t n) { return lookups == 0 ? 0.0 : 100.0 * n / lookups; };
+        auto mib = [](size_t bytes) { return bytes / (1024.0 * 1024.0); };
+
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "cache: lookups=%llu hit=%.1f%% (window=%.1f%% probation=%.1f%% protected=%.1f%% negative=%.1f%%) "
+                 "stale=%llu prefetch=%llu admitted=%llu rejected=%llu memory=%.1f/%.1fMiB neg=%.1f/%.1fMiB",
+                 static_cast<unsigned long long>(lookups), percent(positiveHits + negativeHits),
+                 percent(stats.hits[0][0]), percent(stats.hits[0][1]), percent(stats.hits[0][2]),
+                 percent(negativeHits),
+                 static_cast<unsigned long long>(stats.staleHits), static_cast<unsigned long long>(stats.prefetches),
+                 static_cast<unsigned long long>(stats.admitted), static_cast<unsigned long long>(stats.rejected),
+                 mib(stats.used[0]), mib(stats.budget[0]), mib(stats.used[1]), mib(stats.budget[1]));
+        return line;
+    }
+
+private:
+    static constexpr uint16_t SNAPSHOT_VERSION = 1;
+
+    // W-TinyLFU 的三个段
+    enum Segment : uint8_t
+    {
+        SEGMENT_WINDOW = 0,      // 新条目先进入窗口
+        SEGMENT_PROBATION = 1,   // 主区域：试用段（淘汰候选区）
+        SEGMENT_PROTECTED = 2,   // 主区域：保护段（在主区域内被再次命中的条目）
+    };
+
+    struct Entry
+    {
+        // 放进 std::pmr::list 时，键和记录使用链表的内存资源（缓存的内存池）
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        std::pmr::string key;
+        uint64_t hash;                       // DNSQuestion::hash（索引和频率草图共用）
+        uint8_t rcode;
+        bool negative;                       // 属于否定分区
+        Segment segment = SEGMENT_WINDOW;    // 当前所在的段
+        std::pmr::vector<DNSAnswer> answers;        // 默认全局堆，不使用请求 arena
+        std::pmr::vector<DNSAnswer> authorities;
+        Clock::time_point stored;            // 写入时间，用于计算剩余 TTL
+        Clock::time_point expires;           // 过期时间
+        size_t bytes;                        // 估算的内存占用
+        uint32_t hits = 0;                   // 命中次数（决定是否值得预取）
+        bool prefetching = false;            // 已经触发过后台刷新，避免重复
+        Clock::time_point retryAfter{};      // 上游失败后，此时间之前直接提供过期数据
+
+        Entry() = default;
+        explicit Entry(const allocator_type& alloc) : key(alloc), answers(alloc), authorities(alloc) {}
+        // 资源不同时（例如快照加载构造的条目）移动赋值逐项拷贝到 alloc 中
+        Entry(Entry&& other, const allocator_type& alloc) : Entry(alloc) { *this = std::move(other); }
+        Entry(Entry&& other) = default;
+        Entry& operator=(Entry&& other) = default;
+    };
+
+    using EntryList = std::pmr::list<Entry>;
+
+    // 一个分区 = 独立的内存预算 + 三段链表（每段头部最新，尾部最旧）
+    struct Partition
+    {
+        size_t budget = 0;
+        size_t windowBudget = 0;
+        size_t protectedBudget = 0;
+        size_t used = 0;
+        size_t segmentUsed[3] = {};
+        EntryList segments[3];
+        uint64_t hits[3] = {};
+
+        explicit Partition(std::pmr::memory_resource* memory)
+            : segments{ EntryList(memory), EntryList(memory), EntryList(memory) } {}
+    };
+
+    // 以 Question 哈希为键（哈希已经充分混合，std::hash<uint64_t> 直接使用它）。
+    // 两个不同的键哈希相同时，后写入的条目替换先写入的，查找时按键确认，碰撞只会导致一次未命中；
+    // 种子随机，外部无法有意构造碰撞。
+    using Index = std::pmr::unordered_map<uint64_t, EntryList::iterator>;
+
+    CacheOptions options_;
+    std::unique_ptr<HugePageResource> pages_;                       // --huge-pages：大页区域
+    std::unique_ptr<std::pmr::unsynchronized_pool_resource> pool_;  // 在大页区域上按大小回收小块
+    std::pmr::memory_resource* memory_;                             // 条目、链表和索引的内存（先于它们构造）
+    FrequencySketch sketch_;
+    Partition positive_;
+    Partition negative_;
+    Index index_;
+    mutable std::mutex mutex_;
+    uint64_t prefetches_ = 0;
+    uint64_t staleHits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t admitted_ = 0;
+    uint64_t rejected_ = 0;
+
+    // 频率草图的宽度和索引预留的桶数
+    static size_t expectedEntries(const CacheOptions& options)
+    {
+        return std::max<size_t>(64, (options.positiveBudget + options.negativeBudget) / AVERAGE_ENTRY_BYTES);
+    }
+
+    // 大页区域按预算的 1/16 一块块申请（2 MiB ~ 1 GiB）：预算很大时区域数不多，很小时也不会多占太多
+    static std::unique_ptr<HugePageResource> makePages(const CacheOptions& options)
+    {
+        if (options.hugePages == HugePageMode::OFF) return nullptr;
+        size_t chunk = (options.positiveBudget + options.negativeBudget) / 16;
+        chunk = std::clamp<size_t>(chunk, HugePageRegion::HUGE_PAGE_SIZE, size_t(1) << 30);
+        return std::make_unique<HugePageResource>(options.hugePages, chunk);
+    }
+
+    static void configure(Partition& partition, size_t budget)
+    {
+        partition.budget = budget;
+        partition.windowBudget = budget * WINDOW_PERCENT / 100;
+        partition.protectedBudget = (budget - partition.windowBudget) * PROTECTED_PERCENT / 100;
+    }
+
+    Partition& partitionOf(const Entry& entry) { return entry.negative ? negative_ : positive_; }
+
+    // 把条目移到某段的头部（std::list::splice 不会使迭代器失效，索引无需更新）
+    static void moveTo(Partition& partition, EntryList::iterator entry, Segment segment)
+    {
+        partition.segmentUsed[entry->segment] -= entry->bytes;
+        partition.segmentUsed[segment] += entry->bytes;
+        partition.segments[segment].splice(partition.segments[segment].begin(),
+                                           partition.segments[entry->segment], entry);
+        entry->segment = segment;
+    }
+
+    // 命中后的位置调整
+    static void onHit(Partition& partition, EntryList::iterator entry)
+    {
+        switch (entry->segment)
+        {
+            case SEGMENT_WINDOW:
+            case SEGMENT_PROTECTED:
+                moveTo(partition, entry, entry->segment);
+                break;
+            case SEGMENT_PROBATION:
+                // 试用段中再次命中：晋升到保护段
+                moveTo(partition, entry, SEGMENT_PROTECTED);
+                trimProtected(partition);
+                break;
+        }
+    }
+
+    // 保护段超出预算时，最旧的条目降级回试用段头部
+    static void trimProtected(Partition& partition)
+    {
+        while (partition.segmentUsed[SEGMENT_PROTECTED] > partition.protectedBudget)
+        {
+            moveTo(partition, std::prev(partition.segments[SEGMENT_PROTECTED].end()), SEGMENT_PROBATION);
+        }
+    }
+
+    // 用过期条目填充结果：所有记录 TTL = STALE_TTL，并在没有刷新进行中时请求后台刷新
+    void fillStale(Entry& entry, CacheResult& result)
+    {
+        staleHits_++;
+        result.rcode = entry.rcode;
+        result.answers = entry.answers;
+        result.authorities = entry.authorities;
+        for (auto& record : result.answers) record.ttl = STALE_TTL;
+        for (auto& record : result.authorities) record.ttl = STALE_TTL;
+        result.stale = true;
+        if (!entry.prefetching)
+        {
+            entry.prefetching = true;
+            result.prefetch = true;
+        }
+    }
+
+    static constexpr size_t KEY_SUFFIX_LENGTH = 5;  // '\0' + TYPE(2) + CLASS(2)
+
+    // 键：小写域名 + '\0' + TYPE(2) + CLASS(2)，只在写入时构造（用于确认命中和写入快照）
+    static void makeKey(const DNSQuestion& question, std::pmr::string& key)
+    {
+        key.resize(question.name.size());
+        LabelSimd::toLower(key.data(), question.name.data(), question.name.size());
+        key += '\0';
+        key += static_cast<char>(question.type >> 8);
+        key += static_cast<char>(question.type & 0xFF);
+        key += static_cast<char>(question.qclass >> 8);
+        key += static_cast<char>(question.qclass & 0xFF);
+    }
+
+    // 从键还原 Question 哈希（快照加载时使用；键至少 KEY_SUFFIX_LENGTH 字节）
+    static uint64_t hashOfKey(const std::pmr::string& key)
+    {
+        size_t nameLength = key.size() - KEY_SUFFIX_LENGTH;
+        const uint8_t* suffix = reinterpret_cast<const uint8_t*>(key.data()) + nameLength + 1;
+        uint16_t type = static_cast<uint16_t>((suffix[0] << 8) | suffix[1]);
+        uint16_t qclass = static_cast<uint16_t>((suffix[2] << 8) | suffix[3]);
+        return QuestionHash::of(std::string_view(key.data(), nameLength), type, qclass);
+    }
+
+    // 请求中的 Question 与条目的键是否相同（域名不区分大小写）
+    static bool sameQuestion(const Entry& entry, const DNSQuestion& question)
+    {
+        size_t nameLength = question.name.size();
+        if (entry.key.size() != nameLength + KEY_SUFFIX_LENGTH) return false;
+        const uint8_t* suffix = reinterpret_cast<const uint8_t*>(entry.key.data()) + nameLength + 1;
+        return suffix[0] == (question.type >> 8) && suffix[1] == (question.type & 0xFF) &&
+               suffix[2] == (question.qclass >> 8) && suffix[3] == (question.qclass & 0xFF) &&
+               LabelSimd::equalsLower(entry.key.data(), question.name.data(), nameLength);
+    }
+
+    // 按 Question 哈希查找，并确认不是碰撞；找不到时返回 index_.end()
+    Index::iterator find(const DNSQuestion& question)
+    {
+        auto it = index_.find(question.hash);
+        if (it != index_.end() && !sameQuestion(*it->second, question)) return index_.end();
+        return it;
+    }
+
+    // 估算条目占用的内存：结构体本身 + 链表节点 + 索引节点 + 键 + 每条记录的名字和 RDATA
+    static size_t estimateBytes(const Entry& entry)
+    {
+        size_t bytes = sizeof(Entry) + 2 * sizeof(void*) +
+                       sizeof(Index::value_type) + 2 * sizeof(void*) + entry.key.size();
+        for (const auto* records : { &entry.answers, &entry.authorities })
+        {
+            for (const auto& record : *records)
+            {
+                bytes += sizeof(DNSAnswer) + record.name.size() + record.rdata.size();
+            }
+        }
+        return bytes;
+    }
+
+    bool expiredBeyondStale(const Entry& entry, Clock::time_point now) const
+    {
+        return now >= entry.expires + std::chrono::seconds(options_.serveStaleSeconds);
+    }
+
+    void insert(const DNSQuestion& question, Entry&& entry, uint32_t ttl)
+    {
+        makeKey(question, entry.key);
+        entry.hash = question.hash;
+        entry.stored = Clock::now();
+        entry.expires = entry.stored + std::chrono::seconds(ttl);
+        entry.bytes = estimateBytes(entry);
+        place(std::move(entry), SEGMENT_WINDOW);
+    }
+
+    /**
+     * 把一个准备好的条目放入指定的段，然后恢复预算
+     *
+     * 同一个键可能从否定变为正向（或相反），先删除旧条目；
+     * 预取刷新会替换同一个键：保留命中次数和所在的段，热门条目刷新后仍留在保护段。
+     * 哈希相同但键不同（碰撞）的旧条目同样被删除，但不继承它的命中次数和段
+     */
+    bool place(Entry&& entry, Segment segment)
+    {
+        Partition& partition = entry.negative ? negative_ : positive_;
+        if (entry.bytes > partition.budget) return false;
+
+        auto existing = index_.find(entry.hash);
+        if (existing != index_.end())
+        {
+            if (existing->second->key == entry.key)
+            {
+                entry.hits = existing->second->hits;
+                if (existing->second->negative == entry.negative) segment = existing->second->segment;
+            }
+            erase(existing);
+        }
+
+        entry.segment = segment;
+        partition.used += entry.bytes;
+        partition.segmentUsed[segment] += entry.bytes;
+        partition.segments[segment].push_front(std::move(entry));
+        index_[partition.segments[segment].front().hash] = partition.segments[segment].begin();
+
+        trimProtected(partition);
+        evict(partition);
+        return true;
+    }
+
+    /**
+     * 恢复预算：
+     *   1. 窗口超出预算时，窗口中最旧的条目进入试用段头部，成为准入候选
+     *   2. 分区总量超出预算时，从最早移出窗口的候选开始，比较候选和受害者（试用段尾部）的访问频率，
+     *      淘汰频率较低的一方；已经彻底过期的受害者直接淘汰；没有候选时直接淘汰受害者
+     *
+     * 只有本次调用移出窗口的条目是候选：从保护段降级的条目同样放在试用段头部，但它们已经在主区域中，
+     * 不需要再次准入。本次移出了 candidates 个条目时，它们就是试用段头部的 candidates 个条目：
+     *   试用段：[w3] [w2] [w1] [p1] [p2] ... [victim]     （w1 最先移出，先和 victim 比较）
+     */
+    void evict(Partition& partition)
+    {
+        size_t candidates = 0;
+        while (partition.segmentUsed[SEGMENT_WINDOW] > partition.windowBudget)
+        {
+            moveTo(partition, std::prev(partition.segments[SEGMENT_WINDOW].end()), SEGMENT_PROBATION);
+            candidates++;
+        }
+
+        Clock::time_point now = Clock::now();
+        while (partition.used > partition.budget)
+        {
+            EntryList& probation = partition.segments[SEGMENT_PROBATION];
+            if (probation.empty())
+            {
+                // 试用段为空（例如预算极小）：依次从保护段、窗口的尾部淘汰
+                Segment from = partition.segments[SEGMENT_PROTECTED].empty() ? SEGMENT_WINDOW : SEGMENT_PROTECTED;
+                erase(index_.find(partition.segments[from].back().hash));
+                continue;
+            }
+
+            // 候选都在试用段头部：试用段中只剩候选时，受害者本身就是最早的候选
+            Entry& victim = probation.back();
+            bool victimIsCandidate = probation.size() <= candidates;
+            if (candidates == 0 || victimIsCandidate || expiredBeyondStale(victim, now))
+            {
+                if (victimIsCandidate) candidates--;
+                erase(index_.find(victim.hash));
+                continue;
+            }
+
+            Entry& candidate = *std::next(probation.begin(), candidates - 1);
+            candidates--;
+            if (sketch_.frequency(candidate.hash) > sketch_.frequency(victim.hash))
+            {
+                admitted_++;
+                erase(index_.find(victim.hash));
+            }
+            else
+            {
+                rejected_++;
+                erase(index_.find(candidate.hash));
+            }
+        }
+    }
+
+    // ---------- 快照编码 ----------
+
+    static uint64_t toUnixSeconds(std::chrono::system_clock::time_point time)
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count());
+    }
+
+    static void put16(std::vector<uint8_t>& out, uint16_t value)
+    {
+        out.push_back((value >> 8) & 0xFF);
+        out.push_back(value & 0xFF);
+    }
+
+    static void put32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        put16(out, static_cast<uint16_t>(value >> 16));
+        put16(out, static_cast<uint16_t>(value & 0xFFFF));
+    }
+
+    static void put64(std::vector<uint8_t>& out, uint64_t value)
+    {
+        put32(out, static_cast<uint32_t>(value >> 32));
+        put32(out, static_cast<uint32_t>(value & 0xFFFFFFFF));
+    }
+
+    static void putRecord(std::vector<uint8_t>& out, const DNSAnswer& record)
+    {
+        out.push_back(static_cast<uint8_t>(record.name.size()));
+        out.insert(out.end(), record.name.begin(), record.name.end());
+        put16(out, record.type);
+        put16(out, record.aclass);
+        put32(out, record.ttl);
+        put16(out, static_cast<uint16_t>(record.rdata.size()));
+        out.insert(out.end(), record.rdata.begin(), record.rdata.end());
+    }
+
+    // 带边界检查的读取器：越界后 ok = false，之后的读取都返回 0
+    struct SnapshotReader
+    {
+        const uint8_t* data;
+        size_t size;
+        size_t pos = 0;
+        bool ok = true;
+
+        bool need(size_t n)
+        {
+            if (ok && size - pos >= n) return true;
+            ok = false;
+            return false;
+        }
+
+        uint8_t u8() { return need(1) ? data[pos++] : 0; }
+        uint16_t u16() { uint16_t high = u8(); return static_cast<uint16_t>((high << 8) | u8()); }
+        uint32_t u32() { uint32_t high = u16(); return (high << 16) | u16(); }
+        uint64_t u64() { uint64_t high = u32(); return (high << 32) | u32(); }
+
+        std::string bytes(size_t n)
+        {
+            if (!need(n)) return std::string();
+            std::string out(reinterpret_cast<const char*>(data + pos), n);
+            pos += n;
+            return out;
+        }
+
+        DNSAnswer record()
+        {
+            DNSAnswer record;
+            record.name = bytes(u8());
+            record.type = u16();
+            record.aclass = u16();
+            record.ttl = u32();
+            record.rdlength = u16();
+            std::string rdata = bytes(record.rdlength);
+            record.rdata.assign(rdata.begin(), rdata.end());
+            return record;
+        }
+    };
+
+    void erase(Index::iterator it)
+    {
+        EntryList::iterator entry = it->second;
+        Partition& partition = partitionOf(*entry);
+        partition.used -= entry->bytes;
+        partition.segmentUsed[entry->segment] -= entry->bytes;
+        partition.segments[entry->segment].erase(entry);
+        index_.erase(it);
+    }
+};
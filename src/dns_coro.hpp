@@ -0,0 +1,439 @@
+/**
+ * 基于 C++20 协程的上游转发（--resolver-threads 的解析线程）
+ *
+ * 同步的 forwardQuery() 在上游回复之前一直占着线程：一个解析线程同时只能等一个上游查询，
+ * 超时、重试、一个请求里的多个问题都只能一个接一个地串行等待。
+ *
+ * 这里每个请求是一个协程，代码仍然按顺序写，等待上游时挂起，不占线程：
+ *
+ *   DetachedTask resolve(...)
+ *   {
+ *       UpstreamClient::Reply reply = co_await upstream.query(question);   // 挂起，直到响应到达或超时
+ *       if (!reply.ok) reply = co_await upstream.query(question);          // 重试：换一个 ID 再发一次
+ *       ...
+ *   }
+ *
+ * 一个线程上可以同时挂起成千上万个请求，由一个基于 epoll 的事件循环（EventLoop）驱动：
+ *
+ *   EventLoop::runOnce()
+ *     epoll_wait(上游套接字, 门铃 eventfd, 超时 = 最近的定时器)
+ *       上游套接字可读 -> UpstreamClient 按 ID 找到等待的协程 -> resume()
+ *       定时器到期     -> 对应的查询以 ok = false 结束 -> resume()
+ *
+ * UpstreamClient：一个解析线程一个 connect() 到上游的非阻塞 UDP 套接字
+ *   - 每个查询一个随机的 16 位 ID（跳过正在使用的 ID），响应按 ID 和 Question 匹配，
+ *     不匹配的报文（迟到的、伪造的）直接丢弃
+ *   - 相同的问题已经在等待上游时不再发送，新的查询加入等待者列表，一个响应唤醒所有等待者
+ *   - 查询对象（Query）在协程帧里；协程被销毁时 Query 的析构函数把自己从等待者列表中移除
+ *   - 响应直接收进报文缓冲区池的缓冲区（dns_packet.hpp），匹配后整个缓冲区交给等待的协程，不再复制
+ *
+ * 并行：先创建所有 Query（构造时就发出请求），再逐个 co_await，等待时间 = 最慢的一个，而不是总和：
+ *
+ *   std::deque<UpstreamClient::Query> queries;
+ *   for (const DNSQuestion& q : questions) queries.emplace_back(upstream, q);
+ *   for (auto& query : queries) replies.push_back(co_await query);
+ */
+
+#pragma once
+
+#include <algorithm>     // std::find
+#include <cctype>        // tolower()
+#include <cerrno>        // errno
+#include <chrono>        // std::chrono::steady_clock 定时器
+#include <coroutine>     // std::coroutine_handle, std::suspend_never
+#include <cstdint>       // uint8_t, uint16_t, uint64_t
+#include <cstdio>        // perror()
+#include <exception>     // std::terminate
+#include <functional>    // std::function 事件回调
+#include <memory>        // std::unique_ptr
+#include <queue>         // std::priority_queue 定时器堆
+#include <random>        // std::mt19937 查询 ID
+#include <unordered_map> // ID -> 请求, 问题哈希 -> 请求
+#include <utility>       // std::move, std::pair
+#include <vector>        // std::vector
+#include <sys/epoll.h>   // epoll_create1(), epoll_ctl(), epoll_wait()
+#include <sys/socket.h>  // socket(), connect(), send(), recv()
+#include <unistd.h>      // close()
+
+#include "dns_address.hpp"
+#include "dns_message.hpp"
+#include "dns_packet.hpp"
+
+/**
+ * 不需要返回值、也没有人等待的协程：创建后立即开始执行，结束时自己释放协程帧
+ *
+ * 协程挂起期间由唤醒它的对象（UpstreamClient）持有句柄；线程退出时由 UpstreamClient 销毁。
+ */
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+/**
+ * 单线程的事件循环：epoll 上的可读事件 + 定时器
+ */
+class EventLoop
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    EventLoop() : epollFd_(epoll_create1(EPOLL_CLOEXEC))
+    {
+        if (epollFd_ == -1) perror("epoll_create1");
+    }
+
+    ~EventLoop()
+    {
+        if (epollFd_ != -1) close(epollFd_);
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * fd 可读时调用 onReadable（水平触发：回调没有读完时下一轮还会调用）
+     *
+     * 描述符关闭时自动从 epoll 中移除；回调必须比事件循环的最后一次 runOnce() 活得久
+     */
+    bool watch(int fd, std::function<void()> onReadable)
+    {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = handlers_.size();
+        if (epollFd_ == -1 || epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) == -1)
+        {
+            perror("epoll_ctl");
+            return false;
+        }
+        handlers_.push_back(std::move(onReadable));
+        return true;
+    }
+
+    // delay 之后调用 fn（只调用一次），返回可以传给 cancel() 的编号
+    uint64_t after(std::chrono::milliseconds delay, std::function<void()> fn)
+    {
+        uint64_t id = nextTimer_++;
+        timers_.emplace(id, std::move(fn));
+        deadlines_.emplace(Clock::now() + delay, id);
+        return id;
+    }
+
+    void cancel(uint64_t timer) { timers_.erase(timer); }
+
+    /**
+     * 等待最多 maxWaitMs 毫秒（-1 = 直到有事件或定时器到期，0 = 不等待），处理所有就绪的事件和到期的定时器
+     */
+    void runOnce(int maxWaitMs)
+    {
+        int waitMs = maxWaitMs;
+        if (Clock::time_point deadline; nextDeadline(deadline))
+        {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            if (remaining < 0) remaining = 0;
+            if (waitMs < 0 || remaining < waitMs) waitMs = static_cast<int>(remaining);
+        }
+
+        epoll_event events[64];
+        int ready = epoll_wait(epollFd_, events, 64, waitMs);
+        for (int i = 0; i < ready; i++) handlers_[events[i].data.u64]();
+
+        // 到期的定时器；回调里可能再添加定时器，所以每次都从堆顶重新取
+        Clock::time_point now = Clock::now();
+        while (!deadlines_.empty() && deadlines_.top().first <= now)
+        {
+            uint64_t id = deadlines_.top().second;
+            deadlines_.pop();
+            auto timer = timers_.find(id);
+            if (timer == timers_.end()) continue;   // 已经 cancel()
+            std::function<void()> fn = std::move(timer->second);
+            timers_.erase(timer);
+            fn();
+        }
+    }
+
+private:
+    using Deadline = std::pair<Clock::time_point, uint64_t>;
+
+    int epollFd_;
+    std::vector<std::function<void()>> handlers_;   // 下标 = epoll_event.data.u64
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines_;   // 最早的在堆顶
+    std::unordered_map<uint64_t, std::function<void()>> timers_;   // 还没有到期也没有取消的定时器
+    uint64_t nextTimer_ = 0;
+
+    // 最近一个仍然有效的定时器（顺便丢掉堆顶已经取消的条目）
+    bool nextDeadline(Clock::time_point& deadline)
+    {
+        while (!deadlines_.empty() && timers_.find(deadlines_.top().second) == timers_.end()) deadlines_.pop();
+        if (deadlines_.empty()) return false;
+        deadline = deadlines_.top().first;
+        return true;
+    }
+};
+
+class UpstreamClient
+{
+public:
+    // 一次上游查询的结果：ok = 超时之前收到了匹配的响应，packet 是完整的响应报文
+    struct Reply
+    {
+        bool ok = false;
+        PacketPool::Packet packet;
+    };
+
+private:
+    struct Request;
+
+public:
+    /**
+     * 一次上游查询，可以 co_await；构造时就发出请求（或加入相同问题的等待者）
+     *
+     * 不能复制或移动（UpstreamClient 保存着它的地址），放在协程帧里或 std::deque 中
+     */
+    class Query
+    {
+    public:
+        Query(UpstreamClient& client, const DNSQuestion& question) : client_(client) { client_.start(*this, question); }
+        ~Query() { if (request_ != nullptr) client_.leave(*this); }
+
+        Query(const Query&) = delete;
+        Query& operator=(const Query&) = delete;
+
+        // co_await 使用的等待器只引用 Query（Query 本身不能复制）
+        struct Awaiter
+        {
+            Query& query;
+            bool await_ready() const noexcept { return query.done_; }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { query.handle_ = handle; }
+            Reply await_resume() { return std::move(query.reply_); }
+        };
+
+        Awaiter operator co_await() noexcept { return Awaiter{ *this }; }
+
+    private:
+        friend class UpstreamClient;
+
+        UpstreamClient& client_;
+        Request* request_ = nullptr;        // 等待中的上游请求，结束后为空
+        std::coroutine_handle<> handle_;    // 正在 co_await 这个查询的协程
+        bool done_ = false;
+        Reply reply_;
+    };
+
+    /**
+     * @param loop 本线程的事件循环（必须比 UpstreamClient 活得久）
+     * @param resolver 上游地址
+     * @param timeoutMs 每次查询等待响应的时间
+     * @param packets 本线程的报文缓冲区（接收上游的响应）
+     */
+    UpstreamClient(EventLoop& loop, const SocketAddress& resolver, int timeoutMs, PacketPool::Cache& packets)
+        : loop_(loop), packets_(packets), timeout_(timeoutMs), random_(std::random_device{}())
+    {
+        fd_ = socket(resolver.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ == -1)
+        {
+            perror("Failed to create upstream socket");
+            return;
+        }
+        // connect()：内核只把上游地址发来的报文交给这个套接字
+        if (connect(fd_, resolver.data(), resolver.length) == -1 || !loop_.watch(fd_, [this] { receive(); }))
+        {
+            perror("Failed to connect upstream socket");
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    /**
+     * 销毁所有还在等待上游的协程（线程退出时）
+     */
+    ~UpstreamClient()
+    {
+        std::vector<std::coroutine_handle<>> waiting;
+        for (auto& [id, request] : requests_)
+        {
+            loop_.cancel(request->timer);
+            for (Query* query : request->waiters)
+            {
+                query->request_ = nullptr;
+                if (query->handle_) waiting.push_back(query->handle_);
+            }
+        }
+        requests_.clear();
+        byQuestion_.clear();
+        for (std::coroutine_handle<> handle : waiting) handle.destroy();
+        if (fd_ != -1) close(fd_);
+    }
+
+    UpstreamClient(const UpstreamClient&) = delete;
+    UpstreamClient& operator=(const UpstreamClient&) = delete;
+
+    Query query(const DNSQuestion& question) { return Query(*this, question); }
+
+    // 正在等待上游的请求数（合并的相同问题只算一个）
+    size_t inFlight() const { return requests_.size(); }
+
+private:
+    struct Request
+    {
+        uint16_t id;
+        uint64_t hash;                  // Question 哈希（合并相同的问题）
+        std::vector<uint8_t> question;  // 请求中 Question 部分的线格式，与响应逐字节比较
+        uint64_t timer;
+        std::vector<Query*> waiters;
+    };
+
+    EventLoop& loop_;
+    PacketPool::Cache& packets_;
+    int fd_ = -1;
+    std::chrono::milliseconds timeout_;
+    std::mt19937 random_;
+    std::unordered_map<uint16_t, std::unique_ptr<Request>> requests_;   // ID -> 请求
+    std::unordered_map<uint64_t, Request*> byQuestion_;                  // Question 哈希 -> 请求
+
+    void start(Query& query, const DNSQuestion& question)
+    {
+        if (fd_ == -1)
+        {
+            query.done_ = true;   // ok = false：按上游失败处理
+            return;
+        }
+
+        DNSMessage message;
+        message.header.id = 0;
+        message.header.flags = 0x0100;  // RD=1
+        message.header.qdcount = 1;
+        message.header.ancount = 0;
+        message.header.nscount = 0;
+        message.header.arcount = 0;
+        message.questions.push_back(question);
+        std::pmr::vector<uint8_t> packet = message.serialize();
+
+        // 相同的问题正在等待上游：加入等待者，不再发送
+        auto same = byQuestion_.find(question.hash);
+        if (same != byQuestion_.end() && matches(*same->second, packet.data() + 12, packet.size() - 12))
+        {
+            query.request_ = same->second;
+            same->second->waiters.push_back(&query);
+            return;
+        }
+
+        uint16_t id;
+        do { id = static_cast<uint16_t>(random_()); } while (requests_.count(id) != 0);
+        packet[0] = id >> 8;
+        packet[1] = id & 0xFF;
+        if (send(fd_, packet.data(), packet.size(), 0) == -1)
+        {
+            perror("Failed to send to resolver");
+            query.done_ = true;
+            return;
+        }
+
+        auto request = std::make_unique<Request>();
+        request->id = id;
+        request->hash = question.hash;
+        request->question.assign(packet.begin() + 12, packet.end());
+        request->timer = loop_.after(timeout_, [this, id] {
+            auto expired = requests_.find(id);
+            if (expired != requests_.end()) finish(*expired->second, nullptr);
+        });
+        request->waiters.push_back(&query);
+        query.request_ = request.get();
+        byQuestion_[question.hash] = request.get();
+        requests_.emplace(id, std::move(request));
+    }
+
+    // 协程在查询结束之前被销毁：移出等待者；没有人再等这个请求时取消它（迟到的响应按未知 ID 丢弃）
+    void leave(Query& query)
+    {
+        Request& request = *query.request_;
+        request.waiters.erase(std::find(request.waiters.begin(), request.waiters.end(), &query));
+        query.request_ = nullptr;
+        if (request.waiters.empty()) erase(request);
+    }
+
+    void erase(Request& request)
+    {
+        loop_.cancel(request.timer);
+        auto indexed = byQuestion_.find(request.hash);
+        if (indexed != byQuestion_.end() && indexed->second == &request) byQuestion_.erase(indexed);
+        requests_.erase(request.id);   // 最后一步：request 随之释放
+    }
+
+    // 套接字可读：取出所有报文，按 ID 和 Question 找到请求
+    // （不匹配的报文不占用缓冲区：同一个缓冲区继续接收下一个）
+    void receive()
+    {
+        PacketPool::Packet packet;
+        while (true)
+        {
+            if (!packet) packet = packets_.acquire();
+            uint8_t* buffer = packet.data();
+            ssize_t received = recv(fd_, buffer, packet.capacity(), 0);
+            if (received == -1)
+            {
+                // EAGAIN：读完了；ECONNREFUSED（上游端口不可达）等错误由超时处理
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+                continue;
+            }
+            size_t size = static_cast<size_t>(received);
+            if (size < 12 || (buffer[2] & 0x80) == 0) continue;   // QR=0：不是响应
+
+            auto found = requests_.find(static_cast<uint16_t>(buffer[0] << 8 | buffer[1]));
+            if (found == requests_.end()) continue;
+            Request& request = *found->second;
+            if (size < 12 + request.question.size() || !matches(request, buffer + 12, request.question.size())) continue;
+            packet.resize(size);
+            finish(request, &packet);
+        }
+    }
+
+    // Question 部分相同：域名不区分大小写（上游可能改变大小写），TYPE / CLASS 完全相同
+    static bool matches(const Request& request, const uint8_t* question, size_t length)
+    {
+        if (length != request.question.size()) return false;
+        size_t nameLength = length - 4;
+        for (size_t i = 0; i < nameLength; i++)
+        {
+            if (std::tolower(question[i]) != std::tolower(request.question[i])) return false;
+        }
+        return std::equal(question + nameLength, question + length, request.question.begin() + nameLength);
+    }
+
+    /**
+     * 请求结束（packet 为空 = 超时）：把结果交给所有等待者，然后恢复它们
+     *
+     * 第一个等待者拿走 packet，合并进来的其他等待者各得到一份拷贝
+     * 先把请求移出表再恢复：被恢复的协程可能立即发出新的查询（重试），甚至用到同一个 ID
+     */
+    void finish(Request& request, PacketPool::Packet* packet)
+    {
+        std::vector<std::coroutine_handle<>> resume;
+        const PacketPool::Packet* first = nullptr;
+        for (Query* query : request.waiters)
+        {
+            query->request_ = nullptr;
+            query->done_ = true;
+            query->reply_.ok = packet != nullptr;
+            if (packet != nullptr && first == nullptr)
+            {
+                query->reply_.packet = std::move(*packet);
+                first = &query->reply_.packet;
+            }
+            else if (packet != nullptr)
+            {
+                query->reply_.packet = packets_.acquire();
+                query->reply_.packet.assign(first->data(), first->size());
+            }
+            if (query->handle_) resume.push_back(query->handle_);
+        }
+        erase(request);
+        for (std::coroutine_handle<> handle : resume) handle.resume();
+    }
+};
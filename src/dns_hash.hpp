@@ -0,0 +1,173 @@
+/**
+ * Question 哈希：(QNAME, QTYPE, QCLASS) 的 64 位哈希，域名不区分大小写
+ *
+ * 解析器在逐个标签复制域名时顺便累加哈希（addLabel），解析完 TYPE / CLASS 后 finish()，
+ * 结果保存在 DNSQuestion::hash 中。缓存、区域和限速表直接使用它，不必再扫描一遍域名。
+ *
+ * 计算方式（每个标签 8 字节一组，SWAR 小写化后混入）：
+ *   h = seed
+ *   对每个标签: h = mix(h, 长度); 每 8 字节: h = mix(h, lower(word))   （不足 8 字节补 0）
+ *   h = finalize(mix(h, TYPE << 16 | CLASS))
+ *
+ * 示例："WWW.Example.com" 与 "www.example.COM" 的标签序列都是 [www][example][com]，
+ *       小写化后完全相同，所以哈希相同；而 "wwwexample.com" 的标签边界不同，哈希不同。
+ *
+ * 哈希是“带种子”的：种子在进程启动时随机生成，外部无法离线构造大量碰撞的域名
+ * 来拖慢哈希表（hash flooding）。哈希值只在进程内使用，不要写进快照文件。
+ */
+
+#pragma once
+
+#include <cstddef>      // size_t
+#include <cstdint>      // uint64_t, uint32_t
+#include <cstring>      // memcpy() 读取 8 字节的字
+#include <random>       // std::random_device 随机种子
+#include <string_view>  // std::string_view 点分域名
+
+struct QuestionHash
+{
+    // 进程内固定的随机种子（哈希的起始值）
+    static uint64_t seed()
+    {
+        static const uint64_t value = [] {
+            std::random_device random;
+            return (static_cast<uint64_t>(random()) << 32) ^ random();
+        }();
+        return value;
+    }
+
+    /**
+     * 混入一个标签（任意大小写）
+     *
+     * @param h 当前哈希
+     * @param label 标签内容（不含长度字节）
+     * @param n 标签长度
+     */
+    static uint64_t addLabel(uint64_t h, const uint8_t* label, size_t n)
+    {
+        h = mix(h, n);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, label + i, 8);
+            h = mix(h, lower8(word));
+        }
+        if (i < n)
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, label + i, n - i);
+            h = mix(h, lower8(word));
+        }
+        return h;
+    }
+
+    // 混入 TYPE 和 CLASS，并做最后的雪崩处理（让每一位都影响全部输出位）
+    static uint64_t finish(uint64_t h, uint16_t type, uint16_t qclass)
+    {
+        h = mix(h, (static_cast<uint64_t>(type) << 16) | qclass);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /**
+     * 从点分文本计算哈希（区域加载、快照加载等不经过解析器的场合）
+     *
+     * 与解析器得到的结果相同：标签内不可能有 '.'（解析器会拒绝），按 '.' 切分即可还原标签序列。
+     */
+    static uint64_t of(std::string_view name, uint16_t type, uint16_t qclass)
+    {
+        uint64_t h = seed();
+        size_t start = 0;
+        while (start < name.size())
+        {
+            size_t dot = name.find('.', start);
+            if (dot == std::string_view::npos) dot = name.size();
+            h = addLabel(h, reinterpret_cast<const uint8_t*>(name.data() + start), dot - start);
+            start = dot + 1;
+        }
+        return finish(h, type, qclass);
+    }
+
+private:
+    static uint64_t mix(uint64_t h, uint64_t value)
+    {
+        h ^= value * 0x9E3779B97F4A7C15ULL;
+        h = (h << 27) | (h >> 37);
+        return h * 0xC2B2AE3D27D4EB4FULL;
+    }
+
+    /**
+     * 一次把 8 个字节中的 'A'..'Z' 转成小写（SWAR：把 64 位整数当作 8 个字节的向量）
+     *
+     *   low7  = word & 0x7F..   每个字节的低 7 位（加法不会进位到相邻字节）
+     *   geA   = low7 + 0x3F..   字节 >= 'A'(0x41) 时最高位变为 1
+     *   gtZ   = low7 + 0x25..   字节 >  'Z'(0x5A) 时最高位变为 1
+     *   upper = (geA ^ gtZ) & ~word & 0x80..   在 'A'..'Z' 之间且本身是 ASCII
+     *   word | (upper >> 2)     0x80 >> 2 = 0x20，大写字母加上 0x20
+     */
+    static uint64_t lower8(uint64_t word)
+    {
+        const uint64_t high = 0x8080808080808080ULL;
+        uint64_t low7 = word & ~high;
+        uint64_t geA = low7 + 0x3F3F3F3F3F3F3F3FULL;
+        uint64_t gtZ = low7 + 0x2525252525252525ULL;
+        uint64_t upper = (geA ^ gtZ) & ~word & high;
+        return word | (upper >> 2);
+    }
+};
+
+/**
+ * 分流哈希：steer=hash 的 eBPF 程序对 QNAME 线格式逐字节 (b | 0x20) 做的 32 位 FNV-1a
+ *
+ * 缓存分片（--cache-shards）用同一个哈希选择分片，名字所在的分片就是内核把它交给的工作线程。
+ * 解析器在复制标签时顺便累加（addLabel），结果保存在 DNSQuestion::shardHash 中，
+ * 每次查找 / 插入缓存时不必再扫描一遍域名。与 QuestionHash 不同，它没有随机种子（必须与内核中的程序一致）。
+ *
+ * 示例："WWW.example.com" 的线格式为 03 'W' 'W' 'W' 07 'e' ... 03 'c' 'o' 'm' 00，
+ *       依次混入 03 'w' 'w' 'w' 07 'e' ... 'm'（到根标签为止），与 "www.example.com" 的结果相同
+ */
+struct SteeringHash
+{
+    static constexpr uint32_t OFFSET = 2166136261u;
+    static constexpr uint32_t PRIME = 16777619u;
+    static constexpr size_t MAX_NAME_BYTES = 255;   // 程序最多看 QNAME 的 255 个字节
+
+    // 混入一个标签：长度字节和内容（解析得到的域名不超过 255 字节，不会到达程序的上限）
+    static uint32_t addLabel(uint32_t h, const uint8_t* label, size_t n)
+    {
+        h = mix(h, static_cast<uint8_t>(n));
+        for (size_t i = 0; i < n; i++) h = mix(h, label[i]);
+        return h;
+    }
+
+    // 从点分文本计算（快照加载按名字重新分配分片时使用）；超过 255 字节的部分与程序一样忽略
+    static uint32_t of(std::string_view name)
+    {
+        uint32_t h = OFFSET;
+        size_t start = 0;
+        size_t remaining = MAX_NAME_BYTES;
+        while (start < name.size() && remaining > 0)
+        {
+            size_t dot = name.find('.', start);
+            if (dot == std::string_view::npos) dot = name.size();
+            size_t length = dot - start;
+            if (length == 0) break;   // 根标签（末尾的点）
+            h = mix(h, static_cast<uint8_t>(length));
+            remaining--;
+            for (size_t i = 0; i < length && remaining > 0; i++, remaining--) h = mix(h, static_cast<uint8_t>(name[start + i]));
+            start = dot + 1;
+        }
+        return h;
+    }
+
+private:
+    static uint32_t mix(uint32_t h, uint8_t byte)
+    {
+        return (h ^ (byte | 0x20u)) * PRIME;
+    }
+};
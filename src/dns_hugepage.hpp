@@ -0,0 +1,353 @@
+/**
+ * 大页内存（--huge-pages transparent|explicit）
+ *
+ * 缓存和报文缓冲区达到 GB 级别时，4 KiB 页面的 TLB 远远覆盖不了它们：
+ * 每次查找都要走一遍页表（TLB miss）。2 MiB 的大页让同样多的 TLB 项覆盖 512 倍的内存。
+ *
+ * 两种来源：
+ *   explicit     hugetlbfs 预留的大页（mmap MAP_HUGETLB | MAP_HUGE_2MB），需要管理员事先预留：
+ *                  sysctl vm.nr_hugepages=1024      # 2 GiB
+ *                预留不够时 mmap() 立即失败（不会在之后的缺页时才失败），自动回退到 transparent
+ *   transparent  透明大页（madvise MADV_HUGEPAGE）：内核在缺页或 khugepaged 整理时尽量使用大页，
+ *                不需要预留，但不保证；/sys/kernel/mm/transparent_hugepage/enabled 为 never 时没有效果。
+ *                不可用时回退到普通页面
+ *
+ * HugePageRegion：一块匿名映射（内容为 0），记录实际得到的是哪种页面；
+ *   小于半个大页的区域直接使用普通页面（凑整成 2 MiB 浪费太多）。
+ * HugePageResource：以大块 HugePageRegion 为后备的 std::pmr::memory_resource，
+ *   放在 std::pmr::unsynchronized_pool_resource 之下，缓存条目、链表节点和索引都从大页中分配（见 dns_cache.hpp）。
+ *
+ * 所有区域计入进程级的统计，启动时和统计报告中输出，例如：
+ *   huge pages: explicit 64.0 MiB (2 regions), transparent 2.0 MiB (1 region, AnonHugePages 2.0 MiB), normal 180.0 KiB (4 regions)
+ */
+
+#pragma once
+
+#include <algorithm>     // std::max
+#include <atomic>        // std::atomic 进程级统计
+#include <cerrno>        // errno
+#include <cstddef>       // size_t, std::max_align_t
+#include <cstdint>       // uint8_t, uint64_t
+#include <cstdio>        // snprintf()
+#include <cstring>       // strerror()
+#include <fstream>       // std::ifstream 读 smaps_rollup / sysfs
+#include <iostream>      // std::cerr 回退提示
+#include <memory_resource>  // std::pmr::memory_resource
+#include <new>           // std::bad_alloc
+#include <string>        // std::string
+#include <utility>       // std::exchange
+#include <vector>        // std::vector 区域列表
+#include <sys/mman.h>    // mmap(), munmap(), madvise(), MAP_HUGETLB, MADV_HUGEPAGE
+
+enum class HugePageMode
+{
+    OFF,           // 普通页面
+    TRANSPARENT,   // MADV_HUGEPAGE，失败时普通页面
+    EXPLICIT,      // MAP_HUGETLB，失败时 TRANSPARENT
+};
+
+class HugePageRegion
+{
+public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    // 实际得到的页面
+    enum Backing : uint8_t
+    {
+        NORMAL = 0,
+        TRANSPARENT = 1,
+        EXPLICIT = 2,
+    };
+
+    // "off" / "transparent" / "explicit"
+    static bool parseMode(const std::string& text, HugePageMode& mode)
+    {
+        if (text == "off") mode = HugePageMode::OFF;
+        else if (text == "transparent") mode = HugePageMode::TRANSPARENT;
+        else if (text == "explicit") mode = HugePageMode::EXPLICIT;
+        else return false;
+        return true;
+    }
+
+    HugePageRegion() = default;
+
+    /**
+     * 映射 bytes 字节（内容为 0）
+     *
+     * @param bytes 大小；使用大页时向上取整为 HUGE_PAGE_SIZE 的倍数
+     * @param mode 希望使用的页面，得不到时逐级回退（普通页面也失败时抛出 std::bad_alloc，与 std::vector 相同）
+     */
+    HugePageRegion(size_t bytes, HugePageMode mode)
+    {
+        if (bytes == 0) return;
+        if (bytes < HUGE_PAGE_SIZE / 2) mode = HugePageMode::OFF;
+
+        if (mode == HugePageMode::EXPLICIT)
+        {
+            size_t rounded = roundUp(bytes);
+            // MAP_HUGE_2MB = 21 << MAP_HUGE_SHIFT：明确要求 2 MiB 页（默认大页可能是 1 GiB）
+            void* memory = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+            if (memory != MAP_FAILED)
+            {
+                adopt(memory, rounded, rounded, EXPLICIT);
+                return;
+            }
+            warnOnce(explicitWarned(), std::string("explicit huge pages unavailable (") + strerror(errno) +
+                                           ", see vm.nr_hugepages), falling back to transparent huge pages");
+            totals().fallbacks.fetch_add(1, std::memory_order_relaxed);
+            mode = HugePageMode::TRANSPARENT;
+        }
+
+        if (mode == HugePageMode::TRANSPARENT)
+        {
+            // 多映射一个大页，再把起点对齐到 2 MiB：只有对齐的 2 MiB 范围才能由一个大页映射
+            size_t rounded = roundUp(bytes);
+            size_t length = rounded + HUGE_PAGE_SIZE;
+            void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) throw std::bad_alloc();
+            uint8_t* start = static_cast<uint8_t*>(memory);
+            uint8_t* aligned = reinterpret_cast<uint8_t*>(roundUp(reinterpret_cast<uintptr_t>(start)));
+            if (aligned > start) munmap(start, aligned - start);
+            if (aligned + rounded < start + length) munmap(aligned + rounded, start + length - aligned - rounded);
+            if (madvise(aligned, rounded, MADV_HUGEPAGE) == 0)
+            {
+                adopt(aligned, bytes, rounded, TRANSPARENT);
+                return;
+            }
+            warnOnce(transparentWarned(), std::string("transparent huge pages unavailable (") + strerror(errno) +
+                                              "), using normal pages");
+            totals().fallbacks.fetch_add(1, std::memory_order_relaxed);
+            adopt(aligned, bytes, rounded, NORMAL);
+            return;
+        }
+
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) throw std::bad_alloc();
+        adopt(memory, bytes, bytes, NORMAL);
+    }
+
+    ~HugePageRegion() { release(); }
+
+    HugePageRegion(const HugePageRegion&) = delete;
+    HugePageRegion& operator=(const HugePageRegion&) = delete;
+
+    HugePageRegion(HugePageRegion&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)),
+          mapped_(std::exchange(other.mapped_, 0)), backing_(other.backing_)
+    {
+    }
+
+    HugePageRegion& operator=(HugePageRegion&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            mapped_ = std::exchange(other.mapped_, 0);
+            backing_ = other.backing_;
+        }
+        return *this;
+    }
+
+    uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }       // 可以使用的字节数（大页时是取整后的大小）
+    Backing backing() const { return backing_; }
+
+    /**
+     * 进程中所有区域的一行统计（启动时和统计报告中输出）
+     *
+     * transparent 只是建议，括号中是内核实际用大页映射的匿名内存（/proc/self/smaps_rollup 的 AnonHugePages，
+     * 包括进程中其他透明大页；页面第一次写入之后才会出现）
+     *
+     * 示例："huge pages: explicit 64.0 MiB (2 regions), transparent 0 B, normal 180.0 KiB (4 regions), 1 fallback"
+     */
+    static std::string format()
+    {
+        static const char* const NAMES[] = { "normal", "transparent", "explicit" };
+        std::string text = "huge pages:";
+        for (int backing : { EXPLICIT, TRANSPARENT, NORMAL })
+        {
+            uint64_t bytes = totals().bytes[backing].load(std::memory_order_relaxed);
+            uint64_t regions = totals().regions[backing].load(std::memory_order_relaxed);
+            text += std::string(backing == EXPLICIT ? " " : ", ") + NAMES[backing] + " " + formatBytes(bytes);
+            if (regions > 0 || backing == TRANSPARENT)
+            {
+                text += " (";
+                if (regions > 0) text += std::to_string(regions) + (regions == 1 ? " region" : " regions");
+                if (backing == TRANSPARENT)
+                {
+                    text += std::string(regions > 0 ? ", " : "") + "AnonHugePages " +
+                            formatBytes(anonHugePagesKiB() * 1024) + ", THP " + transparentPolicy();
+                }
+                text += ")";
+            }
+        }
+        uint64_t fallbacks = totals().fallbacks.load(std::memory_order_relaxed);
+        if (fallbacks > 0) text += ", " + std::to_string(fallbacks) + (fallbacks == 1 ? " fallback" : " fallbacks");
+        return text;
+    }
+
+    // /sys/kernel/mm/transparent_hugepage/enabled 中选中的值："always" / "madvise" / "never"（读不到时 "unavailable"）
+    static std::string transparentPolicy()
+    {
+        std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string line;
+        std::getline(file, line);
+        size_t open = line.find('[');
+        size_t close = line.find(']', open);
+        if (open == std::string::npos || close == std::string::npos) return "unavailable";
+        return line.substr(open + 1, close - open - 1);
+    }
+
+private:
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t mapped_ = 0;
+    Backing backing_ = NORMAL;
+
+    struct Totals
+    {
+        std::atomic<uint64_t> bytes[3] = {};     // 当前映射的字节数，下标为 Backing
+        std::atomic<uint64_t> regions[3] = {};
+        std::atomic<uint64_t> fallbacks{ 0 };    // 累计回退次数
+    };
+
+    static Totals& totals()
+    {
+        static Totals totals;
+        return totals;
+    }
+
+    static std::atomic<bool>& explicitWarned()
+    {
+        static std::atomic<bool> warned{ false };
+        return warned;
+    }
+
+    static std::atomic<bool>& transparentWarned()
+    {
+        static std::atomic<bool> warned{ false };
+        return warned;
+    }
+
+    // 每种回退只提示一次（每个工作线程的缓冲区都会各自回退）
+    static void warnOnce(std::atomic<bool>& warned, const std::string& message)
+    {
+        if (!warned.exchange(true, std::memory_order_relaxed)) std::cerr << "Huge pages: " << message << std::endl;
+    }
+
+    static size_t roundUp(size_t bytes) { return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1); }
+
+    void adopt(void* memory, size_t size, size_t mapped, Backing backing)
+    {
+        data_ = static_cast<uint8_t*>(memory);
+        size_ = backing == NORMAL ? size : mapped;
+        mapped_ = mapped;
+        backing_ = backing;
+        totals().bytes[backing_].fetch_add(mapped_, std::memory_order_relaxed);
+        totals().regions[backing_].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release()
+    {
+        if (data_ == nullptr) return;
+        munmap(data_, mapped_);
+        totals().bytes[backing_].fetch_sub(mapped_, std::memory_order_relaxed);
+        totals().regions[backing_].fetch_sub(1, std::memory_order_relaxed);
+        data_ = nullptr;
+    }
+
+    // "AnonHugePages:      4096 kB"
+    static uint64_t anonHugePagesKiB()
+    {
+        std::ifstream file("/proc/self/smaps_rollup");
+        for (std::string line; std::getline(file, line);)
+        {
+            if (line.compare(0, 14, "AnonHugePages:") == 0) return std::stoull(line.substr(14));
+        }
+        return 0;
+    }
+
+    // 1536 -> "1.5 KiB"，3221225472 -> "3.0 GiB"
+    static std::string formatBytes(uint64_t bytes)
+    {
+        if (bytes < 1024) return std::to_string(bytes) + " B";
+        static const char* const UNITS[] = { "KiB", "MiB", "GiB", "TiB" };
+        double value = static_cast<double>(bytes) / 1024;
+        int unit = 0;
+        while (value >= 1024 && unit < 3)
+        {
+            value /= 1024;
+            unit++;
+        }
+        char text[32];
+        snprintf(text, sizeof(text), "%.1f %s", value, UNITS[unit]);
+        return text;
+    }
+};
+
+/**
+ * 以 HugePageRegion 为后备的内存资源（不加锁，由使用者保证互斥）
+ *
+ *   小块（<= DEDICATED_THRESHOLD）从 chunkSize 大小的区域中顺序切分，释放时不归还，随资源一起析构；
+ *     上面再放一个 std::pmr::unsynchronized_pool_resource，由它按大小回收和复用小块
+ *   大块（例如索引的桶数组、频率草图）单独占一个区域，释放时立即 munmap()
+ *
+ * 示例（chunkSize = 64 MiB）：
+ *   allocate(48)       -> 区域 0 [0, 48)
+ *   allocate(8 MiB)    -> 单独的区域 1（8 MiB）
+ *   allocate(4096)     -> 区域 0 [48, 4144)（区域 0 继续切分）
+ *   deallocate(区域 1) -> munmap()
+ */
+class HugePageResource : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t DEDICATED_THRESHOLD = HugePageRegion::HUGE_PAGE_SIZE / 2;
+
+    HugePageResource(HugePageMode mode, size_t chunkSize) : mode_(mode), chunkSize_(std::max(chunkSize, DEDICATED_THRESHOLD)) {}
+
+    HugePageResource(const HugePageResource&) = delete;
+    HugePageResource& operator=(const HugePageResource&) = delete;
+
+private:
+    HugePageMode mode_;
+    size_t chunkSize_;
+    std::vector<HugePageRegion> chunks_;      // 顺序切分的区域，最后一个是当前区域
+    size_t used_ = 0;                         // 当前区域已切出的字节数
+    std::vector<HugePageRegion> dedicated_;   // 单独的大块
+
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        if (bytes > DEDICATED_THRESHOLD)
+        {
+            dedicated_.emplace_back(bytes, mode_);
+            return dedicated_.back().data();
+        }
+        size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+        if (chunks_.empty() || offset + bytes > chunks_.back().size())
+        {
+            chunks_.emplace_back(chunkSize_, mode_);
+            offset = 0;
+        }
+        used_ = offset + bytes;
+        return chunks_.back().data() + offset;
+    }
+
+    void do_deallocate(void* pointer, size_t bytes, size_t) override
+    {
+        if (bytes <= DEDICATED_THRESHOLD) return;
+        for (size_t i = 0; i < dedicated_.size(); i++)
+        {
+            if (dedicated_[i].data() == pointer)
+            {
+                dedicated_[i] = std::move(dedicated_.back());
+                dedicated_.pop_back();
+                return;
+            }
+        }
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
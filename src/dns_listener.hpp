@@ -0,0 +1,360 @@
+/**
+ * 监听器配置与监听套接字
+ *
+ * 每个 --listen 参数描述一个监听器：地址、端口，以及这个入口上的策略和工作线程。
+ *
+ *   --listen <地址>[,选项...]
+ *
+ *   地址：    "0.0.0.0:2053"、"[::]:2053"、"127.0.0.1"（省略端口时为 2053）
+ *   workers=N      N 个工作线程，每个线程一个 SO_REUSEPORT 套接字（内核按四元组哈希分流）
+ *   cpus=2-3+6     工作线程依次绑定到这些 CPU（轮流使用），把不同类别的流量隔离到不同的核上；
+ *                  多个范围用 '+' 连接（',' 已用于分隔选项）
+ *   cpus=node1     NUMA 节点 1 上的全部 CPU（工作线程的缓冲区和内存池随之分配在节点 1 上，见 dns_numa.hpp）
+ *   nic=eth0       报文来自网卡 eth0：没有指定 cpus 时绑定到处理 eth0 接收队列中断的 CPU，
+ *                  找不到中断时使用 eth0 所在节点的 CPU；与 steer=cpu 一起使用时，
+ *                  每个接收队列的报文交给同一个 CPU（或同一节点）上的工作线程
+ *   recursion=off  只回答权威区域，其他查询回复 REFUSED（不使用缓存和上游）
+ *   rrl=off        不做响应限速（例如内部网络、回环）
+ *   acl=off        不检查 --allow / --deny / --refuse（例如只监听回环地址时）
+ *   steer=cpu|hash 用 eBPF 程序代替内核的四元组哈希选择工作线程（见 dns_steering.hpp）：
+ *                  cpu = 收包 CPU 上的工作线程，hash = 按查询名
+ *
+ * 示例：公网只做权威 + 限速，内网可以递归，回环不受限制
+ *   --listen 203.0.113.1:53,workers=4,cpus=0-3,recursion=off,steer=cpu
+ *   --listen 10.0.0.1:53,workers=2,cpus=4-5
+ *   --listen 127.0.0.1:53,rrl=off,acl=off
+ *
+ * 示例：双路服务器，网卡在节点 1 上，8 个接收队列
+ *   --listen 0.0.0.0:53,workers=8,nic=eth0,steer=cpu
+ *
+ * 策略在启动时解析成具体的对象（见 main.cpp 的 ListenerPolicy），工作线程处理报文时不再判断开关。
+ *
+ * 所有监听套接字共用一组内核参数（SocketTuning，--socket-tuning latency|throughput），
+ * 并开启 SO_RXQ_OVFL，统计报告按套接字输出接收队列溢出的丢包数。
+ */
+
+#pragma once
+
+#include <cerrno>        // errno
+#include <cstdint>       // uint32_t
+#include <cstring>       // strerror(), memcpy()
+#include <string>        // std::string
+#include <vector>        // std::vector
+#include <sys/socket.h>  // socket(), setsockopt(), bind(), SO_RXQ_OVFL, SO_BUSY_POLL
+#include <netinet/in.h>  // IPPROTO_IPV6, IPV6_V6ONLY
+#include <unistd.h>      // close()
+
+#include "dns_address.hpp"
+#include "dns_steering.hpp"
+
+struct ListenerConfig
+{
+    static constexpr uint16_t DEFAULT_PORT = 2053;
+
+    std::string text;             // 原始参数（用于日志）
+    SocketAddress address;
+    int workers = 1;
+    std::vector<int> cpus;        // 空表示不绑定 CPU
+    int node = -1;                // cpus=nodeN：启动时按 NUMA 拓扑展开成 cpus
+    std::string nic;              // nic=eth0：没有 cpus 时按网卡的接收队列（或节点）选择 CPU
+    bool recursion = true;
+    bool rateLimit = true;
+    bool acl = true;
+    SteeringMode steering = SteeringMode::NONE;
+
+    /**
+     * 解析 --listen 参数
+     *
+     * @param text "地址[,选项...]"
+     * @param out [输出] 监听器配置
+     * @param error [输出] 出错时的说明
+     * @return 成功返回 true
+     */
+    static bool parse(const std::string& text, ListenerConfig& out, std::string& error)
+    {
+        out = ListenerConfig();
+        out.text = text;
+
+        std::vector<std::string> fields;
+        size_t start = 0;
+        while (true)
+        {
+            size_t comma = text.find(',', start);
+            fields.push_back(text.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+            if (comma == std::string::npos) break;
+            start = comma + 1;
+        }
+
+        if (!SocketAddress::parse(fields[0], DEFAULT_PORT, out.address))
+        {
+            error = "invalid listen address: " + fields[0];
+            return false;
+        }
+
+        for (size_t i = 1; i < fields.size(); i++)
+        {
+            const std::string& field = fields[i];
+            size_t equals = field.find('=');
+            std::string key = field.substr(0, equals);
+            std::string value = equals == std::string::npos ? "" : field.substr(equals + 1);
+
+            if (key == "workers" && isNumber(value) && std::stoi(value) > 0)
+            {
+                out.workers = std::stoi(value);
+            }
+            else if (key == "cpus" && value.compare(0, 4, "node") == 0 && isNumber(value.substr(4)))
+            {
+                out.node = std::stoi(value.substr(4));
+            }
+            else if (key == "cpus" && parseCpuList(value, out.cpus))
+            {
+            }
+            else if (key == "nic" && !value.empty() && value.find('/') == std::string::npos)
+            {
+                out.nic = value;
+            }
+            else if (key == "steer" && ReuseportSteering::parseMode(value, out.steering))
+            {
+            }
+            else if ((key == "recursion" || key == "rrl" || key == "acl") && (value == "on" || value == "off"))
+            {
+                bool enabled = value == "on";
+                if (key == "recursion") out.recursion = enabled;
+                if (key == "rrl") out.rateLimit = enabled;
+                if (key == "acl") out.acl = enabled;
+            }
+            else
+            {
+                error = "invalid listen option '" + field + "' in " + text;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 默认监听器：双栈的 [::]:2053（内核不支持 IPv6 时由 openListenSocket() 回退到 0.0.0.0）
+    static ListenerConfig defaultListener()
+    {
+        ListenerConfig config;
+        config.text = "[::]:2053";
+        SocketAddress::parse(config.text, DEFAULT_PORT, config.address);
+        return config;
+    }
+
+private:
+    static bool isNumber(const std::string& s)
+    {
+        return !s.empty() && s.size() <= 6 && s.find_first_not_of("0123456789") == std::string::npos;
+    }
+
+    // "0-3+6" -> {0, 1, 2, 3, 6}
+    static bool parseCpuList(const std::string& text, std::vector<int>& cpus)
+    {
+        cpus.clear();
+        size_t start = 0;
+        while (start <= text.size())
+        {
+            size_t end = text.find('+', start);
+            if (end == std::string::npos) end = text.size();
+            std::string range = text.substr(start, end - start);
+            size_t dash = range.find('-');
+            std::string first = range.substr(0, dash);
+            std::string last = dash == std::string::npos ? first : range.substr(dash + 1);
+            if (!isNumber(first) || !isNumber(last) || std::stoi(first) > std::stoi(last)) return false;
+            for (int cpu = std::stoi(first); cpu <= std::stoi(last); cpu++) cpus.push_back(cpu);
+            start = end + 1;
+        }
+        return !cpus.empty();
+    }
+};
+
+/**
+ * 监听套接字的内核参数（--socket-tuning 以及单独的 --rcvbuf / --sndbuf / --busy-poll）
+ *
+ *   receiveBuffer  SO_RCVBUF：突发流量时内核接收队列能容纳的字节数；队列满时新报文被丢弃
+ *                  （丢包数见 SO_RXQ_OVFL）。默认值（net.core.rmem_default，通常 208 KiB）只够几百个小报文
+ *   sendBuffer     SO_SNDBUF
+ *   busyPollMicros SO_BUSY_POLL：接收队列为空时先在网卡队列上忙等这么多微秒再睡眠，用 CPU 换延迟
+ *   incomingCpu    SO_INCOMING_CPU：绑定了 CPU 的工作线程，把套接字的 CPU 也设为同一个，
+ *                  内核选择 reuseport 套接字时优先选择在收包 CPU 上的那个
+ *
+ * 预设（显式给出的 --rcvbuf 等参数覆盖预设的值）：
+ *   latency     rcvbuf 4 MiB，busy-poll 50 微秒
+ *   throughput  rcvbuf 16 MiB，sndbuf 4 MiB，不忙等
+ */
+struct SocketTuning
+{
+    int receiveBuffer = 0;       // 0 表示保持内核默认值
+    int sendBuffer = 0;
+    int busyPollMicros = 0;
+    bool incomingCpu = true;
+
+    static bool preset(const std::string& name, SocketTuning& out)
+    {
+        if (name == "latency")
+        {
+            out.receiveBuffer = 4 << 20;
+            out.busyPollMicros = 50;
+            return true;
+        }
+        if (name == "throughput")
+        {
+            out.receiveBuffer = 16 << 20;
+            out.sendBuffer = 4 << 20;
+            out.busyPollMicros = 0;
+            return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * 按 SocketTuning 设置一个监听套接字
+ *
+ * @param cpu 工作线程绑定的 CPU，-1 表示没有绑定
+ * @param warning [输出] 没有生效的设置（例如没有 CAP_NET_ADMIN 时的 busy-poll），不影响继续运行
+ *
+ * 缓冲区先尝试 SO_RCVBUFFORCE / SO_SNDBUFFORCE（root 时不受 net.core.rmem_max 限制），失败再用普通选项
+ * （此时内核把值截断到 rmem_max，不报错）
+ */
+inline void tuneSocket(int udpSocket, const SocketTuning& tuning, int cpu, std::string& warning)
+{
+    auto note = [&](const char* what) {
+        warning += std::string(warning.empty() ? "" : ", ") + what + ": " + strerror(errno);
+    };
+
+    if (tuning.receiveBuffer > 0 &&
+        setsockopt(udpSocket, SOL_SOCKET, SO_RCVBUFFORCE, &tuning.receiveBuffer, sizeof(int)) < 0 &&
+        setsockopt(udpSocket, SOL_SOCKET, SO_RCVBUF, &tuning.receiveBuffer, sizeof(int)) < 0)
+    {
+        note("SO_RCVBUF");
+    }
+    if (tuning.sendBuffer > 0 &&
+        setsockopt(udpSocket, SOL_SOCKET, SO_SNDBUFFORCE, &tuning.sendBuffer, sizeof(int)) < 0 &&
+        setsockopt(udpSocket, SOL_SOCKET, SO_SNDBUF, &tuning.sendBuffer, sizeof(int)) < 0)
+    {
+        note("SO_SNDBUF");
+    }
+    if (tuning.busyPollMicros > 0)
+    {
+        if (setsockopt(udpSocket, SOL_SOCKET, SO_BUSY_POLL, &tuning.busyPollMicros, sizeof(int)) < 0)
+        {
+            note("SO_BUSY_POLL");
+        }
+        else
+        {
+            // 5.11+：忙等期间由本线程处理网卡队列，不再由软中断处理（旧内核没有这个选项，忽略）
+            int prefer = 1;
+            setsockopt(udpSocket, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer));
+        }
+    }
+    if (tuning.incomingCpu && cpu >= 0 &&
+        setsockopt(udpSocket, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0)
+    {
+        note("SO_INCOMING_CPU");
+    }
+}
+
+/**
+ * 套接字实际生效的缓冲区大小（内核返回的是设置值的两倍，包含簿记开销）
+ *
+ * 示例："rcvbuf=8388608 sndbuf=425984 busy-poll=50us"
+ */
+inline std::string describeSocket(int udpSocket)
+{
+    int receiveBuffer = 0, sendBuffer = 0, busyPoll = 0;
+    socklen_t length = sizeof(int);
+    getsockopt(udpSocket, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, &length);
+    length = sizeof(int);
+    getsockopt(udpSocket, SOL_SOCKET, SO_SNDBUF, &sendBuffer, &length);
+    length = sizeof(int);
+    getsockopt(udpSocket, SOL_SOCKET, SO_BUSY_POLL, &busyPoll, &length);
+    std::string text = "rcvbuf=" + std::to_string(receiveBuffer) + " sndbuf=" + std::to_string(sendBuffer);
+    if (busyPoll > 0) text += " busy-poll=" + std::to_string(busyPoll) + "us";
+    return text;
+}
+
+/**
+ * 从 recvmsg() 的控制信息中取出 SO_RXQ_OVFL：该套接字自创建以来因接收队列满而丢弃的报文总数
+ *
+ * @return 控制信息中有这一项时返回 true
+ */
+inline bool readDropCount(const msghdr& header, uint32_t& drops)
+{
+    for (const cmsghdr* control = CMSG_FIRSTHDR(&header); control != nullptr;
+         control = CMSG_NXTHDR(const_cast<msghdr*>(&header), const_cast<cmsghdr*>(control)))
+    {
+        if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SO_RXQ_OVFL)
+        {
+            std::memcpy(&drops, CMSG_DATA(control), sizeof(drops));
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * 创建并绑定一个 UDP 监听套接字
+ *
+ * @param address [输入/输出] 监听地址；[::] 所在的内核不支持 IPv6 时改为 0.0.0.0（同一端口）
+ * @param error [输出] 失败原因
+ * @return 套接字，失败返回 -1
+ *
+ * 步骤：
+ *   1. socket()：地址族与监听地址相同
+ *   2. IPV6_V6ONLY = 0：IPv6 通配地址同时接收 IPv4（双栈）；部分系统默认为 1，必须显式关闭
+ *   3. SO_REUSEPORT：同一地址上的多个工作线程各自绑定一个套接字，由内核分流；
+ *      程序重启时也不会因为旧套接字而 "Address already in use"
+ *   4. SO_RXQ_OVFL：每个收到的报文附带该套接字的累计丢包数（readDropCount()），统计报告据此输出丢包
+ *   5. bind()
+ */
+inline int openListenSocket(SocketAddress& address, std::string& error)
+{
+    int udpSocket = socket(address.family(), SOCK_DGRAM, 0);
+    if (udpSocket == -1 && errno == EAFNOSUPPORT && address.family() == AF_INET6 &&
+        IN6_IS_ADDR_UNSPECIFIED(&address.ipv6().sin6_addr))
+    {
+        SocketAddress::parse("0.0.0.0", address.port(), address);
+        udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    }
+    if (udpSocket == -1)
+    {
+        error = std::string("socket creation failed: ") + strerror(errno);
+        return -1;
+    }
+
+    if (address.family() == AF_INET6)
+    {
+        int v6only = 0;
+        if (setsockopt(udpSocket, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) < 0)
+        {
+            error = std::string("IPV6_V6ONLY failed: ") + strerror(errno);
+            close(udpSocket);
+            return -1;
+        }
+    }
+
+    int reuse = 1;
+    if (setsockopt(udpSocket, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0)
+    {
+        error = std::string("SO_REUSEPORT failed: ") + strerror(errno);
+        close(udpSocket);
+        return -1;
+    }
+
+    int dropCounter = 1;
+    if (setsockopt(udpSocket, SOL_SOCKET, SO_RXQ_OVFL, &dropCounter, sizeof(dropCounter)) < 0)
+    {
+        error = std::string("SO_RXQ_OVFL failed: ") + strerror(errno);
+        close(udpSocket);
+        return -1;
+    }
+
+    if (bind(udpSocket, address.data(), address.length) != 0)
+    {
+        error = "bind " + address.toString() + " failed: " + strerror(errno);
+        close(udpSocket);
+        return -1;
+    }
+    return udpSocket;
+}
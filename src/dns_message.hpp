@@ -0,0 +1,982 @@
+/**
+ * DNS 报文结构 - 线格式（wire format）的解析与序列化
+ *
+ * 包含 Header、Question、Answer 以及完整消息 DNSMessage 的定义，
+ * 由主程序、区域（zone）加载器和转发逻辑共同使用。
+ *
+ * 域名、RDATA 和记录列表都使用 std::pmr 容器，可以从每个请求的 arena（见 dns_arena.hpp）
+ * 分配内存；不传分配器时使用默认的全局堆，与普通的 std::string / std::vector 行为一致。
+ * 拷贝构造总是使用全局堆，所以把 arena 中的对象拷贝进缓存是安全的。
+ *
+ * 所有解析函数都带有报文长度，任何越界读取、指针环、超长标签或域名都会立即返回
+ * ParseError（不抛异常），恶意报文只消耗极少的 CPU。
+ */
+
+#pragma once
+
+#include <cstdint>       // 固定宽度整数类型：uint8_t, uint16_t, uint32_t
+#include <vector>        // std::vector 动态数组
+#include <string>        // std::string 字符串
+#include <string_view>   // std::string_view 编码域名时的只读视图
+#include <memory_resource>  // std::pmr::polymorphic_allocator 按请求的 arena 分配
+
+#include "dns_simd.hpp"  // LabelSimd 向量化复制标签
+#include "dns_hash.hpp"  // QuestionHash 解析时顺便计算的 Question 哈希
+
+/**
+ * 解析错误码
+ *
+ * 解析函数遇到第一个错误就返回，调用方据此回复 FORMERR（请求）或视为上游失败（响应）。
+ */
+enum class ParseError : uint8_t
+{
+    NONE = 0,
+    TRUNCATED,           // 报文在字段中间结束（继续读取会越界）
+    BAD_POINTER,         // 压缩指针没有指向更早的位置
+    TOO_MANY_POINTERS,   // 一个域名内的指针跳转次数超过上限（指针环）
+    LABEL_TOO_LONG,      // 标签长度字节为 0x40-0xBF（超过 63 或未定义的扩展标签类型）
+    NAME_TOO_LONG,       // 域名线格式长度超过 255 字节
+    DOT_IN_LABEL,        // 标签内容含有 '.'（点分文本无法表示，序列化时会被拆成两个标签）
+};
+
+// 错误码的文字描述（用于日志）
+inline const char* parseErrorName(ParseError error)
+{
+    switch (error)
+    {
+        case ParseError::NONE: return "ok";
+        case ParseError::TRUNCATED: return "truncated";
+        case ParseError::BAD_POINTER: return "bad compression pointer";
+        case ParseError::TOO_MANY_POINTERS: return "too many compression pointers";
+        case ParseError::LABEL_TOO_LONG: return "label too long";
+        case ParseError::NAME_TOO_LONG: return "name too long";
+        case ParseError::DOT_IN_LABEL: return "dot in label";
+    }
+    return "unknown";
+}
+
+/**
+ * DNS 消息头结构体（12 字节）
+ * 
+ * DNS Header 格式（RFC 1035）：
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                      ID                       |  16 bits
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |QR|   OPCODE  |AA|TC|RD|RA|   Z    |   RCODE   |  16 bits
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                    QDCOUNT                    |  16 bits
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                    ANCOUNT                    |  16 bits
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                    NSCOUNT                    |  16 bits
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                    ARCOUNT                    |  16 bits
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ */
+struct DNSHeader 
+{
+    uint16_t id;        // 包标识符，响应必须与查询相同
+    
+    // |QR(1)|OPCODE(4)|AA(1)|TC(1)|RD(1)|RA(1)|Z(3)|RCODE(4)|
+    // |  1  |  0000   |  0  |  0  |  0  |  0  | 000|  0000  |
+    // 第二个 16 位字段包含多个标志位
+    uint16_t flags;     // QR(1) + OPCODE(4) + AA(1) + TC(1) + RD(1) + RA(1) + Z(3) + RCODE(4)
+    
+    uint16_t qdcount;   // Question Count: 问题部分的条目数
+    uint16_t ancount;   // Answer Count: 回答部分的记录数
+    uint16_t nscount;   // Authority Count: 授权部分的记录数
+    uint16_t arcount;   // Additional Count: 附加部分的记录数
+    
+    /**
+     * 从字节数组解析 DNS Header（反序列化）
+     * 
+     * @param data 原始字节数据
+     * @param size 报文长度（不足 12 字节时返回 TRUNCATED）
+     * @param header [输出] 解析后的 DNSHeader
+     * @return ParseError::NONE 表示成功
+     * 
+     * ============================================================
+     * 完整解析示例：假设收到以下 12 字节的 DNS 请求头
+     * ============================================================
+     * 
+     * 原始字节（十六进制）：
+     *   索引:  [0]   [1]   [2]   [3]   [4]   [5]   [6]   [7]   [8]   [9]  [10]  [11]
+     *   数据:  0x04  0xD2  0x01  0x00  0x00  0x01  0x00  0x00  0x00  0x00  0x00  0x00
+     *          |--ID---|  |-flags-|  |qdcount|  |ancount|  |nscount|  |arcount|
+     * 
+     * ---------- 1. 解析 ID（字节 0-1）----------
+     * 
+     *   data[0] = 0x04 = 0000 0100
+     *   data[1] = 0xD2 = 1101 0010
+     * 
+     *   计算过程：(data[0] << 8) | data[1]
+     *   
+     *   步骤 1: data[0] << 8
+     *           0x04 << 8 = 0x0400
+     *           二进制: 0000 0100 0000 0000
+     *   
+     *   步骤 2: | data[1]
+     *           0x0400 | 0xD2 = 0x04D2
+     *           二进制: 0000 0100 0000 0000
+     *                 | 0000 0000 1101 0010
+     *                 = 0000 0100 1101 0010
+     *   
+     *   结果: id = 0x04D2 = 1234
+     * 
+     * ---------- 2. 解析 Flags（字节 2-3）----------
+     * 
+     *   data[2] = 0x01 = 0000 0001
+     *   data[3] = 0x00 = 0000 0000
+     * 
+     *   计算过程：(data[2] << 8) | data[3]
+     *   
+     *   步骤 1: data[2] << 8
+     *           0x01 << 8 = 0x0100
+     *   
+     *   步骤 2: | data[3]
+     *           0x0100 | 0x00 = 0x0100
+     *   
+     *   结果: flags = 0x0100 = 0000 0001 0000 0000
+     *   
+     *   Flags 位布局（从高位到低位）：
+     *   |QR|  OPCODE |AA|TC|RD|RA|  Z  | RCODE |
+     *   |15| 14-11   |10| 9| 8| 7| 6-4 |  3-0  |
+     *   | 0| 0 0 0 0 | 0| 0| 1| 0| 0 0 0| 0 0 0 0|
+     *   
+     *   解析各字段：
+     *     - QR     = (0x0100 >> 15) & 0x01 = 0  （这是查询）
+     *     - OPCODE = (0x0100 >> 11) & 0x0F = 0  （标准查询）
+     *     - AA     = (0x0100 >> 10) & 0x01 = 0  （非权威）
+     *     - TC     = (0x0100 >> 9)  & 0x01 = 0  （未截断）
+     *     - RD     = (0x0100 >> 8)  & 0x01 = 1  （期望递归）
+     *     - RA     = (0x0100 >> 7)  & 0x01 = 0  （不支持递归）
+     *     - Z      = (0x0100 >> 4)  & 0x07 = 0  （保留）
+     *     - RCODE  = 0x0100 & 0x0F = 0          （无错误）
+     * 
+     * ---------- 3. 解析 QDCOUNT（字节 4-5）----------
+     * 
+     *   data[4] = 0x00, data[5] = 0x01
+     *   qdcount = (0x00 << 8) | 0x01 = 0x0001 = 1
+     *   含义：有 1 个问题
+     * 
+     * ---------- 4. 解析 ANCOUNT（字节 6-7）----------
+     * 
+     *   data[6] = 0x00, data[7] = 0x00
+     *   ancount = (0x00 << 8) | 0x00 = 0x0000 = 0
+     *   含义：有 0 个回答（查询请求通常为 0）
+     * 
+     * ---------- 5. 解析 NSCOUNT（字节 8-9）----------
+     * 
+     *   data[8] = 0x00, data[9] = 0x00
+     *   nscount = 0
+     * 
+     * ---------- 6. 解析 ARCOUNT（字节 10-11）----------
+     * 
+     *   data[10] = 0x00, data[11] = 0x00
+     *   arcount = 0
+     * 
+     * ============================================================
+     * 最终解析结果
+     * ============================================================
+     *   id      = 1234   (0x04D2)
+     *   flags   = 256    (0x0100) -> QR=0, OPCODE=0, RD=1
+     *   qdcount = 1      (1 个问题)
+     *   ancount = 0      (0 个回答)
+     *   nscount = 0
+     *   arcount = 0
+     */
+    static ParseError parse(const uint8_t* data, size_t size, DNSHeader& header)
+    {
+        if (size < 12) return ParseError::TRUNCATED;
+        
+        // ID（2 字节，大端序）: 高字节在前，低字节在后
+        // 示例: [0x04, 0xD2] -> (0x04 << 8) | 0xD2 = 0x04D2 = 1234
+        header.id = (static_cast<uint16_t>(data[0]) << 8) | data[1];
+        
+        // Flags（2 字节，大端序）
+        // 示例: [0x01, 0x00] -> (0x01 << 8) | 0x00 = 0x0100
+        header.flags = (static_cast<uint16_t>(data[2]) << 8) | data[3];
+        
+        // QDCOUNT（2 字节）
+        // 示例: [0x00, 0x01] -> 1
+        header.qdcount = (static_cast<uint16_t>(data[4]) << 8) | data[5];
+        
+        // ANCOUNT（2 字节）
+        header.ancount = (static_cast<uint16_t>(data[6]) << 8) | data[7];
+        
+        // NSCOUNT（2 字节）
+        header.nscount = (static_cast<uint16_t>(data[8]) << 8) | data[9];
+        
+        // ARCOUNT（2 字节）
+        header.arcount = (static_cast<uint16_t>(data[10]) << 8) | data[11];
+        
+        return ParseError::NONE;
+    }
+    
+    /**
+     * 从 flags 中提取 OPCODE（4 bits，位 14-11）
+     * 
+     * Flags 位布局: |QR(15)|OPCODE(14-11)|AA(10)|TC(9)|RD(8)|RA(7)|Z(6-4)|RCODE(3-0)|
+     * 
+     * 提取示例（flags = 0x0100 = 0000 0001 0000 0000）：
+     *   步骤 1: flags >> 11
+     *           0000 0001 0000 0000 >> 11 = 0000 0000 0000 0000 = 0
+     *   步骤 2: & 0x0F (保留低 4 位)
+     *           0 & 0x0F = 0
+     *   结果: OPCODE = 0 (标准查询)
+     * 
+     * 另一示例（flags = 0x7800，OPCODE=15）：
+     *   0111 1000 0000 0000 >> 11 = 0000 0000 0000 1111 = 15
+     *   15 & 0x0F = 15
+     */
+    uint8_t getOpcode() const { return (flags >> 11) & 0x0F; }
+    
+    /**
+     * 从 flags 中提取 RD（1 bit，位 8）
+     * 
+     * 提取示例（flags = 0x0100 = 0000 0001 0000 0000）：
+     *   步骤 1: flags >> 8
+     *           0000 0001 0000 0000 >> 8 = 0000 0000 0000 0001 = 1
+     *   步骤 2: & 0x01 (保留最低 1 位)
+     *           1 & 0x01 = 1
+     *   结果: RD = 1 (期望递归查询)
+     */
+    uint8_t getRD() const { return (flags >> 8) & 0x01; }
+    
+    /**
+     * 将 DNS Header 序列化为字节数组（网络字节序，大端）
+     * 
+     * 大端序 vs 小端序示例（以 id = 1234 = 0x04D2 为例）：
+     *   - 大端序（网络字节序）: [0x04, 0xD2] 高位字节在前，人类阅读顺序
+     *   - 小端序（x86 架构）:   [0xD2, 0x04] 低位字节在前
+     * 
+     * 网络协议统一使用大端序，所以需要转换。
+     * 
+     * 序列化后的 12 字节数组布局：
+     *   索引:  [0]   [1]   [2]   [3]   [4]   [5]   [6]   [7]   [8]   [9]  [10]  [11]
+     *   字段:  |--ID---|  |-flags-|  |qdcount|  |ancount|  |nscount|  |arcount|
+     *   示例:  0x04  0xD2  0x80  0x00  0x00  0x00  0x00  0x00  0x00  0x00  0x00  0x00
+     *         (id=1234)  (QR=1)   (0)       (0)       (0)       (0)
+     * 
+     * @param bytes [输出] 追加到末尾（通常是空数组，Header 位于报文开头）
+     */
+    void serialize(std::pmr::vector<uint8_t>& bytes) const 
+    {
+        // 在末尾追加 12 字节，所有元素初始化为 0
+        // DNS Header 固定 12 字节: ID(2) + Flags(2) + QDCOUNT(2) + ANCOUNT(2) + NSCOUNT(2) + ARCOUNT(2)
+        size_t base = bytes.size();
+        bytes.resize(base + 12);
+        
+        // ========== ID（16 bits）- 转换为大端序 ==========
+        // 示例: id = 1234 = 0x04D2
+        // 
+        // 提取高字节 (id >> 8) & 0xFF:
+        //   1. id = 0x04D2 = 0000 0100 1101 0010 (二进制)
+        //   2. id >> 8     = 0000 0000 0000 0100 (右移8位，高8位移到低8位)
+        //   3. & 0xFF      = 0000 0000 0000 0100 = 0x04 (掩码保留低8位)
+        // 
+        // 提取低字节 id & 0xFF:
+        //   1. id = 0x04D2 = 0000 0100 1101 0010 (二进制)
+        //   2. & 0xFF      = 0000 0000 1101 0010 = 0xD2 (掩码保留低8位)
+        // 
+        // 结果: bytes[0]=0x04, bytes[1]=0xD2 (大端序：高字节在前)
+        bytes[base + 0] = (id >> 8) & 0xFF;   // 高字节: 右移8位取高8位
+        bytes[base + 1] = id & 0xFF;          // 低字节: 直接取低8位
+        
+        // ========== Flags（16 bits）- 转换为大端序 ==========
+        // 示例: flags = 0x8000 (QR=1, 其余为0)
+        //   bytes[2] = (0x8000 >> 8) & 0xFF = 0x80
+        //   bytes[3] = 0x8000 & 0xFF = 0x00
+        bytes[base + 2] = (flags >> 8) & 0xFF;
+        bytes[base + 3] = flags & 0xFF;
+        
+        // ========== QDCOUNT（16 bits）==========
+        bytes[base + 4] = (qdcount >> 8) & 0xFF;
+        bytes[base + 5] = qdcount & 0xFF;
+        
+        // ========== ANCOUNT（16 bits）==========
+        bytes[base + 6] = (ancount >> 8) & 0xFF;
+        bytes[base + 7] = ancount & 0xFF;
+        
+        // ========== NSCOUNT（16 bits）==========
+        bytes[base + 8] = (nscount >> 8) & 0xFF;
+        bytes[base + 9] = nscount & 0xFF;
+        
+        // ========== ARCOUNT（16 bits）==========
+        bytes[base + 10] = (arcount >> 8) & 0xFF;
+        bytes[base + 11] = arcount & 0xFF;
+    }
+};
+
+/**
+ * DNS Question 结构体
+ * 
+ * Question Section 格式：
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                     NAME                      |  变长，域名编码
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                     TYPE                      |  16 bits，记录类型
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                     CLASS                     |  16 bits，记录类别
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * 
+ * 域名编码示例：
+ *   "codecrafters.io" 编码为：
+ *   \x0c codecrafters \x02 io \x00
+ *   ^^^^ ^^^^^^^^^^^^  ^^^  ^^  ^^
+ *   长度12  标签内容   长度2 标签 结束符
+ * 
+ *   完整字节序列: 0x0C 63 6F 64 65 63 72 61 66 74 65 72 73 02 69 6F 00
+ *                     c  o  d  e  c  r  a  f  t  e  r  s     i  o
+ */
+struct DNSQuestion 
+{
+    // 支持 uses-allocator 构造：放进 std::pmr::vector 时，域名自动使用容器的 arena
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+    
+    static constexpr size_t MAX_NAME_LENGTH = 255;  // 域名线格式的最大长度（RFC 1035 2.3.4）
+    static constexpr uint8_t MAX_LABEL_LENGTH = 63;  // 单个标签的最大长度
+    static constexpr int MAX_POINTER_HOPS = 16;      // 一个域名内最多跟随的压缩指针数
+    
+    std::pmr::string name;  // 域名（如 "codecrafters.io"）
+    uint16_t type;       // 记录类型（1 = A 记录，5 = CNAME 等）
+    uint16_t qclass;     // 记录类别（1 = IN，互联网）
+    uint64_t hash = 0;   // (name, type, qclass) 的哈希，不区分大小写（见 dns_hash.hpp）
+    uint32_t shardHash = SteeringHash::OFFSET;   // 域名的分流哈希，缓存按它选择分片（见 dns_hash.hpp）
+    
+    DNSQuestion() = default;
+    explicit DNSQuestion(const allocator_type& alloc) : name(alloc) {}
+    DNSQuestion(const DNSQuestion& other) = default;
+    DNSQuestion(DNSQuestion&& other) = default;
+    DNSQuestion(const DNSQuestion& other, const allocator_type& alloc)
+        : name(other.name, alloc), type(other.type), qclass(other.qclass), hash(other.hash), shardHash(other.shardHash) {}
+    DNSQuestion(DNSQuestion&& other, const allocator_type& alloc)
+        : name(std::move(other.name), alloc), type(other.type), qclass(other.qclass), hash(other.hash),
+          shardHash(other.shardHash) {}
+    DNSQuestion& operator=(const DNSQuestion& other) = default;
+    DNSQuestion& operator=(DNSQuestion&& other) = default;
+    
+    // 手工填写 name / type / qclass 后调用（解析得到的 Question 已经带有两个哈希）
+    void computeHash()
+    {
+        hash = QuestionHash::of(name, type, qclass);
+        shardHash = SteeringHash::of(name);
+    }
+    
+    /**
+     * 从字节数组解析 DNS Question（反序列化）- 支持压缩
+     * 
+     * @param data 原始字节数据（完整的 DNS 消息，从头开始）
+     * @param size 报文长度
+     * @param offset [输入/输出] 当前解析位置，解析完成后更新为下一个位置
+     * @param question [输出] 解析后的 DNSQuestion（域名使用 question.name 自己的分配器），
+     *                 同时填好 question.hash 和 question.shardHash：复制标签时逐个混入，不再回头扫描域名
+     * @return ParseError::NONE 表示成功
+     * 
+     * ============================================================
+     * DNS 消息压缩机制（RFC 1035 Section 4.1.4）
+     * ============================================================
+     * 
+     * 压缩原理：
+     *   为了减少消息大小，DNS 允许使用"指针"来引用之前出现过的域名。
+     *   指针是一个 2 字节的值，格式如下：
+     *   
+     *   +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+     *   | 1  1|                OFFSET                   |
+     *   +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+     *   
+     *   - 高 2 位为 11（0xC0）表示这是一个指针
+     *   - 低 14 位是从消息开头的偏移量
+     * 
+     * 判断方法：
+     *   - 普通标签: 长度字节 < 64 (0x00-0x3F)，高 2 位为 00
+     *   - 压缩指针: 长度字节 >= 192 (0xC0-0xFF)，高 2 位为 11
+     * 
+     * ============================================================
+     * 压缩示例
+     * ============================================================
+     * 
+     * 假设消息中有两个问题：
+     *   Question 1: "codecrafters.io"
+     *   Question 2: "abc.codecrafters.io"（压缩）
+     * 
+     * 原始字节布局：
+     *   [0-11]  Header (12 bytes)
+     *   [12]    0x0C (长度=12)
+     *   [13-24] "codecrafters"
+     *   [25]    0x02 (长度=2)
+     *   [26-27] "io"
+     *   [28]    0x00 (结束)
+     *   [29-30] TYPE (0x0001)
+     *   [31-32] CLASS (0x0001)
+     *   
+     *   Question 2 (使用压缩):
+     *   [33]    0x03 (长度=3)
+     *   [34-36] "abc"
+     *   [37-38] 0xC0 0x0C (指针，指向偏移 12，即 "codecrafters.io")
+     *   [39-40] TYPE (0x0001)
+     *   [41-42] CLASS (0x0001)
+     * 
+     * 解析 Question 2:
+     *   1. 读取 [33] = 0x03，这是普通标签，长度=3
+     *   2. 读取 "abc"
+     *   3. 读取 [37] = 0xC0，高 2 位为 11，这是压缩指针
+     *   4. 计算偏移: (0xC0 & 0x3F) << 8 | 0x0C = 0x000C = 12
+     *   5. 跳转到偏移 12，继续解析 "codecrafters.io"
+     *   6. 最终得到: "abc.codecrafters.io"
+     */
+    static ParseError parse(const uint8_t* data, size_t size, size_t& offset, DNSQuestion& question)
+    {
+        // 解析域名（支持压缩），直接写入 question.name，同时累加两个哈希
+        uint64_t hash = QuestionHash::seed();
+        uint32_t shardHash = SteeringHash::OFFSET;
+        ParseError error = parseDomainName(data, size, offset, question.name, &hash, &shardHash);
+        if (error != ParseError::NONE) return error;
+        
+        // TYPE + CLASS 共 4 字节（parseDomainName 成功时 offset <= size）
+        if (size - offset < 4) return ParseError::TRUNCATED;
+        
+        // ========== 解析 TYPE（2 字节，大端序）==========
+        question.type = (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
+        offset += 2;
+        
+        // ========== 解析 CLASS（2 字节，大端序）==========
+        question.qclass = (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
+        offset += 2;
+        
+        question.hash = QuestionHash::finish(hash, question.type, question.qclass);
+        question.shardHash = shardHash;
+        return ParseError::NONE;
+    }
+    
+    /**
+     * 解析域名（支持压缩指针）
+     * 
+     * @param data 完整的 DNS 消息数据
+     * @param size 可读取的长度（data[0, size) 之外的字节一律视为越界）
+     * @param offset [输入/输出] 当前位置，解析后更新（注意：遇到指针时只前进 2 字节）
+     * @param name [输出] 解析后的域名字符串（追加到末尾，内存来自 name 自己的分配器）
+     * @param hash [输入/输出] 不为空时，把每个标签混入 QuestionHash（标签刚被读过，还在 L1 缓存中）
+     * @param shardHash [输入/输出] 不为空时，把每个标签混入 SteeringHash
+     * @return ParseError::NONE 表示成功
+     * 
+     * ============================================================
+     * 压缩指针偏移量计算详解
+     * ============================================================
+     * 
+     * 压缩指针格式（2 字节）：
+     *   字节1: [1 1 X X X X X X]  字节2: [Y Y Y Y Y Y Y Y]
+     *          ↑ ↑ └────┬────┘          └──────┬──────┘
+     *        标志位   高6位               低8位
+     *                 └──────────┬──────────┘
+     *                       14位偏移量
+     * 
+     * 公式: offset = ((byte1 & 0x3F) << 8) | byte2
+     * 
+     * ---------- 示例 1: 指针 0xC0 0x0C（偏移 12）----------
+     * 
+     *   字节1: 0xC0 = 1100 0000
+     *   字节2: 0x0C = 0000 1100
+     * 
+     *   步骤 1: 0xC0 & 0x3F（去掉标志位，保留低6位）
+     *           1100 0000
+     *         & 0011 1111
+     *         ───────────
+     *           0000 0000 = 0x00
+     * 
+     *   步骤 2: 0x00 << 8（左移8位，为低8位腾出空间）
+     *           0x00 << 8 = 0x0000
+     * 
+     *   步骤 3: 0x0000 | 0x0C（合并低8位）
+     *           0000 0000 0000 0000
+     *         | 0000 0000 0000 1100
+     *         ─────────────────────
+     *           0000 0000 0000 1100 = 0x000C = 12
+     * 
+     *   结果: 偏移量 = 12
+     * 
+     * ---------- 示例 2: 指针 0xC1 0x2F（偏移 303）----------
+     * 
+     *   字节1: 0xC1 = 1100 0001
+     *   字节2: 0x2F = 0010 1111
+     * 
+     *   步骤 1: 0xC1 & 0x3F = 0000 0001 = 0x01
+     *   步骤 2: 0x01 << 8   = 0x0100 = 256
+     *   步骤 3: 0x0100 | 0x2F = 0x012F = 303
+     * 
+     *   结果: 偏移量 = 303
+     * 
+     * 注意: 14位偏移量最大可表示 2^14 - 1 = 16383 字节
+     * 
+     * ============================================================
+     * 防御恶意报文
+     * ============================================================
+     * 
+     *   - 每次读取前检查边界，报文结束在字段中间 -> TRUNCATED
+     *   - 指针必须指向更早的位置（RFC 1035: "a prior occurance"） -> BAD_POINTER
+     *   - 仍然可以构造出环：[12] 0x01 'a' [14] 0xC0 0x0C
+     *     偏移 14 的指针跳回 12，读完标签 'a' 又回到偏移 14 ……
+     *     所以限制跳转次数 MAX_POINTER_HOPS -> TOO_MANY_POINTERS
+     *   - 长度字节 0x40-0xBF（> 63）不是合法标签 -> LABEL_TOO_LONG
+     *   - 线格式总长度（长度字节 + 内容 + 结束符）超过 255 -> NAME_TOO_LONG
+     *   - 标签内容含 '.'：线格式允许，但内部用点分文本表示域名，
+     *     \x04a.bc 会被当成 "a" 和 "bc" 两个标签，无法原样回显 -> DOT_IN_LABEL
+     */
+    static ParseError parseDomainName(const uint8_t* data, size_t size, size_t& offset, std::pmr::string& name,
+                                      uint64_t* hash = nullptr, uint32_t* shardHash = nullptr)
+    {
+        bool jumped = false;      // 是否已经跳转过（用于正确更新 offset）
+        size_t jumpOffset = 0;    // 跳转前的位置
+        size_t currentPos = offset;
+        size_t wireLength = 0;    // 已读取的线格式长度
+        int hops = 0;             // 已跟随的指针数
+        
+        while (true)
+        {
+            if (currentPos >= size) return ParseError::TRUNCATED;
+            uint8_t labelLen = data[currentPos];
+            
+            // 检查是否是压缩指针（高 2 位为 11，即 >= 0xC0）
+            // 判断方法: labelLen & 0xC0 == 0xC0
+            //   0xC0 = 1100 0000，与操作后如果高2位是11，结果仍为0xC0
+            if ((labelLen & 0xC0) == 0xC0)
+            {
+                // 这是一个压缩指针
+                // 指针格式: [11XXXXXX] [YYYYYYYY] (2 bytes)
+                //           ^^标志位   低14位是偏移量
+                if (currentPos + 1 >= size) return ParseError::TRUNCATED;
+                if (++hops > MAX_POINTER_HOPS) return ParseError::TOO_MANY_POINTERS;
+                if (!jumped)
+                {
+                    // 第一次跳转，记录原始位置 + 2（指针占 2 字节）
+                    jumpOffset = currentPos + 2;
+                    jumped = true;
+                }
+                
+                // 计算指针指向的偏移量
+                // ((labelLen & 0x3F) << 8) | data[currentPos + 1]
+                //   1. labelLen & 0x3F: 清除高2位标志位，保留低6位
+                //   2. << 8: 左移8位，为低8位腾出空间
+                //   3. | data[currentPos + 1]: 合并第二个字节（低8位）
+                uint16_t pointer = ((labelLen & 0x3F) << 8) | data[currentPos + 1];
+                if (pointer >= currentPos) return ParseError::BAD_POINTER;
+                currentPos = pointer;  // 跳转到指针指向的位置
+                continue;
+            }
+            
+            // 0x40-0xBF：高 2 位为 01 / 10，不是普通标签也不是指针
+            if (labelLen > MAX_LABEL_LENGTH) return ParseError::LABEL_TOO_LONG;
+            
+            // 长度为 0 表示域名结束
+            if (labelLen == 0)
+            {
+                currentPos++;  // 跳过结束符
+                break;
+            }
+            
+            // 普通标签：加上它以及之后至少 1 字节的结束符，总长度不能超过 255
+            wireLength += 1 + labelLen;
+            if (wireLength + 1 > MAX_NAME_LENGTH) return ParseError::NAME_TOO_LONG;
+            currentPos++;  // 跳过长度字节
+            if (size - currentPos < labelLen) return ParseError::TRUNCATED;
+            
+            // 如果不是第一个标签，添加分隔符 '.'
+            if (!name.empty())
+            {
+                name += '.';
+            }
+            
+            // 读取标签内容：直接写进字符串的缓冲区，复制的同时（16/32 字节一次）检查 '.'
+            // （不用 resize_and_overwrite：libstdc++ 12 在它需要扩容时会算错长度）
+            size_t start = name.size();
+            name.resize(start + labelLen);
+            if (!LabelSimd::copyLabel(name.data() + start, data + currentPos, labelLen))
+            {
+                return ParseError::DOT_IN_LABEL;
+            }
+            if (hash) *hash = QuestionHash::addLabel(*hash, data + currentPos, labelLen);
+            if (shardHash) *shardHash = SteeringHash::addLabel(*shardHash, data + currentPos, labelLen);
+            currentPos += labelLen;
+        }
+        
+        // 更新 offset
+        // 如果发生了跳转，offset 应该指向指针之后（指针占 2 字节）
+        // 如果没有跳转，offset 应该指向域名结束符之后
+        if (jumped)
+        {
+            offset = jumpOffset;
+        }
+        else
+        {
+            offset = currentPos;
+        }
+        return ParseError::NONE;
+    }
+    
+    /**
+     * 将域名编码为 DNS 标签序列
+     * 
+     * 编码规则：
+     *   1. 按 '.' 分割域名为多个标签
+     *   2. 每个标签格式：<长度字节><内容>
+     *   3. 以 \x00 结束
+     * 
+     * 示例: "codecrafters.io" -> \x0ccodecrafters\x02io\x00
+     * 
+     * 详细编码过程（以 "codecrafters.io" 为例）：
+     * 
+     *   输入: "codecrafters.io"
+     *         ^^^^^^^^^^^^^  ^^
+     *         第一个标签     第二个标签
+     * 
+     *   步骤1: 找到第一个 '.'，位置 pos=12
+     *          标签 "codecrafters"，长度=12 (0x0C)
+     *          输出: [0x0C, 'c','o','d','e','c','r','a','f','t','e','r','s']
+     * 
+     *   步骤2: 从 pos+1=13 开始，找下一个 '.'，未找到
+     *          处理最后一个标签 "io"，长度=2 (0x02)
+     *          输出: [0x02, 'i','o']
+     * 
+     *   步骤3: 添加结束符 \x00
+     * 
+     *   最终结果（十六进制）:
+     *   0C 63 6F 64 65 63 72 61 66 74 65 72 73 02 69 6F 00
+     *   ^^ ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ ^^ ^^^^^ ^^
+     *   长度  c  o  d  e  c  r  a  f  t  e  r  s  长度 i  o  结束
+     *   =12                                       =2
+     */
+    static std::vector<uint8_t> encodeDomainName(std::string_view domain) 
+    {
+        std::vector<uint8_t> encoded;
+        encodeDomainName(domain, encoded);
+        return encoded;
+    }
+    
+    /**
+     * 将域名编码为 DNS 标签序列，追加到 encoded 末尾（不产生临时数组）
+     * 
+     * @param domain 点分域名
+     * @param encoded [输出] std::vector 或 std::pmr::vector<uint8_t>
+     */
+    template <typename Bytes>
+    static void encodeDomainName(std::string_view domain, Bytes& encoded) 
+    {
+        size_t start = 0;
+        size_t pos = 0;
+        
+        // 按 '.' 分割域名
+        // 示例: domain = "codecrafters.io"
+        //       第一次循环: start=0, 找到 pos=12 ('.')
+        //       第二次循环: start=13, 找不到 '.', 退出循环
+        while ((pos = domain.find('.', start)) != std::string_view::npos) 
+        {
+            // 计算当前标签长度
+            // 示例: labelLen = 12 - 0 = 12
+            size_t labelLen = pos - start;
+            
+            // 添加长度字节
+            // 示例: encoded.push_back(12) -> encoded = [0x0C]
+            encoded.push_back(static_cast<uint8_t>(labelLen));
+            
+            // 添加标签内容
+            // 示例: 添加 "codecrafters" 的每个字符
+            //       encoded = [0x0C, 'c','o','d','e','c','r','a','f','t','e','r','s']
+            for (size_t i = start; i < pos; i++) 
+            {
+                encoded.push_back(static_cast<uint8_t>(domain[i]));
+            }
+            
+            // 移动到下一个标签的起始位置
+            // 示例: start = 12 + 1 = 13
+            start = pos + 1;
+        }
+        
+        // 处理最后一个标签（'.' 后面的部分）
+        // 示例: start=13, domain.length()=15
+        //       最后一个标签 "io", 长度=15-13=2
+        if (start < domain.length()) 
+        {
+            size_t labelLen = domain.length() - start;
+            encoded.push_back(static_cast<uint8_t>(labelLen));
+            for (size_t i = start; i < domain.length(); i++) 
+            {
+                encoded.push_back(static_cast<uint8_t>(domain[i]));
+            }
+        }
+        
+        // 添加结束符 \x00
+        // 最终: encoded = [0x0C, ..., 0x02, 'i', 'o', 0x00]
+        encoded.push_back(0x00);
+    }
+    
+    /**
+     * 序列化 Question，追加到 bytes 末尾
+     */
+    void serialize(std::pmr::vector<uint8_t>& bytes) const 
+    {
+        // 1. 编码域名
+        encodeDomainName(name, bytes);
+        
+        // 2. TYPE（2 字节，大端序）
+        bytes.push_back((type >> 8) & 0xFF);
+        bytes.push_back(type & 0xFF);
+        
+        // 3. CLASS（2 字节，大端序）
+        bytes.push_back((qclass >> 8) & 0xFF);
+        bytes.push_back(qclass & 0xFF);
+    }
+};
+
+/**
+ * DNS Answer (Resource Record) 结构体
+ * 
+ * Answer Section 格式（RFC 1035 Section 3.2.1）：
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                     NAME                      |  变长，域名编码
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                     TYPE                      |  16 bits，记录类型
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                     CLASS                     |  16 bits，记录类别
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                     TTL                       |  32 bits，生存时间
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                   RDLENGTH                    |  16 bits，RDATA 长度
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * |                    RDATA                      |  变长，记录数据
+ * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * 
+ * A 记录示例（codecrafters.io -> 8.8.8.8）：
+ *   NAME:     \x0ccodecrafters\x02io\x00  (域名编码)
+ *   TYPE:     0x0001                       (A 记录)
+ *   CLASS:    0x0001                       (IN 互联网)
+ *   TTL:      0x0000003C                   (60 秒)
+ *   RDLENGTH: 0x0004                       (4 字节)
+ *   RDATA:    0x08080808                   (8.8.8.8)
+ */
+struct DNSAnswer 
+{
+    // 与 DNSQuestion 相同：放进 std::pmr::vector 时，域名和 RDATA 使用容器的 arena
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+    
+    std::pmr::string name;  // 域名
+    uint16_t type;          // 记录类型（1 = A 记录）
+    uint16_t aclass;        // 记录类别（1 = IN）
+    uint32_t ttl;           // 生存时间（秒）
+    uint16_t rdlength;      // RDATA 长度
+    std::pmr::vector<uint8_t> rdata;  // 记录数据（A 记录为 4 字节 IP 地址）
+    
+    DNSAnswer() = default;
+    explicit DNSAnswer(const allocator_type& alloc) : name(alloc), rdata(alloc) {}
+    DNSAnswer(const DNSAnswer& other) = default;
+    DNSAnswer(DNSAnswer&& other) = default;
+    DNSAnswer(const DNSAnswer& other, const allocator_type& alloc)
+        : name(other.name, alloc), type(other.type), aclass(other.aclass), ttl(other.ttl),
+          rdlength(other.rdlength), rdata(other.rdata, alloc) {}
+    DNSAnswer(DNSAnswer&& other, const allocator_type& alloc)
+        : name(std::move(other.name), alloc), type(other.type), aclass(other.aclass), ttl(other.ttl),
+          rdlength(other.rdlength), rdata(std::move(other.rdata), alloc) {}
+    DNSAnswer& operator=(const DNSAnswer& other) = default;
+    DNSAnswer& operator=(DNSAnswer&& other) = default;
+    
+    /**
+     * 从字节数组解析 DNS Answer（反序列化）
+     * 
+     * @param data 完整的 DNS 消息数据
+     * @param size 报文长度
+     * @param offset [输入/输出] 当前解析位置
+     * @param answer [输出] 解析后的 DNSAnswer（域名和 RDATA 使用 answer 自己的分配器）
+     * @return ParseError::NONE 表示成功
+     */
+    static ParseError parse(const uint8_t* data, size_t size, size_t& offset, DNSAnswer& answer)
+    {
+        // 1. 解析域名（支持压缩）
+        ParseError error = DNSQuestion::parseDomainName(data, size, offset, answer.name);
+        if (error != ParseError::NONE) return error;
+        
+        // 固定部分：TYPE(2) + CLASS(2) + TTL(4) + RDLENGTH(2) = 10 字节
+        if (size - offset < 10) return ParseError::TRUNCATED;
+        
+        // 2. TYPE（2 字节，大端序）
+        answer.type = (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
+        offset += 2;
+        
+        // 3. CLASS（2 字节，大端序）
+        answer.aclass = (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
+        offset += 2;
+        
+        // 4. TTL（4 字节，大端序）
+        answer.ttl = (static_cast<uint32_t>(data[offset]) << 24) |
+                     (static_cast<uint32_t>(data[offset + 1]) << 16) |
+                     (static_cast<uint32_t>(data[offset + 2]) << 8) |
+                     data[offset + 3];
+        offset += 4;
+        
+        // 5. RDLENGTH（2 字节，大端序）
+        answer.rdlength = (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
+        offset += 2;
+        
+        // 6. RDATA（rdlength 字节）
+        if (size - offset < answer.rdlength) return ParseError::TRUNCATED;
+        answer.rdata.assign(data + offset, data + offset + answer.rdlength);
+        
+        // 含域名的 RDATA 可能使用了压缩指针，指针指向的是原始报文中的偏移，
+        // 原样搬到我们自己的响应里就会指向错误的位置，所以这里展开成完整域名
+        // （展开会改写 rdlength，所以先记下报文中的原始长度，用它前进 offset）
+        uint16_t wireLength = answer.rdlength;
+        error = expandRdataNames(data, offset, answer);
+        if (error != ParseError::NONE) return error;
+        offset += wireLength;
+        
+        return ParseError::NONE;
+    }
+    
+    /**
+     * 展开 RDATA 中的压缩域名（NS / CNAME / PTR / MX / SOA）
+     * 
+     * @param data 完整的 DNS 消息数据
+     * @param rdataOffset RDATA 在消息中的起始位置（answer.rdlength 已经检查过不越界）
+     * @param answer [输入/输出] 重写其 rdata 与 rdlength
+     * @return 域名或固定字段超出 RDATA 范围时返回错误
+     * 
+     * 解析时把可读范围限制在 RDATA 末尾：指针只能指向更早的位置，
+     * 所以合法的名字不会越过 RDATA，越过的一定是畸形记录。
+     * 
+     * 示例（CNAME，RDATA = \x03www + 指针 0xC00C）：
+     *   展开前: 03 77 77 77 C0 0C                  (6 字节)
+     *   展开后: 03 77 77 77 07 65 78 ... 03 63 6F 6D 00
+     */
+    static ParseError expandRdataNames(const uint8_t* data, size_t rdataOffset, DNSAnswer& answer)
+    {
+        size_t pos = rdataOffset;
+        size_t rdataEnd = rdataOffset + answer.rdlength;
+        std::pmr::vector<uint8_t> expanded(answer.rdata.get_allocator());
+        std::pmr::string name(answer.rdata.get_allocator());
+        ParseError error = ParseError::NONE;
+        
+        auto appendName = [&]() {
+            name.clear();
+            error = DNSQuestion::parseDomainName(data, rdataEnd, pos, name);
+            if (error == ParseError::NONE) DNSQuestion::encodeDomainName(name, expanded);
+            return error == ParseError::NONE;
+        };
+        
+        switch (answer.type)
+        {
+            case 2:   // NS
+            case 5:   // CNAME
+            case 12:  // PTR
+                appendName();
+                break;
+            case 15:  // MX: PREFERENCE(2) + EXCHANGE
+                if (answer.rdlength < 2) return ParseError::TRUNCATED;
+                expanded.assign(data + pos, data + pos + 2);
+                pos += 2;
+                appendName();
+                break;
+            case 6:   // SOA: MNAME + RNAME + 5 个 32 位整数
+                if (appendName() && appendName())
+                {
+                    if (rdataEnd - pos < 20) return ParseError::TRUNCATED;
+                    expanded.insert(expanded.end(), data + pos, data + pos + 20);
+                }
+                break;
+            default:
+                return ParseError::NONE;
+        }
+        if (error != ParseError::NONE) return error;
+        
+        answer.rdata = std::move(expanded);
+        answer.rdlength = static_cast<uint16_t>(answer.rdata.size());
+        return ParseError::NONE;
+    }
+    
+    /**
+     * 序列化 Answer，追加到 bytes 末尾
+     */
+    void serialize(std::pmr::vector<uint8_t>& bytes) const 
+    {
+        // 1. NAME - 域名编码（复用 DNSQuestion 的编码函数）
+        DNSQuestion::encodeDomainName(name, bytes);
+        
+        // 2. TYPE（2 字节，大端序）
+        bytes.push_back((type >> 8) & 0xFF);
+        bytes.push_back(type & 0xFF);
+        
+        // 3. CLASS（2 字节，大端序）
+        bytes.push_back((aclass >> 8) & 0xFF);
+        bytes.push_back(aclass & 0xFF);
+        
+        // 4. TTL（4 字节，大端序）
+        // 示例: ttl = 60 = 0x0000003C
+        //   bytes = [0x00, 0x00, 0x00, 0x3C]
+        bytes.push_back((ttl >> 24) & 0xFF);  // 最高字节
+        bytes.push_back((ttl >> 16) & 0xFF);
+        bytes.push_back((ttl >> 8) & 0xFF);
+        bytes.push_back(ttl & 0xFF);          // 最低字节
+        
+        // 5. RDLENGTH（2 字节，大端序）
+        bytes.push_back((rdlength >> 8) & 0xFF);
+        bytes.push_back(rdlength & 0xFF);
+        
+        // 6. RDATA（变长）
+        // A 记录: 4 字节 IPv4 地址
+        // 示例: 8.8.8.8 -> [0x08, 0x08, 0x08, 0x08]
+        bytes.insert(bytes.end(), rdata.begin(), rdata.end());
+    }
+};
+
+/**
+ * DNS 消息结构体
+ * 包含 header、question、answer、authority、additional 五个部分
+ */
+struct DNSMessage 
+{
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+    
+    DNSHeader header;
+    std::pmr::vector<DNSQuestion> questions;  // Question 部分（可包含多个问题）
+    std::pmr::vector<DNSAnswer> answers;      // Answer 部分（可包含多个回答）
+    std::pmr::vector<DNSAnswer> authorities;  // Authority 部分（否定回答携带 SOA）
+    // TODO: 后续添加 additional 部分
+    
+    /**
+     * @param alloc 所有部分（以及 serialize() 的结果）使用的分配器，
+     *              通常是当前请求的 arena；默认全局堆
+     */
+    explicit DNSMessage(const allocator_type& alloc = {})
+        : questions(alloc), answers(alloc), authorities(alloc) {}
+    
+    /**
+     * 序列化整个消息（使用与消息相同的分配器）
+     * 
+     * 各部分直接追加到同一个数组中，不产生中间数组
+     */
+    std::pmr::vector<uint8_t> serialize() const 
+    {
+        std::pmr::vector<uint8_t> bytes(questions.get_allocator());
+        bytes.reserve(512);
+        
+        // 1. 序列化 Header
+        header.serialize(bytes);
+        
+        // 2. 序列化所有 Questions
+        for (const auto& question : questions) 
+        {
+            question.serialize(bytes);
+        }
+        
+        // 3. 序列化所有 Answers
+        for (const auto& answer : answers) 
+        {
+            answer.serialize(bytes);
+        }
+        
+        // 4. 序列化所有 Authority 记录
+        for (const auto& authority : authorities) 
+        {
+            authority.serialize(bytes);
+        }
+        
+        return bytes;
+    }
+};
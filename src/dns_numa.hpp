@@ -0,0 +1,273 @@
+/**
+ * NUMA 拓扑与内存放置（--listen ...,cpus=nodeN / nic=<网卡>，以及工作线程和缓存分片的内存位置）
+ *
+ * 双路服务器上每个插槽是一个 NUMA 节点：CPU 访问本节点的内存最快，访问另一个节点的内存要经过插槽间的互联，
+ * 延迟更高、带宽更低。工作线程在节点 1 上运行、读的缓存分片却在节点 0 上时，每次查找都是远程访问。
+ *
+ * 拓扑来自 sysfs（不依赖 libnuma）：
+ *   /sys/devices/system/node/node<N>/cpulist     节点 N 的 CPU，例如 "0-15,32-47"
+ *   /sys/devices/system/node/node<N>/meminfo     节点 N 的内存（报告用）
+ *   /sys/class/net/<网卡>/device/numa_node        网卡所在的节点（virtio 等设备在上一级的 PCI 设备上）
+ *   /sys/class/net/<网卡>/device/msi_irqs/<IRQ>   网卡的中断；/proc/irq/<IRQ>/effective_affinity_list
+ *                                                 是处理该中断（以及该接收队列软中断）的 CPU
+ *
+ * 内存放置依靠两点：
+ *   1. Linux 默认在第一次写入页面的线程所在的节点上分配物理页（first touch）
+ *   2. set_mempolicy(MPOL_PREFERRED, 节点)：之后本线程分配的页面优先放在指定节点（preferNode()）
+ * 工作线程启动后先绑定 CPU、设置本节点优先，再分配自己的接收缓冲区和请求内存池；
+ * 主线程构造第 i 个缓存分片时临时优先第 i 个工作线程所在的节点。
+ *
+ * 没有 NUMA 的机器（或容器中看不到 /sys/devices/system/node）视为一个节点，所有函数照常工作。
+ */
+
+#pragma once
+
+#include <algorithm>     // std::sort, std::unique
+#include <cctype>        // tolower()
+#include <cstdint>       // uint64_t
+#include <cstdio>        // snprintf()
+#include <fstream>       // std::ifstream 读 sysfs / procfs
+#include <map>           // std::map 节点 -> CPU
+#include <sstream>       // std::istringstream
+#include <string>        // std::string
+#include <vector>        // std::vector
+#include <dirent.h>      // opendir() 列出节点和中断
+#include <linux/mempolicy.h>  // MPOL_DEFAULT, MPOL_PREFERRED
+#include <sys/syscall.h> // SYS_set_mempolicy
+#include <unistd.h>      // syscall()
+
+class NumaTopology
+{
+public:
+    /**
+     * 读取本机的 NUMA 拓扑
+     *
+     * 没有 /sys/devices/system/node 时视为一个节点 0，包含所有在线 CPU
+     */
+    static NumaTopology detect()
+    {
+        NumaTopology topology;
+        for (const std::string& entry : listDirectory("/sys/devices/system/node"))
+        {
+            if (entry.compare(0, 4, "node") != 0 || entry.size() == 4 ||
+                entry.find_first_not_of("0123456789", 4) != std::string::npos)
+            {
+                continue;
+            }
+            int node = std::stoi(entry.substr(4));
+            std::vector<int> cpus;
+            parseCpuList(readLine("/sys/devices/system/node/" + entry + "/cpulist"), cpus);
+            topology.nodes_[node] = Node{ cpus, readMemTotal("/sys/devices/system/node/" + entry + "/meminfo") };
+        }
+        if (topology.nodes_.empty())
+        {
+            std::vector<int> cpus;
+            parseCpuList(readLine("/sys/devices/system/cpu/online"), cpus);
+            topology.nodes_[0] = Node{ cpus, 0 };
+        }
+        for (const auto& [node, info] : topology.nodes_)
+        {
+            for (int cpu : info.cpus)
+            {
+                if (cpu >= static_cast<int>(topology.cpuNodes_.size())) topology.cpuNodes_.resize(cpu + 1, -1);
+                topology.cpuNodes_[cpu] = node;
+            }
+        }
+        return topology;
+    }
+
+    int nodeCount() const { return static_cast<int>(nodes_.size()); }
+    bool hasNode(int node) const { return nodes_.count(node) != 0; }
+
+    // CPU 所在的节点，未知（不存在或离线）返回 -1
+    int nodeOf(int cpu) const
+    {
+        return cpu >= 0 && cpu < static_cast<int>(cpuNodes_.size()) ? cpuNodes_[cpu] : -1;
+    }
+
+    // 下标 = CPU 编号，值 = 节点（ReuseportSteering 的 steer=cpu 用来选择同一节点上的工作线程）
+    const std::vector<int>& cpuNodes() const { return cpuNodes_; }
+
+    std::vector<int> cpusOf(int node) const
+    {
+        auto found = nodes_.find(node);
+        return found == nodes_.end() ? std::vector<int>() : found->second.cpus;
+    }
+
+    /**
+     * 一行拓扑说明
+     *
+     * 示例："2 nodes: node0 cpus 0-15,32-47 (63.9 GiB), node1 cpus 16-31,48-63 (64.0 GiB)"
+     */
+    std::string format() const
+    {
+        std::string text = std::to_string(nodes_.size()) + (nodes_.size() == 1 ? " node: " : " nodes: ");
+        bool first = true;
+        for (const auto& [node, info] : nodes_)
+        {
+            text += (first ? "" : ", ") + std::string("node") + std::to_string(node) + " cpus " + formatCpuList(info.cpus);
+            if (info.memoryKiB > 0)
+            {
+                char memory[32];
+                snprintf(memory, sizeof(memory), " (%.1f GiB)", static_cast<double>(info.memoryKiB) / (1024 * 1024));
+                text += memory;
+            }
+            first = false;
+        }
+        return text;
+    }
+
+    /**
+     * 网卡所在的节点，未知返回 -1
+     *
+     * 先看网卡设备本身，再看上一级（virtio 网卡的 device 是 virtioN，numa_node 在它所在的 PCI 设备上）
+     */
+    static int deviceNode(const std::string& interface)
+    {
+        for (const char* path : { "/device/numa_node", "/device/../numa_node" })
+        {
+            std::string value = readLine("/sys/class/net/" + interface + path);
+            if (!value.empty() && value.find_first_not_of("-0123456789") == std::string::npos) return std::stoi(value);
+        }
+        return -1;
+    }
+
+    /**
+     * 处理网卡接收队列中断的 CPU（升序，去重）
+     *
+     * 中断来自设备的 msi_irqs（同样先看设备本身，再看上一级的 PCI 设备）；
+     * 中断名（/proc/interrupts 最后一列）含 "rx" 或 "input" 的是接收队列，例如
+     * "eth0-TxRx-3"、"virtio3-input.0"；一个都没有时使用设备的全部中断。
+     */
+    static std::vector<int> rxQueueCpus(const std::string& interface)
+    {
+        std::vector<std::string> irqs = listDirectory("/sys/class/net/" + interface + "/device/msi_irqs");
+        if (irqs.empty()) irqs = listDirectory("/sys/class/net/" + interface + "/device/../msi_irqs");
+
+        std::map<std::string, std::string> names;   // IRQ -> 中断名
+        std::ifstream interrupts("/proc/interrupts");
+        for (std::string line; std::getline(interrupts, line);)
+        {
+            std::istringstream fields(line);
+            std::string irq, name, field;
+            fields >> irq;
+            while (fields >> field) name = field;
+            if (!irq.empty() && irq.back() == ':') names[irq.substr(0, irq.size() - 1)] = name;
+        }
+
+        std::vector<std::string> rx;
+        for (const std::string& irq : irqs)
+        {
+            std::string name = names[irq];
+            for (char& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            if (name.find("rx") != std::string::npos || name.find("input") != std::string::npos) rx.push_back(irq);
+        }
+        if (rx.empty()) rx = irqs;
+
+        std::vector<int> cpus;
+        for (const std::string& irq : rx)
+        {
+            std::string affinity = readLine("/proc/irq/" + irq + "/effective_affinity_list");
+            if (affinity.empty()) affinity = readLine("/proc/irq/" + irq + "/smp_affinity_list");
+            std::vector<int> irqCpus;
+            if (parseCpuList(affinity, irqCpus)) cpus.insert(cpus.end(), irqCpus.begin(), irqCpus.end());
+        }
+        std::sort(cpus.begin(), cpus.end());
+        cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+        return cpus;
+    }
+
+    /**
+     * 调用线程之后分配的页面优先放在 node 上（内存不足时仍可以用其他节点）；node < 0 恢复默认（first touch）
+     *
+     * @return 内核不支持 NUMA 策略（没有 CONFIG_NUMA）时返回 false，分配照常进行
+     */
+    static bool preferNode(int node)
+    {
+        if (node < 0) return syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0) == 0;
+        constexpr int MAX_NODES = 1024;
+        unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))] = {};
+        if (node >= MAX_NODES) return false;
+        mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+        return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, MAX_NODES + 1) == 0;
+    }
+
+    // 内核格式的 CPU 列表 "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+    static bool parseCpuList(const std::string& text, std::vector<int>& cpus)
+    {
+        cpus.clear();
+        std::istringstream ranges(text);
+        for (std::string range; std::getline(ranges, range, ',');)
+        {
+            size_t dash = range.find('-');
+            std::string first = range.substr(0, dash);
+            std::string last = dash == std::string::npos ? first : range.substr(dash + 1);
+            if (first.empty() || last.empty() || first.find_first_not_of("0123456789") != std::string::npos ||
+                last.find_first_not_of("0123456789") != std::string::npos)
+            {
+                return false;
+            }
+            for (int cpu = std::stoi(first); cpu <= std::stoi(last); cpu++) cpus.push_back(cpu);
+        }
+        return !cpus.empty();
+    }
+
+    // {0, 1, 2, 3, 8, 10, 11} -> "0-3,8,10-11"
+    static std::string formatCpuList(const std::vector<int>& cpus)
+    {
+        std::string text;
+        for (size_t i = 0; i < cpus.size();)
+        {
+            size_t end = i;
+            while (end + 1 < cpus.size() && cpus[end + 1] == cpus[end] + 1) end++;
+            text += (text.empty() ? "" : ",") + std::to_string(cpus[i]);
+            if (end > i) text += "-" + std::to_string(cpus[end]);
+            i = end + 1;
+        }
+        return text;
+    }
+
+private:
+    struct Node
+    {
+        std::vector<int> cpus;
+        uint64_t memoryKiB = 0;
+    };
+
+    std::map<int, Node> nodes_;     // 按节点编号排序（编号可能不连续）
+    std::vector<int> cpuNodes_;
+
+    static std::string readLine(const std::string& path)
+    {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    // "Node 0 MemTotal:       65843012 kB"
+    static uint64_t readMemTotal(const std::string& path)
+    {
+        std::ifstream file(path);
+        for (std::string line; std::getline(file, line);)
+        {
+            size_t field = line.find("MemTotal:");
+            if (field != std::string::npos) return std::stoull(line.substr(field + 9));
+        }
+        return 0;
+    }
+
+    static std::vector<std::string> listDirectory(const std::string& path)
+    {
+        std::vector<std::string> entries;
+        DIR* directory = opendir(path.c_str());
+        if (directory == nullptr) return entries;
+        while (dirent* entry = readdir(directory))
+        {
+            if (entry->d_name[0] != '.') entries.push_back(entry->d_name);
+        }
+        closedir(directory);
+        std::sort(entries.begin(), entries.end());
+        return entries;
+    }
+};
@@ -0,0 +1,228 @@
+/**
+ * 报文缓冲区池（接收的查询、上游的响应、io_uring 在途的发送）
+ *
+ * 一次处理一个报文时，栈上的 uint8_t buffer[512] 就够了；交给解析线程的请求、等待上游的协程、
+ * 还没有完成的 io_uring 发送都需要活得比一轮循环更久的缓冲区。这里的缓冲区：
+ *   - 固定大小 BUFFER_SIZE = 4096（EDNS 常用的最大载荷，RFC 6891），按缓存行对齐
+ *   - 以 2 MiB 的 slab 为单位申请（HugePageRegion，--huge-pages 时正好一个大页），从不归还给系统
+ *   - 每个线程一个 Cache（attach()），取用和本线程归还只操作 Cache 自己的空闲链表，没有锁和原子操作
+ *
+ * 缓冲区可以在另一个线程归还（工作线程收到的查询由解析线程处理完后释放）：
+ * 这时用 CAS 压入所属 Cache 的 remote_ 栈（多个线程可以同时压入），
+ * 所属线程的空闲链表用完时一次 exchange() 把整个 remote_ 栈取回来。
+ * 取回的一方只有所属线程一个，而且总是整栈取走，所以没有 ABA 问题。
+ *
+ *   工作线程 Cache:  local_ -> [b3] -> [b7] -> ...        remote_ <- [b1] <- [b4]   （解析线程压入）
+ *     acquire():     local_ 为空时 local_ = remote_.exchange(nullptr)；仍为空时申请一个新的 slab
+ *
+ * 只有 attach() 和申请新 slab 时加锁（每个线程一次 / 每 500 个缓冲区一次），
+ * slab 在 Cache 所属的线程中写入，落在该线程的 NUMA 节点上（见 dns_numa.hpp）。
+ *
+ * 使用：
+ *   PacketPool::Cache& packets = pool.attach();      // 每个线程一次
+ *   PacketPool::Packet packet = packets.acquire();   // data() / size() / resize()
+ *   ... 移动到其他线程 ...
+ *   packet.reset();                                  // 或析构：归还给取出它的 Cache
+ *
+ * PacketPool 必须比所有 Cache 的线程和所有 Packet 活得久（main() 中先于它们创建）。
+ */
+
+#pragma once
+
+#include <atomic>        // std::atomic 跨线程归还的栈
+#include <cstddef>       // size_t
+#include <cstdint>       // uint8_t, uint64_t
+#include <cstring>       // memcpy()
+#include <deque>         // std::deque 各线程的 Cache（地址不随扩容变化）
+#include <mutex>         // std::mutex 只保护 attach() 和新增 slab
+#include <string>        // std::string 统计
+#include <utility>       // std::exchange
+#include <vector>        // std::vector slab 列表
+
+#include "dns_hugepage.hpp"
+#include "dns_ring.hpp"   // CACHE_LINE_SIZE
+
+class PacketPool
+{
+private:
+    struct Buffer;
+
+public:
+    static constexpr size_t BUFFER_SIZE = 4096;   // 每个缓冲区的载荷
+    static constexpr size_t SLAB_SIZE = HugePageRegion::HUGE_PAGE_SIZE;
+
+    class Cache;
+
+    /**
+     * 一个缓冲区的所有权（只能移动）；析构或 reset() 时归还
+     */
+    class Packet
+    {
+    public:
+        Packet() = default;
+        ~Packet() { reset(); }
+
+        Packet(Packet&& other) noexcept : buffer_(std::exchange(other.buffer_, nullptr)) {}
+        Packet& operator=(Packet&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                buffer_ = std::exchange(other.buffer_, nullptr);
+            }
+            return *this;
+        }
+
+        Packet(const Packet&) = delete;
+        Packet& operator=(const Packet&) = delete;
+
+        explicit operator bool() const { return buffer_ != nullptr; }
+
+        uint8_t* data() const { return buffer_->data; }
+        size_t size() const { return buffer_->size; }
+        static constexpr size_t capacity() { return BUFFER_SIZE; }
+
+        // 设置有效长度（接收之后）；size 不能超过 capacity()
+        void resize(size_t size) { buffer_->size = size; }
+
+        // 复制 size 字节；超过 capacity() 时返回 false，内容不变
+        bool assign(const uint8_t* data, size_t size)
+        {
+            if (size > BUFFER_SIZE) return false;
+            std::memcpy(buffer_->data, data, size);
+            buffer_->size = size;
+            return true;
+        }
+
+        void reset()
+        {
+            if (buffer_ != nullptr) Cache::release(std::exchange(buffer_, nullptr));
+        }
+
+    private:
+        friend class Cache;
+        explicit Packet(Buffer* buffer) : buffer_(buffer) {}
+
+        Buffer* buffer_ = nullptr;
+    };
+
+    /**
+     * 一个线程的空闲缓冲区；只有 attach() 它的线程可以调用 acquire()
+     */
+    class Cache
+    {
+    public:
+        explicit Cache(PacketPool& pool) : pool_(pool) {}
+
+        Cache(const Cache&) = delete;
+        Cache& operator=(const Cache&) = delete;
+
+        Packet acquire()
+        {
+            if (local_ == nullptr) local_ = remote_.exchange(nullptr, std::memory_order_acquire);
+            if (local_ == nullptr) grow();
+            Buffer* buffer = local_;
+            local_ = buffer->next;
+            buffer->size = 0;
+            return Packet(buffer);
+        }
+
+    private:
+        friend class PacketPool;
+
+        PacketPool& pool_;
+        Buffer* local_ = nullptr;      // 只有所属线程访问
+
+        // 其他线程写入的部分单独占一个缓存行，不干扰所属线程的 local_
+        alignas(CACHE_LINE_SIZE) std::atomic<Buffer*> remote_{ nullptr };
+        std::atomic<uint64_t> remoteFrees_{ 0 };
+
+        // 调用线程 attach() 的 Cache（没有 attach() 的线程为空，归还都走 remote_）
+        static Cache*& current()
+        {
+            thread_local Cache* cache = nullptr;
+            return cache;
+        }
+
+        static void release(Buffer* buffer)
+        {
+            Cache* owner = buffer->owner;
+            if (owner == current())
+            {
+                buffer->next = owner->local_;
+                owner->local_ = buffer;
+                return;
+            }
+            // release：缓冲区中的数据先于压栈对所属线程可见
+            Buffer* head = owner->remote_.load(std::memory_order_relaxed);
+            do
+            {
+                buffer->next = head;
+            } while (!owner->remote_.compare_exchange_weak(head, buffer, std::memory_order_release,
+                                                           std::memory_order_relaxed));
+            owner->remoteFrees_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // 申请一个 slab，切成缓冲区放进空闲链表
+        void grow()
+        {
+            HugePageRegion slab(SLAB_SIZE, pool_.hugePages_);
+            size_t count = slab.size() / sizeof(Buffer);
+            Buffer* buffers = reinterpret_cast<Buffer*>(slab.data());
+            for (size_t i = count; i-- > 0;)
+            {
+                buffers[i].owner = this;
+                buffers[i].next = local_;
+                local_ = &buffers[i];
+            }
+            std::lock_guard<std::mutex> lock(pool_.mutex_);
+            pool_.slabs_.push_back(std::move(slab));
+            pool_.buffers_ += count;
+        }
+    };
+
+    explicit PacketPool(HugePageMode hugePages = HugePageMode::OFF) : hugePages_(hugePages) {}
+
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    // 调用线程的 Cache（每个线程调用一次，之后由调用方保存）
+    Cache& attach()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Cache& cache = caches_.emplace_back(*this);
+        Cache::current() = &cache;
+        return cache;
+    }
+
+    /**
+     * 一行统计：remote frees 是在其他线程归还的次数（交给解析线程的请求）
+     *
+     * 示例："packet pool: 3 threads, 4 slabs, 2016 buffers of 4096 bytes, remote frees=182733"
+     */
+    std::string format() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t remoteFrees = 0;
+        for (const Cache& cache : caches_) remoteFrees += cache.remoteFrees_.load(std::memory_order_relaxed);
+        return "packet pool: " + std::to_string(caches_.size()) + (caches_.size() == 1 ? " thread, " : " threads, ") +
+               std::to_string(slabs_.size()) + (slabs_.size() == 1 ? " slab, " : " slabs, ") + std::to_string(buffers_) +
+               " buffers of " + std::to_string(BUFFER_SIZE) + " bytes, remote frees=" + std::to_string(remoteFrees);
+    }
+
+private:
+    // 头部占一个缓存行，载荷从下一个缓存行开始：sizeof(Buffer) = 64 + 4096，相邻缓冲区不共享缓存行
+    struct Buffer
+    {
+        Buffer* next;      // 空闲时：链表中的下一个
+        Cache* owner;      // 申请它的 Cache（归还的目的地）
+        size_t size;       // 有效长度
+        alignas(CACHE_LINE_SIZE) uint8_t data[BUFFER_SIZE];
+    };
+
+    HugePageMode hugePages_;
+    mutable std::mutex mutex_;
+    std::deque<Cache> caches_;
+    std::vector<HugePageRegion> slabs_;
+    size_t buffers_ = 0;
+};
@@ -0,0 +1,93 @@
+/**
+ * 后台预取线程
+ *
+ * 缓存发现热门条目即将过期时，主线程只把问题放进队列就立即返回，
+ * 由这里的后台线程向上游查询并写回缓存，客户端永远看不到这次上游延迟。
+ *
+ *   主线程                        预取线程
+ *   ───────                       ────────
+ *   cache.lookup() -> prefetch
+ *   schedule(question) ──队列──>  refresh(question)
+ *   立即回复客户端                   forwardQuery() -> cache.insert...()
+ */
+
+#pragma once
+
+#include <condition_variable>  // std::condition_variable 唤醒后台线程
+#include <cstddef>             // size_t
+#include <deque>               // std::deque 待刷新的问题队列
+#include <functional>          // std::function 刷新回调
+#include <mutex>               // std::mutex 保护队列
+#include <thread>              // std::thread 后台线程
+
+#include "dns_message.hpp"
+
+class Prefetcher
+{
+public:
+    using RefreshFn = std::function<void(const DNSQuestion&)>;
+
+    /**
+     * @param refresh 刷新一个问题的回调（在后台线程中执行）
+     * @param maxPending 队列上限，超出时直接丢弃新的预取请求（预取只是优化，丢了不影响正确性）
+     */
+    Prefetcher(RefreshFn refresh, size_t maxPending = 1024)
+        : refresh_(std::move(refresh)), maxPending_(maxPending)
+    {
+        worker_ = std::thread([this] { run(); });
+    }
+
+    ~Prefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeup_.notify_one();
+        worker_.join();
+    }
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    /**
+     * 把一个问题加入刷新队列（不阻塞）
+     *
+     * @return 队列已满时返回 false
+     */
+    bool schedule(const DNSQuestion& question)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (pending_.size() >= maxPending_) return false;
+            pending_.push_back(question);
+        }
+        wakeup_.notify_one();
+        return true;
+    }
+
+private:
+    RefreshFn refresh_;
+    size_t maxPending_;
+    std::deque<DNSQuestion> pending_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stopping_ = false;
+    std::thread worker_;
+
+    void run()
+    {
+        while (true)
+        {
+            DNSQuestion question;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+                if (stopping_) return;
+                question = std::move(pending_.front());
+                pending_.pop_front();
+            }
+            refresh_(question);
+        }
+    }
+};
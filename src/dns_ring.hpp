@@ -0,0 +1,281 @@
+/**
+ * 线程之间传递请求的无锁环形队列（--resolver-threads，见 main.cpp 的流水线）
+ *
+ * SpscRing：单生产者单消费者，固定容量（2 的幂）
+ *
+ *   生产者只写 tail_，消费者只写 head_，两者各占一个缓存行；
+ *   每一方另外缓存对方的下标（cachedHead_ / cachedTail_），只有缓存的值表明“满”或“空”时
+ *   才去读对方的缓存行，平时入队 / 出队不产生跨核的缓存行传递：
+ *
+ *     生产者缓存行: [ tail_ | cachedHead_ ]       消费者缓存行: [ head_ | cachedTail_ ]
+ *
+ *   popBatch() 一次取走最多 max 个元素，只更新一次 head_（批量出队）。
+ *
+ * 多个生产者（多个工作线程）把请求交给同一个消费者时，每个生产者各用一个 SpscRing，
+ * 消费者轮流取（HandoffStage）：等价于一个 MPSC 队列，但入队不需要 CAS，生产者之间也没有争用。
+ *
+ * Doorbell：消费者没有数据时睡眠，生产者入队后唤醒它（eventfd，可以和上游套接字放进同一个 epoll）。
+ *   消费者：sleeping = true -> 再检查一次队列 -> 仍然为空才睡眠（poll / epoll_wait）
+ *   生产者：入队 -> 看到 sleeping 才写 eventfd（忙碌时入队不需要系统调用）
+ *   两边都用 seq_cst 栅栏，保证“入队”和“sleeping = true”至少有一方看到另一方，不会丢失唤醒。
+ */
+
+#pragma once
+
+#include <atomic>        // std::atomic 下标与唤醒
+#include <cstddef>       // size_t
+#include <cstdint>       // uint64_t
+#include <functional>    // std::function 消费者循环
+#include <memory>        // std::unique_ptr
+#include <thread>        // std::thread 消费者线程
+#include <utility>       // std::move
+#include <vector>        // std::vector 槽数组
+#include <sys/eventfd.h> // eventfd() 门铃
+#include <unistd.h>      // read() / write() / close()
+
+// 缓存行大小（x86-64 / 大多数 ARM64）；std::hardware_destructive_interference_size 在 GCC 中会产生 ABI 警告
+inline constexpr size_t CACHE_LINE_SIZE = 64;
+
+template <class T>
+class SpscRing
+{
+public:
+    /**
+     * @param capacity 容量，向上取整为 2 的幂
+     */
+    explicit SpscRing(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // 生产者调用；队列满时返回 false（此时 value 没有被移走，调用方仍然持有它）
+    bool push(T&& value)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ > mask_)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ > mask_) return false;
+        }
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者调用：取出最多 max 个元素，返回个数
+    size_t popBatch(T* out, size_t max)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (cachedTail_ == head)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (cachedTail_ == head) return 0;
+        }
+        size_t count = cachedTail_ - head < max ? cachedTail_ - head : max;
+        for (size_t i = 0; i < count; i++) out[i] = std::move(slots_[(head + i) & mask_]);
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // 任意线程调用（近似值，用于睡眠前的检查）
+    bool empty() const
+    {
+        return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{ 0 };   // 生产者写
+    size_t cachedHead_ = 0;                                     // 生产者看到的 head_
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{ 0 };   // 消费者写
+    size_t cachedTail_ = 0;                                     // 消费者看到的 tail_
+    // 类按缓存行对齐，大小也是缓存行的整数倍，后面的对象不会与 head_ 共享一行
+};
+
+
+class Doorbell
+{
+public:
+    Doorbell() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+    ~Doorbell() { if (fd_ != -1) close(fd_); }
+
+    Doorbell(const Doorbell&) = delete;
+    Doorbell& operator=(const Doorbell&) = delete;
+
+    // eventfd：有信号时可读，消费者可以把它和其他描述符放进同一个 epoll 中等待
+    int fd() const { return fd_; }
+
+    // 生产者：入队之后调用
+    void ring()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed)) signal();
+    }
+
+    /**
+     * 消费者：hasWork() 为 false 时调用 block() 睡眠，block() 应当在 fd() 可读时返回
+     *
+     * 示例（只等门铃）：
+     *   doorbell.sleep(hasWork, [&] { pollfd p{ doorbell.fd(), POLLIN, 0 }; poll(&p, 1, -1); });
+     * 示例（同时等上游的响应和定时器，见 dns_coro.hpp）：
+     *   doorbell.sleep(hasWork, [&] { loop.runOnce(-1); });
+     */
+    template <class HasWork, class Block>
+    void sleep(HasWork&& hasWork, Block&& block)
+    {
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!hasWork()) block();
+        sleeping_.store(false, std::memory_order_relaxed);
+        clear();
+    }
+
+    // 无条件唤醒（退出时）
+    void wake() { signal(); }
+
+    // 清除信号（fd() 不再可读）
+    void clear()
+    {
+        uint64_t count;
+        while (read(fd_, &count, sizeof(count)) == sizeof(count)) {}
+    }
+
+private:
+    int fd_;
+    std::atomic<bool> sleeping_{ false };
+
+    void signal()
+    {
+        uint64_t one = 1;
+        ssize_t written = write(fd_, &one, sizeof(one));
+        (void)written;   // 计数器溢出之前一定已经可读，写失败不影响唤醒
+    }
+};
+
+/**
+ * 流水线的一级：producers 个生产者把元素交给 consumers 个消费者线程
+ *
+ *   生产者 p 按 key 选择消费者 c = key % consumers，放入 rings[c][p]（SpscRing）
+ *   消费者 c 在自己的线程中运行 consume(inbox)，用 inbox.popBatch() 轮流从 rings[c][0..producers) 中批量取出
+ *
+ * 相同 key 的元素总是交给同一个消费者，消费者可以合并重复的工作。
+ *
+ * consume() 自己决定空闲时怎样等待（只等门铃，或者与其他事件一起等），典型的循环：
+ *
+ *   while (!inbox.stopping())
+ *   {
+ *       size_t count = inbox.popBatch(batch, BATCH_SIZE);
+ *       if (count == 0) inbox.doorbell().sleep([&] { return inbox.hasWork(); }, block);
+ *       else process(batch, count);
+ *   }
+ */
+template <class T>
+class HandoffStage
+{
+public:
+    static constexpr size_t BATCH_SIZE = 32;
+
+    class Inbox
+    {
+    public:
+        /**
+         * 取出最多 max 个元素，返回个数
+         *
+         * 每次从下一个环开始取，繁忙的生产者不会让其他环饿死
+         */
+        size_t popBatch(T* out, size_t max)
+        {
+            size_t count = 0;
+            for (size_t i = 0; i < rings_.size() && count < max; i++)
+            {
+                count += rings_[(first_ + i) % rings_.size()]->popBatch(out + count, max - count);
+            }
+            first_++;
+            return count;
+        }
+
+        // 有元素可取，或者正在退出（睡眠前的检查）
+        bool hasWork() const
+        {
+            if (stopping()) return true;
+            for (const auto& ring : rings_)
+            {
+                if (!ring->empty()) return true;
+            }
+            return false;
+        }
+
+        bool stopping() const { return stage_->stopping_.load(std::memory_order_relaxed); }
+        Doorbell& doorbell() { return doorbell_; }
+
+    private:
+        friend class HandoffStage;
+
+        const HandoffStage* stage_ = nullptr;
+        std::vector<std::unique_ptr<SpscRing<T>>> rings_;   // 每个生产者一个
+        size_t first_ = 0;
+        Doorbell doorbell_;
+        std::thread thread_;
+    };
+
+    using ConsumeFn = std::function<void(Inbox& inbox)>;
+
+    HandoffStage(unsigned producers, unsigned consumers, size_t ringCapacity, ConsumeFn consume)
+        : producers_(producers), consume_(std::move(consume))
+    {
+        for (unsigned c = 0; c < consumers; c++)
+        {
+            auto inbox = std::make_unique<Inbox>();
+            inbox->stage_ = this;
+            for (unsigned p = 0; p < producers; p++) inbox->rings_.push_back(std::make_unique<SpscRing<T>>(ringCapacity));
+            inboxes_.push_back(std::move(inbox));
+        }
+        for (auto& inbox : inboxes_) inbox->thread_ = std::thread([this, i = inbox.get()] { consume_(*i); });
+    }
+
+    ~HandoffStage()
+    {
+        stopping_.store(true, std::memory_order_relaxed);
+        for (auto& inbox : inboxes_)
+        {
+            inbox->doorbell_.wake();
+            inbox->thread_.join();
+        }
+    }
+
+    HandoffStage(const HandoffStage&) = delete;
+    HandoffStage& operator=(const HandoffStage&) = delete;
+
+    unsigned producers() const { return producers_; }
+    unsigned consumers() const { return static_cast<unsigned>(inboxes_.size()); }
+
+    /**
+     * 生产者 producer 提交一个元素（不阻塞）
+     *
+     * @return 对应的环已满时返回 false，value 仍归调用方，由调用方自己处理
+     *
+     * 退出时还留在环中的元素随环一起析构，不再交给消费者
+     */
+    bool submit(unsigned producer, uint64_t key, T&& value)
+    {
+        Inbox& inbox = *inboxes_[key % inboxes_.size()];
+        if (!inbox.rings_[producer]->push(std::move(value))) return false;
+        inbox.doorbell_.ring();
+        return true;
+    }
+
+private:
+    unsigned producers_;
+    ConsumeFn consume_;
+    std::vector<std::unique_ptr<Inbox>> inboxes_;
+    std::atomic<bool> stopping_{ false };
+};
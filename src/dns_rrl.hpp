@@ -0,0 +1,274 @@
+/**
+ * 响应限速（Response Rate Limiting, RRL）
+ *
+ * UDP 没有握手，攻击者可以伪造受害者的源地址发送查询，让服务器把（比查询大得多的）响应
+ * 发给受害者，形成反射 / 放大攻击。RRL 按“客户端网段 + 响应”计数：
+ *   键 = (客户端地址的前缀（IPv4 默认 /24，IPv6 默认 /56）, 响应的名字, 类型, RCODE)
+ *   - 正常客户端对同一个名字每秒只会问几次，远低于限额
+ *   - 伪造源地址的洪水会在同一个键上集中大量相同的响应，很快耗尽令牌
+ * 超出限额的响应：
+ *   - 每 slip 个中有 1 个改为发送空的截断响应（TC=1），真实客户端据此改用 TCP 重试，不会被完全拒绝服务
+ *     （按桶计数：一个桶的超限响应依次编号，编号 0, slip, 2*slip, ... 被截断，与其他客户端的流量无关）
+ *   - 其余直接丢弃（drop）
+ *
+ * NXDOMAIN 响应用 SOA 所在的区域名代替查询名做键（由调用方传入），
+ * 随机子域名（a1.example.com, a2.example.com, ...）因此共享同一个令牌桶。
+ *
+ * 令牌桶表：固定大小、无锁
+ *   每个槽是一个 std::atomic<uint64_t>，打包了整个桶的状态：
+ *
+ *   bit:  63  62       48 47                  24 23                   0
+ *        [用] [ slip 序号 ] [   上次补充的时刻    ] [       令牌数         ]
+ *         1    15 bit         24 bit（1/64 秒）       24 bit（1 个令牌 = 64 个单位）
+ *
+ *   - 键的哈希选槽；哈希到同一个槽的不同键共用同一个桶（令牌、补充时刻和 slip 序号），
+ *     所以碰撞只会让这些键的限速更严格，交替使用两个碰撞的键也无法绕过限速
+ *   - “用”位区分空槽（全 0）和令牌、时刻恰好都为 0 的桶
+ *   - 读取 -> 计算新状态 -> compare_exchange，失败时重试；没有锁，也不分配内存
+ *
+ * 补充规则（每个 tick = 1/64 秒补充 rate / 64 个令牌，即 rate 个单位），容量为 1 秒的令牌：
+ *   示例：rate = 5/s，容量 = 5 * 64 = 320 单位，每个响应消耗 64 单位
+ *     t = 0      连续 5 个响应：320 -> 0，第 6 个超限
+ *     t = 0.2s   经过 12.8 个 tick，补充 12 * 5 = 60 单位，仍不足 64，继续超限
+ *     t = 0.25s  16 个 tick，补充 80 单位，放行 1 个响应
+ */
+
+#pragma once
+
+#include <atomic>       // std::atomic 无锁令牌桶和计数器
+#include <chrono>       // std::chrono::steady_clock 令牌补充时刻
+#include <cstdint>      // uint8_t, uint32_t, uint64_t
+#include <cstdio>       // snprintf() 格式化统计信息
+#include <memory>       // std::unique_ptr 令牌桶数组
+#include <string>       // std::string 统计信息
+#include <cstring>      // memcpy() 读取 IPv6 前缀
+#include <netinet/in.h> // sockaddr_in / sockaddr_in6 客户端地址
+#include <arpa/inet.h>  // ntohl()
+
+#include "dns_hash.hpp"
+
+/**
+ * 限速配置
+ */
+struct RrlOptions
+{
+    uint32_t responsesPerSecond = 0;  // 每个键每秒允许的响应数，0 表示关闭 RRL
+    uint32_t slip = 2;                // 每 slip 个超限响应中发送 1 个 TC=1 截断响应，0 表示全部丢弃（最大 MAX_SLIP）
+    uint8_t ipv4PrefixLength = 24;    // IPv4 客户端地址按多长的前缀归为同一个网段
+    uint8_t ipv6PrefixLength = 56;    // IPv6 客户端的前缀长度（一个家庭 / 站点通常分到 /56）
+    size_t tableSize = 65536;         // 令牌桶数量（向上取整为 2 的幂）
+};
+
+/**
+ * 限速统计快照
+ */
+struct RrlStats
+{
+    uint64_t allowed = 0;   // 正常发送
+    uint64_t slipped = 0;   // 超限，改为发送截断响应
+    uint64_t dropped = 0;   // 超限，丢弃
+};
+
+class ResponseRateLimiter
+{
+public:
+    enum class Action : uint8_t
+    {
+        SEND,   // 正常发送
+        SLIP,   // 发送 TC=1 的空响应
+        DROP,   // 不发送
+    };
+
+    // 每秒的 tick 数；一个令牌 = TICKS_PER_SECOND 个单位
+    static constexpr uint64_t TICKS_PER_SECOND = 64;
+
+    // 令牌桶允许的最大速率（24 bit 的令牌字段要容纳 1 秒的令牌 = rate * 64 个单位）
+    static constexpr uint32_t MAX_RATE = (1u << 24) / TICKS_PER_SECOND - 1;
+
+    // slip 序号字段 15 bit
+    static constexpr uint32_t MAX_SLIP = (1u << 15) - 1;
+
+    explicit ResponseRateLimiter(const RrlOptions& options)
+        : options_(options)
+    {
+        if (options_.responsesPerSecond > MAX_RATE) options_.responsesPerSecond = MAX_RATE;
+        if (options_.slip > MAX_SLIP) options_.slip = MAX_SLIP;
+        if (options_.ipv4PrefixLength > 32) options_.ipv4PrefixLength = 32;
+        if (options_.ipv6PrefixLength > 128) options_.ipv6PrefixLength = 128;
+        if (!enabled()) return;
+
+        size_t slots = 1;
+        while (slots < options_.tableSize) slots <<= 1;
+        buckets_ = std::make_unique<std::atomic<uint64_t>[]>(slots);
+        mask_ = slots - 1;
+    }
+
+    bool enabled() const { return options_.responsesPerSecond != 0; }
+
+    const RrlOptions& options() const { return options_; }
+
+    /**
+     * 响应的键：名字的 Question 哈希（不区分大小写）与 RCODE
+     *
+     * @param nameHash 正向回答用 DNSQuestion::hash；NXDOMAIN 用区域名的 QuestionHash；
+     *                 没有 Question 的错误响应（FORMERR）传 0
+     * @param rcode 响应的 RCODE
+     */
+    static uint64_t responseKey(uint64_t nameHash, uint8_t rcode)
+    {
+        return nameHash ^ (static_cast<uint64_t>(rcode) * 0x9E3779B97F4A7C15ULL);
+    }
+
+    /**
+     * 为一个即将发送的响应扣除令牌
+     *
+     * @param client 客户端地址（IPv4 按 ipv4PrefixLength、IPv6 按 ipv6PrefixLength 截取前缀；
+     *               IPv4 映射的 IPv6 地址按 IPv4 处理）
+     * @param responseKey responseKey() 的结果
+     * @return 发送、截断或丢弃；未开启 RRL 时总是 SEND
+     */
+    Action check(const sockaddr* client, uint64_t responseKey)
+    {
+        if (!enabled()) return Action::SEND;
+
+        uint64_t key = mix(responseKey ^ QuestionHash::seed(), clientPrefix(client));
+
+        std::atomic<uint64_t>& bucket = buckets_[key & mask_];
+        uint64_t now = currentTick();
+        uint64_t capacity = static_cast<uint64_t>(options_.responsesPerSecond) * TICKS_PER_SECOND;
+
+        uint64_t old = bucket.load(std::memory_order_relaxed);
+        uint64_t updated;
+        Action action;
+        do
+        {
+            uint64_t tokens = capacity;
+            uint64_t last = now;
+            uint64_t sequence = (old >> 48) & SEQUENCE_MASK;
+            if ((old & OCCUPIED) != 0)
+            {
+                // 时刻字段 24 bit，约 73 小时回绕一次；回绕后的差值按无符号运算仍然正确
+                uint64_t elapsed = (now - ((old >> 24) & FIELD_MASK)) & FIELD_MASK;
+                tokens = old & FIELD_MASK;
+                last = (old >> 24) & FIELD_MASK;
+                if (elapsed > 0)
+                {
+                    uint64_t refill = elapsed >= TICKS_PER_SECOND ? capacity : elapsed * options_.responsesPerSecond;
+                    tokens = tokens + refill > capacity ? capacity : tokens + refill;
+                    last = now;
+                }
+            }
+
+            if (tokens >= TICKS_PER_SECOND)
+            {
+                action = Action::SEND;
+                tokens -= TICKS_PER_SECOND;
+            }
+            else if (options_.slip != 0)
+            {
+                // 本桶的第 sequence 个超限响应：序号为 0 的被截断，序号在 [0, slip) 中循环
+                action = sequence == 0 ? Action::SLIP : Action::DROP;
+                sequence = (sequence + 1) % options_.slip;
+            }
+            else
+            {
+                action = Action::DROP;
+            }
+            updated = OCCUPIED | (sequence << 48) | ((last & FIELD_MASK) << 24) | tokens;
+        } while (!bucket.compare_exchange_weak(old, updated, std::memory_order_relaxed));
+
+        switch (action)
+        {
+            case Action::SEND: allowed_.fetch_add(1, std::memory_order_relaxed); break;
+            case Action::SLIP: slipped_.fetch_add(1, std::memory_order_relaxed); break;
+            case Action::DROP: dropped_.fetch_add(1, std::memory_order_relaxed); break;
+        }
+        return action;
+    }
+
+    RrlStats stats() const
+    {
+        RrlStats stats;
+        stats.allowed = allowed_.load(std::memory_order_relaxed);
+        stats.slipped = slipped_.load(std::memory_order_relaxed);
+        stats.dropped = dropped_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    /**
+     * 格式化统计信息
+     *
+     * 示例：
+     *   rrl: allowed=120345 slipped=5012 dropped=5011
+     */
+    static std::string format(const RrlStats& stats)
+    {
+        char line[128];
+        snprintf(line, sizeof(line), "rrl: allowed=%llu slipped=%llu dropped=%llu",
+                 static_cast<unsigned long long>(stats.allowed), static_cast<unsigned long long>(stats.slipped),
+                 static_cast<unsigned long long>(stats.dropped));
+        return line;
+    }
+
+private:
+    static constexpr uint64_t FIELD_MASK = (1ULL << 24) - 1;
+    static constexpr uint64_t SEQUENCE_MASK = (1ULL << 15) - 1;
+    static constexpr uint64_t OCCUPIED = 1ULL << 63;
+
+    RrlOptions options_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;  // 全 0 表示空槽
+    size_t mask_ = 0;
+    std::atomic<uint64_t> allowed_{ 0 };
+    std::atomic<uint64_t> slipped_{ 0 };
+    std::atomic<uint64_t> dropped_{ 0 };
+
+    static uint64_t mix(uint64_t h, uint64_t value)
+    {
+        h ^= value * 0xC2B2AE3D27D4EB4FULL;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint32_t maskIpv4(uint32_t address, uint8_t length)
+    {
+        return length == 0 ? 0 : address & (~0u << (32 - length));
+    }
+
+    static uint64_t maskBits(uint64_t value, int length)
+    {
+        if (length <= 0) return 0;
+        return length >= 64 ? value : value & (~0ULL << (64 - length));
+    }
+
+    // 客户端网段（IPv6 前缀折叠成 64 位；与 IPv4 前缀用最高位区分，两者不会混在同一个桶里）
+    uint64_t clientPrefix(const sockaddr* client) const
+    {
+        if (client->sa_family == AF_INET6)
+        {
+            const in6_addr& address = reinterpret_cast<const sockaddr_in6*>(client)->sin6_addr;
+            if (IN6_IS_ADDR_V4MAPPED(&address))
+            {
+                uint32_t ipv4;
+                std::memcpy(&ipv4, address.s6_addr + 12, 4);
+                return maskIpv4(ntohl(ipv4), options_.ipv4PrefixLength);
+            }
+            uint64_t high = 0, low = 0;
+            for (int i = 0; i < 8; i++) high = (high << 8) | address.s6_addr[i];
+            for (int i = 8; i < 16; i++) low = (low << 8) | address.s6_addr[i];
+            high = maskBits(high, options_.ipv6PrefixLength);
+            low = maskBits(low, options_.ipv6PrefixLength - 64);
+            return mix(high, low) | (1ULL << 63);
+        }
+        uint32_t ipv4 = ntohl(reinterpret_cast<const sockaddr_in*>(client)->sin_addr.s_addr);
+        return maskIpv4(ipv4, options_.ipv4PrefixLength);
+    }
+
+    static uint64_t currentTick()
+    {
+        auto sinceStart = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(sinceStart).count()) * TICKS_PER_SECOND / 1000000;
+    }
+};
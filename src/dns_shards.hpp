@@ -0,0 +1,156 @@
+/**
+ * 按工作线程分片的缓存（--cache-shards N）
+ *
+ * 单个 DnsCache 由一把互斥锁保护，所有工作线程都在同一个锁和同一组 LRU 链表上写入：
+ * 核越多，锁和链表节点所在的缓存行在核之间来回传递得越频繁。
+ *
+ * 分片后每个分片是一个独立的 DnsCache（各自的锁、W-TinyLFU 段、频率草图和统计），
+ * 名字所属的分片 = 分流哈希 % N，与 steer=hash 选择工作线程的规则相同
+ * （哈希由解析器在复制标签时算好，保存在 DNSQuestion::shardHash 中，见 dns_hash.hpp）：
+ *
+ *   --listen 0.0.0.0:53,workers=4,cpus=0-3,steer=hash --cache-shards 4
+ *
+ *     查询 www.example.com -> nameHash % 4 = 2 -> 内核把报文交给工作线程 2 -> 只访问分片 2
+ *
+ * 这样每个分片只被一个工作线程（以及后台预取线程）访问，锁不会被争用，缓存行留在这个核上。
+ * 报文落在其他工作线程（没有 steer=hash 的监听器、eBPF 程序加载失败）时仍然正确，只是多一次跨核访问。
+ *
+ * 预算按分片数平分：--cache-size 64MiB --cache-shards 4 -> 每个分片 16 MiB。
+ * 快照仍是一个文件，加载时按名字重新分配，分片数可以与保存时不同。
+ *
+ * NUMA：构造时可以为每个分片指定节点，分片的表（频率草图等）在构造时分配并清零，放在该节点上；
+ * 之后插入的条目由插入它的线程分配（工作线程在自己的节点上，见 dns_numa.hpp）。
+ */
+
+#pragma once
+
+#include <cstdint>       // uint32_t
+#include <memory>        // std::unique_ptr
+#include <string>        // std::string
+#include <string_view>   // std::string_view
+#include <vector>        // std::vector
+
+#include "dns_cache.hpp"
+#include "dns_numa.hpp"
+#include "dns_steering.hpp"
+
+class ShardedCache
+{
+public:
+    /**
+     * @param options 整个缓存的配置（预算在分片之间平分）
+     * @param shards 分片数（至少 1）
+     * @param nodes 分片 i 所在的 NUMA 节点 nodes[i]（-1 或空表示不指定）
+     */
+    ShardedCache(const CacheOptions& options, unsigned shards, const std::vector<int>& nodes = {})
+    {
+        if (shards == 0) shards = 1;
+        CacheOptions shardOptions = options;
+        shardOptions.positiveBudget = options.positiveBudget / shards;
+        shardOptions.negativeBudget = options.negativeBudget / shards;
+        for (unsigned i = 0; i < shards; i++)
+        {
+            if (i < nodes.size()) NumaTopology::preferNode(nodes[i]);
+            shards_.push_back(std::make_unique<Shard>(shardOptions));
+        }
+        if (!nodes.empty()) NumaTopology::preferNode(-1);
+    }
+
+    unsigned shardCount() const { return static_cast<unsigned>(shards_.size()); }
+
+    /**
+     * 分流哈希所属的分片
+     *
+     * 查询路径使用解析器算好的 DNSQuestion::shardHash，不再扫描域名；
+     * 只有快照加载（从点分文本）才调用 ReuseportSteering::nameHash() 计算。
+     */
+    DnsCache& shardOf(uint32_t shardHash)
+    {
+        if (shards_.size() == 1) return shards_[0]->cache;
+        return shards_[shardHash % shards_.size()]->cache;
+    }
+
+    // 与 DnsCache 相同的接口，转给名字所属的分片
+    bool lookup(const DNSQuestion& question, CacheResult& result) { return shardOf(question.shardHash).lookup(question, result); }
+    bool serveStale(const DNSQuestion& question, CacheResult& result) { return shardOf(question.shardHash).serveStale(question, result); }
+    void prefetchFailed(const DNSQuestion& question) { shardOf(question.shardHash).prefetchFailed(question); }
+
+    void insertPositive(const DNSQuestion& question, const std::pmr::vector<DNSAnswer>& answers)
+    {
+        shardOf(question.shardHash).insertPositive(question, answers);
+    }
+
+    void insertNegative(const DNSQuestion& question, uint8_t rcode, const DNSAnswer& soa)
+    {
+        shardOf(question.shardHash).insertNegative(question, rcode, soa);
+    }
+
+    long saveSnapshot(const std::string& path, std::string& error) const
+    {
+        std::vector<const DnsCache*> caches;
+        for (const auto& shard : shards_) caches.push_back(&shard->cache);
+        return DnsCache::saveSnapshot(caches, path, error);
+    }
+
+    long loadSnapshot(const std::string& path, std::string& error)
+    {
+        return DnsCache::loadSnapshot(path, error, [this](std::string_view name) -> DnsCache& {
+            return shardOf(ReuseportSteering::nameHash(name));
+        });
+    }
+
+    // 所有分片的统计之和
+    CacheStats stats() const
+    {
+        CacheStats total;
+        for (const auto& shard : shards_)
+        {
+            CacheStats stats = shard->cache.stats();
+            for (int p = 0; p < 2; p++)
+            {
+                for (int s = 0; s < 3; s++) total.hits[p][s] += stats.hits[p][s];
+                total.used[p] += stats.used[p];
+                total.budget[p] += stats.budget[p];
+            }
+            total.staleHits += stats.staleHits;
+            total.misses += stats.misses;
+            total.prefetches += stats.prefetches;
+            total.admitted += stats.admitted;
+            total.rejected += stats.rejected;
+        }
+        return total;
+    }
+
+    /**
+     * 每个分片的查询次数（看负载是否均匀；只有一个分片时返回空字符串）
+     *
+     * 示例：
+     *   cache shards: lookups=25012 24870 25301 24817
+     */
+    std::string formatShards() const
+    {
+        if (shards_.size() == 1) return "";
+        std::string line = "cache shards: lookups=";
+        for (size_t i = 0; i < shards_.size(); i++)
+        {
+            CacheStats stats = shards_[i]->cache.stats();
+            uint64_t lookups = stats.staleHits + stats.misses;
+            for (int p = 0; p < 2; p++)
+            {
+                for (int s = 0; s < 3; s++) lookups += stats.hits[p][s];
+            }
+            line += (i == 0 ? "" : " ") + std::to_string(lookups);
+        }
+        return line;
+    }
+
+private:
+    // 每个分片独占缓存行：相邻分片的锁和计数器不会落在同一行里（伪共享）
+    struct alignas(64) Shard
+    {
+        DnsCache cache;
+        explicit Shard(const CacheOptions& options) : cache(options) {}
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
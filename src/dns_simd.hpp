@@ -0,0 +1,232 @@
+/**
+ * 域名标签的向量化处理（SSE2 / AVX2，其他平台使用标量实现）
+ *
+ * 解析器和缓存 / 区域查找键都要逐字节处理域名：
+ *   - 复制标签，同时检查其中是否含有 '.'（见 ParseError::DOT_IN_LABEL）
+ *   - 把域名转为 ASCII 小写（域名比较不区分大小写）
+ *   - 不区分大小写地比较域名（查找时确认哈希命中的条目）
+ * 这里一次处理 32 字节（AVX2）或 16 字节（SSE2），不足一个向量的尾部：
+ *   - 长度 >= 16 时，用一次与前面重叠的加载处理最后 16 字节（重复处理几个字节没有副作用）
+ *   - 长度 < 16 时逐字节处理
+ * 所有加载都在 [src, src + n) 之内，不会读越界。
+ *
+ * AVX2 在运行时检测（__builtin_cpu_supports），不需要用 -mavx2 编译整个程序。
+ *
+ * 小写转换的向量技巧（没有无符号字节比较，借助有符号溢出）：
+ *   t = x + (128 - 'A')          'A'..'Z' (65..90) 被映射到 128..153，即有符号的 -128..-103
+ *   mask = t < (-128 + 26)       只有大写字母满足；其他字节都落在 -102..127
+ *   x |= mask & 0x20             大写字母加上 0x20 变成小写
+ */
+
+#pragma once
+
+#include <cstddef>   // size_t
+#include <cstdint>   // uint8_t
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>  // SSE2 / AVX2 intrinsics
+#define DNS_SIMD_X86 1
+#endif
+
+struct LabelSimd
+{
+    /**
+     * 复制一个标签，并检查其中是否含有 '.'
+     *
+     * @param dst 目标（至少 n 字节，可以与 src 不同的任意位置）
+     * @param src 报文中的标签内容
+     * @param n 标签长度（0 ~ 63）
+     * @return 不含 '.' 时返回 true
+     *
+     * 示例：src = "www"    -> dst = "www",  true
+     *       src = "a.b"    -> dst = "a.b",  false（调用方丢弃整个域名）
+     */
+    static bool copyLabel(char* dst, const uint8_t* src, size_t n)
+    {
+#ifdef DNS_SIMD_X86
+        if (n >= 32 && hasAvx2()) return copyLabelAvx2(dst, src, n);
+        if (n >= 16) return copyLabelSse2(dst, src, n);
+#endif
+        bool clean = true;
+        for (size_t i = 0; i < n; i++)
+        {
+            dst[i] = static_cast<char>(src[i]);
+            clean &= src[i] != '.';
+        }
+        return clean;
+    }
+
+    /**
+     * ASCII 小写转换（只改变 'A'..'Z'，其他字节原样复制）
+     *
+     * @param dst 目标（至少 n 字节；可以与 src 相同，原地转换）
+     * @param src 源字符串
+     * @param n 长度
+     *
+     * 示例："WwW.Example.COM" -> "www.example.com"
+     */
+    static void toLower(char* dst, const char* src, size_t n)
+    {
+#ifdef DNS_SIMD_X86
+        if (n >= 32 && hasAvx2())
+        {
+            toLowerAvx2(dst, src, n);
+            return;
+        }
+        if (n >= 16)
+        {
+            toLowerSse2(dst, src, n);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; i++)
+        {
+            char c = src[i];
+            dst[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+        }
+    }
+
+    /**
+     * 比较任意大小写的 text 与已经是小写的 lowered（哈希命中后确认域名确实相同）
+     *
+     * @param lowered 小写字符串（缓存键、区域记录名）
+     * @param text 请求中的域名（保留原始大小写）
+     * @param n 长度（两者长度相同时才需要调用）
+     *
+     * 示例：lowered = "www.example.com", text = "WWW.Example.com" -> true
+     */
+    static bool equalsLower(const char* lowered, const char* text, size_t n)
+    {
+#ifdef DNS_SIMD_X86
+        if (n >= 16) return equalsLowerSse2(lowered, text, n);
+#endif
+        for (size_t i = 0; i < n; i++)
+        {
+            char c = text[i];
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c + ('a' - 'A'));
+            if (c != lowered[i]) return false;
+        }
+        return true;
+    }
+
+private:
+#ifdef DNS_SIMD_X86
+    static bool hasAvx2()
+    {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+
+    // ---------- SSE2（x86-64 的基线指令集，总是可用）----------
+
+    static __m128i lower16(__m128i v)
+    {
+        __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(128 - 'A')));
+        __m128i upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + 26)));
+        return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+    }
+
+    // n >= 16
+    static bool copyLabelSse2(char* dst, const uint8_t* src, size_t n)
+    {
+        const __m128i dot = _mm_set1_epi8('.');
+        __m128i found = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            found = _mm_or_si128(found, _mm_cmpeq_epi8(v, dot));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+        }
+        if (i < n)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + n - 16));
+            found = _mm_or_si128(found, _mm_cmpeq_epi8(v, dot));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + n - 16), v);
+        }
+        return _mm_movemask_epi8(found) == 0;
+    }
+
+    // n >= 16；dst == src 时最后一次重叠处理的字节已经是小写，再转换一次结果不变
+    static void toLowerSse2(char* dst, const char* src, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), lower16(v));
+        }
+        if (i < n)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + n - 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + n - 16), lower16(v));
+        }
+    }
+
+    // n >= 16；域名最多 255 字节，SSE2 已经足够，不再单独提供 AVX2 版本
+    static bool equalsLowerSse2(const char* lowered, const char* text, size_t n)
+    {
+        __m128i diff = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowered + i));
+            __m128i b = lower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i)));
+            diff = _mm_or_si128(diff, _mm_xor_si128(a, b));
+        }
+        if (i < n)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowered + n - 16));
+            __m128i b = lower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + n - 16)));
+            diff = _mm_or_si128(diff, _mm_xor_si128(a, b));
+        }
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) == 0xFFFF;
+    }
+
+    // ---------- AVX2（运行时检测到才调用）----------
+
+    __attribute__((target("avx2"))) static __m256i lower32(__m256i v)
+    {
+        __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8(static_cast<char>(128 - 'A')));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + 26)), shifted);
+        return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+    }
+
+    // n >= 32
+    __attribute__((target("avx2"))) static bool copyLabelAvx2(char* dst, const uint8_t* src, size_t n)
+    {
+        const __m256i dot = _mm256_set1_epi8('.');
+        __m256i found = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            found = _mm256_or_si256(found, _mm256_cmpeq_epi8(v, dot));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+        }
+        if (i < n)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + n - 32));
+            found = _mm256_or_si256(found, _mm256_cmpeq_epi8(v, dot));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + n - 32), v);
+        }
+        return _mm256_movemask_epi8(found) == 0;
+    }
+
+    // n >= 32
+    __attribute__((target("avx2"))) static void toLowerAvx2(char* dst, const char* src, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), lower32(v));
+        }
+        if (i < n)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + n - 32));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + n - 32), lower32(v));
+        }
+    }
+#endif
+};
@@ -0,0 +1,112 @@
+/**
+ * 频率草图（Count-Min Sketch）- W-TinyLFU 准入策略使用
+ *
+ * 用很小的固定内存近似记录“每个键最近被访问了多少次”：
+ *   - 4 行哈希，每个计数器 4 bit（最大 15），16 个计数器打包在一个 uint64_t 里
+ *   - 估计值取 4 行中的最小值（Count-Min：只会高估，不会低估）
+ *   - 累计增加 sampleSize 次之后，所有计数器减半（老化），
+ *     让“过去很热、现在已经冷了”的键逐渐失去优势
+ *
+ * 示例（一个 uint64_t 字 = 16 个 4-bit 计数器）：
+ *   bit:  63..60 59..56 ... 7..4 3..0
+ *         [c15]  [c14]  ... [c1] [c0]
+ *   某个键的哈希决定它在每一行使用哪个字，以及字内的哪个计数器。
+ */
+
+#pragma once
+
+#include <algorithm>   // std::min
+#include <cstddef>     // size_t
+#include <cstdint>     // uint64_t
+#include <memory_resource>  // std::pmr::memory_resource 表可以放在大页上
+#include <vector>      // std::pmr::vector
+
+class FrequencySketch
+{
+public:
+    /**
+     * @param expectedEntries 预计缓存的条目数（决定表的宽度）
+     * @param memory 表的内存（--huge-pages 时是缓存的大页资源）
+     */
+    explicit FrequencySketch(size_t expectedEntries, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : table_(memory)
+    {
+        size_t words = 1;
+        while (words < expectedEntries) words <<= 1;
+        table_.assign(words, 0);
+        mask_ = words - 1;
+        sampleSize_ = 10 * words;
+    }
+
+    /**
+     * 记录一次访问
+     *
+     * @param hash 键的 64 位哈希
+     */
+    void increment(uint64_t hash)
+    {
+        int start = static_cast<int>(hash & 3) << 2;
+        bool added = false;
+        for (int i = 0; i < 4; i++)
+        {
+            added |= incrementAt(indexOf(hash, i), start + i);
+        }
+        if (added && ++size_ >= sampleSize_) reset();
+    }
+
+    /**
+     * 估计访问频率（0 ~ 15）
+     */
+    int frequency(uint64_t hash) const
+    {
+        int start = static_cast<int>(hash & 3) << 2;
+        int frequency = 15;
+        for (int i = 0; i < 4; i++)
+        {
+            int offset = (start + i) << 2;
+            frequency = std::min(frequency, static_cast<int>((table_[indexOf(hash, i)] >> offset) & 0x0F));
+        }
+        return frequency;
+    }
+
+    // 草图本身占用的内存（计入缓存的内存上限）
+    size_t bytes() const { return table_.size() * sizeof(uint64_t); }
+
+private:
+    std::pmr::vector<uint64_t> table_;
+    size_t mask_;
+    size_t size_ = 0;         // 自上次老化以来的增加次数
+    size_t sampleSize_;       // 达到该次数后所有计数器减半
+
+    // 每一行使用不同的种子，把同一个哈希散列到不同的字
+    size_t indexOf(uint64_t hash, int row) const
+    {
+        static constexpr uint64_t SEEDS[4] = {
+            0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL
+        };
+        uint64_t h = (hash + SEEDS[row]) * SEEDS[row];
+        h += h >> 32;
+        return static_cast<size_t>(h) & mask_;
+    }
+
+    // 计数器 j（0 ~ 15）未饱和时加 1
+    bool incrementAt(size_t index, int j)
+    {
+        int offset = j << 2;
+        uint64_t mask = 0x0FULL << offset;
+        if ((table_[index] & mask) == mask) return false;
+        table_[index] += 1ULL << offset;
+        return true;
+    }
+
+    // 老化：所有计数器右移 1 位（减半）
+    //   & 0x7777... 清除从高一个计数器移过来的位
+    void reset()
+    {
+        for (auto& word : table_)
+        {
+            word = (word >> 1) & 0x7777777777777777ULL;
+        }
+        size_ /= 2;
+    }
+};
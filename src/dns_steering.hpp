@@ -0,0 +1,284 @@
+/**
+ * SO_REUSEPORT 分流程序（--listen ...,steer=cpu|hash）
+ *
+ * 一个监听器有多个工作线程时，每个线程一个 SO_REUSEPORT 套接字，内核默认按四元组哈希选择套接字：
+ * 报文在 CPU 0 上收到（网卡队列的中断在 CPU 0），却可能交给绑定在 CPU 3 上的工作线程，
+ * 套接字缓冲区、报文和缓存数据都要在核之间来回传递。
+ *
+ * 启动时加载一个 eBPF 程序（SO_ATTACH_REUSEPORT_EBPF），由它返回组内套接字的下标
+ * （下标 = 绑定顺序 = 工作线程编号 w）：
+ *
+ *   steer=cpu   选择绑定在收包 CPU 上的工作线程（bpf_get_smp_processor_id()）
+ *                 cpus=0-1, workers=4 -> CPU 0: 工作线程 0 / 2，CPU 1: 工作线程 1 / 3
+ *                 同一 CPU 上有多个工作线程时再按查询名的哈希（同 steer=hash）选择其中一个；
+ *                 没有工作线程的 CPU 交给同一 NUMA 节点上的工作线程（这些 CPU 轮流分配给节点上的工作线程，
+ *                 报文和套接字缓冲区不跨节点）；节点上也没有工作线程时返回无效下标，内核回退到默认的哈希选择。
+ *                 未指定 cpus 时视为工作线程 w 在 CPU w 上
+ *   steer=hash  按查询名选择（不区分大小写）：同一个名字总是交给同一个工作线程，
+ *                 该线程的 CPU 缓存里保留着这个名字的缓存条目
+ *                 哈希：FNV-1a 32 位，从 offset 12（Question 的 QNAME）开始逐字节 (b | 0x20)，
+ *                 到 0 字节（根标签）或报文结尾为止；工作线程 = hash % workers
+ *
+ * 程序由下面的代码直接生成 eBPF 指令（不依赖 libbpf / clang），用 bpf(BPF_PROG_LOAD) 加载。
+ * 需要 CAP_BPF（或 kernel.unprivileged_bpf_disabled = 0）；加载或挂载失败时调用方继续使用内核的哈希分流。
+ */
+
+#pragma once
+
+#include <algorithm>        // std::find
+#include <cerrno>           // errno
+#include <cstddef>          // offsetof
+#include <cstdint>          // uint32_t
+#include <cstring>          // strerror()
+#include <map>              // std::map 节点 -> 工作线程
+#include <string>           // std::string
+#include <string_view>      // std::string_view 点分域名
+#include <vector>           // std::vector 指令序列
+#include <linux/bpf.h>      // bpf_insn, BPF_PROG_LOAD, __sk_buff
+#include <linux/filter.h>   // BPF_LD / BPF_ABS 等指令编码
+#include <sys/socket.h>     // setsockopt(), SO_ATTACH_REUSEPORT_EBPF
+#include <sys/syscall.h>    // __NR_bpf
+#include <unistd.h>         // syscall(), close()
+
+#include "dns_hash.hpp"     // SteeringHash 与程序相同的查询名哈希
+
+enum class SteeringMode : uint8_t
+{
+    NONE,   // 内核默认的四元组哈希
+    CPU,    // 收包 CPU 上的工作线程
+    HASH,   // 按查询名
+};
+
+class ReuseportSteering
+{
+public:
+    static constexpr uint32_t FNV_OFFSET = SteeringHash::OFFSET;
+    static constexpr uint32_t FNV_PRIME = SteeringHash::PRIME;
+    static constexpr int MAX_NAME_BYTES = static_cast<int>(SteeringHash::MAX_NAME_BYTES);   // QNAME 的最大长度（含长度字节）
+
+    static bool parseMode(const std::string& text, SteeringMode& mode)
+    {
+        if (text == "cpu") mode = SteeringMode::CPU;
+        else if (text == "hash") mode = SteeringMode::HASH;
+        else if (text == "off") mode = SteeringMode::NONE;
+        else return false;
+        return true;
+    }
+
+    static const char* name(SteeringMode mode)
+    {
+        return mode == SteeringMode::CPU ? "cpu" : mode == SteeringMode::HASH ? "hash" : "off";
+    }
+
+    /**
+     * 与 steer=hash 程序相同的查询名哈希，从点分域名计算（见 dns_hash.hpp 的 SteeringHash）
+     *
+     * 示例："WWW.example.com" 与 "www.example.com" 的结果相同。
+     * 解析得到的 Question 已经带有这个哈希（DNSQuestion::shardHash），不必再调用它。
+     */
+    static uint32_t nameHash(std::string_view name)
+    {
+        return SteeringHash::of(name);
+    }
+
+    /**
+     * 生成分流程序，加载并挂到 udpSocket 所在的 reuseport 组
+     *
+     * @param udpSocket 组内任意一个已绑定的套接字（程序属于整个组）
+     * @param workers 组内的套接字数
+     * @param cpus 工作线程 w 绑定在 cpus[w % cpus.size()] 上；空表示没有绑定
+     * @param cpuNodes steer=cpu：下标 = CPU，值 = NUMA 节点（见 NumaTopology::cpuNodes()）；空表示不按节点回退
+     * @param error [输出] 失败原因，例如 "BPF_PROG_LOAD: Operation not permitted"
+     * @return 成功返回 true
+     */
+    static bool attach(int udpSocket, SteeringMode mode, int workers, const std::vector<int>& cpus,
+                       const std::vector<int>& cpuNodes, std::string& error)
+    {
+        std::vector<bpf_insn> program = mode == SteeringMode::CPU ? cpuProgram(workers, cpus, cpuNodes) : hashProgram(workers);
+
+        static const char license[] = "GPL";
+        char log[4096] = "";
+        bpf_attr attr{};
+        attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+        attr.insns = reinterpret_cast<uint64_t>(program.data());
+        attr.insn_cnt = static_cast<uint32_t>(program.size());
+        attr.license = reinterpret_cast<uint64_t>(license);
+        attr.log_buf = reinterpret_cast<uint64_t>(log);
+        attr.log_size = sizeof(log);
+        attr.log_level = 1;
+        int programFd = static_cast<int>(syscall(__NR_bpf, BPF_PROG_LOAD, &attr, sizeof(attr)));
+        if (programFd < 0)
+        {
+            // 第一次不带日志重试：日志缓冲区太小（ENOSPC）时加载本身也会失败
+            int loadErrno = errno;
+            attr.log_buf = 0;
+            attr.log_size = 0;
+            attr.log_level = 0;
+            programFd = static_cast<int>(syscall(__NR_bpf, BPF_PROG_LOAD, &attr, sizeof(attr)));
+            if (programFd < 0)
+            {
+                error = std::string("BPF_PROG_LOAD: ") + strerror(loadErrno);
+                if (loadErrno == EACCES && log[0] != '\0') error += std::string(" (") + log + ")";
+                return false;
+            }
+        }
+
+        // 组持有程序的引用，挂载后可以关闭自己的描述符
+        bool attached = setsockopt(udpSocket, SOL_SOCKET, SO_ATTACH_REUSEPORT_EBPF, &programFd, sizeof(programFd)) == 0;
+        if (!attached) error = std::string("SO_ATTACH_REUSEPORT_EBPF: ") + strerror(errno);
+        close(programFd);
+        return attached;
+    }
+
+private:
+    // 程序中用到的寄存器
+    static constexpr uint8_t R0 = BPF_REG_0;    // 返回值 / BPF_LD_ABS 的结果
+    static constexpr uint8_t R1 = BPF_REG_1;    // 入口时是 __sk_buff*；之后是临时值
+    static constexpr uint8_t R6 = BPF_REG_6;    // __sk_buff*（BPF_LD_ABS 要求放在 R6）
+    static constexpr uint8_t R8 = BPF_REG_8;    // 哈希
+    static constexpr uint8_t R9 = BPF_REG_9;    // 报文长度（UDP 载荷，内核已跳过 UDP 头）
+
+    static bpf_insn insn(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm)
+    {
+        bpf_insn instruction{};
+        instruction.code = code;
+        instruction.dst_reg = dst;
+        instruction.src_reg = src;
+        instruction.off = off;
+        instruction.imm = imm;
+        return instruction;
+    }
+
+    static bpf_insn aluImm(uint8_t op, uint8_t dst, int32_t imm) { return insn(BPF_ALU | op | BPF_K, dst, 0, 0, imm); }
+    static bpf_insn movReg(uint8_t dst, uint8_t src) { return insn(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0); }
+    static bpf_insn aluReg(uint8_t op, uint8_t dst, uint8_t src) { return insn(BPF_ALU | op | BPF_X, dst, src, 0, 0); }
+    static bpf_insn loadSkb(uint8_t dst, int16_t field) { return insn(BPF_LDX | BPF_W | BPF_MEM, dst, R6, field, 0); }
+    static bpf_insn jumpImm(uint8_t op, uint8_t dst, int32_t imm, int16_t skip) { return insn(BPF_JMP | op | BPF_K, dst, 0, skip, imm); }
+    static bpf_insn exit() { return insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0); }
+
+    /**
+     * steer=cpu
+     *
+     *   r6 = ctx; r8 = 查询名哈希（只在某个 CPU 上有多个工作线程时计算）
+     *   r0 = bpf_get_smp_processor_id()
+     *   if r0 != 0 goto next     ; CPU 0 上有工作线程 0 和 2
+     *   r1 = r8 % 2
+     *   if r1 != 0 goto +2
+     *   r0 = 0; exit
+     *   r0 = 2; exit
+     * next:
+     *   ...
+     *   if r0 != 5 goto +2       ; CPU 5 没有工作线程，与 CPU 0 在同一个节点上
+     *   r0 = 0; exit
+     *   ...
+     *   r0 = 0xffffffff; exit    ; 其他 CPU：无效下标，内核按哈希选择
+     */
+    static std::vector<bpf_insn> cpuProgram(int workers, const std::vector<int>& cpus, const std::vector<int>& cpuNodes)
+    {
+        auto cpuOf = [&](int w) { return cpus.empty() ? w : cpus[w % cpus.size()]; };
+        bool shared = false;   // 是否有 CPU 上绑定了多个工作线程
+        for (int w = 0; w < workers; w++)
+        {
+            for (int v = 0; v < w; v++) shared = shared || cpuOf(v) == cpuOf(w);
+        }
+
+        std::vector<bpf_insn> program;
+        program.push_back(movReg(R6, R1));
+        if (shared) hashName(program);
+        // 函数调用会覆盖 R1 - R5，R6 - R9 保持不变
+        program.push_back(insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_get_smp_processor_id));
+
+        std::vector<int> seen;
+        for (int w = 0; w < workers; w++)
+        {
+            int cpu = cpuOf(w);
+            bool done = false;
+            for (int s : seen) done = done || s == cpu;
+            if (done) continue;
+            seen.push_back(cpu);
+
+            std::vector<int> owners;   // 绑定在这个 CPU 上的工作线程
+            for (int v = w; v < workers; v++)
+            {
+                if (cpuOf(v) == cpu) owners.push_back(v);
+            }
+
+            std::vector<bpf_insn> block;
+            if (owners.size() > 1)
+            {
+                block.push_back(movReg(R1, R8));
+                block.push_back(aluImm(BPF_MOD, R1, static_cast<int32_t>(owners.size())));
+            }
+            for (size_t i = 0; i < owners.size(); i++)
+            {
+                if (i + 1 < owners.size()) block.push_back(jumpImm(BPF_JNE, R1, static_cast<int32_t>(i), 2));
+                block.push_back(aluImm(BPF_MOV, R0, owners[i]));
+                block.push_back(exit());
+            }
+            program.push_back(jumpImm(BPF_JNE, R0, cpu, static_cast<int16_t>(block.size())));
+            program.insert(program.end(), block.begin(), block.end());
+        }
+
+        // 没有工作线程的 CPU：依次分给同一节点上的工作线程
+        std::map<int, std::vector<int>> nodeWorkers;
+        for (int w = 0; w < workers; w++)
+        {
+            int cpu = cpuOf(w);
+            if (cpu >= 0 && cpu < static_cast<int>(cpuNodes.size()) && cpuNodes[cpu] >= 0) nodeWorkers[cpuNodes[cpu]].push_back(w);
+        }
+        std::map<int, size_t> next;
+        for (int cpu = 0; cpu < static_cast<int>(cpuNodes.size()); cpu++)
+        {
+            auto local = nodeWorkers.find(cpuNodes[cpu]);
+            if (local == nodeWorkers.end() || std::find(seen.begin(), seen.end(), cpu) != seen.end()) continue;
+            program.push_back(jumpImm(BPF_JNE, R0, cpu, 2));
+            program.push_back(aluImm(BPF_MOV, R0, local->second[next[cpuNodes[cpu]]++ % local->second.size()]));
+            program.push_back(exit());
+        }
+
+        program.push_back(aluImm(BPF_MOV, R0, -1));
+        program.push_back(exit());
+        return program;
+    }
+
+    // steer=hash：r0 = 查询名哈希 % workers
+    static std::vector<bpf_insn> hashProgram(int workers)
+    {
+        std::vector<bpf_insn> program;
+        program.push_back(movReg(R6, R1));
+        hashName(program);
+        program.push_back(movReg(R0, R8));
+        program.push_back(aluImm(BPF_MOD, R0, workers));
+        program.push_back(exit());
+        return program;
+    }
+
+    /**
+     * 查询名哈希（结果在 R8，要求 R6 = ctx），对每个 offset = 12, 13, ... 展开
+     * （不使用循环，旧内核的校验器也能接受）：
+     *
+     *   r9 = skb->len; r8 = FNV_OFFSET
+     *   if r9 <= offset goto done
+     *   r0 = byte[offset]
+     *   if r0 == 0 goto done
+     *   r8 = (r8 ^ (r0 | 0x20)) * FNV_PRIME
+     *   ...
+     * done:
+     */
+    static void hashName(std::vector<bpf_insn>& program)
+    {
+        constexpr int STEP = 6;   // 每个字节的指令数
+        program.push_back(loadSkb(R9, offsetof(__sk_buff, len)));
+        program.push_back(aluImm(BPF_MOV, R8, static_cast<int32_t>(FNV_OFFSET)));
+        for (int i = 0; i < MAX_NAME_BYTES; i++)
+        {
+            int16_t remaining = static_cast<int16_t>((MAX_NAME_BYTES - i) * STEP);   // 跳到 done 的距离
+            program.push_back(jumpImm(BPF_JLE, R9, 12 + i, static_cast<int16_t>(remaining - 1)));
+            program.push_back(insn(BPF_LD | BPF_B | BPF_ABS, 0, 0, 0, 12 + i));
+            program.push_back(jumpImm(BPF_JEQ, R0, 0, static_cast<int16_t>(remaining - 3)));
+            program.push_back(aluImm(BPF_OR, R0, 0x20));
+            program.push_back(aluReg(BPF_XOR, R8, R0));
+            program.push_back(aluImm(BPF_MUL, R8, static_cast<int32_t>(FNV_PRIME)));
+        }
+    }
+};
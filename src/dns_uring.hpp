@@ -0,0 +1,436 @@
+/**
+ * 基于 io_uring 的 UDP 收发（--io-engine uring）
+ *
+ * recvfrom() / sendto() 循环每个报文至少两次系统调用。io_uring 通过与内核共享的两个环形队列交换请求：
+ *   SQ（提交队列）：用户态写入请求（SQE），一次 io_uring_enter() 提交任意多个
+ *   CQ（完成队列）：内核写入结果（CQE），用户态直接读取，不需要系统调用
+ *
+ * 本引擎的用法：
+ *   1. 注册接收缓冲区环（IORING_REGISTER_PBUF_RING）：BUFFER_COUNT 个固定缓冲区，内核收包时自己挑一个
+ *   2. 提交一个 multishot recvmsg：一个 SQE 持续接收，每个报文产生一个 CQE，不需要每次重新提交
+ *   3. 每轮 io_uring_enter()：提交上一轮积累的全部 sendmsg，同时等待至少一个完成事件；
+ *      然后一次处理 CQ 中所有的报文，把处理完的缓冲区还给缓冲区环
+ *
+ *   稳定状态下每轮只有一次系统调用，无论这一轮收到和发出多少个报文。
+ *
+ * 接收缓冲区的布局（multishot recvmsg 的约定）：
+ *   [ io_uring_recvmsg_out (16) | 源地址 (sizeof(sockaddr_storage)) | 控制信息 (SO_RXQ_OVFL) | 载荷 (PAYLOAD_SIZE) ]
+ *   超过 PAYLOAD_SIZE（PacketPool::BUFFER_SIZE）的报文被截断，与 recvmsg() 循环和 batch 引擎相同。
+ *
+ * 发送：响应先复制到一个发送槽（SEND_SLOTS 个，槽里的 msghdr、地址和报文缓冲区在完成前保持有效，
+ * 缓冲区来自报文缓冲区池，完成后归还），
+ * 再放入 SQ，随下一次 io_uring_enter() 批量提交；槽用完时由调用方改用 sendto()。
+ *
+ * 需要 Linux 6.0+（multishot recvmsg）。不直接依赖 liburing，只用 <linux/io_uring.h> 和原始系统调用。
+ * 内核不支持（或被 io_uring_disabled 禁用）时 start() / run() 返回 false，调用方回退到 recvfrom() 循环。
+ */
+
+#pragma once
+
+#include <atomic>           // std::atomic_ref 访问共享环的 head / tail
+#include <cerrno>           // errno
+#include <cstdint>          // uint8_t, uint32_t, uint64_t
+#include <cstring>          // memset(), memcpy(), strerror()
+#include <iostream>         // std::cerr 发送失败
+#include <string>           // std::string 错误信息
+#include <vector>           // std::vector 发送槽
+#include <linux/io_uring.h> // io_uring_params, io_uring_sqe, io_uring_cqe, ...
+#include <sys/mman.h>       // mmap(), munmap()
+#include <sys/socket.h>     // msghdr
+#include <csignal>          // _NSIG
+#include <sys/syscall.h>    // __NR_io_uring_setup / enter / register
+#include <unistd.h>         // syscall(), close()
+
+#include "dns_address.hpp"
+#include "dns_hugepage.hpp"
+#include "dns_packet.hpp"
+#include "dns_listener.hpp"   // readDropCount()
+
+class UringUdpEngine
+{
+public:
+    static constexpr unsigned RING_ENTRIES = 256;     // SQ 大小（CQ 是它的两倍）
+    static constexpr unsigned BUFFER_COUNT = 256;     // 接收缓冲区数量（2 的幂）
+    static constexpr size_t PAYLOAD_SIZE = PacketPool::BUFFER_SIZE;  // 每个报文最多接收的字节数（与 recvmsg() 路径相同）
+    static constexpr unsigned SEND_SLOTS = 128;       // 同时在途的发送数
+    static constexpr long IDLE_WAKEUP_MS = 200;       // 没有报文时检查退出标志的间隔
+
+    /**
+     * @param packets 本线程的报文缓冲区（在途的发送）
+     * @param hugePages 接收缓冲区使用的页面
+     */
+    explicit UringUdpEngine(PacketPool::Cache& packets, HugePageMode hugePages = HugePageMode::OFF)
+        : packets_(packets), hugePages_(hugePages) {}
+    UringUdpEngine(const UringUdpEngine&) = delete;
+    UringUdpEngine& operator=(const UringUdpEngine&) = delete;
+
+    ~UringUdpEngine()
+    {
+        if (ringFd_ >= 0) close(ringFd_);
+        if (sqRing_ != MAP_FAILED) munmap(sqRing_, sqRingSize_);
+        if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+        if (sqes_ != MAP_FAILED) munmap(sqes_, sqesSize_);
+        if (bufferRing_ != MAP_FAILED) munmap(bufferRing_, BUFFER_COUNT * sizeof(io_uring_buf));
+    }
+
+    /**
+     * 创建环、注册接收缓冲区并提交 multishot recvmsg
+     *
+     * @param udpSocket 已绑定的 UDP 套接字
+     * @param error [输出] 失败原因（例如 "io_uring_setup: Function not implemented"）
+     * @return 成功返回 true
+     */
+    bool start(int udpSocket, std::string& error)
+    {
+        socket_ = udpSocket;
+
+        // 每个工作线程一个环，只有创建它的线程提交：SINGLE_ISSUER + DEFER_TASKRUN 让完成处理推迟到
+        // io_uring_enter(GETEVENTS) 时在本线程执行，不打断正在处理的报文；旧内核不认识这两个标志时去掉重试
+        io_uring_params params{};
+        params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+        ringFd_ = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+        if (ringFd_ < 0 && errno == EINVAL)
+        {
+            params = io_uring_params{};
+            ringFd_ = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+        }
+        if (ringFd_ < 0) return fail("io_uring_setup", error);
+
+        if (!mapRings(params, error)) return false;
+        if (!registerBuffers(error)) return false;
+
+        sendSlots_.resize(SEND_SLOTS);
+        for (unsigned i = 0; i < SEND_SLOTS; i++) freeSlots_.push_back(SEND_SLOTS - 1 - i);
+
+        std::memset(&recvTemplate_, 0, sizeof(recvTemplate_));
+        recvTemplate_.msg_namelen = sizeof(sockaddr_storage);
+        recvTemplate_.msg_controllen = CONTROL_SIZE;
+        return armReceive(error);
+    }
+
+    /**
+     * 事件循环
+     *
+     * @param onPacket onPacket(data, size, clientAddress)：处理一个报文（其中可以调用 send()）
+     * @param keepRunning 每轮之后检查，返回 false 时退出
+     * @param error [输出] 异常退出的原因
+     * @return keepRunning() 返回 false 正常退出时为 true；出错（包括内核不支持 multishot recvmsg）时为 false
+     */
+    template <class OnPacket, class KeepRunning>
+    bool run(OnPacket&& onPacket, KeepRunning&& keepRunning, std::string& error)
+    {
+        SocketAddress clientAddress;
+        while (true)
+        {
+            // 提交积累的 SQE（sendmsg / 重新提交的 recvmsg），并等待至少一个完成事件；
+            // 对 UDP 套接字 shutdown() 不会唤醒 multishot recvmsg，所以空闲时最多等待 IDLE_WAKEUP_MS 就检查一次 keepRunning()
+            __kernel_timespec timeout{};
+            timeout.tv_nsec = IDLE_WAKEUP_MS * 1000000LL;
+            io_uring_getevents_arg wait{};
+            wait.sigmask_sz = _NSIG / 8;
+            wait.ts = reinterpret_cast<uint64_t>(&timeout);
+            int submitted = static_cast<int>(syscall(__NR_io_uring_enter, ringFd_, pending_, 1,
+                                                     IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &wait, sizeof(wait)));
+            if (submitted < 0)
+            {
+                if (errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+                {
+                    return fail("io_uring_enter", error);
+                }
+            }
+            else
+            {
+                pending_ -= static_cast<unsigned>(submitted);
+            }
+
+            bool rearm = false;
+            unsigned head = load(cqHead_);
+            unsigned tail = load(cqTail_);
+            for (; head != tail; head++)
+            {
+                const io_uring_cqe& cqe = cqes_[head & cqMask_];
+                if (cqe.user_data != RECV_TAG)
+                {
+                    // 发送完成：归还报文缓冲区和发送槽
+                    if (cqe.res < 0) std::cerr << "Failed to send response: " << strerror(-cqe.res) << std::endl;
+                    sendSlots_[cqe.user_data].packet.reset();
+                    freeSlots_.push_back(static_cast<unsigned>(cqe.user_data));
+                    continue;
+                }
+
+                if (!(cqe.flags & IORING_CQE_F_MORE)) rearm = true;  // multishot 已结束，需要重新提交
+                if (cqe.res < 0)
+                {
+                    // ENOBUFS：缓冲区都在处理中，本轮归还后重新提交即可；其他错误（EINVAL 等）说明内核不支持
+                    if (cqe.res == -ENOBUFS) continue;
+                    store(cqHead_, head + 1);
+                    errno = -cqe.res;
+                    return fail("multishot recvmsg", error);
+                }
+                if (!(cqe.flags & IORING_CQE_F_BUFFER)) continue;  // 没有数据的完成（例如套接字已关闭）
+
+                unsigned bufferId = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                uint8_t* buffer = buffers_.data() + static_cast<size_t>(bufferId) * BUFFER_SIZE;
+                const io_uring_recvmsg_out* out = reinterpret_cast<const io_uring_recvmsg_out*>(buffer);
+                const uint8_t* name = buffer + sizeof(io_uring_recvmsg_out);
+                const uint8_t* control = name + recvTemplate_.msg_namelen;
+                const uint8_t* payload = control + recvTemplate_.msg_controllen;
+                size_t payloadSize = out->payloadlen < PAYLOAD_SIZE ? out->payloadlen : PAYLOAD_SIZE;
+
+                clientAddress.length = out->namelen < sizeof(sockaddr_storage) ? out->namelen : sizeof(sockaddr_storage);
+                std::memcpy(&clientAddress.storage, name, clientAddress.length);
+                if (out->controllen > 0)
+                {
+                    msghdr header{};
+                    header.msg_control = const_cast<uint8_t*>(control);
+                    header.msg_controllen = out->controllen;
+                    readDropCount(header, drops_);
+                }
+                onPacket(payload, payloadSize, clientAddress);
+
+                recycleBuffer(bufferId);
+            }
+            store(cqHead_, head);
+            publishBuffers();
+
+            if (!keepRunning()) return true;
+            if (rearm && !armReceive(error)) return false;
+        }
+    }
+
+    // 最近一个报文携带的 SO_RXQ_OVFL：套接字因接收队列满而丢弃的报文总数
+    uint32_t drops() const { return drops_; }
+
+    /**
+     * 把一个响应放入提交队列（下一次 io_uring_enter() 时发出）
+     *
+     * @return 没有空闲的发送槽（或响应超过一个报文缓冲区）时返回 false，调用方应直接 sendto()
+     */
+    bool send(const uint8_t* data, size_t size, const SocketAddress& clientAddress)
+    {
+        if (freeSlots_.empty() || size > PacketPool::BUFFER_SIZE) return false;
+        io_uring_sqe* sqe = nextSqe();
+        if (sqe == nullptr) return false;
+
+        unsigned index = freeSlots_.back();
+        freeSlots_.pop_back();
+        SendSlot& slot = sendSlots_[index];
+        slot.packet = packets_.acquire();
+        slot.packet.assign(data, size);
+        slot.address = clientAddress;
+        slot.iov.iov_base = slot.packet.data();
+        slot.iov.iov_len = size;
+        std::memset(&slot.msg, 0, sizeof(slot.msg));
+        slot.msg.msg_name = &slot.address.storage;
+        slot.msg.msg_namelen = slot.address.length;
+        slot.msg.msg_iov = &slot.iov;
+        slot.msg.msg_iovlen = 1;
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = socket_;
+        sqe->addr = reinterpret_cast<uint64_t>(&slot.msg);
+        sqe->len = 1;
+        sqe->user_data = index;
+        commitSqe();
+        return true;
+    }
+
+private:
+    static constexpr uint64_t RECV_TAG = ~0ULL;          // recvmsg 的 user_data；发送用槽号
+    static constexpr uint16_t BUFFER_GROUP = 0;
+    static constexpr size_t CONTROL_SIZE = CMSG_SPACE(sizeof(uint32_t));  // SO_RXQ_OVFL
+    static constexpr size_t BUFFER_SIZE = sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage) + CONTROL_SIZE + PAYLOAD_SIZE;
+
+    struct SendSlot
+    {
+        msghdr msg;
+        iovec iov;
+        SocketAddress address;
+        PacketPool::Packet packet;  // 发送完成前一直持有
+    };
+
+    int socket_ = -1;
+    int ringFd_ = -1;
+
+    void* sqRing_ = MAP_FAILED;
+    size_t sqRingSize_ = 0;
+    void* cqRing_ = MAP_FAILED;
+    size_t cqRingSize_ = 0;
+    void* sqes_ = MAP_FAILED;
+    size_t sqesSize_ = 0;
+
+    // SQ：用户态写 tail，内核写 head（两个指针都指向共享映射，用 load() / store() 访问）
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned sqEntries_ = 0;
+    unsigned sqLocalTail_ = 0;   // 下一个要填写的 SQE 位置
+    unsigned pending_ = 0;       // 已发布但还没有被 io_uring_enter() 提交的 SQE
+
+    // CQ：内核写 tail，用户态写 head
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    // 接收缓冲区环
+    io_uring_buf_ring* bufferRing_ = static_cast<io_uring_buf_ring*>(MAP_FAILED);
+    PacketPool::Cache& packets_;
+    HugePageMode hugePages_;
+    HugePageRegion buffers_;
+    unsigned short bufferTail_ = 0;
+
+    msghdr recvTemplate_{};
+    uint32_t drops_ = 0;
+    std::vector<SendSlot> sendSlots_;
+    std::vector<unsigned> freeSlots_;
+
+    static bool fail(const char* what, std::string& error)
+    {
+        error = std::string(what) + ": " + strerror(errno);
+        return false;
+    }
+
+    static unsigned* field(void* base, unsigned offset)
+    {
+        return reinterpret_cast<unsigned*>(static_cast<char*>(base) + offset);
+    }
+
+    // 与内核共享的 head / tail：读对方写的一端用 acquire，发布自己这一端用 release
+    static unsigned load(unsigned* shared)
+    {
+        return std::atomic_ref<unsigned>(*shared).load(std::memory_order_acquire);
+    }
+
+    static void store(unsigned* shared, unsigned value)
+    {
+        std::atomic_ref<unsigned>(*shared).store(value, std::memory_order_release);
+    }
+
+    bool mapRings(const io_uring_params& params, std::string& error)
+    {
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            // SQ 和 CQ 的控制结构在同一块映射里
+            sqRingSize_ = cqRingSize_ = sqRingSize_ > cqRingSize_ ? sqRingSize_ : cqRingSize_;
+        }
+
+        sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_,
+                       IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) return fail("mmap SQ ring", error);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            cqRing_ = sqRing_;
+        }
+        else
+        {
+            cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_,
+                           IORING_OFF_CQ_RING);
+            if (cqRing_ == MAP_FAILED) return fail("mmap CQ ring", error);
+        }
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_,
+                     IORING_OFF_SQES);
+        if (sqes_ == MAP_FAILED) return fail("mmap SQEs", error);
+
+        sqHead_ = field(sqRing_, params.sq_off.head);
+        sqTail_ = field(sqRing_, params.sq_off.tail);
+        sqMask_ = *field(sqRing_, params.sq_off.ring_mask);
+        sqEntries_ = params.sq_entries;
+        sqLocalTail_ = load(sqTail_);
+
+        // SQ 的间接数组固定为 i -> i：第 i 个 SQE 就放在 sqes_[i]
+        unsigned* array = field(sqRing_, params.sq_off.array);
+        for (unsigned i = 0; i < params.sq_entries; i++) array[i] = i;
+
+        cqHead_ = field(cqRing_, params.cq_off.head);
+        cqTail_ = field(cqRing_, params.cq_off.tail);
+        cqMask_ = *field(cqRing_, params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(cqRing_) + params.cq_off.cqes);
+        return true;
+    }
+
+    // 注册接收缓冲区环（内核 5.19+）；环本身必须按页对齐，所以单独 mmap
+    bool registerBuffers(std::string& error)
+    {
+        void* ring = mmap(nullptr, BUFFER_COUNT * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED) return fail("mmap buffer ring", error);
+        bufferRing_ = static_cast<io_uring_buf_ring*>(ring);
+
+        io_uring_buf_reg registration{};
+        registration.ring_addr = reinterpret_cast<uint64_t>(ring);
+        registration.ring_entries = BUFFER_COUNT;
+        registration.bgid = BUFFER_GROUP;
+        if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+        {
+            return fail("IORING_REGISTER_PBUF_RING", error);
+        }
+
+        buffers_ = HugePageRegion(BUFFER_COUNT * BUFFER_SIZE, hugePages_);
+        for (unsigned i = 0; i < BUFFER_COUNT; i++) recycleBuffer(i);
+        publishBuffers();
+        return true;
+    }
+
+    // 把缓冲区放回环中（publishBuffers() 之后内核才能看到）
+    // 注意：不能用 bufferRing_->bufs[i]：C++ 中 <linux/io_uring.h> 的柔性数组宏会引入一个空结构体成员，
+    // bufs 因此偏移 8 字节，最后一项越过映射的末尾；环的第 i 项就是按 io_uring_buf 大小计算的第 i 个位置
+    void recycleBuffer(unsigned bufferId)
+    {
+        io_uring_buf& entry = reinterpret_cast<io_uring_buf*>(bufferRing_)[bufferTail_ & (BUFFER_COUNT - 1)];
+        entry.addr = reinterpret_cast<uint64_t>(buffers_.data() + static_cast<size_t>(bufferId) * BUFFER_SIZE);
+        entry.len = BUFFER_SIZE;
+        entry.bid = static_cast<uint16_t>(bufferId);
+        bufferTail_++;
+    }
+
+    void publishBuffers()
+    {
+        std::atomic_ref<uint16_t>(bufferRing_->tail).store(bufferTail_, std::memory_order_release);
+    }
+
+    // 取一个空闲 SQE；SQ 已满时先把积累的 SQE 提交给内核
+    io_uring_sqe* nextSqe()
+    {
+        if (sqLocalTail_ - load(sqHead_) >= sqEntries_)
+        {
+            int submitted = static_cast<int>(syscall(__NR_io_uring_enter, ringFd_, pending_, 0, 0, nullptr, 0));
+            if (submitted > 0) pending_ -= static_cast<unsigned>(submitted);
+            if (sqLocalTail_ - load(sqHead_) >= sqEntries_) return nullptr;
+        }
+        io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + (sqLocalTail_ & sqMask_);
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    void commitSqe()
+    {
+        sqLocalTail_++;
+        pending_++;
+        store(sqTail_, sqLocalTail_);
+    }
+
+    // multishot recvmsg：IOSQE_BUFFER_SELECT 表示由内核从 BUFFER_GROUP 中挑选缓冲区
+    bool armReceive(std::string& error)
+    {
+        io_uring_sqe* sqe = nextSqe();
+        if (sqe == nullptr)
+        {
+            errno = EBUSY;
+            return fail("arm recvmsg", error);
+        }
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = socket_;
+        sqe->addr = reinterpret_cast<uint64_t>(&recvTemplate_);
+        sqe->len = 1;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->user_data = RECV_TAG;
+        commitSqe();
+        return true;
+    }
+};
@@ -0,0 +1,650 @@
+/**
+ * 权威区域（Zone）数据 - 加载与预渲染响应包
+ *
+ * 对于权威回答，同一个 (name, type) 的响应除了以下几处之外完全相同：
+ *   - Header 的 ID（必须与请求一致）
+ *   - Header 的 RD 位（从请求复制）
+ *   - Question 中域名的大小写（按请求原样回显）
+ *
+ * 因此在加载区域文件时，为每个 RRset 预先渲染好完整的响应包
+ * （Header 模板 + 压缩后的 Question + Answer + Additional），
+ * 命中时只需要一次 memcpy 再修补几个字节，不再构造 DNSAnswer 和调用 serialize()。
+ */
+
+#pragma once
+
+#include <cstdint>        // uint8_t, uint16_t, uint32_t
+#include <cstring>        // memcpy()
+#include <fstream>        // std::ifstream 读取区域文件
+#include <string>         // std::string
+#include <vector>         // std::vector
+#include <unordered_map>  // std::unordered_map 查找表
+#include <arpa/inet.h>    // inet_pton() 解析 A / AAAA 地址
+
+#include "dns_message.hpp"
+#include "dns_simd.hpp"
+
+/**
+ * 区域文件中的一条资源记录
+ *
+ * 含域名的 RDATA（NS / CNAME / PTR / MX）只保存目标域名，
+ * 渲染时再编码，这样目标域名也能参与名字压缩。
+ */
+struct ZoneRecord
+{
+    std::string name;             // 所有者域名（小写，无结尾的 '.'）
+    uint16_t type;                // 记录类型
+    uint32_t ttl;                 // 生存时间（秒）
+    uint16_t preference = 0;      // 仅 MX 使用：优先级
+    std::string target;           // NS / CNAME / PTR / MX 的目标域名
+    std::vector<uint8_t> rdata;   // 其他类型的原始 RDATA
+};
+
+/**
+ * 预渲染的响应包
+ *
+ * 包模板中 ID = 0、RD = 0，Question 域名为小写形式。
+ * 命中时：
+ *   1. memcpy 整个模板
+ *   2. 写入请求 ID（字节 0-1）
+ *   3. 复制请求的 RD 位（字节 2 的最低位）
+ *   4. 用请求中的原始域名字节覆盖 Question 域名（保留客户端的大小写）
+ *
+ * Answer 的所有者名都是指向偏移 12 的压缩指针（0xC00C），
+ * 所以第 4 步之后它们也会自动“回显”请求的大小写。
+ */
+struct PrecomputedResponse
+{
+    std::string name;             // 所有者域名（小写），查找时确认哈希命中
+    uint16_t type;                // 查询类型
+    std::vector<uint8_t> packet;  // 完整响应包
+    uint16_t qnameLength;         // Question 域名的线格式长度（从偏移 12 开始）
+};
+
+/**
+ * 一个已加载的权威区域
+ *
+ * 支持的区域文件语法（RFC 1035 主文件格式的常用子集）：
+ *   $ORIGIN example.com.
+ *   $TTL 300
+ *   @       IN  SOA  ns1 hostmaster ( 1 3600 600 86400 60 )
+ *   @       IN  NS   ns1
+ *   ns1     IN  A    192.0.2.1
+ *   www 60  IN  A    192.0.2.10
+ *           IN  AAAA 2001:db8::10     ; 行首空白表示沿用上一行的所有者名
+ *   mail    IN  MX   10 mx1
+ *   alias   IN  CNAME www
+ *   txt     IN  TXT  "hello" "world"
+ *
+ * 支持的类型：A, AAAA, NS, CNAME, PTR, MX, TXT, SOA
+ */
+class AuthZone
+{
+public:
+    // 记录类型常量（RFC 1035 / RFC 3596）
+    static constexpr uint16_t TYPE_A = 1;
+    static constexpr uint16_t TYPE_NS = 2;
+    static constexpr uint16_t TYPE_CNAME = 5;
+    static constexpr uint16_t TYPE_SOA = 6;
+    static constexpr uint16_t TYPE_PTR = 12;
+    static constexpr uint16_t TYPE_MX = 15;
+    static constexpr uint16_t TYPE_TXT = 16;
+    static constexpr uint16_t TYPE_AAAA = 28;
+    static constexpr uint16_t CLASS_IN = 1;
+
+    // 预渲染包的上限：不支持 EDNS 时 UDP 响应最多 512 字节
+    static constexpr size_t MAX_PACKET_SIZE = 512;
+
+    /**
+     * 加载区域文件并为每个 RRset 预渲染响应包
+     *
+     * @param path 区域文件路径
+     * @param error [输出] 失败时的错误描述（带行号）
+     * @return 成功返回 true
+     */
+    bool load(const std::string& path, std::string& error)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            error = "cannot open zone file " + path;
+            return false;
+        }
+
+        std::string origin;
+        uint32_t defaultTtl = 3600;
+        std::string lastOwner;
+        std::string line;
+        std::string pending;      // 括号跨行时累积的内容
+        int depth = 0;            // 当前未闭合的括号层数
+        int lineNo = 0;
+        int startLine = 0;
+
+        while (std::getline(file, line))
+        {
+            lineNo++;
+            line = stripComment(line);
+            if (depth == 0)
+            {
+                pending.clear();
+                startLine = lineNo;
+            }
+            for (char c : line)
+            {
+                if (c == '(') depth++;
+                else if (c == ')') depth--;
+            }
+            pending += line + ' ';
+            if (depth > 0) continue;
+
+            if (!parseLine(pending, origin, defaultTtl, lastOwner, error))
+            {
+                error = path + ":" + std::to_string(startLine) + ": " + error;
+                return false;
+            }
+        }
+
+        if (depth != 0)
+        {
+            error = path + ": unbalanced parentheses";
+            return false;
+        }
+
+        precompute();
+        return true;
+    }
+
+    /**
+     * 查找预渲染的响应包
+     *
+     * @param question 解析得到的 Question（域名任意大小写，只有 IN 类会命中）
+     * @return 命中返回预渲染包，否则返回 nullptr
+     *
+     * 直接用解析器算好的 question.hash 查表，不构造查找键；
+     * 命中后把域名与记录名（小写）比较一次，排除哈希碰撞。
+     */
+    const PrecomputedResponse* find(const DNSQuestion& question) const
+    {
+        if (question.qclass != CLASS_IN) return nullptr;
+
+        auto it = responses_.find(question.hash);
+        if (it == responses_.end()) return nullptr;
+
+        const PrecomputedResponse& response = it->second;
+        if (response.type != question.type || response.name.size() != question.name.size() ||
+            !LabelSimd::equalsLower(response.name.data(), question.name.data(), question.name.size()))
+        {
+            return nullptr;
+        }
+        return &response;
+    }
+
+    /**
+     * 用预渲染包生成最终响应
+     *
+     * @param response 预渲染包
+     * @param request 客户端请求（至少包含 Header 和第一个 Question 的域名）
+     * @param out [输出] 响应缓冲区（至少 response.packet.size() 字节）
+     * @return 响应长度
+     */
+    static size_t writeResponse(const PrecomputedResponse& response, const uint8_t* request, uint8_t* out)
+    {
+        std::memcpy(out, response.packet.data(), response.packet.size());
+
+        // ID（字节 0-1）：必须与请求一致
+        out[0] = request[0];
+        out[1] = request[1];
+
+        // RD 位（字节 2 的最低位）：从请求复制
+        out[2] |= request[2] & 0x01;
+
+        // 回显请求中的域名字节（长度相同，只有大小写可能不同）
+        std::memcpy(out + 12, request + 12, response.qnameLength);
+
+        return response.packet.size();
+    }
+
+    size_t recordCount() const { return records_.size(); }
+    size_t responseCount() const { return responses_.size(); }
+
+private:
+    std::vector<ZoneRecord> records_;
+    std::unordered_map<std::string, std::vector<size_t>> byName_;  // 域名 -> records_ 下标
+    // Question 哈希 (name, type, IN) -> 预渲染包；两个 (name, type) 哈希碰撞时只保留先出现的一个，
+    // 另一个查不到预渲染包，按普通查询处理（种子随机，64 位哈希几乎不会碰撞）
+    std::unordered_map<uint64_t, PrecomputedResponse> responses_;
+
+    static std::string toLowerAscii(const std::string& s)
+    {
+        std::string out = s;
+        LabelSimd::toLower(out.data(), out.data(), out.size());
+        return out;
+    }
+
+    // 去掉 ';' 之后的注释（引号内的 ';' 除外）
+    static std::string stripComment(const std::string& line)
+    {
+        bool quoted = false;
+        for (size_t i = 0; i < line.size(); i++)
+        {
+            if (line[i] == '"') quoted = !quoted;
+            else if (line[i] == ';' && !quoted) return line.substr(0, i);
+        }
+        return line;
+    }
+
+    // 按空白切分字段；引号内的内容作为一个字段（保留引号以便识别 TXT 字符串）
+    static std::vector<std::string> tokenize(const std::string& line)
+    {
+        std::vector<std::string> tokens;
+        size_t i = 0;
+        while (i < line.size())
+        {
+            char c = line[i];
+            if (c == ' ' || c == '\t' || c == '\r' || c == '(' || c == ')')
+            {
+                i++;
+                continue;
+            }
+            if (c == '"')
+            {
+                size_t end = line.find('"', i + 1);
+                if (end == std::string::npos) end = line.size();
+                tokens.push_back(line.substr(i, end - i + 1));
+                i = end + 1;
+                continue;
+            }
+            size_t start = i;
+            while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r' &&
+                   line[i] != '(' && line[i] != ')')
+            {
+                i++;
+            }
+            tokens.push_back(line.substr(start, i - start));
+        }
+        return tokens;
+    }
+
+    static bool isNumber(const std::string& s)
+    {
+        if (s.empty()) return false;
+        for (char c : s)
+        {
+            if (c < '0' || c > '9') return false;
+        }
+        return true;
+    }
+
+    // 把相对域名补全为绝对域名（小写、无结尾 '.'）
+    static std::string absoluteName(const std::string& name, const std::string& origin)
+    {
+        if (name == "@") return origin;
+        if (!name.empty() && name.back() == '.') return toLowerAscii(name.substr(0, name.size() - 1));
+        if (origin.empty()) return toLowerAscii(name);
+        return toLowerAscii(name) + "." + origin;
+    }
+
+    /**
+     * 检查 absoluteName() 的结果能否编码成线格式（RFC 1035 2.3.4）
+     *
+     * 示例："a..b.example.com" -> empty label；64 个 'a' -> label longer than 63 bytes；
+     * 线格式（每个标签加一个长度字节，再加结尾的 0）超过 255 字节 -> name longer than 255 bytes
+     *
+     * @param error [输出] 失败时的错误描述（行号由 load() 添加）
+     */
+    static bool checkName(const std::string& name, std::string& error)
+    {
+        if (name.empty()) return true;   // 根域名
+        size_t wireLength = 1;
+        size_t start = 0;
+        while (true)
+        {
+            size_t dot = name.find('.', start);
+            size_t length = (dot == std::string::npos ? name.size() : dot) - start;
+            if (length == 0) { error = "empty label in name " + name; return false; }
+            if (length > DNSQuestion::MAX_LABEL_LENGTH) { error = "label longer than 63 bytes in name " + name; return false; }
+            wireLength += length + 1;
+            if (dot == std::string::npos) break;
+            start = dot + 1;
+        }
+        if (wireLength > DNSQuestion::MAX_NAME_LENGTH) { error = "name longer than 255 bytes: " + name; return false; }
+        return true;
+    }
+
+    // 解析一条逻辑行（括号已合并）
+    bool parseLine(const std::string& line, std::string& origin, uint32_t& defaultTtl,
+                   std::string& lastOwner, std::string& error)
+    {
+        std::vector<std::string> tokens = tokenize(line);
+        if (tokens.empty()) return true;
+
+        // ---------- 指令 ----------
+        if (tokens[0] == "$ORIGIN")
+        {
+            if (tokens.size() < 2) { error = "$ORIGIN needs a name"; return false; }
+            origin = absoluteName(tokens[1].back() == '.' ? tokens[1] : tokens[1] + ".", "");
+            return checkName(origin, error);
+        }
+        if (tokens[0] == "$TTL")
+        {
+            if (tokens.size() < 2 || !isNumber(tokens[1])) { error = "$TTL needs a number"; return false; }
+            defaultTtl = static_cast<uint32_t>(std::stoul(tokens[1]));
+            return true;
+        }
+
+        // ---------- 资源记录：[owner] [ttl] [class] type rdata... ----------
+        size_t i = 0;
+        ZoneRecord record;
+        bool inheritsOwner = (line[0] == ' ' || line[0] == '\t');
+        if (inheritsOwner)
+        {
+            if (lastOwner.empty()) { error = "record without owner name"; return false; }
+            record.name = lastOwner;
+        }
+        else
+        {
+            record.name = absoluteName(tokens[i++], origin);
+            if (!checkName(record.name, error)) return false;
+            lastOwner = record.name;
+        }
+
+        record.ttl = defaultTtl;
+        // TTL 和 CLASS 顺序可以互换
+        for (int k = 0; k < 2 && i < tokens.size(); k++)
+        {
+            if (isNumber(tokens[i])) record.ttl = static_cast<uint32_t>(std::stoul(tokens[i++]));
+            else if (tokens[i] == "IN") i++;
+        }
+        if (i >= tokens.size()) { error = "missing record type"; return false; }
+
+        std::string type = tokens[i++];
+        std::vector<std::string> rdata(tokens.begin() + i, tokens.end());
+        if (!parseRdata(type, rdata, origin, record, error)) return false;
+
+        records_.push_back(record);
+        return true;
+    }
+
+    bool parseRdata(const std::string& type, const std::vector<std::string>& fields,
+                    const std::string& origin, ZoneRecord& record, std::string& error)
+    {
+        auto need = [&](size_t n) {
+            if (fields.size() >= n) return true;
+            error = type + " needs " + std::to_string(n) + " field(s)";
+            return false;
+        };
+
+        if (type == "A")
+        {
+            if (!need(1)) return false;
+            record.type = TYPE_A;
+            record.rdata.resize(4);
+            if (inet_pton(AF_INET, fields[0].c_str(), record.rdata.data()) != 1)
+            {
+                error = "bad IPv4 address " + fields[0];
+                return false;
+            }
+        }
+        else if (type == "AAAA")
+        {
+            if (!need(1)) return false;
+            record.type = TYPE_AAAA;
+            record.rdata.resize(16);
+            if (inet_pton(AF_INET6, fields[0].c_str(), record.rdata.data()) != 1)
+            {
+                error = "bad IPv6 address " + fields[0];
+                return false;
+            }
+        }
+        else if (type == "NS" || type == "CNAME" || type == "PTR")
+        {
+            if (!need(1)) return false;
+            record.type = type == "NS" ? TYPE_NS : (type == "CNAME" ? TYPE_CNAME : TYPE_PTR);
+            record.target = absoluteName(fields[0], origin);
+            if (!checkName(record.target, error)) return false;
+        }
+        else if (type == "MX")
+        {
+            if (!need(2)) return false;
+            if (!isNumber(fields[0])) { error = "bad MX preference"; return false; }
+            record.type = TYPE_MX;
+            record.preference = static_cast<uint16_t>(std::stoul(fields[0]));
+            record.target = absoluteName(fields[1], origin);
+            if (!checkName(record.target, error)) return false;
+        }
+        else if (type == "TXT")
+        {
+            if (!need(1)) return false;
+            record.type = TYPE_TXT;
+            for (const auto& field : fields)
+            {
+                std::string text = field;
+                if (text.size() >= 2 && text.front() == '"') text = text.substr(1, text.size() - 2);
+                if (text.size() > 255) { error = "TXT string longer than 255 bytes"; return false; }
+                record.rdata.push_back(static_cast<uint8_t>(text.size()));
+                record.rdata.insert(record.rdata.end(), text.begin(), text.end());
+            }
+        }
+        else if (type == "SOA")
+        {
+            // MNAME RNAME SERIAL REFRESH RETRY EXPIRE MINIMUM
+            if (!need(7)) return false;
+            record.type = TYPE_SOA;
+            for (int k = 0; k < 2; k++)
+            {
+                std::string name = absoluteName(fields[k], origin);
+                if (!checkName(name, error)) return false;
+                std::vector<uint8_t> encoded = DNSQuestion::encodeDomainName(name);
+                record.rdata.insert(record.rdata.end(), encoded.begin(), encoded.end());
+            }
+            for (int k = 2; k < 7; k++)
+            {
+                if (!isNumber(fields[k])) { error = "bad SOA number " + fields[k]; return false; }
+                uint32_t value = static_cast<uint32_t>(std::stoul(fields[k]));
+                record.rdata.push_back((value >> 24) & 0xFF);
+                record.rdata.push_back((value >> 16) & 0xFF);
+                record.rdata.push_back((value >> 8) & 0xFF);
+                record.rdata.push_back(value & 0xFF);
+            }
+        }
+        else
+        {
+            error = "unsupported record type " + type;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * 名字压缩表：记录已经写入包中的每个域名后缀及其偏移
+     *
+     * 示例：在偏移 12 写入 "www.example.com" 后，表中有
+     *   "www.example.com" -> 12
+     *   "example.com"     -> 16
+     *   "com"             -> 24
+     * 之后再写 "mail.example.com" 时只需写 \x04mail + 指针 0xC010。
+     */
+    using CompressionTable = std::unordered_map<std::string, uint16_t>;
+
+    static void writeName(std::vector<uint8_t>& packet, const std::string& name, CompressionTable& table)
+    {
+        std::string rest = name;
+        while (!rest.empty())
+        {
+            auto it = table.find(rest);
+            if (it != table.end())
+            {
+                packet.push_back(0xC0 | (it->second >> 8));
+                packet.push_back(it->second & 0xFF);
+                return;
+            }
+            // 指针只有 14 位，超出范围的位置不能作为压缩目标
+            if (packet.size() < 0x4000) table[rest] = static_cast<uint16_t>(packet.size());
+
+            size_t dot = rest.find('.');
+            std::string label = rest.substr(0, dot);
+            packet.push_back(static_cast<uint8_t>(label.size()));
+            packet.insert(packet.end(), label.begin(), label.end());
+            rest = (dot == std::string::npos) ? "" : rest.substr(dot + 1);
+        }
+        packet.push_back(0x00);
+    }
+
+    static void put16(std::vector<uint8_t>& packet, uint16_t value)
+    {
+        packet.push_back((value >> 8) & 0xFF);
+        packet.push_back(value & 0xFF);
+    }
+
+    static void put32(std::vector<uint8_t>& packet, uint32_t value)
+    {
+        put16(packet, static_cast<uint16_t>(value >> 16));
+        put16(packet, static_cast<uint16_t>(value & 0xFFFF));
+    }
+
+    // 写入一条资源记录；ownerPointer 非 0 时所有者名直接写压缩指针
+    static void writeRecord(std::vector<uint8_t>& packet, const ZoneRecord& record,
+                            CompressionTable& table, uint16_t ownerPointer)
+    {
+        if (ownerPointer != 0)
+        {
+            put16(packet, 0xC000 | ownerPointer);
+        }
+        else
+        {
+            writeName(packet, record.name, table);
+        }
+        put16(packet, record.type);
+        put16(packet, CLASS_IN);
+        put32(packet, record.ttl);
+
+        // RDLENGTH 先占位，写完 RDATA 后回填
+        size_t lengthPos = packet.size();
+        put16(packet, 0);
+        if (record.type == TYPE_MX) put16(packet, record.preference);
+        if (!record.target.empty())
+        {
+            writeName(packet, record.target, table);
+        }
+        else
+        {
+            packet.insert(packet.end(), record.rdata.begin(), record.rdata.end());
+        }
+        uint16_t rdlength = static_cast<uint16_t>(packet.size() - lengthPos - 2);
+        packet[lengthPos] = (rdlength >> 8) & 0xFF;
+        packet[lengthPos + 1] = rdlength & 0xFF;
+    }
+
+    std::vector<const ZoneRecord*> rrset(const std::string& name, uint16_t type) const
+    {
+        std::vector<const ZoneRecord*> result;
+        auto it = byName_.find(name);
+        if (it == byName_.end()) return result;
+        for (size_t index : it->second)
+        {
+            if (records_[index].type == type) result.push_back(&records_[index]);
+        }
+        return result;
+    }
+
+    /**
+     * 渲染一个 (name, type) 的完整响应包
+     *
+     * Answer 部分：
+     *   - 该名字下 type 类型的 RRset
+     *   - 若名字是 CNAME 且查询的不是 CNAME，则先放 CNAME，再沿区域内的链继续
+     * Additional 部分：
+     *   - NS / MX 目标在本区域内的 A / AAAA 记录（glue）
+     *
+     * @return 没有可回答的记录或包超过 512 字节时返回 false
+     */
+    bool render(const std::string& name, uint16_t type, PrecomputedResponse& out) const
+    {
+        std::vector<const ZoneRecord*> answers;
+        std::string current = name;
+        for (int hops = 0; hops < 8; hops++)
+        {
+            std::vector<const ZoneRecord*> found = rrset(current, type);
+            if (!found.empty())
+            {
+                answers.insert(answers.end(), found.begin(), found.end());
+                break;
+            }
+            std::vector<const ZoneRecord*> cname = rrset(current, TYPE_CNAME);
+            if (type == TYPE_CNAME || cname.empty()) break;
+            answers.push_back(cname[0]);
+            current = cname[0]->target;
+        }
+        if (answers.empty()) return false;
+
+        std::vector<const ZoneRecord*> additionals;
+        for (const ZoneRecord* answer : answers)
+        {
+            if (answer->type != TYPE_NS && answer->type != TYPE_MX) continue;
+            for (uint16_t glueType : { TYPE_A, TYPE_AAAA })
+            {
+                std::vector<const ZoneRecord*> glue = rrset(answer->target, glueType);
+                additionals.insert(additionals.end(), glue.begin(), glue.end());
+            }
+        }
+
+        std::vector<uint8_t>& packet = out.packet;
+        packet.clear();
+
+        // Header 模板：ID=0, QR=1, OPCODE=0, AA=1, RD=0（命中时修补）, RCODE=0
+        put16(packet, 0);
+        put16(packet, 0x8400);
+        put16(packet, 1);
+        put16(packet, static_cast<uint16_t>(answers.size()));
+        put16(packet, 0);
+        put16(packet, static_cast<uint16_t>(additionals.size()));
+
+        // Question
+        CompressionTable table;
+        writeName(packet, name, table);
+        out.qnameLength = static_cast<uint16_t>(packet.size() - 12);
+        put16(packet, type);
+        put16(packet, CLASS_IN);
+
+        for (const ZoneRecord* answer : answers)
+        {
+            // 与问题同名的记录直接指向偏移 12
+            writeRecord(packet, *answer, table, answer->name == name ? 12 : 0);
+        }
+        for (const ZoneRecord* additional : additionals)
+        {
+            writeRecord(packet, *additional, table, 0);
+        }
+
+        return packet.size() <= MAX_PACKET_SIZE;
+    }
+
+    // 为区域内出现过的每个 (name, type) 预渲染响应包
+    void precompute()
+    {
+        byName_.clear();
+        for (size_t i = 0; i < records_.size(); i++)
+        {
+            byName_[records_[i].name].push_back(i);
+        }
+
+        responses_.clear();
+        for (const auto& record : records_)
+        {
+            std::vector<uint16_t> types = { record.type };
+            // CNAME 所有者也要为常见地址类型预渲染（沿链回答）
+            if (record.type == TYPE_CNAME) types = { TYPE_CNAME, TYPE_A, TYPE_AAAA };
+
+            for (uint16_t type : types)
+            {
+                uint64_t key = QuestionHash::of(record.name, type, CLASS_IN);
+                if (responses_.count(key)) continue;
+
+                PrecomputedResponse response;
+                response.name = record.name;
+                response.type = type;
+                if (render(record.name, type, response)) responses_.emplace(key, std::move(response));
+            }
+        }
+    }
+};
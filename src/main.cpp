@@ -2,7 +2,7 @@
  * DNS 服务器 - C++ 实现
  * 
  * DNS (Domain Name System) 是互联网的"电话簿"，负责将域名转换为 IP 地址。
- * 本程序实现了一个基础的 DNS 服务器框架，监听 UDP 2053 端口。
+ * 本程序实现了一个基础的 DNS 服务器框架，默认监听 UDP 2053 端口（可用 --listen 指定多个地址）。
  * 
  * DNS 协议使用 UDP 作为传输层协议（也支持 TCP，但 UDP 更常用）。
  * 标准 DNS 端口是 53，这里使用 2053 是为了避免需要 root 权限。
@@ -16,755 +16,152 @@
 #include <arpa/inet.h>   // htons(), ntohs() 等网络字节序转换函数
 #include <vector>        // std::vector 动态数组
 #include <string>        // std::string 字符串
+#include <thread>        // std::jthread 周期性统计报告
+#include <condition_variable>  // std::condition_variable_any 可被中断的等待
+#include <csignal>       // sigaction(), pthread_sigmask() 优雅退出时保存缓存快照
+#include <cerrno>        // errno / EINTR
+#include <atomic>        // std::atomic<bool> 通知工作线程退出
+#include <pthread.h>     // pthread_setaffinity_np() 把工作线程绑定到 CPU
+#include <deque>         // std::deque 每个套接字的计数（元素地址不随扩容变化）
+#include <algorithm>     // std::find 监听器的 CPU 所在的 NUMA 节点
+#include <cctype>        // std::tolower 比较上游响应中的 Question
+#include <optional>      // std::optional 解析线程（--resolver-threads）
+#include <memory_resource>  // std::pmr::unsynchronized_pool_resource 解析线程的内存池
+#include <random>        // std::mt19937 转发给上游的查询 ID
+#include <chrono>        // std::chrono::steady_clock 等待上游响应的截止时间
+#include <poll.h>        // poll() 在截止时间之前等待上游响应
+
+#include "dns_message.hpp"  // DNSHeader / DNSQuestion / DNSAnswer / DNSMessage
+#include "dns_zone.hpp"     // 权威区域数据与预渲染响应包
+#include "dns_cache.hpp"    // 正向 / 否定响应缓存
+#include "dns_shards.hpp"   // 按工作线程分片的缓存
+#include "dns_prefetch.hpp" // 热门条目的后台预取
+#include "dns_arena.hpp"    // 每个请求的内存池
+#include "dns_rrl.hpp"      // 响应限速（RRL）
+#include "dns_acl.hpp"      // 按客户端地址的访问控制
+#include "dns_address.hpp"  // IPv4 / IPv6 套接字地址
+#include "dns_listener.hpp" // --listen 监听器配置与监听套接字
+#include "dns_uring.hpp"    // --io-engine uring：io_uring 批量收发
+#include "dns_batch.hpp"    // --io-engine batch：recvmmsg / sendmmsg + UDP GRO / GSO
+#include "dns_ring.hpp"     // --resolver-threads：工作线程与解析线程之间的无锁队列
+#include "dns_coro.hpp"     // --resolver-threads：解析线程中的协程与 epoll 事件循环
+#include "dns_numa.hpp"     // NUMA 拓扑：工作线程、缓冲区和缓存分片放在同一个节点上
+#include "dns_hugepage.hpp" // --huge-pages：缓存和接收缓冲区使用 2 MiB 大页
+#include "dns_packet.hpp"   // 报文缓冲区池：交给解析线程的请求、上游的响应、在途的发送
 
 /**
- * DNS 消息头结构体（12 字节）
- * 
- * DNS Header 格式（RFC 1035）：
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                      ID                       |  16 bits
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |QR|   OPCODE  |AA|TC|RD|RA|   Z    |   RCODE   |  16 bits
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                    QDCOUNT                    |  16 bits
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                    ANCOUNT                    |  16 bits
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                    NSCOUNT                    |  16 bits
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                    ARCOUNT                    |  16 bits
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
+ * 一次上游转发的结果
  */
-struct DNSHeader 
+struct ForwardResult
 {
-    uint16_t id;        // 包标识符，响应必须与查询相同
-    
-    // |QR(1)|OPCODE(4)|AA(1)|TC(1)|RD(1)|RA(1)|Z(3)|RCODE(4)|
-    // |  1  |  0000   |  0  |  0  |  0  |  0  | 000|  0000  |
-    // 第二个 16 位字段包含多个标志位
-    uint16_t flags;     // QR(1) + OPCODE(4) + AA(1) + TC(1) + RD(1) + RA(1) + Z(3) + RCODE(4)
-    
-    uint16_t qdcount;   // Question Count: 问题部分的条目数
-    uint16_t ancount;   // Answer Count: 回答部分的记录数
-    uint16_t nscount;   // Authority Count: 授权部分的记录数
-    uint16_t arcount;   // Additional Count: 附加部分的记录数
-    
-    /**
-     * 从字节数组解析 DNS Header（反序列化）
-     * 
-     * @param data 原始字节数据（至少 12 字节）
-     * @return 解析后的 DNSHeader
-     * 
-     * ============================================================
-     * 完整解析示例：假设收到以下 12 字节的 DNS 请求头
-     * ============================================================
-     * 
-     * 原始字节（十六进制）：
-     *   索引:  [0]   [1]   [2]   [3]   [4]   [5]   [6]   [7]   [8]   [9]  [10]  [11]
-     *   数据:  0x04  0xD2  0x01  0x00  0x00  0x01  0x00  0x00  0x00  0x00  0x00  0x00
-     *          |--ID---|  |-flags-|  |qdcount|  |ancount|  |nscount|  |arcount|
-     * 
-     * ---------- 1. 解析 ID（字节 0-1）----------
-     * 
-     *   data[0] = 0x04 = 0000 0100
-     *   data[1] = 0xD2 = 1101 0010
-     * 
-     *   计算过程：(data[0] << 8) | data[1]
-     *   
-     *   步骤 1: data[0] << 8
-     *           0x04 << 8 = 0x0400
-     *           二进制: 0000 0100 0000 0000
-     *   
-     *   步骤 2: | data[1]
-     *           0x0400 | 0xD2 = 0x04D2
-     *           二进制: 0000 0100 0000 0000
-     *                 | 0000 0000 1101 0010
-     *                 = 0000 0100 1101 0010
-     *   
-     *   结果: id = 0x04D2 = 1234
-     * 
-     * ---------- 2. 解析 Flags（字节 2-3）----------
-     * 
-     *   data[2] = 0x01 = 0000 0001
-     *   data[3] = 0x00 = 0000 0000
-     * 
-     *   计算过程：(data[2] << 8) | data[3]
-     *   
-     *   步骤 1: data[2] << 8
-     *           0x01 << 8 = 0x0100
-     *   
-     *   步骤 2: | data[3]
-     *           0x0100 | 0x00 = 0x0100
-     *   
-     *   结果: flags = 0x0100 = 0000 0001 0000 0000
-     *   
-     *   Flags 位布局（从高位到低位）：
-     *   |QR|  OPCODE |AA|TC|RD|RA|  Z  | RCODE |
-     *   |15| 14-11   |10| 9| 8| 7| 6-4 |  3-0  |
-     *   | 0| 0 0 0 0 | 0| 0| 1| 0| 0 0 0| 0 0 0 0|
-     *   
-     *   解析各字段：
-     *     - QR     = (0x0100 >> 15) & 0x01 = 0  （这是查询）
-     *     - OPCODE = (0x0100 >> 11) & 0x0F = 0  （标准查询）
-     *     - AA     = (0x0100 >> 10) & 0x01 = 0  （非权威）
-     *     - TC     = (0x0100 >> 9)  & 0x01 = 0  （未截断）
-     *     - RD     = (0x0100 >> 8)  & 0x01 = 1  （期望递归）
-     *     - RA     = (0x0100 >> 7)  & 0x01 = 0  （不支持递归）
-     *     - Z      = (0x0100 >> 4)  & 0x07 = 0  （保留）
-     *     - RCODE  = 0x0100 & 0x0F = 0          （无错误）
-     * 
-     * ---------- 3. 解析 QDCOUNT（字节 4-5）----------
-     * 
-     *   data[4] = 0x00, data[5] = 0x01
-     *   qdcount = (0x00 << 8) | 0x01 = 0x0001 = 1
-     *   含义：有 1 个问题
-     * 
-     * ---------- 4. 解析 ANCOUNT（字节 6-7）----------
-     * 
-     *   data[6] = 0x00, data[7] = 0x00
-     *   ancount = (0x00 << 8) | 0x00 = 0x0000 = 0
-     *   含义：有 0 个回答（查询请求通常为 0）
-     * 
-     * ---------- 5. 解析 NSCOUNT（字节 8-9）----------
-     * 
-     *   data[8] = 0x00, data[9] = 0x00
-     *   nscount = 0
-     * 
-     * ---------- 6. 解析 ARCOUNT（字节 10-11）----------
-     * 
-     *   data[10] = 0x00, data[11] = 0x00
-     *   arcount = 0
-     * 
-     * ============================================================
-     * 最终解析结果
-     * ============================================================
-     *   id      = 1234   (0x04D2)
-     *   flags   = 256    (0x0100) -> QR=0, OPCODE=0, RD=1
-     *   qdcount = 1      (1 个问题)
-     *   ancount = 0      (0 个回答)
-     *   nscount = 0
-     *   arcount = 0
-     */
-    static DNSHeader parse(const uint8_t* data)
-    {
-        DNSHeader header;
-        
-        // ID（2 字节，大端序）: 高字节在前，低字节在后
-        // 示例: [0x04, 0xD2] -> (0x04 << 8) | 0xD2 = 0x04D2 = 1234
-        header.id = (static_cast<uint16_t>(data[0]) << 8) | data[1];
-        
-        // Flags（2 字节，大端序）
-        // 示例: [0x01, 0x00] -> (0x01 << 8) | 0x00 = 0x0100
-        header.flags = (static_cast<uint16_t>(data[2]) << 8) | data[3];
-        
-        // QDCOUNT（2 字节）
-        // 示例: [0x00, 0x01] -> 1
-        header.qdcount = (static_cast<uint16_t>(data[4]) << 8) | data[5];
-        
-        // ANCOUNT（2 字节）
-        header.ancount = (static_cast<uint16_t>(data[6]) << 8) | data[7];
-        
-        // NSCOUNT（2 字节）
-        header.nscount = (static_cast<uint16_t>(data[8]) << 8) | data[9];
-        
-        // ARCOUNT（2 字节）
-        header.arcount = (static_cast<uint16_t>(data[10]) << 8) | data[11];
-        
-        return header;
-    }
-    
-    /**
-     * 从 flags 中提取 OPCODE（4 bits，位 14-11）
-     * 
-     * Flags 位布局: |QR(15)|OPCODE(14-11)|AA(10)|TC(9)|RD(8)|RA(7)|Z(6-4)|RCODE(3-0)|
-     * 
-     * 提取示例（flags = 0x0100 = 0000 0001 0000 0000）：
-     *   步骤 1: flags >> 11
-     *           0000 0001 0000 0000 >> 11 = 0000 0000 0000 0000 = 0
-     *   步骤 2: & 0x0F (保留低 4 位)
-     *           0 & 0x0F = 0
-     *   结果: OPCODE = 0 (标准查询)
-     * 
-     * 另一示例（flags = 0x7800，OPCODE=15）：
-     *   0111 1000 0000 0000 >> 11 = 0000 0000 0000 1111 = 15
-     *   15 & 0x0F = 15
-     */
-    uint8_t getOpcode() const { return (flags >> 11) & 0x0F; }
-    
-    /**
-     * 从 flags 中提取 RD（1 bit，位 8）
-     * 
-     * 提取示例（flags = 0x0100 = 0000 0001 0000 0000）：
-     *   步骤 1: flags >> 8
-     *           0000 0001 0000 0000 >> 8 = 0000 0000 0000 0001 = 1
-     *   步骤 2: & 0x01 (保留最低 1 位)
-     *           1 & 0x01 = 1
-     *   结果: RD = 1 (期望递归查询)
-     */
-    uint8_t getRD() const { return (flags >> 8) & 0x01; }
-    
-    /**
-     * 将 DNS Header 序列化为字节数组（网络字节序，大端）
-     * 
-     * 大端序 vs 小端序示例（以 id = 1234 = 0x04D2 为例）：
-     *   - 大端序（网络字节序）: [0x04, 0xD2] 高位字节在前，人类阅读顺序
-     *   - 小端序（x86 架构）:   [0xD2, 0x04] 低位字节在前
-     * 
-     * 网络协议统一使用大端序，所以需要转换。
-     * 
-     * 序列化后的 12 字节数组布局：
-     *   索引:  [0]   [1]   [2]   [3]   [4]   [5]   [6]   [7]   [8]   [9]  [10]  [11]
-     *   字段:  |--ID---|  |-flags-|  |qdcount|  |ancount|  |nscount|  |arcount|
-     *   示例:  0x04  0xD2  0x80  0x00  0x00  0x00  0x00  0x00  0x00  0x00  0x00  0x00
-     *         (id=1234)  (QR=1)   (0)       (0)       (0)       (0)
-     */
-    std::vector<uint8_t> serialize() const 
-    {
-        // 创建 12 字节的数组，所有元素初始化为 0
-        // DNS Header 固定 12 字节: ID(2) + Flags(2) + QDCOUNT(2) + ANCOUNT(2) + NSCOUNT(2) + ARCOUNT(2)
-        std::vector<uint8_t> bytes(12);
-        
-        // ========== ID（16 bits）- 转换为大端序 ==========
-        // 示例: id = 1234 = 0x04D2
-        // 
-        // 提取高字节 (id >> 8) & 0xFF:
-        //   1. id = 0x04D2 = 0000 0100 1101 0010 (二进制)
-        //   2. id >> 8     = 0000 0000 0000 0100 (右移8位，高8位移到低8位)
-        //   3. & 0xFF      = 0000 0000 0000 0100 = 0x04 (掩码保留低8位)
-        // 
-        // 提取低字节 id & 0xFF:
-        //   1. id = 0x04D2 = 0000 0100 1101 0010 (二进制)
-        //   2. & 0xFF      = 0000 0000 1101 0010 = 0xD2 (掩码保留低8位)
-        // 
-        // 结果: bytes[0]=0x04, bytes[1]=0xD2 (大端序：高字节在前)
-        bytes[0] = (id >> 8) & 0xFF;   // 高字节: 右移8位取高8位
-        bytes[1] = id & 0xFF;          // 低字节: 直接取低8位
-        
-        // ========== Flags（16 bits）- 转换为大端序 ==========
-        // 示例: flags = 0x8000 (QR=1, 其余为0)
-        //   bytes[2] = (0x8000 >> 8) & 0xFF = 0x80
-        //   bytes[3] = 0x8000 & 0xFF = 0x00
-        bytes[2] = (flags >> 8) & 0xFF;
-        bytes[3] = flags & 0xFF;
-        
-        // ========== QDCOUNT（16 bits）==========
-        bytes[4] = (qdcount >> 8) & 0xFF;
-        bytes[5] = qdcount & 0xFF;
-        
-        // ========== ANCOUNT（16 bits）==========
-        bytes[6] = (ancount >> 8) & 0xFF;
-        bytes[7] = ancount & 0xFF;
-        
-        // ========== NSCOUNT（16 bits）==========
-        bytes[8] = (nscount >> 8) & 0xFF;
-        bytes[9] = nscount & 0xFF;
-        
-        // ========== ARCOUNT（16 bits）==========
-        bytes[10] = (arcount >> 8) & 0xFF;
-        bytes[11] = arcount & 0xFF;
-        
-        return bytes;
-    }
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    bool ok = false;                        // 是否收到了上游响应
+    uint8_t rcode = 0;                      // 上游响应的 RCODE（0 = NOERROR, 3 = NXDOMAIN）
+    std::pmr::vector<DNSAnswer> answers;    // Answer 部分的全部记录
+    bool hasSoa = false;                    // Authority 部分是否带有 SOA
+    DNSAnswer soa;                          // 否定回答中的 SOA 记录
+
+    explicit ForwardResult(const allocator_type& alloc = {}) : answers(alloc), soa(alloc) {}
 };
 
 /**
- * DNS Question 结构体
- * 
- * Question Section 格式：
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                     NAME                      |  变长，域名编码
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                     TYPE                      |  16 bits，记录类型
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                     CLASS                     |  16 bits，记录类别
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * 
- * 域名编码示例：
- *   "codecrafters.io" 编码为：
- *   \x0c codecrafters \x02 io \x00
- *   ^^^^ ^^^^^^^^^^^^  ^^^  ^^  ^^
- *   长度12  标签内容   长度2 标签 结束符
- * 
- *   完整字节序列: 0x0C 63 6F 64 65 63 72 61 66 74 65 72 73 02 69 6F 00
- *                     c  o  d  e  c  r  a  f  t  e  r  s     i  o
+ * 解析上游的响应报文（forwardQuery() 与解析线程的协程共用）
+ *
+ * 任何解析错误都按上游失败处理：result.ok 保持 false，不缓存畸形数据。
+ * TC=1（截断：记录不完整，没有 Answer 时还会被当成 NODATA）同样按失败处理。
+ * ID、QR=1 和 Question 由接收方在调用之前确认（matchesForwardRequest() / UpstreamClient::receive()）
  */
-struct DNSQuestion 
+ForwardResult parseForwardResponse(const uint8_t* responseData, size_t responseSize,
+                                   const ForwardResult::allocator_type& alloc = {})
 {
-    std::string name;    // 域名（如 "codecrafters.io"）
-    uint16_t type;       // 记录类型（1 = A 记录，5 = CNAME 等）
-    uint16_t qclass;     // 记录类别（1 = IN，互联网）
+    ForwardResult result(alloc);
+    DNSHeader responseHeader;
+    ParseError error = DNSHeader::parse(responseData, responseSize, responseHeader);
+    if (error == ParseError::NONE && (responseHeader.flags & 0x0200) != 0)
+    {
+        std::cerr << "Truncated response from resolver (TC=1), not cached" << std::endl;
+        return result;
+    }
+    
+    // 跳过 Header 和 Question 部分，解析 Answer
+    size_t offset = 12;  // Header 大小
     
-    /**
-     * 从字节数组解析 DNS Question（反序列化）- 支持压缩
-     * 
-     * @param data 原始字节数据（完整的 DNS 消息，从头开始）
-     * @param offset [输入/输出] 当前解析位置，解析完成后更新为下一个位置
-     * @return 解析后的 DNSQuestion
-     * 
-     * ============================================================
-     * DNS 消息压缩机制（RFC 1035 Section 4.1.4）
-     * ============================================================
-     * 
-     * 压缩原理：
-     *   为了减少消息大小，DNS 允许使用"指针"来引用之前出现过的域名。
-     *   指针是一个 2 字节的值，格式如下：
-     *   
-     *   +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
-     *   | 1  1|                OFFSET                   |
-     *   +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
-     *   
-     *   - 高 2 位为 11（0xC0）表示这是一个指针
-     *   - 低 14 位是从消息开头的偏移量
-     * 
-     * 判断方法：
-     *   - 普通标签: 长度字节 < 64 (0x00-0x3F)，高 2 位为 00
-     *   - 压缩指针: 长度字节 >= 192 (0xC0-0xFF)，高 2 位为 11
-     * 
-     * ============================================================
-     * 压缩示例
-     * ============================================================
-     * 
-     * 假设消息中有两个问题：
-     *   Question 1: "codecrafters.io"
-     *   Question 2: "abc.codecrafters.io"（压缩）
-     * 
-     * 原始字节布局：
-     *   [0-11]  Header (12 bytes)
-     *   [12]    0x0C (长度=12)
-     *   [13-24] "codecrafters"
-     *   [25]    0x02 (长度=2)
-     *   [26-27] "io"
-     *   [28]    0x00 (结束)
-     *   [29-30] TYPE (0x0001)
-     *   [31-32] CLASS (0x0001)
-     *   
-     *   Question 2 (使用压缩):
-     *   [33]    0x03 (长度=3)
-     *   [34-36] "abc"
-     *   [37-38] 0xC0 0x0C (指针，指向偏移 12，即 "codecrafters.io")
-     *   [39-40] TYPE (0x0001)
-     *   [41-42] CLASS (0x0001)
-     * 
-     * 解析 Question 2:
-     *   1. 读取 [33] = 0x03，这是普通标签，长度=3
-     *   2. 读取 "abc"
-     *   3. 读取 [37] = 0xC0，高 2 位为 11，这是压缩指针
-     *   4. 计算偏移: (0xC0 & 0x3F) << 8 | 0x0C = 0x000C = 12
-     *   5. 跳转到偏移 12，继续解析 "codecrafters.io"
-     *   6. 最终得到: "abc.codecrafters.io"
-     */
-    static DNSQuestion parse(const uint8_t* data, size_t& offset)
+    // 跳过 Question 部分
+    for (uint16_t i = 0; i < responseHeader.qdcount && error == ParseError::NONE; i++)
     {
-        DNSQuestion question;
-        
-        // 解析域名（支持压缩）
-        question.name = parseDomainName(data, offset);
-        
-        // ========== 解析 TYPE（2 字节，大端序）==========
-        question.type = (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
-        offset += 2;
-        
-        // ========== 解析 CLASS（2 字节，大端序）==========
-        question.qclass = (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
-        offset += 2;
-        
-        return question;
+        DNSQuestion skipped(alloc);
+        error = DNSQuestion::parse(responseData, responseSize, offset, skipped);
     }
     
-    /**
-     * 解析域名（支持压缩指针）
-     * 
-     * @param data 完整的 DNS 消息数据
-     * @param offset [输入/输出] 当前位置，解析后更新（注意：遇到指针时只前进 2 字节）
-     * @return 解析后的域名字符串
-     * 
-     * ============================================================
-     * 压缩指针偏移量计算详解
-     * ============================================================
-     * 
-     * 压缩指针格式（2 字节）：
-     *   字节1: [1 1 X X X X X X]  字节2: [Y Y Y Y Y Y Y Y]
-     *          ↑ ↑ └────┬────┘          └──────┬──────┘
-     *        标志位   高6位               低8位
-     *                 └──────────┬──────────┘
-     *                       14位偏移量
-     * 
-     * 公式: offset = ((byte1 & 0x3F) << 8) | byte2
-     * 
-     * ---------- 示例 1: 指针 0xC0 0x0C（偏移 12）----------
-     * 
-     *   字节1: 0xC0 = 1100 0000
-     *   字节2: 0x0C = 0000 1100
-     * 
-     *   步骤 1: 0xC0 & 0x3F（去掉标志位，保留低6位）
-     *           1100 0000
-     *         & 0011 1111
-     *         ───────────
-     *           0000 0000 = 0x00
-     * 
-     *   步骤 2: 0x00 << 8（左移8位，为低8位腾出空间）
-     *           0x00 << 8 = 0x0000
-     * 
-     *   步骤 3: 0x0000 | 0x0C（合并低8位）
-     *           0000 0000 0000 0000
-     *         | 0000 0000 0000 1100
-     *         ─────────────────────
-     *           0000 0000 0000 1100 = 0x000C = 12
-     * 
-     *   结果: 偏移量 = 12
-     * 
-     * ---------- 示例 2: 指针 0xC1 0x2F（偏移 303）----------
-     * 
-     *   字节1: 0xC1 = 1100 0001
-     *   字节2: 0x2F = 0010 1111
-     * 
-     *   步骤 1: 0xC1 & 0x3F = 0000 0001 = 0x01
-     *   步骤 2: 0x01 << 8   = 0x0100 = 256
-     *   步骤 3: 0x0100 | 0x2F = 0x012F = 303
-     * 
-     *   结果: 偏移量 = 303
-     * 
-     * 注意: 14位偏移量最大可表示 2^14 - 1 = 16383 字节
-     */
-    static std::string parseDomainName(const uint8_t* data, size_t& offset)
+    // 解析 Answer 部分（全部记录，例如 CNAME 链 + 最终的 A 记录）
+    for (uint16_t i = 0; i < responseHeader.ancount && error == ParseError::NONE; i++)
     {
-        std::string name;
-        bool jumped = false;      // 是否已经跳转过（用于正确更新 offset）
-        size_t jumpOffset = 0;    // 跳转前的位置
-        size_t currentPos = offset;
-        
-        while (true)
-        {
-            uint8_t labelLen = data[currentPos];
-            
-            // 检查是否是压缩指针（高 2 位为 11，即 >= 0xC0）
-            // 判断方法: labelLen & 0xC0 == 0xC0
-            //   0xC0 = 1100 0000，与操作后如果高2位是11，结果仍为0xC0
-            if ((labelLen & 0xC0) == 0xC0)
-            {
-                // 这是一个压缩指针
-                // 指针格式: [11XXXXXX] [YYYYYYYY] (2 bytes)
-                //           ^^标志位   低14位是偏移量
-                if (!jumped)
-                {
-                    // 第一次跳转，记录原始位置 + 2（指针占 2 字节）
-                    jumpOffset = currentPos + 2;
-                    jumped = true;
-                }
-                
-                // 计算指针指向的偏移量
-                // ((labelLen & 0x3F) << 8) | data[currentPos + 1]
-                //   1. labelLen & 0x3F: 清除高2位标志位，保留低6位
-                //   2. << 8: 左移8位，为低8位腾出空间
-                //   3. | data[currentPos + 1]: 合并第二个字节（低8位）
-                uint16_t pointer = ((labelLen & 0x3F) << 8) | data[currentPos + 1];
-                currentPos = pointer;  // 跳转到指针指向的位置
-                continue;
-            }
-            
-            // 长度为 0 表示域名结束
-            if (labelLen == 0)
-            {
-                currentPos++;  // 跳过结束符
-                break;
-            }
-            
-            // 普通标签
-            currentPos++;  // 跳过长度字节
-            
-            // 如果不是第一个标签，添加分隔符 '.'
-            if (!name.empty())
-            {
-                name += '.';
-            }
-            
-            // 读取标签内容
-            for (uint8_t i = 0; i < labelLen; i++)
-            {
-                name += static_cast<char>(data[currentPos]);
-                currentPos++;
-            }
-        }
-        
-        // 更新 offset
-        // 如果发生了跳转，offset 应该指向指针之后（指针占 2 字节）
-        // 如果没有跳转，offset 应该指向域名结束符之后
-        if (jumped)
-        {
-            offset = jumpOffset;
-        }
-        else
-        {
-            offset = currentPos;
-        }
-        
-        return name;
+        error = DNSAnswer::parse(responseData, responseSize, offset, result.answers.emplace_back());
     }
     
-    /**
-     * 将域名编码为 DNS 标签序列
-     * 
-     * 编码规则：
-     *   1. 按 '.' 分割域名为多个标签
-     *   2. 每个标签格式：<长度字节><内容>
-     *   3. 以 \x00 结束
-     * 
-     * 示例: "codecrafters.io" -> \x0ccodecrafters\x02io\x00
-     * 
-     * 详细编码过程（以 "codecrafters.io" 为例）：
-     * 
-     *   输入: "codecrafters.io"
-     *         ^^^^^^^^^^^^^  ^^
-     *         第一个标签     第二个标签
-     * 
-     *   步骤1: 找到第一个 '.'，位置 pos=12
-     *          标签 "codecrafters"，长度=12 (0x0C)
-     *          输出: [0x0C, 'c','o','d','e','c','r','a','f','t','e','r','s']
-     * 
-     *   步骤2: 从 pos+1=13 开始，找下一个 '.'，未找到
-     *          处理最后一个标签 "io"，长度=2 (0x02)
-     *          输出: [0x02, 'i','o']
-     * 
-     *   步骤3: 添加结束符 \x00
-     * 
-     *   最终结果（十六进制）:
-     *   0C 63 6F 64 65 63 72 61 66 74 65 72 73 02 69 6F 00
-     *   ^^ ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ ^^ ^^^^^ ^^
-     *   长度  c  o  d  e  c  r  a  f  t  e  r  s  长度 i  o  结束
-     *   =12                                       =2
-     */
-    static std::vector<uint8_t> encodeDomainName(const std::string& domain) 
+    // 解析 Authority 部分：否定回答（NXDOMAIN / NODATA）在这里携带 SOA
+    for (uint16_t i = 0; i < responseHeader.nscount && error == ParseError::NONE; i++)
     {
-        std::vector<uint8_t> encoded;
-        size_t start = 0;
-        size_t pos = 0;
-        
-        // 按 '.' 分割域名
-        // 示例: domain = "codecrafters.io"
-        //       第一次循环: start=0, 找到 pos=12 ('.')
-        //       第二次循环: start=13, 找不到 '.', 退出循环
-        while ((pos = domain.find('.', start)) != std::string::npos) 
-        {
-            // 计算当前标签长度
-            // 示例: labelLen = 12 - 0 = 12
-            size_t labelLen = pos - start;
-            
-            // 添加长度字节
-            // 示例: encoded.push_back(12) -> encoded = [0x0C]
-            encoded.push_back(static_cast<uint8_t>(labelLen));
-            
-            // 添加标签内容
-            // 示例: 添加 "codecrafters" 的每个字符
-            //       encoded = [0x0C, 'c','o','d','e','c','r','a','f','t','e','r','s']
-            for (size_t i = start; i < pos; i++) 
-            {
-                encoded.push_back(static_cast<uint8_t>(domain[i]));
-            }
-            
-            // 移动到下一个标签的起始位置
-            // 示例: start = 12 + 1 = 13
-            start = pos + 1;
-        }
-        
-        // 处理最后一个标签（'.' 后面的部分）
-        // 示例: start=13, domain.length()=15
-        //       最后一个标签 "io", 长度=15-13=2
-        if (start < domain.length()) 
-        {
-            size_t labelLen = domain.length() - start;
-            encoded.push_back(static_cast<uint8_t>(labelLen));
-            for (size_t i = start; i < domain.length(); i++) 
-            {
-                encoded.push_back(static_cast<uint8_t>(domain[i]));
-            }
+        DNSAnswer authority(alloc);
+        error = DNSAnswer::parse(responseData, responseSize, offset, authority);
+        if (error == ParseError::NONE && authority.type == 6 && !result.hasSoa)
+        {
+            result.soa = std::move(authority);
+            result.hasSoa = true;
         }
-        
-        // 添加结束符 \x00
-        // 最终: encoded = [0x0C, ..., 0x02, 'i', 'o', 0x00]
-        encoded.push_back(0x00);
-        
-        return encoded;
     }
     
-    /**
-     * 序列化 Question 为字节数组
-     */
-    std::vector<uint8_t> serialize() const 
+    if (error != ParseError::NONE)
     {
-        std::vector<uint8_t> bytes;
-        
-        // 1. 编码域名
-        std::vector<uint8_t> encodedName = encodeDomainName(name);
-        bytes.insert(bytes.end(), encodedName.begin(), encodedName.end());
-        
-        // 2. TYPE（2 字节，大端序）
-        bytes.push_back((type >> 8) & 0xFF);
-        bytes.push_back(type & 0xFF);
-        
-        // 3. CLASS（2 字节，大端序）
-        bytes.push_back((qclass >> 8) & 0xFF);
-        bytes.push_back(qclass & 0xFF);
-        
-        return bytes;
+        std::cerr << "Malformed response from resolver: " << parseErrorName(error) << std::endl;
+        return ForwardResult(alloc);
     }
-};
+    
+    result.ok = true;
+    result.rcode = responseHeader.flags & 0x0F;
+    return result;
+}
 
 /**
- * DNS Answer (Resource Record) 结构体
- * 
- * Answer Section 格式（RFC 1035 Section 3.2.1）：
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                     NAME                      |  变长，域名编码
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                     TYPE                      |  16 bits，记录类型
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                     CLASS                     |  16 bits，记录类别
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                     TTL                       |  32 bits，生存时间
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                   RDLENGTH                    |  16 bits，RDATA 长度
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * |                    RDATA                      |  变长，记录数据
- * +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- * 
- * A 记录示例（codecrafters.io -> 8.8.8.8）：
- *   NAME:     \x0ccodecrafters\x02io\x00  (域名编码)
- *   TYPE:     0x0001                       (A 记录)
- *   CLASS:    0x0001                       (IN 互联网)
- *   TTL:      0x0000003C                   (60 秒)
- *   RDLENGTH: 0x0004                       (4 字节)
- *   RDATA:    0x08080808                   (8.8.8.8)
+ * 转发给上游的查询 ID：每个线程一个以 std::random_device 为种子的生成器（与 UpstreamClient 相同），
+ * 路径外的攻击者无法预测
  */
-struct DNSAnswer 
+uint16_t randomQueryId()
 {
-    std::string name;       // 域名
-    uint16_t type;          // 记录类型（1 = A 记录）
-    uint16_t aclass;        // 记录类别（1 = IN）
-    uint32_t ttl;           // 生存时间（秒）
-    uint16_t rdlength;      // RDATA 长度
-    std::vector<uint8_t> rdata;  // 记录数据（A 记录为 4 字节 IP 地址）
-    
-    /**
-     * 从字节数组解析 DNS Answer（反序列化）
-     * 
-     * @param data 完整的 DNS 消息数据
-     * @param offset [输入/输出] 当前解析位置
-     * @return 解析后的 DNSAnswer
-     */
-    static DNSAnswer parse(const uint8_t* data, size_t& offset)
-    {
-        DNSAnswer answer;
-        
-        // 1. 解析域名（支持压缩）
-        answer.name = DNSQuestion::parseDomainName(data, offset);
-        
-        // 2. TYPE（2 字节，大端序）
-        answer.type = (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
-        offset += 2;
-        
-        // 3. CLASS（2 字节，大端序）
-        answer.aclass = (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
-        offset += 2;
-        
-        // 4. TTL（4 字节，大端序）
-        answer.ttl = (static_cast<uint32_t>(data[offset]) << 24) |
-                     (static_cast<uint32_t>(data[offset + 1]) << 16) |
-                     (static_cast<uint32_t>(data[offset + 2]) << 8) |
-                     data[offset + 3];
-        offset += 4;
-        
-        // 5. RDLENGTH（2 字节，大端序）
-        answer.rdlength = (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
-        offset += 2;
-        
-        // 6. RDATA（rdlength 字节）
-        answer.rdata.assign(data + offset, data + offset + answer.rdlength);
-        offset += answer.rdlength;
-        
-        return answer;
-    }
-    
-    /**
-     * 序列化 Answer 为字节数组
-     */
-    std::vector<uint8_t> serialize() const 
-    {
-        std::vector<uint8_t> bytes;
-        
-        // 1. NAME - 域名编码（复用 DNSQuestion 的编码函数）
-        std::vector<uint8_t> encodedName = DNSQuestion::encodeDomainName(name);
-        bytes.insert(bytes.end(), encodedName.begin(), encodedName.end());
-        
-        // 2. TYPE（2 字节，大端序）
-        bytes.push_back((type >> 8) & 0xFF);
-        bytes.push_back(type & 0xFF);
-        
-        // 3. CLASS（2 字节，大端序）
-        bytes.push_back((aclass >> 8) & 0xFF);
-        bytes.push_back(aclass & 0xFF);
-        
-        // 4. TTL（4 字节，大端序）
-        // 示例: ttl = 60 = 0x0000003C
-        //   bytes = [0x00, 0x00, 0x00, 0x3C]
-        bytes.push_back((ttl >> 24) & 0xFF);  // 最高字节
-        bytes.push_back((ttl >> 16) & 0xFF);
-        bytes.push_back((ttl >> 8) & 0xFF);
-        bytes.push_back(ttl & 0xFF);          // 最低字节
-        
-        // 5. RDLENGTH（2 字节，大端序）
-        bytes.push_back((rdlength >> 8) & 0xFF);
-        bytes.push_back(rdlength & 0xFF);
-        
-        // 6. RDATA（变长）
-        // A 记录: 4 字节 IPv4 地址
-        // 示例: 8.8.8.8 -> [0x08, 0x08, 0x08, 0x08]
-        bytes.insert(bytes.end(), rdata.begin(), rdata.end());
-        
-        return bytes;
-    }
-};
+    thread_local std::mt19937 random(std::random_device{}());
+    return static_cast<uint16_t>(random());
+}
 
 /**
- * DNS 消息结构体
- * 包含 header、question、answer、authority、additional 五个部分
+ * 上游的报文是否是对 request（forwardQuery() 发出的单问题查询）的回答
+ *
+ * ID 相同、QR=1、只有一个问题，Question 部分与请求逐字节相同（域名不区分大小写，上游可能改变大小写）
  */
-struct DNSMessage 
+bool matchesForwardRequest(const uint8_t* response, size_t responseSize, const std::pmr::vector<uint8_t>& request)
 {
-    DNSHeader header;
-    std::vector<DNSQuestion> questions;  // Question 部分（可包含多个问题）
-    std::vector<DNSAnswer> answers;      // Answer 部分（可包含多个回答）
-    // TODO: 后续添加 authority, additional 部分
-    
-    std::vector<uint8_t> serialize() const 
+    if (responseSize < request.size()) return false;
+    if (response[0] != request[0] || response[1] != request[1]) return false;
+    if ((response[2] & 0x80) == 0) return false;   // QR=0：不是响应
+    if (response[4] != 0 || response[5] != 1) return false;
+    size_t nameEnd = request.size() - 4;   // TYPE + CLASS
+    for (size_t i = 12; i < nameEnd; i++)
     {
-        // 1. 序列化 Header
-        std::vector<uint8_t> bytes = header.serialize();
-        
-        // 2. 序列化所有 Questions
-        for (const auto& question : questions) 
-        {
-            std::vector<uint8_t> questionBytes = question.serialize();
-            bytes.insert(bytes.end(), questionBytes.begin(), questionBytes.end());
-        }
-        
-        // 3. 序列化所有 Answers
-        for (const auto& answer : answers) 
-        {
-            std::vector<uint8_t> answerBytes = answer.serialize();
-            bytes.insert(bytes.end(), answerBytes.begin(), answerBytes.end());
-        }
-        
-        return bytes;
+        if (std::tolower(response[i]) != std::tolower(request[i])) return false;
     }
-};
+    return std::equal(request.begin() + nameEnd, request.end(), response + nameEnd);
+}
 
 /**
  * 向上游 DNS 服务器转发查询并获取响应
  * 
- * @param resolverAddr 上游 DNS 服务器地址
+ * @param resolverAddr 上游 DNS 服务器地址（IPv4 或 IPv6）
  * @param question 要查询的问题
- * @param queryId 查询 ID
- * @return 从上游服务器获取的 Answer
+ * @param queryId 查询 ID（randomQueryId()，不要使用客户端请求的 ID）
+ * @param timeoutMs 等待上游响应的超时时间（毫秒），超时视为上游失败
+ * @param packets 调用线程的报文缓冲区（接收上游的响应）
+ * @param alloc 请求与结果使用的分配器（主循环传入当前请求的 arena，预取线程使用默认全局堆）
+ * @return 上游的 RCODE、全部 Answer 记录以及 Authority 中的 SOA（用于否定缓存）
  * 
  * ============================================================
  * DNS 转发完整流程示例
@@ -784,14 +181,14 @@ struct DNSMessage
  *        │                       │                           │
  *        │   请求: 2个问题        │                           │
  *        │   ID=1234             │   转发请求1: abc.example.com
- *        │                       │   ID=1234                 │
+ *        │                       │   ID=0x9E3B（随机）        │
  *        │                       │ ─────────────────────────>│
  *        │                       │                           │
  *        │                       │   响应1: 1.2.3.4          │
  *        │                       │ <─────────────────────────│
  *        │                       │                           │
  *        │                       │   转发请求2: xyz.example.com
- *        │                       │   ID=1234                 │
+ *        │                       │   ID=0x51C7（随机）        │
  *        │                       │ ─────────────────────────>│
  *        │                       │                           │
  *        │                       │   响应2: 5.6.7.8          │
@@ -867,7 +264,7 @@ struct DNSMessage
  * 
  *   转发请求 1 (abc.example.com):
  *   +--+--+--+--+--+--+--+--+--+--+--+--+
- *   |         ID = 1234                 |  保持原 ID
+ *   |         ID = 0x9E3B               |  随机 ID（不使用客户端的 ID）
  *   +--+--+--+--+--+--+--+--+--+--+--+--+
  *   |         Flags = 0x0100 (RD=1)     |
  *   +--+--+--+--+--+--+--+--+--+--+--+--+
@@ -876,9 +273,9 @@ struct DNSMessage
  *   |    Question: abc.example.com      |
  *   +--+--+--+--+--+--+--+--+--+--+--+--+
  *   
- *   上游响应 1:
+ *   上游响应 1（ID、QR=1 和 Question 都与请求相同才接受）:
  *   +--+--+--+--+--+--+--+--+--+--+--+--+
- *   |         ID = 1234                 |
+ *   |         ID = 0x9E3B               |
  *   +--+--+--+--+--+--+--+--+--+--+--+--+
  *   |         ANCOUNT = 1               |
  *   +--+--+--+--+--+--+--+--+--+--+--+--+
@@ -935,24 +332,37 @@ struct DNSMessage
  * 
  * 2. ID 必须匹配
  *    - 返回给客户端的响应 ID 必须与原始请求相同
- *    - 转发给上游的请求可以使用相同 ID（简化实现）
+ *    - 转发给上游的请求使用随机 ID（randomQueryId()），套接字 connect() 到上游；
+ *      只接受来自上游、ID 相同、QR=1、Question 相同（不区分大小写）的报文，
+ *      否则伪造的响应会被写进缓存，提供给所有客户端（缓存投毒）
  * 
  * 3. 压缩指针只在解析时处理
  *    - 解析请求时支持压缩指针
  *    - 生成响应时不使用压缩（简化实现）
  */
-DNSAnswer forwardQuery(const sockaddr_in& resolverAddr, const DNSQuestion& question, uint16_t queryId)
+ForwardResult forwardQuery(const SocketAddress& resolverAddr, const DNSQuestion& question, uint16_t queryId,
+                           int timeoutMs, PacketPool::Cache& packets, const ForwardResult::allocator_type& alloc = {})
 {
-    // 创建转发用的 socket
-    int forwardSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    ForwardResult result(alloc);
+    
+    // 创建转发用的 socket（地址族与上游地址相同）
+    int forwardSocket = socket(resolverAddr.family(), SOCK_DGRAM, 0);
     if (forwardSocket == -1)
     {
         perror("Failed to create forward socket");
-        return DNSAnswer{};
+        return result;
+    }
+    
+    // connect()：内核只把上游地址发来的报文交给这个套接字，其他来源的伪造报文直接丢弃
+    if (connect(forwardSocket, resolverAddr.data(), resolverAddr.length) == -1)
+    {
+        perror("Failed to connect forward socket");
+        close(forwardSocket);
+        return result;
     }
     
     // 构建转发请求（只包含 1 个问题）
-    DNSMessage forwardRequest;
+    DNSMessage forwardRequest(alloc);
     forwardRequest.header.id = queryId;
     forwardRequest.header.flags = 0x0100;  // RD=1 (期望递归)
     forwardRequest.header.qdcount = 1;     // 关键：只有 1 个问题
@@ -961,287 +371,1483 @@ DNSAnswer forwardQuery(const sockaddr_in& resolverAddr, const DNSQuestion& quest
     forwardRequest.header.arcount = 0;
     forwardRequest.questions.push_back(question);
     
-    std::vector<uint8_t> requestBytes = forwardRequest.serialize();
+    std::pmr::vector<uint8_t> requestBytes = forwardRequest.serialize();
     
     // 发送请求到上游 DNS 服务器
-    if (sendto(forwardSocket, requestBytes.data(), requestBytes.size(), 0,
-               reinterpret_cast<const struct sockaddr*>(&resolverAddr), sizeof(resolverAddr)) == -1)
+    if (send(forwardSocket, requestBytes.data(), requestBytes.size(), 0) == -1)
     {
         perror("Failed to send to resolver");
         close(forwardSocket);
-        return DNSAnswer{};
+        return result;
     }
     
-    // 接收响应
-    // recvfrom() 默认是阻塞调用
-    char responseBuffer[512];
-    socklen_t addrLen = sizeof(resolverAddr);
-    int bytesReceived = recvfrom(forwardSocket, responseBuffer, sizeof(responseBuffer), 0,
-                                  nullptr, nullptr);
-    close(forwardSocket);
-    
-    if (bytesReceived == -1)
+    // 接收响应：ID 或 Question 不匹配的报文（迟到的旧响应、伪造的报文）丢弃后继续等待，
+    // 总等待时间不超过 timeoutMs，上游宕机时不会永远阻塞
+    PacketPool::Packet response = packets.acquire();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    ssize_t bytesReceived = -1;
+    while (true)
     {
-        perror("Failed to receive from resolver");
-        return DNSAnswer{};
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        pollfd readable = { forwardSocket, POLLIN, 0 };
+        int ready = remaining.count() > 0 ? poll(&readable, 1, static_cast<int>(remaining.count())) : 0;
+        if (ready == -1 && errno == EINTR) continue;
+        if (ready <= 0)
+        {
+            std::cerr << "Timed out waiting for resolver" << std::endl;
+            break;
+        }
+        bytesReceived = recv(forwardSocket, response.data(), response.capacity(), 0);
+        if (bytesReceived == -1)
+        {
+            perror("Failed to receive from resolver");
+            break;
+        }
+        if (matchesForwardRequest(response.data(), static_cast<size_t>(bytesReceived), requestBytes)) break;
+        std::cerr << "Ignored mismatched " << bytesReceived << "-byte packet from resolver" << std::endl;
+        bytesReceived = -1;
     }
+    close(forwardSocket);
     
-    // 解析响应
-    const uint8_t* responseData = reinterpret_cast<uint8_t*>(responseBuffer);
-    DNSHeader responseHeader = DNSHeader::parse(responseData);
-    
-    // 跳过 Header 和 Question 部分，解析 Answer
-    size_t offset = 12;  // Header 大小
+    if (bytesReceived == -1) return result;
     
-    // 跳过 Question 部分
-    for (uint16_t i = 0; i < responseHeader.qdcount; i++)
+    return parseForwardResponse(response.data(), static_cast<size_t>(bytesReceived), alloc);
+}
+
+/**
+ * 把一次转发的结果写入缓存
+ * 
+ * @return 是否是否定回答（NXDOMAIN / NODATA）
+ * 
+ *   - NOERROR 且有 Answer      -> 正向条目
+ *   - NXDOMAIN，或 NOERROR 但没有 Answer（NODATA），且带 SOA -> 否定条目（RFC 2308）
+ *   - 其他（SERVFAIL、REFUSED、没有 SOA 的否定回答）不缓存
+ */
+bool cacheForwardResult(ShardedCache& cache, const DNSQuestion& question, const ForwardResult& forwarded)
+{
+    bool negative = forwarded.rcode == DnsCache::RCODE_NXDOMAIN ||
+                    (forwarded.rcode == 0 && forwarded.answers.empty());
+    if (forwarded.rcode == 0 && !forwarded.answers.empty())
     {
-        DNSQuestion::parse(responseData, offset);
+        cache.insertPositive(question, forwarded.answers);
     }
-    
-    // 解析 Answer 部分
-    DNSAnswer answer;
-    if (responseHeader.ancount > 0)
+    else if (negative && forwarded.hasSoa)
     {
-        answer = DNSAnswer::parse(responseData, offset);
+        cache.insertNegative(question, forwarded.rcode, forwarded.soa);
     }
-    
-    return answer;
+    return negative;
 }
 
-int main(int argc, char* argv[])
+/**
+ * 发送响应的方式
+ * 
+ *   SocketSender：直接 sendto()（默认的 recvfrom() 循环）
+ *   UringSender：放进 io_uring 的提交队列，与同一轮的其他响应一起提交（见 serveUdp()）
+ * 处理查询的代码只调用 send()，与工作线程使用哪种收发方式无关。
+ */
+class ResponseSender
 {
-    // ==================== 1. 初始化输出设置 ====================
-    // 设置 std::cout 和 std::cerr 为无缓冲模式
-    // std::unitbuf 会在每次输出操作后自动刷新缓冲区
-    // 这确保调试信息能够立即显示，而不是等缓冲区满了才输出
-    std::cout << std::unitbuf;
-    std::cerr << std::unitbuf;
+public:
+    virtual ~ResponseSender() = default;
+    virtual void send(const uint8_t* data, size_t size, const SocketAddress& clientAddress) = 0;
+};
 
-    // 禁用 C 标准库的 stdout 缓冲
-    // 与上面的设置配合，确保所有输出都是即时的
-    setbuf(stdout, NULL);
+class SocketSender : public ResponseSender
+{
+public:
+    explicit SocketSender(int udpSocket) : udpSocket_(udpSocket) {}
 
-    // 调试信息，用于确认程序已启动
-    std::cout << "Logs from your program will appear here!" << std::endl;
-    
-    // ==================== 1.5 解析命令行参数 ====================
-    // 格式: ./your_server --resolver <ip>:<port>
-    std::string resolverIp;
-    int resolverPort = 0;
-    
-    for (int i = 1; i < argc; i++)
+    void send(const uint8_t* data, size_t size, const SocketAddress& clientAddress) override
     {
-        if (std::string(argv[i]) == "--resolver" && i + 1 < argc)
+        if (sendto(udpSocket_, data, size, 0, clientAddress.data(), clientAddress.length) == -1)
         {
-            std::string resolverAddr = argv[i + 1];
-            size_t colonPos = resolverAddr.find(':');
-            if (colonPos != std::string::npos)
-            {
-                resolverIp = resolverAddr.substr(0, colonPos);
-                resolverPort = std::stoi(resolverAddr.substr(colonPos + 1));
-            }
-            break;
+            perror("Failed to send response");
         }
     }
+
+private:
+    int udpSocket_;
+};
+
+// 错误响应使用的 RCODE
+constexpr uint8_t RCODE_FORMERR = 1;
+constexpr uint8_t RCODE_REFUSED = 5;
+
+/**
+ * 回复不带任何记录的错误响应
+ * 
+ * 用于：
+ *   - FORMERR（RCODE = 1）：Header 完整但 Question 无法解析（截断、指针环、超长标签 / 域名）
+ *   - REFUSED（RCODE = 5）：ACL 拒绝该客户端查询或递归
+ * 只回显 ID、OPCODE 和 RD：
+ *   ID | QR=1 OPCODE RD RCODE | QDCOUNT=0 | ANCOUNT=0 | NSCOUNT=0 | ARCOUNT=0
+ */
+void sendErrorResponse(ResponseSender& sender, const DNSHeader& request, const SocketAddress& clientAddress,
+                       std::pmr::memory_resource* resource, uint8_t rcode)
+{
+    DNSMessage response(resource);
+    response.header.id = request.id;
+    response.header.flags = (1 << 15) | (request.getOpcode() << 11) | (request.getRD() << 8) | rcode;
+    response.header.qdcount = 0;
+    response.header.ancount = 0;
+    response.header.nscount = 0;
+    response.header.arcount = 0;
     
-    // 配置上游 DNS 服务器地址
-    sockaddr_in resolverAddress{};
-    if (!resolverIp.empty())
-    {
-        resolverAddress.sin_family = AF_INET;
-        resolverAddress.sin_port = htons(resolverPort);
-        inet_pton(AF_INET, resolverIp.c_str(), &resolverAddress.sin_addr);
-        std::cout << "Using resolver: " << resolverIp << ":" << resolverPort << std::endl;
-    }
+    std::pmr::vector<uint8_t> responseBytes = response.serialize();
+    sender.send(responseBytes.data(), responseBytes.size(), clientAddress);
+}
 
-    // ==================== 2. 创建 UDP Socket ====================
-    // socket() 函数创建一个通信端点，返回文件描述符
-    // 参数说明：
-    //   - AF_INET: 使用 IPv4 协议族
-    //   - SOCK_DGRAM: 使用数据报套接字（UDP）
-    //     * SOCK_STREAM 是 TCP（面向连接、可靠传输）
-    //     * SOCK_DGRAM 是 UDP（无连接、不保证可靠）
-    //   - 0: 自动选择协议（对于 SOCK_DGRAM 就是 UDP）
-    int udpSocket;
-    struct sockaddr_in clientAddress;  // 用于存储客户端地址信息
+/**
+ * 回复 TC=1 的空响应（RRL 的 slip 动作）
+ * 
+ * 复制请求的 Header 和 Question 部分，置 QR=1、TC=1，不带任何记录：
+ *   ID | QR=1 OPCODE TC=1 RD | QDCOUNT（与请求相同）| ANCOUNT=0 | NSCOUNT=0 | ARCOUNT=0
+ * 真实客户端看到 TC=1 会改用 TCP 重试；被伪造的受害者只收到与查询同样大小的包，没有放大效果。
+ * 
+ * @param questionEnd 请求中 Question 部分结束的偏移（请求最多 PacketPool::BUFFER_SIZE 字节，多个 Question 时可以超过 512）
+ */
+void sendTruncated(ResponseSender& sender, const uint8_t* request, size_t questionEnd, const SocketAddress& clientAddress)
+{
+    uint8_t response[PacketPool::BUFFER_SIZE];
+    if (questionEnd > sizeof(response)) return;
+    std::memcpy(response, request, questionEnd);
+    response[2] = 0x80 | (request[2] & 0x79) | 0x02;  // QR=1，保留 OPCODE 和 RD，AA=0，TC=1
+    response[3] = 0;                                  // RA=0, Z=0, RCODE=0
+    std::memset(response + 6, 0, 6);                  // ANCOUNT / NSCOUNT / ARCOUNT = 0
+    sender.send(response, questionEnd, clientAddress);
+}
 
-    udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
-    if (udpSocket == -1) 
+/**
+ * 按 RRL 的决定处理一个即将发送的响应
+ * 
+ * @return true 表示调用方不要再发送原响应（已经丢弃，或已经改为发送截断响应）
+ */
+bool limitResponse(ResponseRateLimiter& limiter, ResponseSender& sender, uint64_t responseKey,
+                   const uint8_t* request, size_t questionEnd, const SocketAddress& clientAddress)
+{
+    switch (limiter.check(clientAddress.data(), responseKey))
     {
-        // errno 是全局错误码，strerror() 将其转换为可读的错误信息
-        std::cerr << "Socket creation failed: " << strerror(errno) << "..." << std::endl;
-        return 1;
+        case ResponseRateLimiter::Action::SEND:
+            return false;
+        case ResponseRateLimiter::Action::SLIP:
+            sendTruncated(sender, request, questionEnd, clientAddress);
+            return true;
+        case ResponseRateLimiter::Action::DROP:
+            return true;
     }
+    return true;
+}
 
-    // ==================== 3. 设置 Socket 选项 ====================
-    // SO_REUSEPORT 允许多个 socket 绑定到同一个端口
-    // 主要作用：
-    //   1. 程序重启时，避免 "Address already in use" 错误
-    //      （因为之前的 socket 可能还在 TIME_WAIT 状态）
-    //   2. 允许多进程/多线程负载均衡
-    int reuse = 1;
-    if (setsockopt(udpSocket, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) 
-    {
-        std::cerr << "SO_REUSEPORT failed: " << strerror(errno) << std::endl;
-        return 1;
-    }
+/**
+ * 收到 SIGTERM / SIGINT 时置位，主线程从 sigsuspend() 返回后检查它并通知工作线程退出
+ */
+volatile sig_atomic_t stopRequested = 0;
 
-    // ==================== 4. 配置服务器地址并绑定 ====================
-    // sockaddr_in 结构体用于指定 IPv4 地址
-    // 使用 C99 的指定初始化器语法（designated initializers）
-    sockaddr_in serv_addr = 
-    { 
-        .sin_family = AF_INET,           // 地址族：IPv4
-        .sin_port = htons(2053),         // 端口号：2053
-                                         // htons() = Host TO Network Short
-                                         // 将主机字节序转换为网络字节序（大端）
-        .sin_addr = { htonl(INADDR_ANY) }, // IP 地址：0.0.0.0（监听所有网卡）
-                                           // htonl() = Host TO Network Long
-                                           // INADDR_ANY 表示接受来自任何网卡的连接
-    };
+void handleStopSignal(int)
+{
+    stopRequested = 1;
+}
 
-    // bind() 将 socket 与指定的地址和端口关联
-    // 这样内核才知道把发往该端口的数据包交给这个 socket
-    if (bind(udpSocket, reinterpret_cast<struct sockaddr*>(&serv_addr), sizeof(serv_addr)) != 0) 
+/**
+ * 保存缓存快照并打印结果
+ */
+void saveCacheSnapshot(const ShardedCache& cache, const std::string& path)
+{
+    std::string error;
+    long saved = cache.saveSnapshot(path, error);
+    if (saved < 0)
     {
-        std::cerr << "Bind failed: " << strerror(errno) << std::endl;
-        return 1;
+        std::cerr << "Cache snapshot save failed: " << error << std::endl;
+        return;
     }
+    std::cout << "Saved " << saved << " cache entries to " << path << std::endl;
+}
 
-    // ==================== 5. 主循环：接收请求并响应 ====================
-    int bytesRead;                              // 接收到的字节数
-    char buffer[512];                           // 接收缓冲区
-                                                // DNS 消息通常不超过 512 字节（UDP 限制）
-    socklen_t clientAddrLen = sizeof(clientAddress);  // 客户端地址结构体的大小
+struct PendingQuery;
 
-    while (true) 
-    {
-        // ---------- 5.1 接收 DNS 查询 ----------
-        // recvfrom() 从 UDP socket 接收数据
-        // 参数说明：
-        //   - udpSocket: 要接收数据的 socket
-        //   - buffer: 存放接收数据的缓冲区
-        //   - sizeof(buffer): 缓冲区大小
-        //   - 0: 标志位（无特殊选项）
-        //   - clientAddress: [输出] 发送方的地址信息
-        //   - clientAddrLen: [输入/输出] 地址结构体的大小
-        // 返回值：接收到的字节数，-1 表示错误
-        bytesRead = recvfrom(udpSocket, buffer, sizeof(buffer), 0, 
-                             reinterpret_cast<struct sockaddr*>(&clientAddress), &clientAddrLen);
-        if (bytesRead == -1) 
-        {
-            perror("Error receiving data");  // perror() 打印错误信息，自动附加 errno 描述
-            break;
-        }
+/**
+ * 工作线程的收发方式（--io-engine）
+ */
+enum class IoEngine
+{
+    SOCKET,   // recvfrom() / sendto()，每个报文两次系统调用
+    BATCH,    // recvmmsg() / sendmmsg() 批量收发，支持时再用 UDP GRO / GSO
+    URING,    // io_uring：multishot recvmsg + 批量提交的 sendmsg
+};
 
-        // 添加字符串结束符（仅用于调试打印，DNS 数据是二进制的）
-        buffer[bytesRead] = '\0';
-        std::cout << "Received " << bytesRead << " bytes" << std::endl;
+/**
+ * 所有监听器、所有工作线程共享的服务器状态
+ *
+ * 区域数据只读；缓存和预取队列内部有锁；running 在退出时由主线程清除
+ */
+struct ServerContext
+{
+    const AuthZone& zone;
+    bool zoneLoaded;
+    ShardedCache& cache;
+    Prefetcher& prefetcher;
+    const SocketAddress& resolverAddress;
+    bool hasResolver;
+    int resolverTimeoutMs;
+    int resolverRetries;               // 解析线程中上游超时后重发的次数（--resolver-retries）
+    IoEngine ioEngine;
+    bool udpOffload;                   // batch 引擎是否尝试 UDP GRO / GSO（--udp-offload）
+    HugePageMode hugePages;            // 接收缓冲区使用的页面（--huge-pages）
+    PacketPool& packets;               // 报文缓冲区池（每个线程 attach() 一次）
+    std::atomic<uint64_t>& gsoCoalesced;  // GSO 合并进其他条目的响应数（统计报告用）
+    std::atomic<bool> running{ true };
+    HandoffStage<PendingQuery>* resolverStage = nullptr;  // --resolver-threads，空 = 工作线程自己转发
+};
 
-        // ---------- 5.2 解析请求并构建 DNS 响应 ----------
-        // 首先解析请求的 Header
-        const uint8_t* requestData = reinterpret_cast<uint8_t*>(buffer);
-        DNSHeader requestHeader = DNSHeader::parse(requestData);
-        
-        // 解析所有 Question（从 offset=12 开始，即 Header 之后）
-        size_t offset = 12;  // DNS Header 固定 12 字节
-        std::vector<DNSQuestion> requestQuestions;
-        for (uint16_t i = 0; i < requestHeader.qdcount; i++)
-        {
-            DNSQuestion q = DNSQuestion::parse(requestData, offset);
-            std::cout << "Query " << (i + 1) << " for domain: " << q.name << std::endl;
-            requestQuestions.push_back(q);
-        }
-        
-        // 使用 DNSMessage 统一管理响应
-        DNSMessage response;
-        
-        // ===== 设置 Header =====
-        // 从请求中复制 ID（必须匹配）
-        response.header.id = requestHeader.id;
-        
-        // 从请求中提取需要复制的字段
-        uint8_t requestOpcode = requestHeader.getOpcode();
-        uint8_t requestRD = requestHeader.getRD();
-        
-        // 构建 flags 字段（16 bits）：
-        // QR(1) | OPCODE(4) | AA(1) | TC(1) | RD(1) | RA(1) | Z(3) | RCODE(4)
-        uint16_t qr = 1;                    // QR = 1 表示这是响应包
-        uint16_t opcode = requestOpcode;    // OPCODE: 从请求复制
-        uint16_t aa = 0;                    // AA = 0 非权威回答
-        uint16_t tc = 0;                    // TC = 0 未截断
-        uint16_t rd = requestRD;            // RD: 从请求复制
-        uint16_t ra = 0;                    // RA = 0 不支持递归
-        uint16_t z = 0;                     // Z = 0 保留字段
-        // RCODE: 如果 OPCODE=0 则返回 0（无错误），否则返回 4（未实现）
-        uint16_t rcode = (requestOpcode == 0) ? 0 : 4;
-        
-        // 按位组合 flags
-        // |QR(1)|OPCODE(4)|AA(1)|TC(1)|RD(1)|RA(1)|Z(3)|RCODE(4)|
-        response.header.flags = (qr << 15) | (opcode << 11) | (aa << 10) | 
-                                (tc << 9) | (rd << 8) | (ra << 7) | 
-                                (z << 4) | rcode;
-        
-        response.header.qdcount = requestQuestions.size();  // 问题数：与请求相同
-        response.header.ancount = requestQuestions.size();  // 回答数：每个问题一个回答
-        response.header.nscount = 0;    // 授权记录数：0
-        response.header.arcount = 0;    // 附加记录数：0
-        
-        // ===== 为每个 Question 添加 Question 和 Answer =====
-        for (const auto& reqQuestion : requestQuestions)
-        {
-            // 添加 Question（从请求中复制，不压缩）
-            DNSQuestion question;
-            question.name = reqQuestion.name;
-            question.type = 1;       // TYPE = 1 (A 记录)
-            question.qclass = 1;     // CLASS = 1 (IN，互联网)
-            response.questions.push_back(question);
-            
-            // 如果配置了 resolver，转发查询；否则返回固定 IP
-            if (!resolverIp.empty())
-            {
-                // 转发查询到上游 DNS 服务器
-                // 注意：上游服务器只接受单个问题，所以每个问题单独转发
-                DNSAnswer answer = forwardQuery(resolverAddress, reqQuestion, requestHeader.id);
-                response.answers.push_back(answer);
-            }
-            else
-            {
-                // 没有配置 resolver，返回固定 IP（兼容之前的阶段）
-                DNSAnswer answer;
-                answer.name = reqQuestion.name;
-                answer.type = 1;         // TYPE = 1 (A 记录)
-                answer.aclass = 1;       // CLASS = 1 (IN，互联网)
-                answer.ttl = 60;         // TTL = 60 秒
-                answer.rdlength = 4;     // RDATA 长度 = 4 字节（IPv4 地址）
-                answer.rdata = {8, 8, 8, 8};  // IP 地址 8.8.8.8
-                response.answers.push_back(answer);
-            }
-        }
-        
-        // ===== 序列化响应 =====
-        std::vector<uint8_t> responseBytes = response.serialize();
-
-        // ---------- 5.3 发送 DNS 响应 ----------
-        // sendto() 向指定地址发送 UDP 数据
-        // 参数说明：
-        //   - udpSocket: 发送数据的 socket
-        //   - responseBytes.data(): 要发送的数据指针
-        //   - responseBytes.size(): 数据长度（12 字节）
-        //   - 0: 标志位
-        //   - clientAddress: 目标地址（即发送查询的客户端）
-        //   - sizeof(clientAddress): 地址结构体大小
-        if (sendto(udpSocket, responseBytes.data(), responseBytes.size(), 0, 
-                   reinterpret_cast<struct sockaddr*>(&clientAddress), sizeof(clientAddress)) == -1) 
-        {
-            perror("Failed to send response");
-        }
-    }
+/**
+ * 每个监听套接字的计数（工作线程写，统计线程读）
+ */
+struct SocketCounters
+{
+    std::atomic<uint64_t> packets{ 0 };  // 收到的查询数（看 reuseport 在工作线程之间的分布）
+    std::atomic<uint32_t> drops{ 0 };    // SO_RXQ_OVFL：接收队列满而被内核丢弃的报文总数
+};
 
-    // ==================== 6. 清理资源 ====================
-    // 关闭 socket，释放系统资源
-    close(udpSocket);
+/**
+ * 一个监听器的策略，启动时由 --listen 的选项确定
+ *
+ * 关闭的功能不是用标志表示，而是换成一个“什么都不做”的对象：
+ *   acl=off        -> queryAcl 指向空的 AccessList（全部 ALLOW）
+ *   recursion=off  -> recursionAcl 指向默认动作为 REFUSE 的空 AccessList
+ *   rrl=off        -> rateLimiter 指向未开启的限速器（check() 总是 SEND）
+ * 所以工作线程处理报文的代码对所有监听器都相同，没有“这个监听器是否开启了某功能”的分支。
+ */
+struct ListenerPolicy
+{
+    const AccessList* queryAcl;
+    const AccessList* recursionAcl;
+    ResponseRateLimiter* rateLimiter;
+};
+
+/**
+ * 每个工作线程自己的请求内存池和响应缓冲区
+ */
+struct QueryScratch
+{
+    // 请求内存池：一次查询中的 Question、DNSMessage、记录和响应字节都从这里分配，
+    // 下一次查询开始时整体释放（上一次的对象此时都已析构）
+    RequestArena arena;
+    uint8_t zoneResponse[AuthZone::MAX_PACKET_SIZE];  // 权威命中时的响应缓冲区
+    unsigned worker = 0;    // 工作线程编号（所有监听器连续编号），即它在解析线程队列中的生产者编号
+    int udpSocket = -1;     // 工作线程的套接字（解析线程在同一个套接字上发送响应）
+    PacketPool::Cache* packets = nullptr;  // 本线程的报文缓冲区
+    PacketPool::Packet receive;            // recvmsg() 循环的接收缓冲区：交给解析线程时整个移走，不复制
+};
+
+/**
+ * 交给解析线程的请求（--resolver-threads）
+ *
+ * 按值放进 SpscRing，不需要 new。请求报文在报文缓冲区中：recvmsg() 循环收到的缓冲区直接移过来；
+ * batch / io_uring 引擎的接收缓冲区会被下一批报文覆盖，复制到一个新的缓冲区。
+ * 解析线程重新解析后由一个协程转发（resolveQuery()），响应直接从收到请求的套接字发出，
+ * 缓冲区随 PendingQuery 析构归还给工作线程。
+ */
+struct PendingQuery
+{
+    PacketPool::Packet packet;
+    SocketAddress clientAddress;
+    int udpSocket;
+    const ListenerPolicy* policy;
+    uint64_t questionHash;  // 工作线程解析出的第一个 Question 的哈希：选择解析线程（相同的问题在同一个线程中合并）
+};
+
+/**
+ * handleQuery() 在流水线中的位置
+ *
+ *   没有 --resolver-threads:   INLINE   查缓存，未命中时在本线程转发（阻塞到上游回复或超时）
+ *   有 --resolver-threads:
+ *     工作线程              RECEIVE  解析、权威区域、查缓存；第一个问题未命中时放入解析线程的队列，立即处理下一个报文
+ *       ──SpscRing──>
+ *     解析线程              resolveQuery() 协程：查询其余的问题，所有未命中的问题同时转发，超时重试，然后回复
+ *
+ * 队列满时工作线程照常 INLINE 处理。
+ */
+enum class QueryStage
+{
+    INLINE,
+    RECEIVE,
+};
+
+/**
+ * 递归响应的 Header（权威区域之外的名字：缓存、上游或固定 IP）
+ */
+void initRecursiveResponse(DNSMessage& response, const DNSHeader& requestHeader, size_t questionCount)
+{
+    // ===== 设置 Header =====
+    // 从请求中复制 ID（必须匹配）
+    response.header.id = requestHeader.id;
+
+    // 从请求中提取需要复制的字段
+    uint8_t requestOpcode = requestHeader.getOpcode();
+    uint8_t requestRD = requestHeader.getRD();
+
+    // 构建 flags 字段（16 bits）：
+    // QR(1) | OPCODE(4) | AA(1) | TC(1) | RD(1) | RA(1) | Z(3) | RCODE(4)
+    uint16_t qr = 1;                    // QR = 1 表示这是响应包
+    uint16_t opcode = requestOpcode;    // OPCODE: 从请求复制
+    uint16_t aa = 0;                    // AA = 0 非权威回答
+    uint16_t tc = 0;                    // TC = 0 未截断
+    uint16_t rd = requestRD;            // RD: 从请求复制
+    uint16_t ra = 0;                    // RA = 0 不支持递归
+    uint16_t z = 0;                     // Z = 0 保留字段
+    // RCODE: 如果 OPCODE=0 则返回 0（无错误），否则返回 4（未实现）
+    uint16_t rcode = (requestOpcode == 0) ? 0 : 4;
+
+    // 按位组合 flags
+    // |QR(1)|OPCODE(4)|AA(1)|TC(1)|RD(1)|RA(1)|Z(3)|RCODE(4)|
+    response.header.flags = (qr << 15) | (opcode << 11) | (aa << 10) | 
+                            (tc << 9) | (rd << 8) | (ra << 7) | 
+                            (z << 4) | rcode;
+
+    response.header.qdcount = questionCount;  // 问题数：与请求相同
+    response.header.arcount = 0;    // 附加记录数：0
+    // ancount / nscount 在收集完所有回答之后再填写（sendRecursiveResponse()）
+}
+
+/**
+ * 把一个问题的结果加入响应
+ *
+ * @param hit 缓存命中（正向、否定或 serve-stale 的过期数据），cached 中的 TTL 已调整
+ * @param forwarded 未命中时上游的回答（写入缓存）；ok == false 时回复 SERVFAIL
+ */
+void appendResolution(DNSMessage& response, uint8_t& upstreamRcode, const DNSQuestion& question, bool hit,
+                      const CacheResult& cached, const ForwardResult& forwarded, ServerContext& server)
+{
+    if (hit)
+    {
+        response.answers.insert(response.answers.end(), cached.answers.begin(), cached.answers.end());
+        response.authorities.insert(response.authorities.end(), cached.authorities.begin(), cached.authorities.end());
+        if (cached.rcode != 0) upstreamRcode = cached.rcode;
+        if (cached.prefetch) server.prefetcher.schedule(question);
+        return;
+    }
+
+    if (!forwarded.ok)
+    {
+        upstreamRcode = 2;  // SERVFAIL：上游不可达
+        return;
+    }
+
+    // RFC 2308：NXDOMAIN / NODATA 按 SOA 的 MINIMUM 缓存，
+    // 并把 SOA 放在 Authority 部分返回给客户端
+    bool negative = cacheForwardResult(server.cache, question, forwarded);
+    if (negative && forwarded.hasSoa)
+    {
+        response.authorities.push_back(forwarded.soa);
+    }
+
+    response.answers.insert(response.answers.end(), forwarded.answers.begin(), forwarded.answers.end());
+    if (forwarded.rcode != 0) upstreamRcode = forwarded.rcode;
+}
+
+/**
+ * 填写记录数和 RCODE，经过响应限速后序列化并发送
+ *
+ * @param questionEnd 请求中 Question 部分的结尾（限速 slip 时回复截断响应用）
+ */
+void sendRecursiveResponse(DNSMessage& response, uint8_t upstreamRcode, const std::pmr::vector<DNSQuestion>& requestQuestions,
+                           const uint8_t* requestData, size_t questionEnd, const SocketAddress& clientAddress,
+                           const ListenerPolicy& policy, ResponseSender& sender)
+{
+    // 回答数 / 授权记录数：按实际收集到的记录填写
+    response.header.ancount = response.answers.size();
+    response.header.nscount = response.authorities.size();
+
+    // 标准查询时，把上游（或缓存）的 RCODE 带回给客户端（例如 NXDOMAIN）
+    if ((response.header.flags & 0x0F) == 0 && upstreamRcode != 0)
+    {
+        response.header.flags |= upstreamRcode;
+    }
+
+    // ===== 响应限速 =====
+    // 键用第一个问题的名字；NXDOMAIN 改用 SOA 的所有者（区域名），随机子域名共享同一个令牌桶
+    if (policy.rateLimiter->enabled() && !requestQuestions.empty())
+    {
+        uint8_t responseRcode = response.header.flags & 0x0F;
+        uint64_t nameHash = requestQuestions[0].hash;
+        if (responseRcode == DnsCache::RCODE_NXDOMAIN && !response.authorities.empty())
+        {
+            nameHash = QuestionHash::of(response.authorities[0].name, 0, 0);
+        }
+        if (limitResponse(*policy.rateLimiter, sender, ResponseRateLimiter::responseKey(nameHash, responseRcode),
+                          requestData, questionEnd, clientAddress))
+        {
+            return;
+        }
+    }
+
+    // ===== 序列化响应 =====
+    std::pmr::vector<uint8_t> responseBytes = response.serialize();
+
+    // ---------- 3. 发送 DNS 响应 ----------
+    // 直接 sendto()，或放入 io_uring 提交队列（见 ResponseSender）
+    sender.send(responseBytes.data(), responseBytes.size(), clientAddress);
+}
+
+/**
+ * 处理一个查询报文，回复零个（丢弃）或一个响应
+ * 
+ * @param requestData 收到的报文
+ * @param requestSize 报文长度
+ * @param clientAddress 发送方（双栈套接字上的 IPv4 客户端表现为 ::ffff:a.b.c.d）
+ * @param scratch 本工作线程的内存池和缓冲区
+ * @param sender 发送响应的方式
+ * @param stage 流水线中的位置（见 QueryStage）
+ */
+void handleQuery(const uint8_t* requestData, size_t requestSize, const SocketAddress& clientAddress,
+                 const ListenerPolicy& policy, ServerContext& server, QueryScratch& scratch, ResponseSender& sender,
+                 QueryStage stage = QueryStage::INLINE)
+{
+    RequestArena& arena = scratch.arena;
+    uint8_t* zoneResponse = scratch.zoneResponse;
+    arena.reset();
+    
+    // ---------- 1.1 ACL：解析之前按源地址决定是否处理 ----------
+    // 前缀树查找只有几次数组下标访问；deny 直接丢弃，refuse 只需要 Header 中的 ID
+    AclAction access = policy.queryAcl->match(clientAddress.data());
+    if (access == AclAction::DENY) return;
+
+    // 注意：接收缓冲区不以 '\0' 结尾，解析都显式使用 requestSize 作为长度
+    std::cout << "Received " << requestSize << " bytes" << std::endl;
+
+    // ---------- 2. 解析请求并构建 DNS 响应 ----------
+    // 首先解析请求的 Header；不足 12 字节连 ID 都没有，无法回复，直接丢弃
+    DNSHeader requestHeader;
+    if (DNSHeader::parse(requestData, requestSize, requestHeader) != ParseError::NONE)
+    {
+        std::cerr << "Dropped " << requestSize << "-byte packet from " << clientAddress.toString()
+                  << ": header truncated" << std::endl;
+        return;
+    }
+
+    // REFUSED 与 FORMERR 一样只有 12 字节，slip 时照常发送，只在 drop 时不回复
+    if (access == AclAction::REFUSE)
+    {
+        if (policy.rateLimiter->check(clientAddress.data(), ResponseRateLimiter::responseKey(0, RCODE_REFUSED)) !=
+            ResponseRateLimiter::Action::DROP)
+        {
+            sendErrorResponse(sender, requestHeader, clientAddress, arena.resource(), RCODE_REFUSED);
+        }
+        return;
+    }
+
+    // 解析所有 Question（从 offset=12 开始，即 Header 之后）
+    // 任何一个 Question 解析失败都立即回复 FORMERR，不再继续处理
+    size_t offset = 12;  // DNS Header 固定 12 字节
+    std::pmr::vector<DNSQuestion> requestQuestions(arena.resource());
+    ParseError parseError = ParseError::NONE;
+    for (uint16_t i = 0; i < requestHeader.qdcount && parseError == ParseError::NONE; i++)
+    {
+        parseError = DNSQuestion::parse(requestData, requestSize, offset, requestQuestions.emplace_back());
+        if (parseError == ParseError::NONE)
+        {
+            std::cout << "Query " << (i + 1) << " for domain: " << requestQuestions.back().name << std::endl;
+        }
+    }
+    if (parseError != ParseError::NONE)
+    {
+        std::cerr << "Malformed query from " << clientAddress.toString() << ": " << parseErrorName(parseError)
+                  << std::endl;
+        // FORMERR 本身只有 12 字节，与截断响应一样大，所以 slip 时照常发送，只在 drop 时不回复
+        if (policy.rateLimiter->check(clientAddress.data(), ResponseRateLimiter::responseKey(0, RCODE_FORMERR)) !=
+            ResponseRateLimiter::Action::DROP)
+        {
+            sendErrorResponse(sender, requestHeader, clientAddress, arena.resource(), RCODE_FORMERR);
+        }
+        return;
+    }
+
+    // ---------- 2.1 权威区域命中：直接使用预渲染包 ----------
+    // 只处理单问题的标准查询；Question 域名未压缩时，
+    // 其线格式长度 = 当前 offset - 12 (Header) - 4 (TYPE + CLASS)
+    if (server.zoneLoaded && requestHeader.getOpcode() == 0 && requestQuestions.size() == 1)
+    {
+        const DNSQuestion& q = requestQuestions[0];
+        const PrecomputedResponse* hit = server.zone.find(q);
+        if (hit != nullptr && hit->qnameLength == offset - 12 - 4)
+        {
+            if (limitResponse(*policy.rateLimiter, sender, ResponseRateLimiter::responseKey(q.hash, 0),
+                              requestData, offset, clientAddress))
+            {
+                return;
+            }
+            size_t responseLength = AuthZone::writeResponse(*hit, requestData, zoneResponse);
+            sender.send(zoneResponse, responseLength, clientAddress);
+            return;
+        }
+    }
+
+    // 区域之外的名字需要递归（缓存 / 上游），不在 --allow-recursion 名单中的客户端回复 REFUSED
+    if (policy.recursionAcl->match(clientAddress.data()) != AclAction::ALLOW)
+    {
+        if (policy.rateLimiter->check(clientAddress.data(), ResponseRateLimiter::responseKey(0, RCODE_REFUSED)) !=
+            ResponseRateLimiter::Action::DROP)
+        {
+            sendErrorResponse(sender, requestHeader, clientAddress, arena.resource(), RCODE_REFUSED);
+        }
+        return;
+    }
+
+    // 使用 DNSMessage 统一管理响应
+    DNSMessage response(arena.resource());
+    initRecursiveResponse(response, requestHeader, requestQuestions.size());
+    uint8_t upstreamRcode = 0;      // 上游（或缓存）返回的 RCODE
+
+    // ===== 为每个 Question 添加 Question 和 Answer =====
+    for (const auto& reqQuestion : requestQuestions)
+    {
+        // 添加 Question（从请求中复制，不压缩；NAME / TYPE / CLASS 与请求相同）
+        response.questions.push_back(reqQuestion);
+    
+        // 如果配置了 resolver，先查缓存，未命中再转发；否则返回固定 IP
+        if (server.hasResolver)
+        {
+            CacheResult cached(arena.resource());
+            bool hit = server.cache.lookup(reqQuestion, cached);
+        
+            // 第一个问题未命中：整个请求交给解析线程，本线程继续接收下一个报文
+            // （解析线程查询其余的问题；前面有问题已经命中时照常在本线程处理，避免重复查缓存）
+            if (!hit && stage == QueryStage::RECEIVE && &reqQuestion == &requestQuestions[0] &&
+                requestSize <= PacketPool::BUFFER_SIZE)
+            {
+                PendingQuery pending;
+                bool received = scratch.receive && requestData == scratch.receive.data();
+                if (received)
+                {
+                    pending.packet = std::move(scratch.receive);
+                }
+                else
+                {
+                    pending.packet = scratch.packets->acquire();
+                    pending.packet.assign(requestData, requestSize);
+                }
+                pending.clientAddress = clientAddress;
+                pending.udpSocket = scratch.udpSocket;
+                pending.policy = &policy;
+                pending.questionHash = reqQuestion.hash;
+                if (server.resolverStage->submit(scratch.worker, reqQuestion.hash, std::move(pending))) return;
+                // 队列满：submit() 没有移走 pending，接收缓冲区还回去（requestData 仍指向它）
+                if (received) scratch.receive = std::move(pending.packet);
+            }
+        
+            ForwardResult forwarded(arena.resource());
+            if (!hit)
+            {
+                // 转发查询到上游 DNS 服务器
+                // 注意：上游服务器只接受单个问题，所以每个问题单独转发
+                forwarded = forwardQuery(server.resolverAddress, reqQuestion, randomQueryId(), server.resolverTimeoutMs,
+                                         *scratch.packets, arena.resource());
+            
+                // 上游失败：窗口内有过期数据则返回过期数据（RFC 8767），否则 SERVFAIL
+                if (!forwarded.ok) hit = server.cache.serveStale(reqQuestion, cached);
+            }
+            appendResolution(response, upstreamRcode, reqQuestion, hit, cached, forwarded, server);
+        }
+        else
+        {
+            // 没有配置 resolver，返回固定 IP（兼容之前的阶段）
+            DNSAnswer& answer = response.answers.emplace_back();
+            answer.name = reqQuestion.name;
+            answer.type = 1;         // TYPE = 1 (A 记录)
+            answer.aclass = 1;       // CLASS = 1 (IN，互联网)
+            answer.ttl = 60;         // TTL = 60 秒
+            answer.rdlength = 4;     // RDATA 长度 = 4 字节（IPv4 地址）
+            answer.rdata = {8, 8, 8, 8};  // IP 地址 8.8.8.8
+        }
+    }
+
+    sendRecursiveResponse(response, upstreamRcode, requestQuestions, requestData, offset, clientAddress, policy, sender);
+}
+
+/**
+ * 解析线程中处理一个请求的协程（--resolver-threads）
+ *
+ * 工作线程已经检查过 ACL、权威区域和第一个问题的缓存；这里查询其余问题的缓存，
+ * 所有未命中的问题同时发给上游，超时（或响应畸形）的问题整轮重发，最多 server.resolverRetries 次，
+ * 仍然失败时返回过期数据（serve-stale）或 SERVFAIL。
+ *
+ * 示例：2 个问题都未命中，上游 100 ms 回复，xyz 的第一个请求丢失（--resolver-timeout 500 --resolver-retries 1）：
+ *   t=0       同时发出 abc / xyz，协程挂起
+ *   t=100ms   abc 的响应到达
+ *   t=500ms   xyz 超时，用新的 ID 重发
+ *   t=600ms   xyz 的响应到达，合并成一个响应回复客户端
+ *   （逐个同步转发时是 100 + 500 + 100 ms，而且这期间线程不能处理别的请求）
+ *
+ * @param memory 本解析线程的内存池（协程都在同一个线程中运行，不需要锁）
+ */
+DetachedTask resolveQuery(PendingQuery query, ServerContext& server, UpstreamClient& upstream,
+                          std::pmr::memory_resource* memory)
+{
+    const uint8_t* requestData = query.packet.data();
+    size_t requestSize = query.packet.size();
+    
+    // 工作线程已经成功解析过同一个报文，这里不会失败
+    DNSHeader requestHeader;
+    if (DNSHeader::parse(requestData, requestSize, requestHeader) != ParseError::NONE) co_return;
+    size_t offset = 12;
+    std::pmr::vector<DNSQuestion> questions(memory);
+    for (uint16_t i = 0; i < requestHeader.qdcount; i++)
+    {
+        if (DNSQuestion::parse(requestData, requestSize, offset, questions.emplace_back()) != ParseError::NONE) co_return;
+    }
+    
+    size_t count = questions.size();
+    std::pmr::vector<CacheResult> cached(count, memory);
+    std::pmr::vector<ForwardResult> forwarded(count, memory);
+    std::vector<bool> hit(count, false);
+    for (size_t i = 1; i < count; i++) hit[i] = server.cache.lookup(questions[i], cached[i]);
+    
+    for (int attempt = 0; attempt <= server.resolverRetries; attempt++)
+    {
+        // 先创建这一轮所有的查询（构造时发出），再逐个等待
+        std::deque<UpstreamClient::Query> queries;
+        std::vector<size_t> asked;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (hit[i] || forwarded[i].ok) continue;
+            queries.emplace_back(upstream, questions[i]);
+            asked.push_back(i);
+        }
+        if (asked.empty()) break;
+        
+        for (size_t k = 0; k < asked.size(); k++)
+        {
+            UpstreamClient::Reply reply = co_await queries[k];
+            if (reply.ok) forwarded[asked[k]] = parseForwardResponse(reply.packet.data(), reply.packet.size(), memory);
+        }
+    }
+    
+    DNSMessage response(memory);
+    initRecursiveResponse(response, requestHeader, count);
+    uint8_t upstreamRcode = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        response.questions.push_back(questions[i]);
+        if (!hit[i] && !forwarded[i].ok) hit[i] = server.cache.serveStale(questions[i], cached[i]);
+        appendResolution(response, upstreamRcode, questions[i], hit[i], cached[i], forwarded[i], server);
+    }
+    
+    SocketSender sender(query.udpSocket);
+    sendRecursiveResponse(response, upstreamRcode, questions, requestData, offset, query.clientAddress, *query.policy,
+                          sender);
+}
+
+/**
+ * batch 引擎的发送方式：响应暂存到本批结束时用 sendmmsg() 一起发出
+ */
+class BatchSender : public ResponseSender
+{
+public:
+    explicit BatchSender(UdpBatchIo& batch) : batch_(batch) {}
+
+    void send(const uint8_t* data, size_t size, const SocketAddress& clientAddress) override
+    {
+        batch_.queue(data, size, clientAddress);
+    }
+
+private:
+    UdpBatchIo& batch_;
+};
+
+/**
+ * io_uring 引擎的发送方式：响应放入提交队列；发送槽或 SQ 用完时直接 sendto()
+ */
+class UringSender : public ResponseSender
+{
+public:
+    UringSender(UringUdpEngine& engine, int udpSocket) : engine_(engine), fallback_(udpSocket) {}
+
+    void send(const uint8_t* data, size_t size, const SocketAddress& clientAddress) override
+    {
+        if (!engine_.send(data, size, clientAddress)) fallback_.send(data, size, clientAddress);
+    }
+
+private:
+    UringUdpEngine& engine_;
+    SocketSender fallback_;
+};
+
+/**
+ * 一个工作线程：在自己的套接字上循环接收查询并回复，直到 server.running 被清除
+ *
+ * 每个工作线程有自己的接收缓冲区和请求内存池，线程之间只共享 ServerContext 中的对象。
+ * --io-engine batch 时每次系统调用收发一批报文；--io-engine uring 时使用 io_uring，
+ * 内核不支持 io_uring 时回退到 recvfrom() 循环。
+ */
+void serveUdp(unsigned worker, int udpSocket, SocketCounters& counters, const ListenerPolicy& policy, ServerContext& server)
+{
+    QueryScratch scratch;
+    scratch.worker = worker;
+    scratch.udpSocket = udpSocket;
+    scratch.packets = &server.packets.attach();
+    QueryStage stage = server.resolverStage != nullptr ? QueryStage::RECEIVE : QueryStage::INLINE;
+    
+    if (server.ioEngine == IoEngine::BATCH)
+    {
+        UdpBatchIo batch(udpSocket, server.udpOffload, server.hugePages);
+        BatchSender sender(batch);
+        if (server.udpOffload && (!batch.gro() || !batch.gso()))
+        {
+            std::cerr << "UDP offload partially unavailable: GRO " << (batch.gro() ? "on" : "off") << ", GSO "
+                      << (batch.gso() ? "on" : "off") << std::endl;
+        }
+        
+        uint64_t reported = 0;
+        while (true)
+        {
+            int received = batch.receive();
+            // 退出时主线程对套接字调用 shutdown()，阻塞中的 recvmmsg() 返回一个空报文
+            if (!server.running.load(std::memory_order_relaxed)) break;
+            if (received < 0)
+            {
+                if (errno == EINTR) continue;
+                perror("Error receiving data");
+                kill(getpid(), SIGTERM);
+                break;
+            }
+            
+            batch.forEachPacket([&](const uint8_t* data, size_t size, const SocketAddress& clientAddress) {
+                counters.packets.fetch_add(1, std::memory_order_relaxed);
+                handleQuery(data, size, clientAddress, policy, server, scratch, sender, stage);
+            });
+            batch.flush();
+            counters.drops.store(batch.drops(), std::memory_order_relaxed);
+            
+            if (batch.coalesced() != reported)
+            {
+                server.gsoCoalesced.fetch_add(batch.coalesced() - reported, std::memory_order_relaxed);
+                reported = batch.coalesced();
+            }
+        }
+        return;
+    }
+    
+    if (server.ioEngine == IoEngine::URING)
+    {
+        UringUdpEngine engine(*scratch.packets, server.hugePages);
+        UringSender sender(engine, udpSocket);
+        std::string error;
+        bool finished = engine.start(udpSocket, error) &&
+                        engine.run([&](const uint8_t* data, size_t size, const SocketAddress& clientAddress) {
+                                       counters.packets.fetch_add(1, std::memory_order_relaxed);
+                                       handleQuery(data, size, clientAddress, policy, server, scratch, sender, stage);
+                                   },
+                                   [&] {
+                                       counters.drops.store(engine.drops(), std::memory_order_relaxed);
+                                       return server.running.load(std::memory_order_relaxed);
+                                   },
+                                   error);
+        if (finished) return;
+        std::cerr << "io_uring unavailable (" << error << "), falling back to recvfrom()" << std::endl;
+    }
+    
+    SocketSender sender(udpSocket);
+    int bytesRead;                              // 接收到的字节数
+                                                // 接收缓冲区是 scratch.receive（报文缓冲区池，EDNS 大小）
+    SocketAddress clientAddress;                // 客户端地址
+    alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(uint32_t))];  // SO_RXQ_OVFL 丢包计数
+    iovec iov{};
+    msghdr header{};
+    uint32_t drops = 0;
+
+    while (true) 
+    {
+        // ---------- 1. 接收 DNS 查询 ----------
+        // recvmsg() 从 UDP socket 接收数据（与 recvfrom() 相同，另外带回控制信息）
+        // 参数说明（msghdr 的字段）：
+        //   - msg_iov: 存放接收数据的缓冲区
+        //   - msg_name: [输出] 发送方的地址信息
+        //   - msg_namelen: [输入/输出] 地址结构体的大小（每次都要重置为缓冲区大小）
+        //   - msg_control: [输出] 控制信息，这里是 SO_RXQ_OVFL 的累计丢包数
+        // 返回值：接收到的字节数，-1 表示错误
+        // 上一个报文交给了解析线程时，缓冲区已经被移走，换一个新的
+        if (!scratch.receive) scratch.receive = scratch.packets->acquire();
+        iov = iovec{ scratch.receive.data(), scratch.receive.capacity() };
+        header.msg_name = clientAddress.data();
+        header.msg_namelen = sizeof(clientAddress.storage);
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+        bytesRead = recvmsg(udpSocket, &header, 0);
+        clientAddress.length = header.msg_namelen;
+        if (bytesRead <= 0)
+        {
+            // 退出时主线程对套接字调用 shutdown()，阻塞中的 recvmsg() 返回 0
+            if (!server.running.load(std::memory_order_relaxed)) break;
+            if (bytesRead == 0 || errno == EINTR) continue;
+            perror("Error receiving data");  // perror() 打印错误信息，自动附加 errno 描述
+            kill(getpid(), SIGTERM);         // 让主线程走正常的退出流程（保存快照）
+            break;
+        }
+
+        if (readDropCount(header, drops)) counters.drops.store(drops, std::memory_order_relaxed);
+        counters.packets.fetch_add(1, std::memory_order_relaxed);
+        scratch.receive.resize(static_cast<size_t>(bytesRead));
+        handleQuery(scratch.receive.data(), static_cast<size_t>(bytesRead), clientAddress, policy, server, scratch, sender,
+                    stage);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // ==================== 1. 初始化输出设置 ====================
+    // 设置 std::cout 和 std::cerr 为无缓冲模式
+    // std::unitbuf 会在每次输出操作后自动刷新缓冲区
+    // 这确保调试信息能够立即显示，而不是等缓冲区满了才输出
+    std::cout << std::unitbuf;
+    std::cerr << std::unitbuf;
+
+    // 禁用 C 标准库的 stdout 缓冲
+    // 与上面的设置配合，确保所有输出都是即时的
+    setbuf(stdout, NULL);
+
+    // 调试信息，用于确认程序已启动
+    std::cout << "Logs from your program will appear here!" << std::endl;
+    
+    // ==================== 1.5 解析命令行参数 ====================
+    // 格式: ./your_server [--resolver <ip>:<port> | [<ipv6>]:<port>] [--zone <file>]
+    //                      [--cache-size <bytes>] [--negative-cache-size <bytes>]
+    //                      [--prefetch-hits <n>] [--serve-stale <seconds>]
+    //                      [--resolver-timeout <ms>] [--resolver-retries <n>] [--stats-interval <seconds>]
+    //                      [--cache-file <path>] [--cache-save-interval <seconds>]
+    //                      [--rrl-rate <responses/s>] [--rrl-slip <n>]
+    //                      [--rrl-ipv4-prefix <bits>] [--rrl-ipv6-prefix <bits>] [--rrl-table-size <buckets>]
+    //                      [--allow <prefix>] [--deny <prefix>] [--refuse <prefix>]
+    //                      [--allow-recursion <prefix>]
+    //                      [--listen <addr>[:<port>][,workers=N][,cpus=a-b+c][,steer=cpu|hash]
+    //                                [,recursion=off][,rrl=off][,acl=off]]...
+    //                      [--io-engine socket|batch|uring] [--udp-offload on|off]
+    //                      [--socket-tuning latency|throughput] [--rcvbuf <bytes>] [--sndbuf <bytes>]
+    //                      [--busy-poll <usec>] [--cache-shards <n>] [--resolver-threads <n>]
+    //                      [--huge-pages off|transparent|explicit]
+    SocketAddress resolverAddress;               // 上游 DNS 服务器（IPv4 或 IPv6）
+    bool hasResolver = false;
+    std::string zoneFile;
+    CacheOptions cacheOptions;                   // 缓存预算 / 预取 / serve-stale 配置
+    int resolverTimeoutMs = 1500;                // 等待上游响应的超时时间
+    int resolverRetries = 1;                     // --resolver-retries：解析线程中超时后重发的次数
+    int statsInterval = 0;                       // 统计报告间隔（秒），0 = 不报告
+    std::string cacheFile;                       // 缓存快照文件，空 = 不持久化
+    int cacheSaveInterval = 0;                   // 周期性保存快照的间隔（秒），0 = 只在退出时保存
+    RrlOptions rrlOptions;                       // 响应限速配置（默认关闭）
+    AccessList queryAcl;                         // 谁可以查询（allow / deny / refuse）
+    AccessList recursionAcl;                     // 谁可以通过 --resolver 递归
+    std::string aclError;
+    std::vector<ListenerConfig> listeners;       // 每个 --listen 一个；没有指定时使用 [::]:2053
+    IoEngine ioEngine = IoEngine::SOCKET;        // --io-engine：socket / batch / uring
+    bool udpOffload = true;                      // --udp-offload off：batch 引擎不使用 GRO / GSO
+    SocketTuning socketTuning;                   // --socket-tuning 预设（默认全部保持内核默认值）
+    int receiveBuffer = -1;                      // --rcvbuf / --sndbuf / --busy-poll，-1 = 使用预设
+    int sendBuffer = -1;
+    int busyPollMicros = -1;
+    unsigned resolverThreads = 0;                // --resolver-threads：缓存未命中交给这些线程转发，0 = 工作线程自己转发
+    unsigned cacheShards = 1;                    // --cache-shards：缓存分片数（与 steer=hash 的 workers 相同时每个工作线程独占一个分片）
+    HugePageMode hugePages = HugePageMode::OFF;  // --huge-pages：缓存和接收缓冲区的页面（explicit 不可用时回退到 transparent）
+    
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--resolver" && i + 1 < argc)
+        {
+            std::string resolverText = argv[++i];
+            if (!SocketAddress::parse(resolverText, 53, resolverAddress))
+            {
+                std::cerr << "Invalid resolver address: " << resolverText << std::endl;
+                return 1;
+            }
+            hasResolver = true;
+        }
+        else if (std::string(argv[i]) == "--zone" && i + 1 < argc)
+        {
+            zoneFile = argv[++i];
+        }
+        else if (std::string(argv[i]) == "--cache-size" && i + 1 < argc)
+        {
+            cacheOptions.positiveBudget = std::stoull(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--negative-cache-size" && i + 1 < argc)
+        {
+            cacheOptions.negativeBudget = std::stoull(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--prefetch-hits" && i + 1 < argc)
+        {
+            cacheOptions.prefetchHits = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (std::string(argv[i]) == "--serve-stale" && i + 1 < argc)
+        {
+            cacheOptions.serveStaleSeconds = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (std::string(argv[i]) == "--resolver-timeout" && i + 1 < argc)
+        {
+            resolverTimeoutMs = std::stoi(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--resolver-retries" && i + 1 < argc)
+        {
+            resolverRetries = std::stoi(argv[++i]);
+            if (resolverRetries < 0 || resolverRetries > 10)
+            {
+                std::cerr << "Invalid resolver retry count: " << argv[i] << " (expected 0-10)" << std::endl;
+                return 1;
+            }
+        }
+        else if (std::string(argv[i]) == "--stats-interval" && i + 1 < argc)
+        {
+            statsInterval = std::stoi(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--cache-file" && i + 1 < argc)
+        {
+            cacheFile = argv[++i];
+        }
+        else if (std::string(argv[i]) == "--cache-save-interval" && i + 1 < argc)
+        {
+            cacheSaveInterval = std::stoi(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--rrl-rate" && i + 1 < argc)
+        {
+            rrlOptions.responsesPerSecond = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (std::string(argv[i]) == "--rrl-slip" && i + 1 < argc)
+        {
+            rrlOptions.slip = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (std::string(argv[i]) == "--rrl-ipv4-prefix" && i + 1 < argc)
+        {
+            rrlOptions.ipv4PrefixLength = static_cast<uint8_t>(std::stoul(argv[++i]));
+        }
+        else if (std::string(argv[i]) == "--rrl-ipv6-prefix" && i + 1 < argc)
+        {
+            rrlOptions.ipv6PrefixLength = static_cast<uint8_t>(std::stoul(argv[++i]));
+        }
+        else if (std::string(argv[i]) == "--rrl-table-size" && i + 1 < argc)
+        {
+            rrlOptions.tableSize = std::stoull(argv[++i]);
+        }
+        else if ((std::string(argv[i]) == "--allow" || std::string(argv[i]) == "--deny" ||
+                  std::string(argv[i]) == "--refuse") && i + 1 < argc)
+        {
+            AclAction action = std::string(argv[i]) == "--allow" ? AclAction::ALLOW
+                             : std::string(argv[i]) == "--deny"  ? AclAction::DENY
+                                                                 : AclAction::REFUSE;
+            if (!queryAcl.add(action, argv[++i], aclError))
+            {
+                std::cerr << aclError << std::endl;
+                return 1;
+            }
+        }
+        else if (std::string(argv[i]) == "--allow-recursion" && i + 1 < argc)
+        {
+            if (!recursionAcl.add(AclAction::ALLOW, argv[++i], aclError))
+            {
+                std::cerr << aclError << std::endl;
+                return 1;
+            }
+        }
+        else if (std::string(argv[i]) == "--io-engine" && i + 1 < argc)
+        {
+            std::string engine = argv[++i];
+            if (engine != "socket" && engine != "batch" && engine != "uring")
+            {
+                std::cerr << "Invalid I/O engine: " << engine << " (expected socket, batch or uring)" << std::endl;
+                return 1;
+            }
+            ioEngine = engine == "uring" ? IoEngine::URING : engine == "batch" ? IoEngine::BATCH : IoEngine::SOCKET;
+        }
+        else if (std::string(argv[i]) == "--udp-offload" && i + 1 < argc)
+        {
+            udpOffload = std::string(argv[++i]) != "off";
+        }
+        else if (std::string(argv[i]) == "--resolver-threads" && i + 1 < argc)
+        {
+            resolverThreads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (std::string(argv[i]) == "--cache-shards" && i + 1 < argc)
+        {
+            cacheShards = static_cast<unsigned>(std::stoul(argv[++i]));
+            if (cacheShards == 0 || cacheShards > 1024)
+            {
+                std::cerr << "Invalid cache shard count: " << argv[i] << " (expected 1-1024)" << std::endl;
+                return 1;
+            }
+        }
+        else if (std::string(argv[i]) == "--huge-pages" && i + 1 < argc)
+        {
+            std::string mode = argv[++i];
+            if (!HugePageRegion::parseMode(mode, hugePages))
+            {
+                std::cerr << "Invalid huge page mode: " << mode << " (expected off, transparent or explicit)" << std::endl;
+                return 1;
+            }
+        }
+        else if (std::string(argv[i]) == "--socket-tuning" && i + 1 < argc)
+        {
+            std::string profile = argv[++i];
+            if (!SocketTuning::preset(profile, socketTuning))
+            {
+                std::cerr << "Invalid socket tuning profile: " << profile << " (expected latency or throughput)" << std::endl;
+                return 1;
+            }
+        }
+        else if (std::string(argv[i]) == "--rcvbuf" && i + 1 < argc)
+        {
+            receiveBuffer = std::stoi(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--sndbuf" && i + 1 < argc)
+        {
+            sendBuffer = std::stoi(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--busy-poll" && i + 1 < argc)
+        {
+            busyPollMicros = std::stoi(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--listen" && i + 1 < argc)
+        {
+            std::string listenError;
+            if (!ListenerConfig::parse(argv[++i], listeners.emplace_back(), listenError))
+            {
+                std::cerr << listenError << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (listeners.empty()) listeners.push_back(ListenerConfig::defaultListener());
+    
+    // NUMA 拓扑：cpus=nodeN 展开成节点上的 CPU；nic=eth0 且没有 cpus 时使用处理接收队列中断的 CPU
+    NumaTopology topology = NumaTopology::detect();
+    std::cout << "NUMA: " << topology.format() << std::endl;
+    for (ListenerConfig& config : listeners)
+    {
+        if (config.node >= 0)
+        {
+            if (!topology.hasNode(config.node))
+            {
+                std::cerr << "Listener " << config.text << ": no NUMA node " << config.node << std::endl;
+                return 1;
+            }
+            config.cpus = topology.cpusOf(config.node);
+        }
+        if (!config.nic.empty() && config.cpus.empty())
+        {
+            config.cpus = NumaTopology::rxQueueCpus(config.nic);
+            if (config.cpus.empty()) config.cpus = topology.cpusOf(NumaTopology::deviceNode(config.nic));
+            if (config.cpus.empty())
+            {
+                std::cerr << "Listener " << config.text << ": no interrupt or NUMA information for " << config.nic
+                          << ", workers are not pinned" << std::endl;
+            }
+        }
+    }
+    if (receiveBuffer >= 0) socketTuning.receiveBuffer = receiveBuffer;
+    if (sendBuffer >= 0) socketTuning.sendBuffer = sendBuffer;
+    if (busyPollMicros >= 0) socketTuning.busyPollMicros = busyPollMicros;
+    
+    // 编译 ACL 前缀树：有 allow 规则时名单外的地址默认 REFUSED，否则默认允许；
+    // 指定了 --allow-recursion 时，名单外的地址只能得到权威区域的回答，递归查询回复 REFUSED
+    queryAcl.compile(queryAcl.hasAllowRule() ? AclAction::REFUSE : AclAction::ALLOW);
+    recursionAcl.compile(recursionAcl.empty() ? AclAction::ALLOW : AclAction::REFUSE);
+    if (!queryAcl.empty() || !recursionAcl.empty())
+    {
+        std::cout << "Access control: " << queryAcl.ruleCount() << " query rules, "
+                  << recursionAcl.ruleCount() << " recursion rules ("
+                  << queryAcl.nodeCount() + recursionAcl.nodeCount() << " trie nodes)" << std::endl;
+    }
+    
+    // 加载权威区域，并为每个 RRset 预渲染响应包
+    AuthZone zone;
+    bool zoneLoaded = false;
+    if (!zoneFile.empty())
+    {
+        std::string error;
+        if (!zone.load(zoneFile, error))
+        {
+            std::cerr << "Zone load failed: " << error << std::endl;
+            return 1;
+        }
+        zoneLoaded = true;
+        std::cout << "Loaded zone " << zoneFile << ": " << zone.recordCount() << " records, "
+                  << zone.responseCount() << " precomputed responses" << std::endl;
+    }
+    
+    if (hasResolver)
+    {
+        std::cout << "Using resolver: " << resolverAddress.toString() << std::endl;
+    }
+    
+    // 上游回答缓存：正向和否定条目各自独立的内存预算；--cache-shards 时按名字分成多个独立的缓存
+    // 分片 i 放在工作线程 i 所在的 NUMA 节点上（按绑定了 CPU 的监听器，优先 steer=hash 的：它的工作线程 i 只访问分片 i）
+    std::vector<int> shardNodes;
+    const ListenerConfig* shardOwner = nullptr;
+    for (const ListenerConfig& config : listeners)
+    {
+        if (config.cpus.empty()) continue;
+        if (shardOwner == nullptr || (config.steering == SteeringMode::HASH && shardOwner->steering != SteeringMode::HASH))
+        {
+            shardOwner = &config;
+        }
+    }
+    for (unsigned i = 0; shardOwner != nullptr && cacheShards > 1 && i < cacheShards; i++)
+    {
+        shardNodes.push_back(topology.nodeOf(shardOwner->cpus[i % shardOwner->cpus.size()]));
+    }
+    cacheOptions.hugePages = hugePages;
+    ShardedCache cache(cacheOptions, cacheShards, shardNodes);
+    
+    // 报文缓冲区池：每个工作线程、解析线程和预取线程各自 attach()，slab 在各自的线程中分配
+    PacketPool packetPool(hugePages);
+    if (cache.shardCount() > 1)
+    {
+        std::cout << "Cache: " << cache.shardCount() << " shards, "
+                  << cacheOptions.positiveBudget / cache.shardCount() / (1024 * 1024) << " MiB each";
+        if (!shardNodes.empty() && topology.nodeCount() > 1)
+        {
+            std::cout << ", nodes";
+            for (int node : shardNodes) std::cout << " " << node;
+        }
+        std::cout << std::endl;
+    }
+    
+    // 热启动：从上次退出时保存的快照恢复缓存，剩余 TTL 按停机时间扣减
+    if (!cacheFile.empty())
+    {
+        std::string error;
+        long loaded = cache.loadSnapshot(cacheFile, error);
+        if (loaded < 0)
+        {
+            std::cerr << "Cache snapshot not loaded: " << error << std::endl;
+        }
+        else
+        {
+            std::cout << "Loaded " << loaded << " cache entries from " << cacheFile << std::endl;
+            if (!error.empty()) std::cerr << "Cache snapshot: " << error << std::endl;
+        }
+    }
+
+    // 大页：此时已经分配了频率草图、索引的桶数组（以及快照条目所在的区域）；
+    // 工作线程的接收缓冲区稍后在各自的线程中分配，之后的统计报告中包含它们
+    if (hugePages != HugePageMode::OFF)
+    {
+        std::cout << "Huge pages " << (hugePages == HugePageMode::EXPLICIT ? "explicit" : "transparent")
+                  << " requested, " << HugePageRegion::format() << std::endl;
+    }
+
+    // 响应限速：按 (客户端网段, 名字, 类型, RCODE) 计数，超限的响应截断或丢弃
+    ResponseRateLimiter rateLimiter(rrlOptions);
+    if (rateLimiter.enabled())
+    {
+        std::cout << "Response rate limiting: " << rateLimiter.options().responsesPerSecond << "/s per /"
+                  << static_cast<int>(rateLimiter.options().ipv4PrefixLength) << " (IPv6 /"
+                  << static_cast<int>(rateLimiter.options().ipv6PrefixLength) << "), slip "
+                  << rateLimiter.options().slip << std::endl;
+    }
+    
+    // ==================== 2. 为每个监听器创建套接字 ====================
+    // 每个工作线程一个套接字，同一监听器的套接字用 SO_REUSEPORT 绑定到同一地址，
+    // 内核按 (源地址, 源端口) 哈希把报文分给其中一个，线程之间不共享接收队列
+    // 关闭的功能换成“什么都不做”的对象（见 ListenerPolicy），处理报文时不需要判断开关
+    AccessList allowAll;                         // acl=off：全部允许
+    AccessList refuseAll;                        // recursion=off：区域之外的名字全部 REFUSED
+    refuseAll.compile(AclAction::REFUSE);
+    ResponseRateLimiter noRateLimit{ RrlOptions{} };  // rrl=off：不限速
+    
+    struct ListenerSockets
+    {
+        ListenerPolicy policy;
+        std::vector<int> sockets;
+        std::deque<SocketCounters> counters;   // 与 sockets 一一对应（atomic 不能移动，所以用 deque）
+    };
+    std::deque<ListenerSockets> bound;
+    for (ListenerConfig& config : listeners)
+    {
+        ListenerSockets& listener = bound.emplace_back();
+        listener.policy.queryAcl = config.acl ? &queryAcl : &allowAll;
+        listener.policy.recursionAcl = !config.recursion ? &refuseAll : config.acl ? &recursionAcl : &allowAll;
+        listener.policy.rateLimiter = config.rateLimit ? &rateLimiter : &noRateLimit;
+        for (int w = 0; w < config.workers; w++)
+        {
+            std::string error;
+            int udpSocket = openListenSocket(config.address, error);
+            if (udpSocket == -1)
+            {
+                std::cerr << "Listener " << config.text << ": " << error << std::endl;
+                return 1;
+            }
+            // 套接字的 CPU 与工作线程绑定的 CPU 一致（第 w 个工作线程绑定 cpus[w % cpus.size()]）
+            std::string warning;
+            int cpu = config.cpus.empty() ? -1 : config.cpus[w % config.cpus.size()];
+            tuneSocket(udpSocket, socketTuning, cpu, warning);
+            if (!warning.empty() && w == 0)
+            {
+                std::cerr << "Listener " << config.text << ": socket tuning: " << warning << std::endl;
+            }
+            listener.sockets.push_back(udpSocket);
+            listener.counters.emplace_back();
+        }
+
+        // 所有套接字都加入 reuseport 组之后再挂分流程序；失败时保留内核的哈希分流
+        bool steered = false;
+        if (config.steering != SteeringMode::NONE && config.workers > 1)
+        {
+            std::string error;
+            steered = ReuseportSteering::attach(listener.sockets[0], config.steering, config.workers, config.cpus,
+                                                topology.cpuNodes(), error);
+            if (!steered)
+            {
+                std::cerr << "Listener " << config.text << ": steer=" << ReuseportSteering::name(config.steering)
+                          << " unavailable, using kernel hash: " << error << std::endl;
+            }
+        }
+        
+        // 通配地址说明是否双栈：[::] 同时接收 IPv4，0.0.0.0（内核不支持 IPv6 时的回退）只有 IPv4
+        std::cout << "Listening on " << config.address.toString();
+        if (config.address.family() == AF_INET6 && IN6_IS_ADDR_UNSPECIFIED(&config.address.ipv6().sin6_addr))
+        {
+            std::cout << " (dual-stack)";
+        }
+        else if (config.address.family() == AF_INET && config.address.ipv4().sin_addr.s_addr == htonl(INADDR_ANY))
+        {
+            std::cout << " (IPv4 only)";
+        }
+        std::cout << ", " << config.workers << (config.workers == 1 ? " worker" : " workers");
+        if (!config.cpus.empty())
+        {
+            std::vector<int> nodes;
+            for (int cpu : config.cpus)
+            {
+                if (std::find(nodes.begin(), nodes.end(), topology.nodeOf(cpu)) == nodes.end()) nodes.push_back(topology.nodeOf(cpu));
+            }
+            std::cout << ", cpus " << NumaTopology::formatCpuList(config.cpus) << (nodes.size() == 1 ? " (node" : " (nodes");
+            for (int node : nodes) std::cout << " " << node;
+            std::cout << ")";
+        }
+        if (!config.nic.empty())
+        {
+            std::cout << ", nic " << config.nic << " (node " << NumaTopology::deviceNode(config.nic) << ", rx queue cpus "
+                      << NumaTopology::formatCpuList(NumaTopology::rxQueueCpus(config.nic)) << ")";
+        }
+        if (steered) std::cout << ", steer " << ReuseportSteering::name(config.steering);
+        if (steered && config.steering == SteeringMode::HASH && cache.shardCount() > 1 &&
+            static_cast<unsigned>(config.workers) != cache.shardCount())
+        {
+            // 工作线程 = hash % workers，分片 = hash % shards，两者不同时名字与分片对不上
+            std::cout << " (" << config.workers << " workers != " << cache.shardCount() << " cache shards, shards are shared)";
+        }
+        if (!config.recursion) std::cout << ", recursion off";
+        if (!config.rateLimit && rateLimiter.enabled()) std::cout << ", rrl off";
+        if (!config.acl && (!queryAcl.empty() || !recursionAcl.empty())) std::cout << ", acl off";
+        if (socketTuning.receiveBuffer > 0 || socketTuning.sendBuffer > 0 || socketTuning.busyPollMicros > 0)
+        {
+            std::cout << ", " << describeSocket(listener.sockets[0]);
+        }
+        std::cout << std::endl;
+    }
+    
+    // SIGTERM / SIGINT：所有线程创建前先屏蔽（新线程继承屏蔽字），
+    // 之后只由主线程在 sigsuspend() 中接收
+    struct sigaction stopAction{};
+    stopAction.sa_handler = handleStopSignal;
+    sigemptyset(&stopAction.sa_mask);
+    sigaction(SIGTERM, &stopAction, nullptr);
+    sigaction(SIGINT, &stopAction, nullptr);
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGTERM);
+    sigaddset(&stopSignals, SIGINT);
+    sigset_t waitMask;                           // sigsuspend() 期间的屏蔽字：不屏蔽 SIGTERM / SIGINT
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &waitMask);
+    sigdelset(&waitMask, SIGTERM);
+    sigdelset(&waitMask, SIGINT);
+    
+    // 后台预取：热门条目进入 TTL 最后 10% 时在后台刷新；
+    // serve-stale 时也由它在后台反复重试已过期的条目。
+    // 结果直接写入缓存，所以查询 ID 同样是随机的（递增的 ID 可以被路径外的攻击者预测）
+    PacketPool::Cache* prefetchPackets = nullptr;   // 只在预取线程中使用
+    Prefetcher prefetcher([&](const DNSQuestion& question) {
+        if (prefetchPackets == nullptr) prefetchPackets = &packetPool.attach();
+        ForwardResult forwarded = forwardQuery(resolverAddress, question, randomQueryId(), resolverTimeoutMs, *prefetchPackets);
+        if (forwarded.ok)
+        {
+            cacheForwardResult(cache, question, forwarded);
+        }
+        else
+        {
+            cache.prefetchFailed(question);
+        }
+    });
+    
+    // batch 引擎中 GSO 合并的响应数，由工作线程累加
+    std::atomic<uint64_t> gsoCoalesced{ 0 };
+    
+    // 周期性统计报告：按段输出缓存命中率（main 返回时 jthread 自动请求停止并等待退出）
+    std::jthread statsReporter;
+    if (statsInterval > 0)
+    {
+        statsReporter = std::jthread([&](std::stop_token stop) {
+            std::mutex sleepMutex;
+            std::condition_variable_any sleeper;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            while (!sleeper.wait_for(lock, stop, std::chrono::seconds(statsInterval), [] { return false; }) &&
+                   !stop.stop_requested())
+            {
+                std::cout << DnsCache::format(cache.stats()) << std::endl;
+                if (cache.shardCount() > 1) std::cout << cache.formatShards() << std::endl;
+                if (hugePages != HugePageMode::OFF) std::cout << HugePageRegion::format() << std::endl;
+                std::cout << packetPool.format() << std::endl;
+                if (rateLimiter.enabled()) std::cout << ResponseRateLimiter::format(rateLimiter.stats()) << std::endl;
+                if (ioEngine == IoEngine::BATCH && udpOffload)
+                {
+                    std::cout << "udp: gso coalesced=" << gsoCoalesced.load(std::memory_order_relaxed) << std::endl;
+                }
+                // 每个监听器的查询数和内核丢包（SO_RXQ_OVFL），括号内是各工作线程套接字的计数
+                //   示例：udp [::]:2053: packets=90210 (30011 29876 30323) rxq drops=1532 (1200 0 332)
+                for (size_t l = 0; l < bound.size(); l++)
+                {
+                    uint64_t totalPackets = 0, totalDrops = 0;
+                    std::string packets, drops;
+                    for (const SocketCounters& counters : bound[l].counters)
+                    {
+                        uint64_t socketPackets = counters.packets.load(std::memory_order_relaxed);
+                        uint32_t socketDrops = counters.drops.load(std::memory_order_relaxed);
+                        totalPackets += socketPackets;
+                        totalDrops += socketDrops;
+                        packets += (packets.empty() ? "" : " ") + std::to_string(socketPackets);
+                        drops += (drops.empty() ? "" : " ") + std::to_string(socketDrops);
+                    }
+                    bool perSocket = bound[l].counters.size() > 1;
+                    std::cout << "udp " << listeners[l].address.toString() << ": packets=" << totalPackets;
+                    if (perSocket) std::cout << " (" << packets << ")";
+                    std::cout << " rxq drops=" << totalDrops;
+                    if (perSocket) std::cout << " (" << drops << ")";
+                    std::cout << std::endl;
+                }
+            }
+        });
+    }
+    
+    // 周期性保存快照：进程被 SIGKILL 或崩溃时，最多丢失一个间隔内的变化
+    std::jthread snapshotWriter;
+    if (!cacheFile.empty() && cacheSaveInterval > 0)
+    {
+        snapshotWriter = std::jthread([&](std::stop_token stop) {
+            std::mutex sleepMutex;
+            std::condition_variable_any sleeper;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            while (!sleeper.wait_for(lock, stop, std::chrono::seconds(cacheSaveInterval), [] { return false; }) &&
+                   !stop.stop_requested())
+            {
+                saveCacheSnapshot(cache, cacheFile);
+            }
+        });
+    }
+    
+    // ==================== 3. 启动工作线程 ====================
+    // cpus=... 时工作线程依次绑定到列出的 CPU，不同监听器的流量因此落在不同的核上（以及各自的 NUMA 节点上）
+    if (ioEngine == IoEngine::URING) std::cout << "I/O engine: io_uring (multishot recvmsg, batched sendmsg)" << std::endl;
+    if (ioEngine == IoEngine::BATCH)
+    {
+        std::cout << "I/O engine: recvmmsg / sendmmsg, " << UdpBatchIo::BATCH_SIZE << " packets per call"
+                  << (udpOffload ? ", UDP GRO / GSO" : "") << std::endl;
+    }
+    ServerContext server{ zone, zoneLoaded, cache, prefetcher, resolverAddress, hasResolver, resolverTimeoutMs,
+                          resolverRetries, ioEngine, udpOffload, hugePages, packetPool, gsoCoalesced };
+    
+    // 解析线程：工作线程把缓存未命中的查询放进 SpscRing（每个工作线程 x 每个解析线程一个），
+    // 上游的往返时间不再阻塞接收。每个解析线程运行一个 epoll 事件循环，每个请求是一个协程（resolveQuery()），
+    // 等待上游时挂起，一个线程可以同时等待成千上万个上游查询；同一个问题总是交给同一个解析线程，只转发一次
+    std::optional<HandoffStage<PendingQuery>> resolverStage;
+    if (resolverThreads > 0 && hasResolver)
+    {
+        using ResolverStage = HandoffStage<PendingQuery>;
+        unsigned workerCount = 0;
+        for (const ListenerSockets& listener : bound) workerCount += static_cast<unsigned>(listener.sockets.size());
+        resolverStage.emplace(workerCount, resolverThreads, 1024, [&](ResolverStage::Inbox& inbox) {
+            EventLoop loop;
+            std::pmr::unsynchronized_pool_resource memory;   // 先于 upstream 创建：协程帧析构时还要用
+            PacketPool::Cache& packets = server.packets.attach();
+            UpstreamClient upstream(loop, server.resolverAddress, server.resolverTimeoutMs, packets);
+            loop.watch(inbox.doorbell().fd(), [&] { inbox.doorbell().clear(); });
+            
+            PendingQuery batch[ResolverStage::BATCH_SIZE];
+            while (!inbox.stopping())
+            {
+                size_t count = inbox.popBatch(batch, ResolverStage::BATCH_SIZE);
+                for (size_t i = 0; i < count; i++) resolveQuery(std::move(batch[i]), server, upstream, &memory);
+                
+                // 队列为空时睡眠，直到门铃（新的请求）、上游的响应或最近的超时；否则只处理已经就绪的事件
+                if (count == 0) inbox.doorbell().sleep([&] { return inbox.hasWork(); }, [&] { loop.runOnce(-1); });
+                else loop.runOnce(0);
+            }
+            // 退出：upstream 析构时销毁仍在等待上游的协程（这些请求不再回复）
+        });
+        server.resolverStage = &*resolverStage;
+        std::cout << "Resolver threads: " << resolverThreads << " (" << workerCount << " workers, coroutines on epoll, "
+                  << resolverRetries << " retries after " << resolverTimeoutMs << " ms)" << std::endl;
+    }
+    
+    std::vector<std::jthread> workers;
+    for (size_t l = 0; l < bound.size(); l++)
+    {
+        const ListenerConfig& config = listeners[l];
+        for (size_t w = 0; w < bound[l].sockets.size(); w++)
+        {
+            // 工作线程先在自己的线程中绑定 CPU、设置本节点优先，再进入 serveUdp()：
+            // 接收缓冲区、请求内存池、io_uring 环都在这之后分配，落在工作线程所在的 NUMA 节点上
+            int cpu = config.cpus.empty() ? -1 : config.cpus[w % config.cpus.size()];
+            unsigned worker = static_cast<unsigned>(workers.size());
+            workers.emplace_back([&, l, w, cpu, worker, node = topology.nodeOf(cpu)] {
+                if (cpu >= 0)
+                {
+                    cpu_set_t cpus;
+                    CPU_ZERO(&cpus);
+                    CPU_SET(cpu, &cpus);
+                    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+                    if (error != 0)
+                    {
+                        std::cerr << "Listener " << config.text << ": pinning worker to cpu " << cpu << " failed: "
+                                  << strerror(error) << std::endl;
+                    }
+                    else
+                    {
+                        NumaTopology::preferNode(node);
+                    }
+                }
+                serveUdp(worker, bound[l].sockets[w], bound[l].counters[w], bound[l].policy, server);
+            });
+        }
+    }
+    
+    // ==================== 4. 等待退出信号 ====================
+    // sigsuspend() 原子地解除屏蔽并等待，信号不会在检查 stopRequested 与开始等待之间丢失
+    while (!stopRequested)
+    {
+        sigsuspend(&waitMask);
+    }
+    
+    // ==================== 5. 清理资源 ====================
+    // shutdown() 让阻塞在 recvfrom() 中的工作线程立即返回 0，它们看到 running == false 后退出
+    server.running.store(false);
+    for (const ListenerSockets& listener : bound)
+    {
+        for (int udpSocket : listener.sockets) shutdown(udpSocket, SHUT_RD);
+    }
+    workers.clear();  // 等待所有工作线程退出
+    resolverStage.reset();  // 解析线程在套接字关闭之前退出（正在等待上游的查询直接放弃）
+    
+    // 关闭 socket，释放系统资源
+    for (const ListenerSockets& listener : bound)
+    {
+        for (int udpSocket : listener.sockets) close(udpSocket);
+    }
+    
+    // 优雅退出：先停止周期性保存，再写最后一次快照
+    if (!cacheFile.empty())
+    {
+        snapshotWriter = std::jthread();
+        saveCacheSnapshot(cache, cacheFile);
+    }
 
     return 0;
 }
@@ -0,0 +1,39 @@
+/**
+ * 测试公共代码：CHECK() 与结果汇总
+ *
+ * 每个 tests/test_*.cpp 是一个独立的可执行文件（ctest 中一个用例），main() 依次调用各个用例函数，
+ * 最后 return checkResult("test_xxx")。CHECK() 失败时只记录并输出位置，继续执行后面的检查。
+ */
+
+#pragma once
+
+#include <iostream>
+
+inline int& checkFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                               \
+    do                                                                                                 \
+    {                                                                                                  \
+        if (!(condition))                                                                              \
+        {                                                                                              \
+            std::cerr << __func__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            checkFailures()++;                                                                         \
+        }                                                                                              \
+    } while (0)
+
+// 输出汇总，返回进程退出码（有失败时为 1）
+inline int checkResult(const char* name)
+{
+    int failures = checkFailures();
+    if (failures > 0)
+    {
+        std::cerr << failures << (failures == 1 ? " check failed" : " checks failed") << std::endl;
+        return 1;
+    }
+    std::cout << name << ": all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * ACL 前缀树的最长前缀匹配（ctest：test_acl）
+ *
+ * 重叠的 /8、/12、/24、/25 规则：/12 和 /25 不是 8 的倍数，在树中展开成连续的槽；
+ * 子节点继承父槽的动作，叶子上的动作必须是最长匹配的规则。
+ * IPv4 映射的 IPv6 地址（::ffff:a.b.c.d）按 IPv4 规则匹配。
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+#include "dns_acl.hpp"
+#include "check.hpp"
+
+static AclAction match(const AccessList& acl, const char* address)
+{
+    sockaddr_in6 client6{};
+    if (inet_pton(AF_INET6, address, &client6.sin6_addr) == 1)
+    {
+        client6.sin6_family = AF_INET6;
+        return acl.match(reinterpret_cast<const sockaddr*>(&client6));
+    }
+    sockaddr_in client{};
+    client.sin_family = AF_INET;
+    inet_pton(AF_INET, address, &client.sin_addr);
+    return acl.match(reinterpret_cast<const sockaddr*>(&client));
+}
+
+struct RuleText
+{
+    AclAction action;
+    const char* prefix;
+};
+
+// 按 rules 的顺序添加并编译
+static AccessList build(const std::vector<RuleText>& rules, AclAction unmatched)
+{
+    AccessList acl;
+    std::string error;
+    for (const RuleText& rule : rules) CHECK(acl.add(rule.action, rule.prefix, error));
+    acl.compile(unmatched);
+    return acl;
+}
+
+/**
+ *   allow  10.0.0.0/8          10.x.x.x
+ *   deny   10.16.0.0/12        10.16.0.0 ~ 10.31.255.255
+ *   refuse 10.20.30.0/24       10.20.30.0 ~ 10.20.30.255
+ *   allow  10.20.30.128/25     10.20.30.128 ~ 10.20.30.255（写成带主机位的 .200/25）
+ *   其他地址 deny
+ */
+static const std::vector<RuleText> OVERLAPPING = {
+    { AclAction::ALLOW, "10.0.0.0/8" },
+    { AclAction::DENY, "10.16.0.0/12" },
+    { AclAction::REFUSE, "10.20.30.0/24" },
+    { AclAction::ALLOW, "10.20.30.200/25" },
+};
+
+static void checkOverlapping(const AccessList& acl)
+{
+    CHECK(match(acl, "10.1.2.3") == AclAction::ALLOW);
+    CHECK(match(acl, "10.15.255.255") == AclAction::ALLOW);   // /12 的前一个地址
+    CHECK(match(acl, "10.16.0.0") == AclAction::DENY);        // /12 的第一个地址
+    CHECK(match(acl, "10.31.255.255") == AclAction::DENY);    // /12 的最后一个地址
+    CHECK(match(acl, "10.32.0.0") == AclAction::ALLOW);       // /12 的后一个地址
+    CHECK(match(acl, "10.20.29.255") == AclAction::DENY);
+    CHECK(match(acl, "10.20.30.0") == AclAction::REFUSE);
+    CHECK(match(acl, "10.20.30.127") == AclAction::REFUSE);   // /25 的前一个地址
+    CHECK(match(acl, "10.20.30.128") == AclAction::ALLOW);
+    CHECK(match(acl, "10.20.30.255") == AclAction::ALLOW);
+    CHECK(match(acl, "10.20.31.0") == AclAction::DENY);
+    CHECK(match(acl, "9.255.255.255") == AclAction::DENY);
+    CHECK(match(acl, "11.0.0.0") == AclAction::DENY);
+}
+
+// 最长前缀优先，与规则的书写顺序无关
+static void longestPrefix()
+{
+    checkOverlapping(build(OVERLAPPING, AclAction::DENY));
+    checkOverlapping(build(std::vector<RuleText>(OVERLAPPING.rbegin(), OVERLAPPING.rend()), AclAction::DENY));
+}
+
+// 前缀完全相同时后写的规则优先；/0 覆盖默认动作
+static void samePrefix()
+{
+    AccessList acl = build({ { AclAction::REFUSE, "0.0.0.0/0" },
+                             { AclAction::DENY, "192.0.2.0/24" },
+                             { AclAction::ALLOW, "192.0.2.0/24" } }, AclAction::DENY);
+    CHECK(match(acl, "192.0.2.1") == AclAction::ALLOW);
+    CHECK(match(acl, "198.51.100.1") == AclAction::REFUSE);
+    CHECK(match(acl, "2001:db8::1") == AclAction::DENY);   // IPv4 的 /0 不覆盖 IPv6
+}
+
+// IPv4 映射的 IPv6 地址按 IPv4 规则匹配；其他 IPv6 地址使用 IPv6 规则
+static void ipv4Mapped()
+{
+    std::vector<RuleText> rules = OVERLAPPING;
+    rules.push_back({ AclAction::REFUSE, "2001:db8::/32" });
+    rules.push_back({ AclAction::ALLOW, "2001:db8:1::/48" });
+    AccessList acl = build(rules, AclAction::DENY);
+
+    CHECK(match(acl, "::ffff:10.1.2.3") == AclAction::ALLOW);
+    CHECK(match(acl, "::ffff:10.16.0.1") == AclAction::DENY);
+    CHECK(match(acl, "::ffff:10.20.30.5") == AclAction::REFUSE);
+    CHECK(match(acl, "::ffff:10.20.30.200") == AclAction::ALLOW);
+    CHECK(match(acl, "::ffff:11.0.0.1") == AclAction::DENY);
+
+    CHECK(match(acl, "2001:db8:1::5") == AclAction::ALLOW);
+    CHECK(match(acl, "2001:db8:2::1") == AclAction::REFUSE);
+    CHECK(match(acl, "2001:db9::1") == AclAction::DENY);
+    CHECK(match(acl, "::10.1.2.3") == AclAction::DENY);   // IPv4 兼容地址（已废弃）不是映射地址
+}
+
+// 无法解析的前缀被拒绝
+static void invalidPrefix()
+{
+    AccessList acl;
+    std::string error;
+    CHECK(!acl.add(AclAction::DENY, "10.0.0.0/33", error));
+    CHECK(error.find("invalid length") != std::string::npos);
+    CHECK(!acl.add(AclAction::DENY, "10.0.0.0/", error));
+    CHECK(!acl.add(AclAction::DENY, "2001:db8::/129", error));
+    CHECK(!acl.add(AclAction::DENY, "example.com/8", error));
+    CHECK(error.find("invalid address") != std::string::npos);
+    CHECK(acl.empty());
+}
+
+int main()
+{
+    longestPrefix();
+    samePrefix();
+    ipv4Mapped();
+    invalidPrefix();
+
+    return checkResult("test_acl");
+}
@@ -0,0 +1,147 @@
+/**
+ * W-TinyLFU 准入与分段的测试（ctest：test_cache）
+ *
+ * 正向预算很小（只放得下几十个条目），否定预算很大：频率草图按两者之和确定宽度，
+ * 几十个名字在草图中几乎不会碰撞，频率比较的结果是确定的。
+ * 所有名字等长，每个条目估算的内存相同，容量 = 正向预算 / 单个条目的字节数。
+ */
+
+#include <cstdint>
+#include <cstdio>
+
+#include "dns_cache.hpp"
+#include "check.hpp"
+
+static CacheOptions smallOptions()
+{
+    CacheOptions options;
+    options.positiveBudget = 16 * 1024;
+    options.negativeBudget = 4 * 1024 * 1024;
+    options.prefetchHits = 0;
+    return options;
+}
+
+// 等长的名字："hot007.test"、"new000.test" ……
+static DNSQuestion question(const char* prefix, int index)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%s%03d.test", prefix, index);
+    DNSQuestion question;
+    question.name = name;
+    question.type = 1;
+    question.qclass = 1;
+    question.computeHash();
+    return question;
+}
+
+static std::pmr::vector<DNSAnswer> answerFor(const DNSQuestion& question)
+{
+    DNSAnswer record;
+    record.name = question.name;
+    record.type = 1;
+    record.aclass = 1;
+    record.ttl = 3600;
+    record.rdlength = 4;
+    record.rdata = { 192, 0, 2, 1 };
+    return std::pmr::vector<DNSAnswer>{ record };
+}
+
+static bool hit(DnsCache& cache, const DNSQuestion& question)
+{
+    CacheResult result;
+    return cache.lookup(question, result);
+}
+
+// 与转发路径相同：先查一次（未命中，草图记录一次访问），再写入
+static void missThenInsert(DnsCache& cache, const DNSQuestion& question)
+{
+    CHECK(!hit(cache, question));
+    cache.insertPositive(question, answerFor(question));
+}
+
+// 正向分区放得下多少个条目
+static size_t capacity()
+{
+    DnsCache probe(smallOptions());
+    probe.insertPositive(question("hot", 0), answerFor(question("hot", 0)));
+    CacheStats stats = probe.stats();
+    return stats.used[0] == 0 ? 0 : stats.budget[0] / stats.used[0];
+}
+
+/**
+ * 频率低的候选被拒绝，频率高的候选淘汰试用段尾部的条目
+ *
+ *   装满 hot000..：每个名字 1 次未命中 + 3 次命中，频率 4
+ *   new000：1 次未命中后写入，频率 1 < 4 -> 拒绝，热门名字全部保留
+ *   new001：10 次未命中后写入，频率 10 > 受害者 -> 准入，只淘汰一个热门名字
+ */
+static void admission()
+{
+    size_t entries = capacity();
+    CHECK(entries >= 8);
+    DnsCache cache(smallOptions());
+
+    for (size_t i = 0; i < entries; i++) missThenInsert(cache, question("hot", static_cast<int>(i)));
+    for (int round = 0; round < 3; round++)
+    {
+        for (size_t i = 0; i < entries; i++) CHECK(hit(cache, question("hot", static_cast<int>(i))));
+    }
+    CHECK(cache.stats().rejected == 0);
+
+    missThenInsert(cache, question("new", 0));
+    CacheStats stats = cache.stats();
+    CHECK(stats.rejected == 1);
+    CHECK(stats.admitted == 0);
+    for (size_t i = 0; i < entries; i++) CHECK(hit(cache, question("hot", static_cast<int>(i))));
+    CHECK(!hit(cache, question("new", 0)));
+
+    DNSQuestion warm = question("new", 1);
+    for (int i = 0; i < 9; i++) CHECK(!hit(cache, warm));
+    missThenInsert(cache, warm);
+    stats = cache.stats();
+    CHECK(stats.admitted == 1);
+    CHECK(stats.rejected == 1);
+    CHECK(hit(cache, warm));
+
+    size_t survivors = 0;
+    for (size_t i = 0; i < entries; i++) survivors += hit(cache, question("hot", static_cast<int>(i))) ? 1 : 0;
+    CHECK(survivors == entries - 1);
+}
+
+/**
+ * 保护段溢出时最旧的条目降级回试用段，而不是被淘汰
+ *
+ *   装满 hot000..，按顺序各命中一次：全部从试用段晋升到保护段，
+ *   保护段只占主区域的 80%，最先晋升的 hot000 被降级回试用段。
+ *   再次查询 hot000 记为试用段命中，最后晋升的名字记为保护段命中，所有名字都还在缓存中。
+ */
+static void protectedDemotion()
+{
+    size_t entries = capacity();
+    CHECK(entries >= 8);
+    DnsCache cache(smallOptions());
+
+    for (size_t i = 0; i < entries; i++) missThenInsert(cache, question("hot", static_cast<int>(i)));
+    for (size_t i = 0; i < entries; i++) CHECK(hit(cache, question("hot", static_cast<int>(i))));
+    CacheStats before = cache.stats();
+    CHECK(before.hits[0][1] == entries);   // 第一次命中都在试用段
+    CHECK(before.hits[0][2] == 0);
+
+    CHECK(hit(cache, question("hot", 0)));
+    CacheStats after = cache.stats();
+    CHECK(after.hits[0][1] == before.hits[0][1] + 1);
+
+    CHECK(hit(cache, question("hot", static_cast<int>(entries - 1))));
+    CHECK(cache.stats().hits[0][2] == before.hits[0][2] + 1);
+
+    for (size_t i = 0; i < entries; i++) CHECK(hit(cache, question("hot", static_cast<int>(i))));
+    CHECK(cache.stats().rejected == 0 && cache.stats().admitted == 0);
+}
+
+int main()
+{
+    admission();
+    protectedDemotion();
+
+    return checkResult("test_cache");
+}
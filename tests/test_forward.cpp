@@ -0,0 +1,262 @@
+/**
+ * 端到端测试：只缓存与转发请求匹配的上游响应（ctest：test_forward）
+ *
+ * 测试进程自己充当上游（127.0.0.1 上的一个 UDP 套接字），启动
+ *   dns-server --listen 127.0.0.1:<port> --resolver 127.0.0.1:<upstream>
+ * 上游按查询的名字决定怎样回答：
+ *   spoof.test  先发 ID 错误、Question 错误、QR=0 的三个报文（都回答 6.6.6.6），最后才发正确的回答 1.2.3.4
+ *   trunc.test  只回答 TC=1 的 NODATA（带 SOA），不能被缓存
+ * 客户端必须得到 1.2.3.4 / SERVFAIL；再次查询时 spoof.test 来自缓存，trunc.test 重新询问上游。
+ * 工作线程中的 forwardQuery() 和 --resolver-threads 的 UpstreamClient 各测一次。
+ *
+ * 用法：test_forward <dns-server 路径>
+ */
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.hpp"
+
+static sockaddr_in loopback(uint16_t port)
+{
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return address;
+}
+
+// 单问题 A / IN 查询
+static std::vector<uint8_t> makeQuery(uint16_t id, const std::string& name)
+{
+    std::vector<uint8_t> query = { static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id & 0xFF), 0x01, 0x00,
+                                   0, 1, 0, 0, 0, 0, 0, 0 };
+    size_t start = 0;
+    while (start < name.size())
+    {
+        size_t dot = name.find('.', start);
+        if (dot == std::string::npos) dot = name.size();
+        query.push_back(static_cast<uint8_t>(dot - start));
+        query.insert(query.end(), name.begin() + start, name.begin() + dot);
+        start = dot + 1;
+    }
+    query.insert(query.end(), { 0, 0, 1, 0, 1 });
+    return query;
+}
+
+// 查询中的第一个名字（点分文本）
+static std::string questionName(const std::vector<uint8_t>& query)
+{
+    std::string name;
+    for (size_t offset = 12; offset < query.size() && query[offset] != 0; offset += query[offset] + 1)
+    {
+        if (!name.empty()) name += '.';
+        name.append(reinterpret_cast<const char*>(&query[offset + 1]), query[offset]);
+    }
+    return name;
+}
+
+/**
+ * 在 request 之后追加回答：flags 为响应的第 3、4 字节；address 非空时带一条 A 记录，否则带一条 SOA
+ */
+static std::vector<uint8_t> makeReply(const std::vector<uint8_t>& request, uint16_t flags, const uint8_t* address)
+{
+    std::vector<uint8_t> reply = request;
+    reply[2] = flags >> 8;
+    reply[3] = flags & 0xFF;
+    if (address != nullptr)
+    {
+        reply[7] = 1;   // ANCOUNT
+        reply.insert(reply.end(), { 0xC0, 0x0C, 0, 1, 0, 1, 0, 0, 0x0E, 0x10, 0, 4 });
+        reply.insert(reply.end(), address, address + 4);
+    }
+    else
+    {
+        reply[9] = 1;   // NSCOUNT
+        reply.insert(reply.end(), { 0xC0, 0x0C, 0, 6, 0, 1, 0, 0, 0x0E, 0x10, 0, 24,
+                                    0xC0, 0x0C, 0xC0, 0x0C, 0, 0, 0, 1, 0, 0, 0x0E, 0x10,
+                                    0, 0, 0x02, 0x58, 0, 1, 0x51, 0x80, 0, 0, 0x01, 0x2C });
+    }
+    return reply;
+}
+
+struct FakeUpstream
+{
+    int socket = -1;
+    uint16_t port = 0;
+    std::atomic<int> spoofQueries{ 0 };
+    std::atomic<int> truncQueries{ 0 };
+    std::atomic<bool> stop{ false };
+
+    void serve()
+    {
+        static const uint8_t REAL[4] = { 1, 2, 3, 4 };
+        static const uint8_t FORGED[4] = { 6, 6, 6, 6 };
+        while (!stop)
+        {
+            pollfd readable = { socket, POLLIN, 0 };
+            if (poll(&readable, 1, 100) <= 0) continue;
+            std::vector<uint8_t> request(512);
+            sockaddr_in from{};
+            socklen_t fromLength = sizeof(from);
+            ssize_t received = recvfrom(socket, request.data(), request.size(), 0,
+                                        reinterpret_cast<sockaddr*>(&from), &fromLength);
+            if (received < 12) continue;
+            request.resize(static_cast<size_t>(received));
+
+            std::vector<std::vector<uint8_t>> replies;
+            std::string name = questionName(request);
+            if (name == "spoof.test")
+            {
+                spoofQueries++;
+                std::vector<uint8_t> wrongId = makeReply(request, 0x8180, FORGED);
+                wrongId[1] ^= 0x01;
+                std::vector<uint8_t> wrongQuestion = makeReply(request, 0x8180, FORGED);
+                wrongQuestion[13] = 'x';
+                replies = { wrongId, wrongQuestion, makeReply(request, 0x0180, FORGED), makeReply(request, 0x8180, REAL) };
+            }
+            else if (name == "trunc.test")
+            {
+                truncQueries++;
+                replies = { makeReply(request, 0x8380, nullptr) };
+            }
+            else
+            {
+                replies = { makeReply(request, 0x8180, REAL) };
+            }
+            for (const std::vector<uint8_t>& reply : replies)
+            {
+                sendto(socket, reply.data(), reply.size(), 0, reinterpret_cast<sockaddr*>(&from), fromLength);
+            }
+        }
+    }
+};
+
+// 发送 query，等待 timeoutMs 内的一个响应；没有响应时返回空
+static std::vector<uint8_t> exchange(int client, const std::vector<uint8_t>& query, int timeoutMs)
+{
+    send(client, query.data(), query.size(), 0);
+    pollfd ready = { client, POLLIN, 0 };
+    if (poll(&ready, 1, timeoutMs) <= 0) return {};
+    std::vector<uint8_t> response(4096);
+    ssize_t received = recv(client, response.data(), response.size(), 0);
+    if (received < 0) return {};
+    response.resize(static_cast<size_t>(received));
+    return response;
+}
+
+// 响应中第一条 Answer 的 A 记录地址（响应只有一个问题，Answer 的名字是压缩指针）
+static std::vector<uint8_t> firstAddress(const std::vector<uint8_t>& response, size_t questionEnd)
+{
+    if (response.size() < questionEnd + 16 || response[7] == 0) return {};
+    size_t rdata = questionEnd;
+    while (rdata < response.size() && response[rdata] != 0 && (response[rdata] & 0xC0) != 0xC0) rdata += response[rdata] + 1;
+    rdata += (response[rdata] & 0xC0) == 0xC0 ? 2 : 1;
+    rdata += 10;
+    if (rdata + 4 > response.size()) return {};
+    return std::vector<uint8_t>(response.begin() + rdata, response.begin() + rdata + 4);
+}
+
+// resolverThreads = "0"：工作线程中的 forwardQuery()；"1"：解析线程中的 UpstreamClient
+static void forwardValidation(const char* server, const char* resolverThreads)
+{
+    int failuresBefore = checkFailures();
+    FakeUpstream upstream;
+    upstream.socket = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in upstreamAddress = loopback(0);
+    bind(upstream.socket, reinterpret_cast<sockaddr*>(&upstreamAddress), sizeof(upstreamAddress));
+    socklen_t length = sizeof(upstreamAddress);
+    getsockname(upstream.socket, reinterpret_cast<sockaddr*>(&upstreamAddress), &length);
+    upstream.port = ntohs(upstreamAddress.sin_port);
+    std::thread upstreamThread([&upstream] { upstream.serve(); });
+
+    // 一个当前空闲的端口给 dns-server
+    int probe = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in serverAddress = loopback(0);
+    bind(probe, reinterpret_cast<sockaddr*>(&serverAddress), sizeof(serverAddress));
+    length = sizeof(serverAddress);
+    getsockname(probe, reinterpret_cast<sockaddr*>(&serverAddress), &length);
+    close(probe);
+
+    std::string listen = "127.0.0.1:" + std::to_string(ntohs(serverAddress.sin_port));
+    std::string resolver = "127.0.0.1:" + std::to_string(upstream.port);
+    pid_t child = fork();
+    if (child == 0)
+    {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        dup2(devNull, STDERR_FILENO);
+        execl(server, server, "--listen", listen.c_str(), "--resolver", resolver.c_str(), "--resolver-timeout", "500",
+              "--resolver-threads", resolverThreads, static_cast<char*>(nullptr));
+        _exit(127);
+    }
+
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    connect(client, reinterpret_cast<sockaddr*>(&serverAddress), sizeof(serverAddress));
+
+    // 等服务器开始监听（最多 5 秒）
+    bool ready = false;
+    for (int i = 0; i < 50 && !ready; i++)
+    {
+        ready = !exchange(client, makeQuery(1, "ready.test"), 100).empty();
+        if (!ready) usleep(100 * 1000);
+    }
+    CHECK(ready);
+
+    const std::vector<uint8_t> REAL = { 1, 2, 3, 4 };
+    std::vector<uint8_t> spoofQuery = makeQuery(0x1111, "spoof.test");
+    for (int round = 0; round < 2; round++)
+    {
+        std::vector<uint8_t> response = exchange(client, spoofQuery, 2000);
+        CHECK(response.size() > 12 && response[0] == 0x11 && response[1] == 0x11);
+        CHECK(response.size() > 12 && (response[3] & 0x0F) == 0);
+        CHECK(firstAddress(response, spoofQuery.size()) == REAL);
+    }
+    CHECK(upstream.spoofQueries == 1);   // 第二次来自缓存
+
+    std::vector<uint8_t> truncQuery = makeQuery(0x2222, "trunc.test");
+    int truncAsked = 0;
+    for (int round = 0; round < 2; round++)
+    {
+        std::vector<uint8_t> response = exchange(client, truncQuery, 2000);
+        CHECK(response.size() >= 12 && (response[3] & 0x0F) == 2);   // SERVFAIL
+        CHECK(response.size() >= 12 && response[7] == 0 && response[9] == 0);
+        // 截断的回答没有进入缓存：每次都重新询问上游（解析线程失败后还会按 --resolver-retries 重发）
+        CHECK(upstream.truncQueries > truncAsked);
+        truncAsked = upstream.truncQueries;
+    }
+
+    close(client);
+    kill(child, SIGTERM);
+    int status = 0;
+    waitpid(child, &status, 0);
+    upstream.stop = true;
+    upstreamThread.join();
+    close(upstream.socket);
+    if (checkFailures() > failuresBefore) std::cerr << "resolver threads: " << resolverThreads << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: test_forward <dns-server>" << std::endl;
+        return 2;
+    }
+
+    for (const char* resolverThreads : { "0", "1" }) forwardValidation(argv[1], resolverThreads);
+
+    return checkResult("test_forward");
+}
@@ -0,0 +1,83 @@
+/**
+ * 报文解析的回归测试（ctest：test_message）
+ *
+ * 每个用例是一个手工构造的报文，覆盖曾经出过问题的解析路径。
+ * 失败时输出用例名和条件，返回非 0。
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "dns_arena.hpp"
+#include "dns_message.hpp"
+#include "check.hpp"
+
+/**
+ * 压缩的 CNAME 后面跟着 SOA
+ *
+ * CNAME 的 RDATA 在报文中是 6 字节（\x03web + 指向 example.com 的指针），展开后是 17 字节。
+ * 下一条记录必须从报文中原始 RDATA 的末尾开始解析，而不是展开后的长度。
+ *
+ *   12  Question  www.example.com A IN      （example.com 在偏移 16）
+ *   33  Answer    www.example.com CNAME web.example.com     -> C0 0C ... 00 06 03 'web' C0 10
+ *   51  Authority example.com SOA ns.example.com hostmaster.example.com 1 3600 600 86400 300
+ */
+static void compressedCnameFollowedBySoa()
+{
+    std::vector<uint8_t> packet = {
+        0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+        // Question
+        3, 'w', 'w', 'w', 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0,
+        0x00, 0x01, 0x00, 0x01,
+        // Answer：CNAME，RDATA 使用压缩指针
+        0xC0, 0x0C, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x0E, 0x10, 0x00, 0x06,
+        3, 'w', 'e', 'b', 0xC0, 0x10,
+        // Authority：SOA
+        0xC0, 0x10, 0x00, 0x06, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2C, 0x00, 0x26,
+        2, 'n', 's', 0xC0, 0x10,
+        10, 'h', 'o', 's', 't', 'm', 'a', 's', 't', 'e', 'r', 0xC0, 0x10,
+        0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x0E, 0x10, 0x00, 0x00, 0x02, 0x58,
+        0x00, 0x01, 0x51, 0x80, 0x00, 0x00, 0x01, 0x2C,
+    };
+
+    RequestArena arena;
+    DNSHeader header;
+    CHECK(DNSHeader::parse(packet.data(), packet.size(), header) == ParseError::NONE);
+
+    size_t offset = 12;
+    DNSQuestion question(arena.resource());
+    CHECK(DNSQuestion::parse(packet.data(), packet.size(), offset, question) == ParseError::NONE);
+    CHECK(offset == 33);
+    CHECK(question.shardHash == SteeringHash::of("WWW.Example.com"));   // 解析时累加的分流哈希（缓存分片用）
+
+    DNSAnswer cname(arena.resource());
+    CHECK(DNSAnswer::parse(packet.data(), packet.size(), offset, cname) == ParseError::NONE);
+    CHECK(cname.type == 5);
+    CHECK(cname.rdlength == 17);
+    CHECK(cname.rdata.size() == 17);
+    CHECK(offset == 51);
+
+    DNSAnswer soa(arena.resource());
+    CHECK(DNSAnswer::parse(packet.data(), packet.size(), offset, soa) == ParseError::NONE);
+    CHECK(soa.name == "example.com");
+    CHECK(soa.type == 6);
+    CHECK(soa.ttl == 300);
+    CHECK(offset == packet.size());
+
+    // 展开后的 SOA：ns.example.com（16）+ hostmaster.example.com（24）+ 5 个 32 位整数（20）
+    CHECK(soa.rdlength == 60);
+    CHECK(soa.rdata.size() == 60);
+    if (soa.rdata.size() == 60)
+    {
+        const uint8_t* minimum = soa.rdata.data() + 56;
+        CHECK(((minimum[0] << 24) | (minimum[1] << 16) | (minimum[2] << 8) | minimum[3]) == 300);
+    }
+}
+
+int main()
+{
+    compressedCnameFollowedBySoa();
+
+    return checkResult("test_message");
+}
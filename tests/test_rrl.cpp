@@ -0,0 +1,96 @@
+/**
+ * 响应限速令牌桶的测试（ctest：test_rrl）
+ *
+ * rate 足够小，测试在一个 tick（1/64 秒）之内完成，令牌不会被补充。
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "check.hpp"
+#include "dns_rrl.hpp"
+
+using Action = ResponseRateLimiter::Action;
+
+static sockaddr_in client(const char* address)
+{
+    sockaddr_in client{};
+    client.sin_family = AF_INET;
+    inet_pton(AF_INET, address, &client.sin_addr);
+    return client;
+}
+
+static Action check(ResponseRateLimiter& limiter, const sockaddr_in& from, uint64_t key)
+{
+    return limiter.check(reinterpret_cast<const sockaddr*>(&from), key);
+}
+
+// 只有一个槽：所有键碰撞，共用同一个桶；交替使用两个键不会重新得到令牌
+static void collidingKeysShareBucket()
+{
+    RrlOptions options;
+    options.responsesPerSecond = 2;
+    options.slip = 2;
+    options.tableSize = 1;
+    ResponseRateLimiter limiter(options);
+    sockaddr_in from = client("192.0.2.1");
+    uint64_t a = ResponseRateLimiter::responseKey(0x1111, 0);
+    uint64_t b = ResponseRateLimiter::responseKey(0x2222, 0);
+
+    CHECK(check(limiter, from, a) == Action::SEND);
+    CHECK(check(limiter, from, b) == Action::SEND);
+    CHECK(check(limiter, from, a) == Action::SLIP);
+    CHECK(check(limiter, from, b) == Action::DROP);
+    CHECK(check(limiter, from, a) == Action::SLIP);
+    CHECK(check(limiter, from, b) == Action::DROP);
+
+    RrlStats stats = limiter.stats();
+    CHECK(stats.allowed == 2 && stats.slipped == 2 && stats.dropped == 2);
+}
+
+// slip 序号按桶计数：另一个客户端的超限响应不改变本桶哪些响应被截断
+static void slipSequencePerBucket()
+{
+    RrlOptions options;
+    options.responsesPerSecond = 1;
+    options.slip = 3;
+    ResponseRateLimiter limiter(options);
+    sockaddr_in first = client("192.0.2.1");
+    sockaddr_in second = client("198.51.100.1");
+    uint64_t key = ResponseRateLimiter::responseKey(0x3333, 0);
+
+    CHECK(check(limiter, first, key) == Action::SEND);
+    CHECK(check(limiter, second, key) == Action::SEND);
+
+    // 第二个客户端每轮超限两次，第一个客户端的序列仍然是 SLIP, DROP, DROP, SLIP, ...
+    const Action expected[] = { Action::SLIP, Action::DROP, Action::DROP, Action::SLIP, Action::DROP, Action::DROP };
+    for (Action action : expected)
+    {
+        CHECK(check(limiter, first, key) == action);
+        CHECK(check(limiter, second, key) != Action::SEND);
+        CHECK(check(limiter, second, key) != Action::SEND);
+    }
+}
+
+// slip = 0：超限的响应全部丢弃
+static void slipDisabled()
+{
+    RrlOptions options;
+    options.responsesPerSecond = 1;
+    options.slip = 0;
+    ResponseRateLimiter limiter(options);
+    sockaddr_in from = client("192.0.2.1");
+    uint64_t key = ResponseRateLimiter::responseKey(0x4444, 0);
+
+    CHECK(check(limiter, from, key) == Action::SEND);
+    for (int i = 0; i < 4; i++) CHECK(check(limiter, from, key) == Action::DROP);
+}
+
+int main()
+{
+    collidingKeysShareBucket();
+    slipSequencePerBucket();
+    slipDisabled();
+
+    return checkResult("test_rrl");
+}
@@ -0,0 +1,155 @@
+/**
+ * 端到端测试：RRL slip 对超过 512 字节的多问题查询回复截断响应（ctest：test_rrl_slip）
+ *
+ * 对每种 --io-engine 启动一个 dns-server：
+ *   dns-server --listen 127.0.0.1:<port> --rrl-rate 1 --rrl-slip 1 --io-engine <engine>
+ * 连续发送同一个 40 个问题（约 900 字节）的查询。第一个查询用掉令牌桶，之后的查询被 slip，
+ * 回复复制了全部 Question 的 TC=1 响应（与查询一样长）。最后用另一个名字确认服务器仍在运行。
+ *
+ * 用法：test_rrl_slip <dns-server 路径>
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.hpp"
+
+// 一个标准查询：每个名字一个 A / IN 问题
+static std::vector<uint8_t> makeQuery(uint16_t id, const std::vector<std::string>& names)
+{
+    std::vector<uint8_t> query = { static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id & 0xFF), 0x01, 0x00,
+                                   static_cast<uint8_t>(names.size() >> 8), static_cast<uint8_t>(names.size() & 0xFF),
+                                   0, 0, 0, 0, 0, 0 };
+    for (const std::string& name : names)
+    {
+        size_t start = 0;
+        while (start < name.size())
+        {
+            size_t dot = name.find('.', start);
+            if (dot == std::string::npos) dot = name.size();
+            query.push_back(static_cast<uint8_t>(dot - start));
+            query.insert(query.end(), name.begin() + start, name.begin() + dot);
+            start = dot + 1;
+        }
+        query.insert(query.end(), { 0, 0, 1, 0, 1 });
+    }
+    return query;
+}
+
+// 一个当前空闲的 UDP 端口
+static uint16_t freePort()
+{
+    int probe = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(probe, reinterpret_cast<sockaddr*>(&address), &length);
+    close(probe);
+    return ntohs(address.sin_port);
+}
+
+// 发送 query，等待 timeoutMs 内的一个响应；没有响应时返回空
+static std::vector<uint8_t> exchange(int client, const std::vector<uint8_t>& query, int timeoutMs)
+{
+    send(client, query.data(), query.size(), 0);
+    pollfd ready = { client, POLLIN, 0 };
+    if (poll(&ready, 1, timeoutMs) <= 0) return {};
+    std::vector<uint8_t> response(65535);
+    ssize_t received = recv(client, response.data(), response.size(), 0);
+    if (received < 0) return {};
+    response.resize(static_cast<size_t>(received));
+    return response;
+}
+
+static void slipLargeQuery(const char* server, const char* engine)
+{
+    int failuresBefore = checkFailures();
+    uint16_t port = freePort();
+    std::string listen = "127.0.0.1:" + std::to_string(port);
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        execl(server, server, "--listen", listen.c_str(), "--rrl-rate", "1", "--rrl-slip", "1", "--io-engine", engine,
+              static_cast<char*>(nullptr));
+        _exit(127);
+    }
+
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+
+    // 等服务器开始监听（最多 5 秒；监听之前 connect() 的套接字会立即收到 ECONNREFUSED）
+    std::vector<uint8_t> probe = makeQuery(1, { "ready.test" });
+    bool ready = false;
+    for (int i = 0; i < 50 && !ready; i++)
+    {
+        ready = !exchange(client, probe, 100).empty();
+        if (!ready) usleep(100 * 1000);
+    }
+    CHECK(ready);
+
+    std::vector<std::string> names;
+    for (int i = 0; i < 40; i++) names.push_back("name" + std::to_string(i) + ".slip.test");
+    std::vector<uint8_t> query = makeQuery(0x5150, names);
+    CHECK(query.size() > 512);
+
+    int truncated = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        std::vector<uint8_t> response = exchange(client, query, 1000);
+        if (response.size() < 12) continue;
+        CHECK(response[0] == 0x51 && response[1] == 0x50);
+        if ((response[2] & 0x02) == 0) continue;
+        // TC=1：Header + 全部 Question，没有记录
+        truncated++;
+        CHECK(response.size() == query.size());
+        CHECK(std::memcmp(response.data() + 12, query.data() + 12, query.size() - 12) == 0);
+        CHECK(response[4] == 0 && response[5] == 40);
+        CHECK(response[6] == 0 && response[7] == 0);
+    }
+    CHECK(truncated > 0);
+
+    // 另一个名字使用另一个令牌桶，得到完整的回答
+    std::vector<uint8_t> alive = exchange(client, makeQuery(2, { "alive.test" }), 1000);
+    CHECK(alive.size() > 12);
+    close(client);
+
+    kill(child, SIGTERM);
+    int status = 0;
+    waitpid(child, &status, 0);
+    CHECK(!WIFSIGNALED(status) || WTERMSIG(status) == SIGTERM);
+    if (checkFailures() > failuresBefore) std::cerr << "io engine: " << engine << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: test_rrl_slip <dns-server>" << std::endl;
+        return 2;
+    }
+
+    for (const char* engine : { "socket", "batch", "uring" }) slipLargeQuery(argv[1], engine);
+
+    return checkResult("test_rrl_slip");
+}
@@ -0,0 +1,117 @@
+/**
+ * 向量化标签处理与标量实现一致（ctest：test_simd）
+ *
+ * 长度 0 ~ 80 覆盖标量（< 16）、SSE2（16 ~ 31，以及无 AVX2 的 CPU）、AVX2（>= 32），
+ * 以及每种宽度的整块和重叠的尾部（17、31、33、63、64 ……）。
+ * 内容从 256 个起始字节开始按步长 7 循环，'A' / 'Z' / '@' / '[' 和 0x80 以上的字节都会出现在每个位置上。
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "dns_simd.hpp"
+#include "check.hpp"
+
+static constexpr size_t MAX_LENGTH = 80;
+static constexpr char GUARD = '\x5A';   // 目标缓冲区在 n 之后的字节，不能被改写
+
+static char scalarLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+static std::string pattern(size_t n, int start)
+{
+    std::string text(n, '\0');
+    for (size_t i = 0; i < n; i++) text[i] = static_cast<char>((start + 7 * i) & 0xFF);
+    return text;
+}
+
+static std::string lowered(const std::string& text)
+{
+    std::string out = text;
+    for (char& c : out) c = scalarLower(c);
+    return out;
+}
+
+// toLower：复制和原地转换都与逐字节转换相同，不写 n 之后的字节
+static void toLowerMatchesScalar()
+{
+    for (size_t n = 0; n <= MAX_LENGTH; n++)
+    {
+        for (int start = 0; start < 256; start++)
+        {
+            std::string text = pattern(n, start);
+            std::string expected = lowered(text);
+
+            std::vector<char> dst(n + 1, GUARD);
+            LabelSimd::toLower(dst.data(), text.data(), n);
+            CHECK(std::string(dst.data(), n) == expected);
+            CHECK(dst[n] == GUARD);
+
+            std::string inPlace = text;
+            LabelSimd::toLower(inPlace.data(), inPlace.data(), n);
+            CHECK(inPlace == expected);
+        }
+    }
+}
+
+// equalsLower：只差大小写时相等；任意一个位置（包括重叠的尾部）不同时不相等
+static void equalsLowerMatchesScalar()
+{
+    for (size_t n = 0; n <= MAX_LENGTH; n++)
+    {
+        for (int start = 0; start < 256; start += 5)
+        {
+            std::string text = pattern(n, start);
+            std::string lower = lowered(text);
+            CHECK(LabelSimd::equalsLower(lower.data(), text.data(), n));
+
+            for (size_t i = 0; i < n; i++)
+            {
+                // lower[i] + 1 转成小写后不可能等于 lower[i]
+                std::string changed = text;
+                changed[i] = static_cast<char>(lower[i] + 1);
+                CHECK(!LabelSimd::equalsLower(lower.data(), changed.data(), n));
+            }
+        }
+    }
+}
+
+// copyLabel：原样复制，不写 n 之后的字节；只有内容含 '.' 时返回 false，'.' 在哪个位置都能发现
+static void copyLabelMatchesScalar()
+{
+    for (size_t n = 0; n <= MAX_LENGTH; n++)
+    {
+        for (int start = 0; start < 256; start += 3)
+        {
+            std::string text = pattern(n, start);
+            std::vector<char> dst(n + 1, GUARD);
+            bool clean = LabelSimd::copyLabel(dst.data(), reinterpret_cast<const uint8_t*>(text.data()), n);
+            CHECK(clean == (text.find('.') == std::string::npos));
+            CHECK(std::memcmp(dst.data(), text.data(), n) == 0);
+            CHECK(dst[n] == GUARD);
+        }
+
+        std::string plain(n, 'a');
+        std::vector<char> dst(n + 1, GUARD);
+        CHECK(LabelSimd::copyLabel(dst.data(), reinterpret_cast<const uint8_t*>(plain.data()), n));
+        for (size_t i = 0; i < n; i++)
+        {
+            std::string dotted = plain;
+            dotted[i] = '.';
+            CHECK(!LabelSimd::copyLabel(dst.data(), reinterpret_cast<const uint8_t*>(dotted.data()), n));
+        }
+    }
+}
+
+int main()
+{
+    toLowerMatchesScalar();
+    equalsLowerMatchesScalar();
+    copyLabelMatchesScalar();
+
+    return checkResult("test_simd");
+}
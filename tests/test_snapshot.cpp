@@ -0,0 +1,248 @@
+/**
+ * 缓存快照的测试（ctest：test_snapshot）
+ *
+ * 保存 -> 加载后条目仍能按（不同大小写的）名字命中：哈希的种子不写进文件，加载时从键重新计算；
+ * 分片数不同的缓存之间也能互相加载。截断或损坏的文件被拒绝，只保留损坏位置之前的条目。
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "dns_cache.hpp"
+#include "dns_shards.hpp"
+#include "check.hpp"
+
+// 文件格式中的偏移（见 DnsCache::saveSnapshot）：Header 20 字节，第一个条目的 KEY_LEN 在 35，KEY 从 37 开始
+static constexpr size_t VERSION_OFFSET = 4;
+static constexpr size_t FIRST_KEY_LENGTH_OFFSET = 35;
+static constexpr size_t FIRST_KEY_OFFSET = 37;
+
+static DNSQuestion question(const std::string& name)
+{
+    DNSQuestion question;
+    question.name = name;
+    question.type = 1;
+    question.qclass = 1;
+    question.computeHash();
+    return question;
+}
+
+static DNSAnswer record(const std::string& name, uint16_t type, std::vector<uint8_t> rdata)
+{
+    DNSAnswer record;
+    record.name = name;
+    record.type = type;
+    record.aclass = 1;
+    record.ttl = 3600;
+    record.rdlength = static_cast<uint16_t>(rdata.size());
+    record.rdata.assign(rdata.begin(), rdata.end());
+    return record;
+}
+
+// example.test SOA：MNAME、RNAME 为空名字（各 1 字节）+ 5 个 32 位整数，MINIMUM = 300
+static DNSAnswer soa()
+{
+    return record("example.test", 6, { 0, 0, 0, 0, 0, 1, 0, 0, 0x0E, 0x10, 0, 0, 0x02, 0x58,
+                                       0, 1, 0x51, 0x80, 0, 0, 0x01, 0x2C });
+}
+
+/**
+ * 按插入顺序写进文件的三个条目（每段从旧到新，先正向后否定）：
+ *   WWW.Example.test   A 192.0.2.1
+ *   mail.example.test  A 192.0.2.2, 192.0.2.3
+ *   missing.example.test  NXDOMAIN + SOA（否定分区，在文件的最后）
+ */
+template <class Cache>
+static void fill(Cache& cache)
+{
+    cache.insertPositive(question("WWW.Example.test"), { record("WWW.Example.test", 1, { 192, 0, 2, 1 }) });
+    cache.insertPositive(question("mail.example.test"), { record("mail.example.test", 1, { 192, 0, 2, 2 }),
+                                                          record("mail.example.test", 1, { 192, 0, 2, 3 }) });
+    cache.insertNegative(question("missing.example.test"), DnsCache::RCODE_NXDOMAIN, soa());
+}
+
+// fill() 写入的条目都能命中，内容与写入时相同
+template <class Cache>
+static void checkFilled(Cache& cache)
+{
+    CacheResult www;
+    CHECK(cache.lookup(question("www.EXAMPLE.test"), www));
+    CHECK(www.rcode == 0 && www.answers.size() == 1);
+    if (www.answers.size() == 1)
+    {
+        CHECK(www.answers[0].rdata == std::pmr::vector<uint8_t>({ 192, 0, 2, 1 }));
+        CHECK(www.answers[0].ttl <= 3600 && www.answers[0].ttl > 3500);
+    }
+
+    CacheResult mail;
+    CHECK(cache.lookup(question("mail.example.test"), mail));
+    CHECK(mail.answers.size() == 2);
+
+    CacheResult missing;
+    CHECK(cache.lookup(question("missing.example.test"), missing));
+    CHECK(missing.rcode == DnsCache::RCODE_NXDOMAIN);
+    CHECK(missing.answers.empty() && missing.authorities.size() == 1);
+    if (missing.authorities.size() == 1) CHECK(missing.authorities[0].ttl <= 300);
+}
+
+static std::string tempPath()
+{
+    char path[] = "/tmp/test_snapshot.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) close(fd);
+    return path;
+}
+
+static std::vector<uint8_t> readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        .write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+// 保存的快照：fill() 的三个条目
+static std::vector<uint8_t> savedSnapshot()
+{
+    DnsCache cache{ CacheOptions() };
+    fill(cache);
+    std::string path = tempPath();
+    std::string error;
+    CHECK(cache.saveSnapshot(path, error) == 3);
+    std::vector<uint8_t> bytes = readFile(path);
+    unlink(path.c_str());
+    return bytes;
+}
+
+// 把 bytes 作为快照加载到一个新的缓存；返回 loadSnapshot() 的结果
+static long loadBytes(const std::vector<uint8_t>& bytes, DnsCache& cache, std::string& error)
+{
+    std::string path = tempPath();
+    writeFile(path, bytes);
+    error.clear();
+    long loaded = cache.loadSnapshot(path, error);
+    unlink(path.c_str());
+    return loaded;
+}
+
+// 保存 -> 加载：条目、记录和 RCODE 都还原，大小写不同的名字也能命中（哈希从键重新计算）
+static void roundTrip()
+{
+    DnsCache cache{ CacheOptions() };
+    std::string error;
+    CHECK(loadBytes(savedSnapshot(), cache, error) == 3);
+    CHECK(error.empty());
+    checkFilled(cache);
+}
+
+// 4 个分片保存的快照加载到 3 个分片：条目按名字重新分配，查询时仍落在同一个分片上
+static void reshard()
+{
+    std::string path = tempPath();
+    std::string error;
+    {
+        ShardedCache four(CacheOptions(), 4);
+        fill(four);
+        for (int i = 0; i < 20; i++)
+        {
+            std::string name = "host" + std::to_string(i) + ".example.test";
+            four.insertPositive(question(name), { record(name, 1, { 192, 0, 2, static_cast<uint8_t>(i) }) });
+        }
+        CHECK(four.saveSnapshot(path, error) == 23);
+    }
+
+    ShardedCache three(CacheOptions(), 3);
+    CHECK(three.loadSnapshot(path, error) == 23);
+    unlink(path.c_str());
+    checkFilled(three);
+    for (int i = 0; i < 20; i++)
+    {
+        CacheResult result;
+        CHECK(three.lookup(question("HOST" + std::to_string(i) + ".example.test"), result));
+        CHECK(result.answers.size() == 1 && result.answers[0].rdata[3] == i);
+    }
+}
+
+// 截断：Header 不完整时整个文件被拒绝；条目不完整时只保留之前的条目
+static void truncated()
+{
+    std::vector<uint8_t> bytes = savedSnapshot();
+    std::string error;
+
+    {
+        DnsCache cache{ CacheOptions() };
+        CHECK(loadBytes(std::vector<uint8_t>(bytes.begin(), bytes.begin() + 10), cache, error) == -1);
+        CHECK(error.find("is not a cache snapshot") != std::string::npos);
+    }
+
+    {
+        DnsCache cache{ CacheOptions() };
+        CHECK(loadBytes(std::vector<uint8_t>(bytes.begin(), bytes.end() - 1), cache, error) == 2);
+        CHECK(error.find("is truncated after 2 entries") != std::string::npos);
+        CacheResult result;
+        CHECK(cache.lookup(question("www.example.test"), result));
+        CHECK(!cache.lookup(question("missing.example.test"), result));
+    }
+}
+
+// 损坏：魔数或版本不对时整个文件被拒绝；条目的长度或键损坏时不加载它和之后的条目
+static void corrupted()
+{
+    std::vector<uint8_t> bytes = savedSnapshot();
+    std::string error;
+
+    {
+        std::vector<uint8_t> badMagic = bytes;
+        badMagic[0] = 'X';
+        DnsCache cache{ CacheOptions() };
+        CHECK(loadBytes(badMagic, cache, error) == -1);
+        CHECK(error.find("is not a cache snapshot") != std::string::npos);
+    }
+
+    {
+        std::vector<uint8_t> badVersion = bytes;
+        badVersion[VERSION_OFFSET + 1]++;
+        DnsCache cache{ CacheOptions() };
+        CHECK(loadBytes(badVersion, cache, error) == -1);
+    }
+
+    {
+        // KEY_LEN 超出文件：读不到键
+        std::vector<uint8_t> badLength = bytes;
+        badLength[FIRST_KEY_LENGTH_OFFSET] = 0xFF;
+        DnsCache cache{ CacheOptions() };
+        CHECK(loadBytes(badLength, cache, error) == 0);
+        CHECK(error.find("is truncated after 0 entries") != std::string::npos);
+        CacheResult result;
+        CHECK(!cache.lookup(question("mail.example.test"), result));
+    }
+
+    {
+        // 键中域名之后的 '\0' 被改写："www.example.test" 占 16 字节
+        std::vector<uint8_t> badKey = bytes;
+        CHECK(badKey[FIRST_KEY_OFFSET + 16] == 0);
+        badKey[FIRST_KEY_OFFSET + 16] = 'x';
+        DnsCache cache{ CacheOptions() };
+        CHECK(loadBytes(badKey, cache, error) == 0);
+        CHECK(error.find("is corrupt after 0 entries") != std::string::npos);
+    }
+}
+
+int main()
+{
+    roundTrip();
+    reshard();
+    truncated();
+    corrupted();
+
+    return checkResult("test_snapshot");
+}
@@ -0,0 +1,97 @@
+/**
+ * 区域文件加载的回归测试（ctest：test_zone）
+ *
+ * 每个用例写一个临时区域文件，检查 AuthZone::load() 接受或拒绝它，以及拒绝时带行号的错误描述。
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "dns_zone.hpp"
+#include "check.hpp"
+
+// 加载 text；返回 load() 的结果，error 为错误描述
+static bool loadZone(const std::string& text, std::string& error)
+{
+    char path[] = "/tmp/test_zone.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return false;
+    close(fd);
+    std::ofstream(path) << text;
+    AuthZone zone;
+    bool loaded = zone.load(path, error);
+    unlink(path);
+    return loaded;
+}
+
+static const std::string HEADER =
+    "$ORIGIN example.com.\n"
+    "$TTL 300\n"
+    "@ IN SOA ns hostmaster 1 3600 600 86400 300\n";
+
+// 63 字节的标签可以加载，64 字节的被拒绝（在所有者、RDATA 和 $ORIGIN 中）
+static void labelLength()
+{
+    std::string label63(63, 'a');
+    std::string label64(64, 'a');
+    std::string error;
+
+    CHECK(loadZone(HEADER + label63 + " A 192.0.2.1\n", error));
+
+    CHECK(!loadZone(HEADER + label64 + " A 192.0.2.1\n", error));
+    CHECK(error.find(":4: label longer than 63 bytes") != std::string::npos);
+
+    CHECK(!loadZone(HEADER + "www CNAME " + label64 + "\n", error));
+    CHECK(error.find(":4: label longer than 63 bytes") != std::string::npos);
+
+    CHECK(!loadZone(HEADER + "@ MX 10 " + label64 + "\n", error));
+    CHECK(error.find(":4: label longer than 63 bytes") != std::string::npos);
+
+    CHECK(!loadZone("$ORIGIN " + label64 + ".com.\n", error));
+    CHECK(error.find(":1: label longer than 63 bytes") != std::string::npos);
+}
+
+// 空标签（a..b、以 '.' 开头）被拒绝
+static void emptyLabel()
+{
+    std::string error;
+
+    CHECK(!loadZone(HEADER + "a..b A 192.0.2.1\n", error));
+    CHECK(error.find(":4: empty label") != std::string::npos);
+
+    CHECK(!loadZone(HEADER + "www NS ns..example.com.\n", error));
+    CHECK(error.find(":4: empty label") != std::string::npos);
+
+    CHECK(!loadZone("$ORIGIN example.com.\n@ SOA .ns hostmaster 1 2 3 4 5\n", error));
+    CHECK(error.find(":2: empty label") != std::string::npos);
+}
+
+// 线格式正好 255 字节的域名可以加载，256 字节的被拒绝
+static void nameLength()
+{
+    // 3 个 61 字节的标签 + 1 个 55 字节的标签 = 3 * 62 + 56 = 242，加上 example.com 和结尾的 0（13）= 255
+    std::string label61(61, 'b');
+    std::string fits = label61 + "." + label61 + "." + label61 + "." + std::string(55, 'b');
+    std::string tooLong = label61 + "." + label61 + "." + label61 + "." + std::string(56, 'b');
+    std::string error;
+
+    CHECK(loadZone(HEADER + fits + " A 192.0.2.1\n", error));
+
+    CHECK(!loadZone(HEADER + tooLong + " A 192.0.2.1\n", error));
+    CHECK(error.find(":4: name longer than 255 bytes") != std::string::npos);
+
+    CHECK(!loadZone(HEADER + "www PTR " + tooLong + "\n", error));
+    CHECK(error.find(":4: name longer than 255 bytes") != std::string::npos);
+}
+
+int main()
+{
+    labelLength();
+    emptyLabel();
+    nameLength();
+
+    return checkResult("test_zone");
+}